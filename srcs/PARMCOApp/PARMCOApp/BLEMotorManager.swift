@@ -22,6 +22,7 @@ import CoreBluetooth
  * CALLBACKS:
  * - onReadyStateChanged: Called when BLE connection is established/lost
  * - onRPMUpdate: Called when new RPM data arrives
+ * - onMotorStatus: Called for per-motor status lines ("sync1:...", "fault0:...")
  * - onStatusUpdate: Called for general status messages
  */
 
@@ -41,6 +42,11 @@ class BLEMotorManager: NSObject {
     var onStatusUpdate: ((String) -> Void)?             // General status messages
     var onReadyStateChanged: ((Bool) -> Void)?          // Connection ready/not ready
     var onRPMUpdate: ((String) -> Void)?                 // RPM updates from motor
+    var onMotorStatus: ((String, Int, [String]) -> Void)?  // Per-motor status: tag, motor, fields
+    
+    // Notifications are pieces of newline-terminated lines (split at the ATT MTU)
+    private var statusBuffer = ""
+    private let MAX_STATUS_LINE = 1024  // Drop a line that never ends
     
     /**
      * SETUP BLE CONNECTION
@@ -61,6 +67,7 @@ class BLEMotorManager: NSObject {
         
         self.peripheral = peripheral
         self.peripheral?.delegate = self  // Receive BLE events
+        statusBuffer = ""  // Drop a line cut off by the last connection
         
         // Discover Nordic UART Service (6E400001...)
         print("🔍 Looking for Nordic UART Service: \(UART_SERVICE_UUID.uuidString)")
@@ -266,12 +273,14 @@ extension BLEMotorManager: CBPeripheralDelegate {
      * 
      * PROTOCOL:
      * - RPM data arrives as notifications on TX characteristic (UART_TX_UUID)
-     * - Format: Plain number string (e.g., "1234.56")
+     * - Every line ends with "\n"; ble_server.c splits lines longer than one
+     *   notification (ATT MTU - 3 bytes), so pieces are joined up to the newline
      * - Updates are sent every 100ms by ble_server.c
      * 
-     * PARSING:
-     * - If value is numeric (e.g., "1234.56") → RPM update
-     * - If value is text → Status message
+     * PARSING (per line):
+     * - If value is numeric (e.g., "1234.56") → RPM update (motor 0)
+     * - If value is "<tag>N:a,b,..." (rpm, sync, spec, fault, sysid) → motor status
+     * - Other text → Status message
      * 
      * @param peripheral: The Raspberry Pi peripheral
      * @param characteristic: The characteristic that updated (should be TX)
@@ -285,23 +294,46 @@ extension BLEMotorManager: CBPeripheralDelegate {
         
         // Check if this is the TX characteristic (RPM data)
         if characteristic.uuid == UART_TX_UUID {
-            if let data = characteristic.value, let status = String(data: data, encoding: .utf8) {
-                print("📥 Motor status from UART TX: \(status)")
-                NSLog("📥 Status: \(status)")
-                
-                // PARSE VALUE: Is it RPM (number) or status (text)?
-                let trimmed = status.trimmingCharacters(in: .whitespacesAndNewlines)
-                if trimmed.range(of: #"^\d+\.?\d*$"#, options: .regularExpression) != nil {
-                    // It's a numeric value → RPM update
-                    onRPMUpdate?(trimmed)
-                } else {
-                    // It's text → Status message
-                    onStatusUpdate?(status)
+            if let data = characteristic.value, let piece = String(data: data, encoding: .utf8) {
+                statusBuffer += piece
+                while let newline = statusBuffer.firstIndex(of: "\n") {
+                    let line = String(statusBuffer[..<newline])
+                    statusBuffer.removeSubrange(...newline)
+                    handleStatusLine(line)
+                }
+                if statusBuffer.count > MAX_STATUS_LINE {
+                    statusBuffer = ""
                 }
             }
         }
     }
     
+    /**
+     * HANDLE ONE STATUS LINE
+     * @param line: Complete line from the TX characteristic, without the newline
+     */
+    private func handleStatusLine(_ line: String) {
+        print("📥 Motor status from UART TX: \(line)")
+        NSLog("📥 Status: \(line)")
+        
+        // PARSE VALUE: Is it RPM (number), a motor status line or other text?
+        let trimmed = line.trimmingCharacters(in: .whitespacesAndNewlines)
+        if trimmed.range(of: #"^\d+\.?\d*$"#, options: .regularExpression) != nil {
+            // It's a numeric value → RPM update
+            onRPMUpdate?(trimmed)
+        } else if let match = trimmed.range(of: #"^(rpm|sync|spec|fault|sysid)\d+:"#, options: .regularExpression) {
+            // "<tag>N:fields" → motor status
+            let head = trimmed[match].dropLast()  // "sync1"
+            let tag = String(head.prefix { !$0.isNumber })
+            let motor = Int(head.dropFirst(tag.count)) ?? 0
+            let fields = trimmed[match.upperBound...].split(separator: ",", omittingEmptySubsequences: false).map(String.init)
+            onMotorStatus?(tag, motor, fields)
+        } else {
+            // It's text → Status message
+            onStatusUpdate?(line)
+        }
+    }
+    
     func peripheral(_ peripheral: CBPeripheral, didWriteValueFor characteristic: CBCharacteristic, error: Error?) {
         if let error = error {
             print("❌ Error writing value: \(error.localizedDescription)")
@@ -67,6 +67,11 @@ class MainTabBarController: UITabBarController {
             self?.motorControlVC.updateRPM(rpmString)
         }
         
+        // Forward per-motor status (sync lock, faults, vibration, system identification)
+        bleManager.onMotorStatus = { [weak self] tag, motor, fields in
+            self?.motorControlVC.updateMotorStatus(tag: tag, motor: motor, fields: fields)
+        }
+        
         // SETUP CONNECTION CALLBACK
         // Show/hide Motor Control and Game tabs based on connection status
         connectionsVC.onConnectionChanged = { [weak self] isConnected, peripheral in
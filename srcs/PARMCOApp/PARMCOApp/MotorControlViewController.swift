@@ -38,6 +38,10 @@ class MotorControlViewController: UIViewController {
     let rpmValueLabel = UILabel()  // Separate label below speedometer
     let MAX_RPM: CGFloat = 14500.0
     
+    // 7. Per-motor status (sync lock, faults, vibration, system identification)
+    let telemetryLabel = UILabel()
+    var telemetry: [String: String] = [:]  // Latest line per "<tag>N", e.g. "sync1"
+    
     override func viewDidLoad() {
         super.viewDidLoad()
         
@@ -166,6 +170,12 @@ class MotorControlViewController: UIViewController {
         rpmValueLabel.textColor = .systemBlue
         rpmValueLabel.textAlignment = .center
         
+        // Per-motor status below the mode selector (empty until a status line arrives)
+        telemetryLabel.font = UIFont.monospacedSystemFont(ofSize: 13, weight: .regular)
+        telemetryLabel.textColor = .lightGray
+        telemetryLabel.textAlignment = .center
+        telemetryLabel.numberOfLines = 0
+        
         // Add all subviews
         view.addSubview(titleLabel)
         view.addSubview(startStopButton)
@@ -182,6 +192,7 @@ class MotorControlViewController: UIViewController {
         view.addSubview(desiredRPMSliderContainer)
         desiredRPMSliderContainer.addSubview(desiredRPMSlider)
         view.addSubview(desiredRPMValueLabel)
+        view.addSubview(telemetryLabel)
         
         // Disable autoresizing masks
         titleLabel.translatesAutoresizingMaskIntoConstraints = false
@@ -199,6 +210,7 @@ class MotorControlViewController: UIViewController {
         desiredRPMSliderContainer.translatesAutoresizingMaskIntoConstraints = false
         desiredRPMSlider.translatesAutoresizingMaskIntoConstraints = false
         desiredRPMValueLabel.translatesAutoresizingMaskIntoConstraints = false
+        telemetryLabel.translatesAutoresizingMaskIntoConstraints = false
         
         // Layout constraints - REORGANIZED ORDER:
         // 1. START/STOP and Rotation side by side
@@ -275,7 +287,12 @@ class MotorControlViewController: UIViewController {
             modeSegmentedControl.topAnchor.constraint(equalTo: modeLabel.bottomAnchor, constant: 10),
             modeSegmentedControl.centerXAnchor.constraint(equalTo: view.centerXAnchor),
             modeSegmentedControl.widthAnchor.constraint(equalToConstant: 280),
-            modeSegmentedControl.heightAnchor.constraint(equalToConstant: 40)
+            modeSegmentedControl.heightAnchor.constraint(equalToConstant: 40),
+            
+            // 5. Per-motor status
+            telemetryLabel.topAnchor.constraint(equalTo: modeSegmentedControl.bottomAnchor, constant: 15),
+            telemetryLabel.leadingAnchor.constraint(equalTo: view.leadingAnchor, constant: 20),
+            telemetryLabel.trailingAnchor.constraint(equalTo: view.trailingAnchor, constant: -20)
         ])
     }
     
@@ -487,5 +504,37 @@ class MotorControlViewController: UIViewController {
             }
         }
     }
+    
+    /**
+     * UPDATE PER-MOTOR STATUS
+     * Called for every "<tag>N:fields" line from the Raspberry Pi (see
+     * motor_control_ble_pipe.c sendSyncStatus/sendSpectrum/sendFault/sendSysid).
+     * Keeps the latest line of each kind and motor on screen.
+     * 
+     * @param tag: "rpm", "sync", "spec", "fault" or "sysid"
+     * @param motor: Motor number N
+     * @param fields: Comma-separated values after the colon
+     */
+    func updateMotorStatus(tag: String, motor: Int, fields: [String]) {
+        let text: String
+        switch tag {
+        case "rpm" where fields.count >= 1:
+            text = "M\(motor): \(fields[0]) RPM"
+        case "sync" where fields.count >= 4:
+            text = "M\(motor) sync: \(fields[3] == "1" ? "LOCKED" : "not locked"), speed \(fields[0]) RPM, phase \(fields[1])°"
+        case "spec" where fields.count >= 2:
+            text = "M\(motor) vibration: imbalance \(fields[0])°, jitter \(fields[1])°"
+        case "fault" where fields.count >= 2:
+            text = fields[0] == "none" ? "" : "M\(motor) FAULT: \(fields[0]) (\(fields[1]))"
+        case "sysid" where fields.count >= 5:
+            text = "M\(motor) sysid: \(fields[1]) RPM/%, bandwidth \(fields[2]) Hz, margin \(fields[4])°"
+        default:
+            return
+        }
+        DispatchQueue.main.async {
+            self.telemetry["\(tag)\(motor)"] = text.isEmpty ? nil : text
+            self.telemetryLabel.text = self.telemetry.keys.sorted().compactMap { self.telemetry[$0] }.joined(separator: "\n")
+        }
+    }
 }
 
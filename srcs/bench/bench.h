@@ -0,0 +1,189 @@
+/*
+ * bench.h
+ * Minimal microbenchmark harness shared by the PARMCO benchmark programs.
+ *
+ * Each benchmark binary is a single translation unit that #includes the
+ * program under test with -DPARMCO_NO_MAIN, then calls bench_run() for every
+ * hot function. For each benchmark it reports:
+ *   - ns/call      wall clock (CLOCK_MONOTONIC)
+ *   - cycles/call  user-space CPU cycles from perf_event_open()
+ *                  ("n/a" if /proc/sys/kernel/perf_event_paranoid forbids it)
+ *   - allocs/call  malloc/calloc/realloc/posix_memalign calls (GLib included)
+ *   - bytes/call   bytes requested by those calls
+ *
+ * Allocation counting interposes the C allocator, so this header must be
+ * included exactly once per program (glibc only).
+ */
+
+#ifndef PARMCO_BENCH_H
+#define PARMCO_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define BENCH_DEFAULT_ITERS 1000000UL
+
+// ============================================================================
+// ALLOCATION COUNTING
+// ============================================================================
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static unsigned long bench_alloc_count = 0;
+static unsigned long bench_alloc_bytes = 0;
+
+static inline void bench_note_alloc(size_t size) {
+    __atomic_fetch_add(&bench_alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bench_alloc_bytes, size, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+    bench_note_alloc(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    bench_note_alloc(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    bench_note_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    bench_note_alloc(size);
+    *memptr = __libc_memalign(alignment, size);
+    return *memptr ? 0 : 12;  // ENOMEM
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+// ============================================================================
+// CYCLE COUNTER
+// ============================================================================
+
+static int bench_cycles_fd = -2;  // -2 = not opened yet, -1 = unavailable
+
+static void bench_cycles_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    bench_cycles_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (bench_cycles_fd < 0) {
+        bench_cycles_fd = -1;
+    }
+}
+
+static void bench_cycles_start(void) {
+    if (bench_cycles_fd == -2) bench_cycles_open();
+    if (bench_cycles_fd < 0) return;
+    ioctl(bench_cycles_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(bench_cycles_fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+// Returns cycles since bench_cycles_start(), or -1 if unavailable
+static long long bench_cycles_stop(void) {
+    if (bench_cycles_fd < 0) return -1;
+    ioctl(bench_cycles_fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long cycles = 0;
+    if (read(bench_cycles_fd, &cycles, sizeof(cycles)) != sizeof(cycles)) return -1;
+    return cycles;
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+typedef void (*bench_fn)(void *ctx, unsigned long iteration);
+
+// Results go here; bench_silence_stdout() keeps the code under test quiet
+static FILE *bench_out = NULL;
+static unsigned long bench_iters = BENCH_DEFAULT_ITERS;
+
+static double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Parses the optional iteration count argument and prints the table header.
+ * Usage: bench_xxx [iterations]
+ */
+static void bench_init(const char *title, int argc, char *argv[]) {
+    if (!bench_out) bench_out = stdout;
+    if (argc > 1) {
+        unsigned long n = strtoul(argv[1], NULL, 10);
+        if (n > 0) bench_iters = n;
+    }
+    fprintf(bench_out, "\n=== %s (%lu iterations) ===\n\n", title, bench_iters);
+    fprintf(bench_out, "%-36s %12s %12s %12s %12s\n",
+            "benchmark", "ns/call", "cycles/call", "allocs/call", "bytes/call");
+    fflush(bench_out);
+}
+
+/**
+ * Redirects stdout to /dev/null so printf() inside the code under test does
+ * not dominate the measurement. Results keep going to the original stdout.
+ */
+static inline void bench_silence_stdout(void) {
+    fflush(stdout);
+    bench_out = fdopen(dup(STDOUT_FILENO), "w");
+    if (!freopen("/dev/null", "w", stdout)) {
+        perror("freopen");
+    }
+}
+
+static void bench_run(const char *name, bench_fn fn, void *ctx) {
+    // Warm up caches, branch predictors and lazy allocations
+    unsigned long warmup = bench_iters / 100 + 1;
+    for (unsigned long i = 0; i < warmup; i++) fn(ctx, i);
+
+    unsigned long allocs_before = bench_alloc_count;
+    unsigned long bytes_before = bench_alloc_bytes;
+    double t0 = bench_now_ns();
+    bench_cycles_start();
+
+    for (unsigned long i = 0; i < bench_iters; i++) fn(ctx, i);
+
+    long long cycles = bench_cycles_stop();
+    double t1 = bench_now_ns();
+    unsigned long allocs = bench_alloc_count - allocs_before;
+    unsigned long bytes = bench_alloc_bytes - bytes_before;
+
+    char cycles_str[32];
+    if (cycles >= 0) {
+        snprintf(cycles_str, sizeof(cycles_str), "%.1f", (double)cycles / bench_iters);
+    } else {
+        snprintf(cycles_str, sizeof(cycles_str), "n/a");
+    }
+
+    fprintf(bench_out, "%-36s %12.1f %12s %12.2f %12.1f\n",
+            name, (t1 - t0) / bench_iters, cycles_str,
+            (double)allocs / bench_iters, (double)bytes / bench_iters);
+    fflush(bench_out);
+}
+
+#endif // PARMCO_BENCH_H
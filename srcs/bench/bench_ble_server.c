@@ -0,0 +1,72 @@
+/*
+ * bench_ble_server.c
+ * Microbenchmarks for the ble_server.c hot paths.
+ *
+ * The program under test is compiled into this file with PARMCO_NO_MAIN.
+ * Nothing touches D-Bus, so no Bluetooth adapter is needed.
+ *
+ * Compilation (on the Pi, from srcs/bench):
+ * gcc -O2 -o bench_ble_server bench_ble_server.c `pkg-config --cflags --libs glib-2.0 gio-2.0 gio-unix-2.0` -lpthread
+ *
+ * Run:
+ * ./bench_ble_server [iterations] > bench_output.txt
+ */
+
+#define PARMCO_NO_MAIN
+#include "../ble_server.c"
+#include "bench.h"
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+static const char *bench_lines[] = {
+    "rpm:0.00", "rpm:1234.56", "rpm:987.10", "rpm:10000.00",
+};
+
+// Line parse only (rejected line: no GVariant is built)
+static void bench_parse_reject(void *arg, unsigned long i) {
+    (void)arg;
+    (void)i;
+    const char *text = status_text("status:ok");
+    if (text) g_variant_unref(g_variant_ref_sink(build_value_notification((const guint8 *)text, 1)));
+}
+
+// handle_pipe_line: parse "rpm:" line and build the PropertiesChanged parameters
+static void bench_rpm_notification(void *arg, unsigned long i) {
+    (void)arg;
+    const char *text = status_text(bench_lines[i % 4]);
+    GVariant *v = build_value_notification((const guint8 *)text, strlen(text));
+    g_variant_unref(g_variant_ref_sink(v));
+}
+
+// history_pipe_line "end": encode a full 600-point transfer at the largest chunk size
+static void bench_history_encode(void *arg, unsigned long i) {
+    (void)arg;
+    (void)i;
+    history.num_chunks = encode_history_chunks(HISTORY_CHUNK_MAX);
+}
+
+static void history_fill(void) {
+    history.num_points = HISTORY_MAX_POINTS;
+    history.step_ms = 100;
+    for (int k = 0; k < HISTORY_MAX_POINTS; k++) {
+        history.points[k].age_ms = (HISTORY_MAX_POINTS - k) * 100;
+        history.points[k].rpm10 = 25000 + (k * 37) % 200;
+        history.points[k].setpoint10 = 25000;
+        history.points[k].duty10 = 500;
+        history.points[k].mode = 1;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench_silence_stdout();
+    bench_init("ble_server hot paths", argc, argv);
+
+    bench_run("status_text (reject)", bench_parse_reject, NULL);
+    bench_run("build_value_notification (rpm)", bench_rpm_notification, NULL);
+    history_fill();
+    bench_run("encode_history_chunks (600 points)", bench_history_encode, NULL);
+
+    return 0;
+}
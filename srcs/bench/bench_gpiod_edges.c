@@ -0,0 +1,200 @@
+/*
+ * bench_gpiod_edges.c
+ * Edge throughput and timestamp accuracy of the gpiod tachometer capture,
+ * measured without hardware on the kernel's gpio-sim module.
+ *
+ * A gpio-sim chip is created through configfs. A driver thread toggles the
+ * simulated line's pull (which the kernel turns into real edge interrupts)
+ * at a fixed rate, noting CLOCK_MONOTONIC just before each toggle. The main
+ * thread reads the edges through the HAL exactly like rpmThread does and
+ * compares them with the driver's timestamps.
+ *
+ * Requirements: root, CONFIG_GPIO_SIM (sudo modprobe gpio-sim), configfs mounted.
+ *
+ * Compilation (from srcs/bench):
+ * gcc -O2 -DPARMCO_NO_PIGPIO -DPARMCO_WITH_GPIOD -o bench_gpiod_edges bench_gpiod_edges.c \
+ *     ../motor_hal*.c -lgpiod -lpthread -lm
+ *
+ * Run:
+ * sudo ./bench_gpiod_edges [edges] [period_us] [--debounce-us=N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "../motor_hal.h"
+
+#define SIM_CONFIGFS "/sys/kernel/config/gpio-sim/parmco-bench"
+#define SIM_LINE 0
+#define MAX_EDGES 200000
+
+static unsigned g_num_edges = 20000;
+static unsigned g_period_us = 200;
+static char g_pull_path[256];
+static uint64_t g_sent_ns[MAX_EDGES];
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int writeFile(const char* path, const char* value) {
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) return -1;
+    ssize_t n = write(fd, value, strlen(value));
+    close(fd);
+    return n < 0 ? -1 : 0;
+}
+
+static int readFile(const char* path, char* buf, size_t size) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    if (!fgets(buf, size, f)) buf[0] = 0;
+    fclose(f);
+    buf[strcspn(buf, "\n")] = 0;
+    return 0;
+}
+
+// Create and enable a one-bank gpio-sim chip; returns its /dev path in chip_dev
+static int simChipCreate(char* chip_dev, size_t size) {
+    char dev_name[64], chip_name[64];
+    mkdir(SIM_CONFIGFS, 0755);
+    mkdir(SIM_CONFIGFS "/bank0", 0755);
+    if (writeFile(SIM_CONFIGFS "/bank0/num_lines", "8") < 0 ||
+        writeFile(SIM_CONFIGFS "/live", "1") < 0) {
+        fprintf(stderr, "❌ Cannot set up gpio-sim (%s). Try: sudo modprobe gpio-sim\n", strerror(errno));
+        return -1;
+    }
+    readFile(SIM_CONFIGFS "/dev_name", dev_name, sizeof(dev_name));
+    readFile(SIM_CONFIGFS "/bank0/chip_name", chip_name, sizeof(chip_name));
+    snprintf(chip_dev, size, "/dev/%s", chip_name);
+    snprintf(g_pull_path, sizeof(g_pull_path), "/sys/devices/platform/%s/%s/sim_gpio%d/pull",
+             dev_name, chip_name, SIM_LINE);
+    return 0;
+}
+
+static void simChipDestroy(void) {
+    writeFile(SIM_CONFIGFS "/live", "0");
+    rmdir(SIM_CONFIGFS "/bank0");
+    rmdir(SIM_CONFIGFS);
+}
+
+// Toggle the simulated input at a fixed rate, recording when each edge was requested
+static void* driverThread(void* arg) {
+    (void)arg;
+    int fd = open(g_pull_path, O_WRONLY);
+    if (fd < 0) {
+        perror(g_pull_path);
+        return NULL;
+    }
+    uint64_t next = nowNs();
+    for (unsigned i = 0; i < g_num_edges; i++) {
+        next += (uint64_t)g_period_us * 1000;
+        while (nowNs() < next) { }
+        const char* pull = (i & 1) ? "pull-down" : "pull-up";
+        g_sent_ns[i] = nowNs();
+        if (pwrite(fd, pull, strlen(pull), 0) < 0) break;
+    }
+    close(fd);
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned debounce_us = 0;
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--debounce-us=", 14) == 0) {
+            debounce_us = (unsigned)atoi(argv[i] + 14);
+        } else if (argv[i][0] != '-') {
+            if (positional++ == 0) g_num_edges = (unsigned)atoi(argv[i]);
+            else g_period_us = (unsigned)atoi(argv[i]);
+        }
+    }
+    if (g_num_edges == 0 || g_num_edges > MAX_EDGES) g_num_edges = MAX_EDGES;
+
+    char chip_dev[128];
+    if (simChipCreate(chip_dev, sizeof(chip_dev)) < 0) {
+        simChipDestroy();
+        return 1;
+    }
+
+    motor_hal_config cfg;
+    halConfigDefaults(&cfg);
+    cfg.backend = "gpiod";
+    cfg.gpiochip = chip_dev;
+    cfg.motors[0].ir_pin = SIM_LINE;
+    cfg.num_motors = 1;
+    if (halInit(&cfg) < 0) {
+        simChipDestroy();
+        return 1;
+    }
+    halSetMode(SIM_LINE, HAL_INPUT);
+    halGlitchFilter(SIM_LINE, debounce_us);
+    if (halEdgeCaptureStart(SIM_LINE) < 0) {
+        fprintf(stderr, "❌ Edge capture not available\n");
+        halTerminate();
+        simChipDestroy();
+        return 1;
+    }
+
+    printf("\n=== gpiod edge capture on %s (%u edges every %u us, debounce %u us) ===\n\n",
+           chip_dev, g_num_edges, g_period_us, debounce_us);
+
+    pthread_t driver;
+    pthread_create(&driver, NULL, driverThread, NULL);
+
+    // Read edges in batches, the way rpmThread does
+    hal_edge batch[64];
+    unsigned received = 0, batches = 0, level_errors = 0;
+    double lat_sum = 0.0, lat_max = 0.0, jitter_sq = 0.0;
+    uint64_t first_ns = 0, last_ns = 0;
+    uint32_t prev_tick = 0;
+
+    while (received < g_num_edges) {
+        int n = halWaitEdges(SIM_LINE, batch, 64, 500000);
+        if (n <= 0) break;  // Timeout: driver finished or edges were lost
+        batches++;
+        for (int i = 0; i < n && received < g_num_edges; i++, received++) {
+            // Compare in the 32-bit microsecond tick domain used by the HAL
+            uint64_t sent = g_sent_ns[received];
+            uint32_t sent_us = (uint32_t)(sent / 1000);
+            int32_t lat_us = (int32_t)(batch[i].tick - sent_us);
+            lat_sum += lat_us;
+            if (lat_us > lat_max) lat_max = lat_us;
+
+            if (batch[i].level != ((received & 1) ? 0u : 1u)) level_errors++;
+
+            if (received > 0) {
+                double interval = (double)(uint32_t)(batch[i].tick - prev_tick);
+                jitter_sq += (interval - g_period_us) * (interval - g_period_us);
+            } else {
+                first_ns = sent;
+            }
+            prev_tick = batch[i].tick;
+            last_ns = sent;
+        }
+    }
+
+    pthread_join(driver, NULL);
+    halTerminate();
+    simChipDestroy();
+
+    double span_s = (last_ns - first_ns) / 1e9;
+    printf("%-28s %u / %u\n", "edges received", received, g_num_edges);
+    printf("%-28s %u\n", "polarity errors", level_errors);
+    printf("%-28s %.1f\n", "edges per read", batches ? (double)received / batches : 0.0);
+    printf("%-28s %.0f edges/s\n", "throughput", span_s > 0 ? received / span_s : 0.0);
+    printf("%-28s %.1f us (max %.0f us)\n", "timestamp - request",
+           received ? lat_sum / received : 0.0, lat_max);
+    printf("%-28s %.2f us\n", "interval jitter (rms)",
+           received > 1 ? sqrt(jitter_sq / (received - 1)) : 0.0);
+    return received == g_num_edges ? 0 : 2;
+}
@@ -0,0 +1,114 @@
+/*
+ * bench_hal.c
+ * Per-call cost of the GPIO/PWM operations of one HAL backend, so the
+ * backends in motor_hal.h can be compared on the same Pi.
+ *
+ * Only the IR sensor pin is read and the LED pin is toggled; the motor
+ * enable pin gets PWM duty 0, so the motor never moves.
+ *
+ * Also measures halScanEdges() (the pigpio DMA sample scan) on a synthetic
+ * 1 ms batch of 1 us samples, which needs no hardware.
+ *
+ * Compilation (from srcs/bench, add the backend flags from motor_hal.h):
+ * gcc -O2 -o bench_hal bench_hal.c ../motor_hal*.c -lpigpio -lrt -lpthread -lm
+ *
+ * Run:
+ * sudo ./bench_hal [iterations] --backend=pigpio
+ * ./bench_hal 100000 --backend=pigpiod
+ */
+
+#include "../motor_hal.h"
+#include "bench.h"
+
+// Wiring from motor_control_ble_pipe.c
+#define BENCH_ENABLE_PIN 17
+#define BENCH_IN1_PIN    23
+#define BENCH_IN2_PIN    24
+#define BENCH_LED_PIN    25
+#define BENCH_IR_PIN     5
+
+static void bench_tick(void *arg, unsigned long i) {
+    (void)i;
+    *(uint32_t *)arg += halTick();
+}
+
+static void bench_read(void *arg, unsigned long i) {
+    (void)i;
+    *(int *)arg += halRead(BENCH_IR_PIN);
+}
+
+static void bench_write(void *arg, unsigned long i) {
+    (void)arg;
+    halWrite(BENCH_LED_PIN, i & 1);
+}
+
+static void bench_pwm(void *arg, unsigned long i) {
+    (void)arg;
+    (void)i;
+    halPWM(BENCH_ENABLE_PIN, 0);
+}
+
+/*
+ * One pigpio sample batch: 1000 samples 1 us apart with 2 IR edges (about
+ * 10,000 RPM on 3 blades) and the LED bit toggling every 50 samples as
+ * unrelated bank activity.
+ */
+#define SCAN_SAMPLES 1000
+
+typedef struct {
+    hal_edge samples[SCAN_SAMPLES];
+    hal_edge edges[SCAN_SAMPLES];
+    uint32_t last_level;
+    int sink;
+} scan_ctx;
+
+static void bench_scan(void *arg, unsigned long i) {
+    (void)i;
+    scan_ctx *ctx = arg;
+    ctx->last_level = 0;
+    ctx->sink += halScanEdges(ctx->samples, SCAN_SAMPLES, 1u << BENCH_IR_PIN,
+                              &ctx->last_level, ctx->edges);
+}
+
+int main(int argc, char *argv[]) {
+    motor_hal_config cfg;
+    halConfigDefaults(&cfg);
+    cfg.motors[0].enable_pin = BENCH_ENABLE_PIN;
+    cfg.motors[0].in1_pin = BENCH_IN1_PIN;
+    cfg.motors[0].in2_pin = BENCH_IN2_PIN;
+    cfg.motors[0].ir_pin = BENCH_IR_PIN;
+    cfg.num_motors = 1;
+    cfg.blades = 3;
+    if (halConfigFromArgs(&cfg, argc, argv) < 0 || halInit(&cfg) < 0) {
+        return 1;
+    }
+
+    halSetMode(BENCH_ENABLE_PIN, HAL_OUTPUT);
+    halSetMode(BENCH_LED_PIN, HAL_OUTPUT);
+    halSetMode(BENCH_IR_PIN, HAL_INPUT);
+    halSetPWMRange(BENCH_ENABLE_PIN, 255);
+
+    char title[64];
+    snprintf(title, sizeof(title), "HAL backend '%s'", g_hal->name);
+    bench_init(title, argc, argv);
+
+    uint32_t tick_sink = 0;
+    int read_sink = 0;
+    bench_run("halTick", bench_tick, &tick_sink);
+    bench_run("halRead (IR sensor)", bench_read, &read_sink);
+    bench_run("halWrite (LED)", bench_write, NULL);
+    bench_run("halPWM (enable, duty 0)", bench_pwm, NULL);
+
+    static scan_ctx scan;
+    for (int i = 0; i < SCAN_SAMPLES; i++) {
+        uint32_t level = ((i / 50) & 1) ? (1u << BENCH_LED_PIN) : 0;
+        if (i >= 300 && i < 700) level |= 1u << BENCH_IR_PIN;
+        scan.samples[i].tick = (uint32_t)i;
+        scan.samples[i].level = level;
+    }
+    bench_run("halScanEdges (1000 samples)", bench_scan, &scan);
+
+    halWrite(BENCH_LED_PIN, 0);
+    halTerminate();
+    return 0;
+}
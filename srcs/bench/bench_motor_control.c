@@ -0,0 +1,186 @@
+/*
+ * bench_motor_control.c
+ * Microbenchmarks for the motor_control_ble_pipe.c hot paths.
+ *
+ * The program under test is compiled into this file with PARMCO_NO_MAIN and
+ * runs on the simulated GPIO backend (motor_hal_sim.c), so no hardware,
+ * root or pigpio daemon is needed.
+ *
+ * Compilation (from srcs/bench):
+ * gcc -O2 -DPARMCO_NO_PIGPIO -o bench_motor_control bench_motor_control.c -lrt -lpthread -lm
+ *
+ * Run:
+ * ./bench_motor_control [iterations] > bench_output.txt
+ */
+
+#define PARMCO_NO_MAIN
+#include "../motor_control_ble_pipe.c"
+#include "../motor_hal.c"
+#include "../motor_hal_sim.c"
+#include "../rpm_estimator.c"
+#include "../rpm_history.c"
+#include "../rpm_sync.c"
+#include "../rpm_angle.c"
+#include "../rpm_quadrature.c"
+#include "../rpm_spectrum.c"
+#include "../hbridge.c"
+#include "../motor_start.c"
+#include "../motor_profile.c"
+#include "../pwm_sweep.c"
+#include "../motor_fault.c"
+#include "../motor_sysid.c"
+#include "../motor_observer.c"
+#include "bench.h"
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+/*
+ * rpmThread window count over a full PULSE_BUFFER_SIZE buffer with pulses
+ * every 2 ms (~10,000 RPM on 3 blades), so about a quarter are in the window.
+ */
+typedef struct {
+    uint32_t pulse_times[PULSE_BUFFER_SIZE];
+    unsigned long pulse_index;
+    uint32_t now;
+    unsigned long sink;
+} window_ctx;
+
+static void bench_window_count(void *arg, unsigned long i) {
+    window_ctx *ctx = arg;
+    ctx->sink += countPulsesInWindow(ctx->pulse_times, PULSE_BUFFER_SIZE, ctx->pulse_index,
+                                     ctx->now + (uint32_t)(i & 0xFF),
+                                     RPM_CALCULATION_WINDOW_MS * 1000);
+}
+
+/*
+ * rpmThread per-edge work: both-edge period estimate with blade spacing
+ * correction, 3 blades at ~10,000 RPM (edges alternate every 1 ms)
+ */
+static void bench_estimator_edge(void *arg, unsigned long i) {
+    rpm_estimator *est = arg;
+    rpmEstimatorEdge(est, (uint32_t)(i * 1000), (int)(i & 1));
+}
+
+// Angle observer update after each accepted edge (3 blades at ~3300 RPM)
+typedef struct {
+    rpm_estimator est;
+    rpm_angle obs;
+} angle_ctx;
+
+static void bench_angle_edge(void *arg, unsigned long i) {
+    angle_ctx *ctx = arg;
+    uint32_t tick = (uint32_t)(i * 3000);
+    if (rpmEstimatorEdge(&ctx->est, tick, (int)(i & 1))) {
+        rpmAngleEdge(&ctx->obs, &ctx->est, tick, (int)(i & 1));
+    }
+}
+
+// Spectrum feed append after each accepted edge (capture thread share)
+typedef struct {
+    rpm_estimator est;
+    rpm_spectrum_feed feed;
+} spectrum_ctx;
+
+static void bench_spectrum_feed(void *arg, unsigned long i) {
+    spectrum_ctx *ctx = arg;
+    uint32_t tick = (uint32_t)(i * 3000);
+    if (rpmEstimatorEdge(&ctx->est, tick, (int)(i & 1))) {
+        rpmSpectrumFeedEdge(&ctx->feed, &ctx->est, tick, (int)(i & 1));
+    }
+}
+
+// One analysis of a full feed (spectrum thread, once per second)
+static void bench_spectrum_analyze(void *arg, unsigned long i) {
+    spectrum_ctx *ctx = arg;
+    rpm_spectrum spec;
+    rpmSpectrumAnalyze(&ctx->feed, NUM_BLADES, NULL, &spec);
+}
+
+// Full PID computation (stabilization delay bypassed) around a 1500 RPM target
+static void bench_pid(void *arg, unsigned long i) {
+    int *sink = arg;
+    g_motors[0].last_speed_change_time = 0;
+    g_motors[0].speed = 40;
+    *sink += pidController(&g_motors[0], 1400.0 + (double)(i & 0xFF), 1500.0, 100.0);
+}
+
+// Command parsing and dispatch for the commands the iPhone sends most
+static const char *bench_commands[] = {
+    "auto 1500\n", "s 40\n", "rpm\n", "manual\n", "+\n", "-\n", "f\n", "xyz\n",
+};
+
+static void bench_process_command(void *arg, unsigned long i) {
+    (void)arg;
+    char input[256];
+    strcpy(input, bench_commands[i % (sizeof(bench_commands) / sizeof(bench_commands[0]))]);
+    processCommand(input);
+}
+
+static void bench_format_rpm(void *arg, unsigned long i) {
+    char *buf = arg;
+    formatRPM(buf, 32, 0, 1234.56 + (double)(i & 0xFF));
+}
+
+// sendRPM including stdio into a /dev/null stream standing in for the pipe
+static void bench_send_rpm(void *arg, unsigned long i) {
+    (void)arg;
+    sendRPM(0, 1234.56 + (double)(i & 0xFF));
+}
+
+int main(int argc, char *argv[]) {
+    bench_silence_stdout();
+    bench_init("motor_control_ble_pipe hot paths", argc, argv);
+
+    motor_hal_config hal_cfg;
+    halConfigDefaults(&hal_cfg);
+    hal_cfg.backend = "sim";
+    hal_cfg.motors[0].enable_pin = MOTOR_ENABLE_PIN;
+    hal_cfg.motors[0].in1_pin = MOTOR_IN1_PIN;
+    hal_cfg.motors[0].in2_pin = MOTOR_IN2_PIN;
+    hal_cfg.motors[0].ir_pin = IR_SENSOR_PIN;
+    hal_cfg.num_motors = 1;
+    hal_cfg.blades = NUM_BLADES;
+    halInit(&hal_cfg);
+    g_motors[0].pins = hal_cfg.motors[0];
+    g_motors[0].direction = 1;
+
+    static window_ctx window;
+    for (unsigned long i = 0; i < PULSE_BUFFER_SIZE; i++) {
+        window.pulse_times[i] = (uint32_t)(i * 2000);
+    }
+    window.pulse_index = 0;
+    window.now = (PULSE_BUFFER_SIZE - 1) * 2000;
+    bench_run("rpmThread window count (1000)", bench_window_count, &window);
+
+    static rpm_estimator est;
+    rpmEstimatorInit(&est, RPM_EDGES_BOTH, NUM_BLADES);
+    bench_run("rpmEstimatorEdge", bench_estimator_edge, &est);
+
+    static angle_ctx angle;
+    rpmEstimatorInit(&angle.est, RPM_EDGES_BOTH, NUM_BLADES);
+    rpmAngleInit(&angle.obs);
+    bench_run("rpmEstimatorEdge + rpmAngleEdge", bench_angle_edge, &angle);
+
+    static spectrum_ctx spectrum;
+    rpmEstimatorInit(&spectrum.est, RPM_EDGES_BOTH, NUM_BLADES);
+    rpmSpectrumFeedInit(&spectrum.feed);
+    bench_run("rpmEstimatorEdge + spectrum feed", bench_spectrum_feed, &spectrum);
+    bench_run("rpmSpectrumAnalyze (32 revs)", bench_spectrum_analyze, &spectrum);
+
+    int pid_sink = 0;
+    bench_run("pidController", bench_pid, &pid_sink);
+
+    bench_run("processCommand (mixed)", bench_process_command, NULL);
+
+    char rpm_buf[32];
+    bench_run("formatRPM", bench_format_rpm, rpm_buf);
+
+    g_rpm_pipe_stream = fopen("/dev/null", "w");
+    bench_run("sendRPM (format + fputs + fflush)", bench_send_rpm, NULL);
+    fclose(g_rpm_pipe_stream);
+    g_rpm_pipe_stream = NULL;
+
+    return 0;
+}
@@ -9,6 +9,19 @@
  * 
  * Run:
  *   sudo ./ble_server
+ *
+ * Status notifications:
+ *   Every line on the status characteristic ends with '\n' and is split
+ *   into notifications of at most MTU - 3 bytes; the phone joins them up
+ *   to the newline, see HANDLE ONE RPM PIPE LINE.
+ *
+ * History transfer:
+ *   The phone writes "get FROM [TO [MAX]]" (seconds ago) to the history
+ *   characteristic and receives the points as delta-encoded chunks, see
+ *   HISTORY TRANSFER below.
+ *
+ * Tracing:
+ *   USDT probes (provider "parmco") are listed in parmco_trace.h
  */
 
 #include <stdio.h>
@@ -21,6 +34,7 @@
 #include <sys/select.h>
 #include <pthread.h>
 #include <gio/gio.h>
+#include "parmco_trace.h"
 
 // Configuration
 #define FIFO_PATH "/tmp/motor_pipe"
@@ -30,6 +44,7 @@
 #define MOTOR_SERVICE_UUID "6e400001-b5a3-f393-e0a9-e50e24dcca9e"
 #define COMMAND_CHAR_UUID  "6e400002-b5a3-f393-e0a9-e50e24dcca9e"  // RX (write)
 #define STATUS_CHAR_UUID   "6e400003-b5a3-f393-e0a9-e50e24dcca9e"  // TX (notify)
+#define HISTORY_CHAR_UUID  "6e400004-b5a3-f393-e0a9-e50e24dcca9e"  // History (write request, notify chunks)
 
 // D-Bus paths and interfaces
 #define BLUEZ_BUS_NAME "org.bluez"
@@ -43,16 +58,66 @@
 #define SERVICE_PATH "/org/bluez/example/service0"
 #define COMMAND_CHAR_PATH "/org/bluez/example/service0/char0"
 #define STATUS_CHAR_PATH "/org/bluez/example/service0/char1"
+#define HISTORY_CHAR_PATH "/org/bluez/example/service0/char2"
 #define ADV_PATH "/org/bluez/example/advertisement0"
 
 // Global state
 static GMainLoop *main_loop = NULL;
 static GDBusConnection *dbus_conn = NULL;
 static FILE *pipe_out = NULL;
-static FILE *rpm_pipe_in = NULL;
+static int rpm_pipe_fd = -1;
 static gboolean status_char_notifying = FALSE;
 static gboolean last_connected_state = FALSE;
 static guint rpm_timer_id = 0;
+static guint history_timer_id = 0;
+
+// History transfer (see HISTORY TRANSFER)
+#define HISTORY_MAX_POINTS   600   // motor_control HIST_MAX_POINTS
+#define HISTORY_MAX_CHUNKS   (HISTORY_MAX_POINTS + 1)  // At least one point per chunk, plus the header
+#define HISTORY_CHUNK_MIN    20    // Chunk size for the default ATT MTU (23 - 3)
+#define HISTORY_CHUNK_MAX    244   // Chunk size for the largest common ATT MTU (247 - 3)
+#define HISTORY_CHUNK_POINTS 63    // Point count field is 6 bits
+#define HISTORY_FLAG_HEADER  0x40
+#define HISTORY_FLAG_LAST    0x80
+#define HISTORY_PUMP_MS      20    // Chunk send interval
+#define HISTORY_CHUNKS_PER_PUMP 4  // Chunks per interval (about 4 KB/s at the minimum MTU)
+
+/*
+ * Notification payload for an ATT MTU reported by BlueZ (0 = unknown)
+ */
+static guint mtu_payload(guint mtu) {
+    return mtu > 3 ? MIN(mtu - 3, HISTORY_CHUNK_MAX) : HISTORY_CHUNK_MIN;
+}
+
+// Status notification size, from the MTU of the phone's latest write
+static guint status_payload = HISTORY_CHUNK_MIN;
+
+typedef struct {
+    guint32 age_ms;
+    gint32 rpm10;       // 0.1 RPM
+    gint32 setpoint10;  // 0.1 RPM
+    gint32 duty10;      // 0.1 %
+    gint32 mode;
+} history_point;
+
+static struct {
+    gboolean notifying;
+    guint chunk_size;                    // Payload size from the requesting write's MTU
+    
+    // Points arriving from motor control (between hist:begin and hist:end)
+    gboolean receiving;
+    history_point points[HISTORY_MAX_POINTS];
+    int num_points;
+    int expected_points;                 // Count from the begin line
+    guint32 step_ms;
+    
+    // Encoded transfer, kept for resume until the next request
+    guint8 chunks[HISTORY_MAX_CHUNKS][HISTORY_CHUNK_MAX];
+    guint8 chunk_len[HISTORY_MAX_CHUNKS];
+    int num_chunks;
+    int next_chunk;                      // Next chunk to send
+    gboolean sending;
+} history = { .chunk_size = HISTORY_CHUNK_MIN };
 
 // Forward declarations
 static void cleanup_and_exit(int code);
@@ -101,6 +166,7 @@ static void write_to_pipe(const char *command) {
     }
     
     if (fprintf(pipe_out, "%s", command) < 0) {
+        PARMCO_TRACE2(pipe_write, command, 0);
         printf("[BLE] ERROR: Failed to write to pipe: %s\n", strerror(errno));
         fclose(pipe_out);
         pipe_out = NULL;
@@ -108,6 +174,7 @@ static void write_to_pipe(const char *command) {
     }
     
     fflush(pipe_out);
+    PARMCO_TRACE2(pipe_write, command, 1);
     printf("[BLE] Sent to C program: %s", command);
 }
 
@@ -152,13 +219,136 @@ static void send_beeps(int count) {
 // ============================================================================
 // RPM NOTIFICATION HANDLER
 // ============================================================================
+// Per-motor lines forwarded whole on the status characteristic ("<tag>N:...")
+static const char *const status_tags[] = {"rpm", "sync", "spec", "fault", "sysid"};
+
+/*
+ * TRUE for "<tag>N:" lines with a tag from status_tags
+ */
+static gboolean is_status_line(const char *line) {
+    for (size_t i = 0; i < G_N_ELEMENTS(status_tags); i++) {
+        size_t len = strlen(status_tags[i]);
+        if (strncmp(line, status_tags[i], len) != 0 || line[len] < '0' || line[len] > '9') {
+            continue;
+        }
+        const char *p = line + len;
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p == ':') {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * STATUS TEXT
+ * What one line from the RPM pipe carries to the iPhone: motor 0's "rpm:"
+ * as the bare number, the per-motor status lines ("rpmN:", "syncN:",
+ * "specN:", "faultN:", "sysidN:") whole so the phone can tell them apart.
+ * 
+ * @param line: Pipe line without trailing newline, e.g. "rpm:1234.56"
+ * @return Text to send (without the newline), or NULL if the line is not a status line
+ */
+static const char *status_text(const char *line) {
+    if (strncmp(line, "rpm:", 4) == 0) {
+        return line + 4;  // Extract just the number (skip "rpm:" prefix)
+    }
+    return is_status_line(line) ? line : NULL;
+}
+
+/**
+ * BUILD VALUE NOTIFICATION
+ * @return Floating "(sa{sv}as)" GVariant carrying data as the characteristic Value
+ */
+static GVariant *build_value_notification(const guint8 *data, gsize len) {
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("ay"));
+    for (gsize k = 0; k < len; k++) {
+        g_variant_builder_add(&builder, "y", data[k]);
+    }
+    GVariant *value = g_variant_builder_end(&builder);
+    
+    // Build the changed properties dictionary with the Value
+    GVariantBuilder changed_props;
+    g_variant_builder_init(&changed_props, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&changed_props, "{sv}", "Value", value);
+    
+    // Build empty invalidated properties array
+    GVariantBuilder invalidated;
+    g_variant_builder_init(&invalidated, G_VARIANT_TYPE("as"));
+    
+    return g_variant_new("(sa{sv}as)", GATT_CHRC_IFACE, &changed_props, &invalidated);
+}
+
+/**
+ * EMIT NOTIFICATION
+ * Sends PropertiesChanged parameters (from build_value_notification) as a
+ * notification of the characteristic at path.
+ * @return TRUE if the signal was emitted
+ */
+static gboolean emit_notification(const char *path, GVariant *notification) {
+    GError *error = NULL;
+    g_dbus_connection_emit_signal(
+        dbus_conn,
+        NULL,  // destination (broadcast)
+        path,
+        "org.freedesktop.DBus.Properties",
+        "PropertiesChanged",
+        notification,
+        &error);
+    if (error) {
+        // Don't print errors - updates are too frequent
+        g_error_free(error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void history_pipe_line(const char *line);
+
+/**
+ * HANDLE ONE RPM PIPE LINE
+ * "rpm:" and the per-motor status lines go to the status characteristic,
+ * "hist:" lines (answers to history requests) to the history transfer.
+ * 
+ * A status line longer than one notification (status_payload, from the
+ * phone's ATT MTU) is split; the phone joins the pieces up to the '\n'
+ * that ends every line. BlueZ would otherwise cut it at the MTU.
+ */
+static void handle_pipe_line(const char *line) {
+    if (strncmp(line, "hist:", 5) == 0) {
+        history_pipe_line(line + 5);
+        return;
+    }
+    if (!status_char_notifying) {
+        return;
+    }
+    
+    // PARSE RPM FORMAT: "rpm:####.##" or "<tag>N:..."
+    const char *text = status_text(line);
+    if (!text) {
+        return;
+    }
+    char *message = g_strdup_printf("%s\n", text);
+    gsize len = strlen(message);
+    gboolean ok = TRUE;
+    for (gsize offset = 0; offset < len; offset += status_payload) {
+        gsize piece = MIN(status_payload, len - offset);
+        ok &= emit_notification(STATUS_CHAR_PATH,
+                                build_value_notification((const guint8 *)message + offset, piece));
+    }
+    PARMCO_TRACE2(notify_emit, text, ok);
+    g_free(message);
+}
+
 /**
  * READ RPM FROM PIPE AND SEND TO iPhone
- * This function is called periodically by GLib main loop (every 100ms).
- * It reads RPM data from the motor control program via named pipe and
- * sends it to the iPhone via BLE notifications.
+ * Reads every complete line waiting in the RPM pipe and handles it.
+ * Called by the RPM timer (every 100ms) and before each batch of history
+ * chunks, so live RPM notifications never queue behind a history transfer.
  * 
- * PIPE FORMAT: "rpm:####.##\n"
+ * PIPE FORMAT: "rpm:####.##\n" (plus the per-motor status lines, see
+ * status_text, and "hist:..." lines, see HISTORY TRANSFER)
  * Example: "rpm:1234.56\n"
  * 
  * BLE PROTOCOL:
@@ -167,27 +357,25 @@ static void send_beeps(int count) {
  * - Uses D-Bus PropertiesChanged signal for BLE notifications
  * 
  * FLOW:
- * 1. Check if iPhone has enabled notifications (status_char_notifying)
+ * 1. Check if iPhone has enabled notifications (status or history)
  * 2. Open RPM pipe if not already open
- * 3. Read RPM data using non-blocking select()
+ * 3. read() everything available (non-blocking) and split it into lines
  * 4. Parse "rpm:####.##" format
- * 5. Send just the number (no "rpm:" prefix) to iPhone
- * 
- * @param user_data: Unused (required by GSourceFunc signature)
- * @return G_SOURCE_CONTINUE to keep timer running
+ * 5. Send just the number (no "rpm:" prefix) to iPhone, status lines whole
  */
-static gboolean read_rpm_from_pipe(gpointer user_data) {
-    static char rpm_buffer[256];
+static void drain_rpm_pipe(void) {
+    static char rpm_buffer[4096];
+    static size_t rpm_buffer_len = 0;
     
-    // Only send RPM if iPhone has enabled notifications
-    if (!status_char_notifying) {
-        return G_SOURCE_CONTINUE;  // Keep timer running
+    // Only read if iPhone has enabled notifications
+    if (!status_char_notifying && !history.notifying) {
+        return;
     }
     
     // OPEN RPM PIPE (if not already open)
-    if (!rpm_pipe_in) {
-        int fd = open(RPM_FIFO_PATH, O_RDONLY | O_NONBLOCK);
-        if (fd < 0) {
+    if (rpm_pipe_fd < 0) {
+        rpm_pipe_fd = open(RPM_FIFO_PATH, O_RDONLY | O_NONBLOCK);
+        if (rpm_pipe_fd < 0) {
             if (errno != ENXIO) {  // ENXIO = no writer yet (normal)
                 // CREATE PIPE: If it doesn't exist, create it once
                 static gboolean pipe_created = FALSE;
@@ -198,85 +386,273 @@ static gboolean read_rpm_from_pipe(gpointer user_data) {
                     }
                 }
             }
-            return G_SOURCE_CONTINUE;  // Try again next time
+            return;  // Try again next time
         }
+        rpm_buffer_len = 0;
+        printf("[BLE] RPM pipe opened!\n");
+    }
+    
+    // READ RPM DATA (non-blocking): everything that is waiting
+    for (;;) {
+        ssize_t n = read(rpm_pipe_fd, rpm_buffer + rpm_buffer_len,
+                         sizeof(rpm_buffer) - 1 - rpm_buffer_len);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) break;  // Nothing more for now
+            close(rpm_pipe_fd);  // Read error - close and reopen
+            rpm_pipe_fd = -1;
+            return;
+        }
+        if (n == 0) {
+            // No writer (motor control restarting) - keep the pipe open, but
+            // drop a partial line: the next writer starts with a fresh one
+            rpm_buffer_len = 0;
+            break;
+        }
+        rpm_buffer_len += n;
+        rpm_buffer[rpm_buffer_len] = '\0';
+        
+        // Handle each complete line, keep a partial one for the next read
+        char *line = rpm_buffer;
+        char *newline;
+        while ((newline = strchr(line, '\n')) != NULL) {
+            *newline = '\0';
+            handle_pipe_line(line);
+            line = newline + 1;
+        }
+        rpm_buffer_len = strlen(line);
+        memmove(rpm_buffer, line, rpm_buffer_len + 1);
+        if (rpm_buffer_len == sizeof(rpm_buffer) - 1) {
+            rpm_buffer_len = 0;  // Overlong line - drop it
+        }
+    }
+}
+
+/**
+ * RPM TIMER
+ * @param user_data: Unused (required by GSourceFunc signature)
+ * @return G_SOURCE_CONTINUE to keep timer running
+ */
+static gboolean read_rpm_from_pipe(gpointer user_data) {
+    drain_rpm_pipe();
+    return G_SOURCE_CONTINUE;
+}
+
+// ============================================================================
+// HISTORY TRANSFER
+// ============================================================================
+/*
+ * Minutes of history as single RPM-style notifications would take far too
+ * long and hold up live RPM, so history has its own characteristic:
+ * 
+ * REQUEST (phone writes text to HISTORY_CHAR):
+ *   "get FROM [TO [MAX]]"  points from FROM to TO seconds ago, at most MAX
+ *                          (forwarded to motor control as "hist ...")
+ *   "resume N"             send the stored transfer again from chunk N
+ *                          (after a reconnect or a gap in sequence numbers)
+ *   "stop"                 stop sending
+ * 
+ * CHUNKS (notifications on HISTORY_CHAR, at most MTU - 3 bytes each):
+ *   byte 0-1  sequence number (little endian), 0 = header
+ *   byte 2    bit 7 = last chunk, bit 6 = header, bits 0-5 = points in chunk
+ *   header:   varint total points, varint step_ms, varint total chunks
+ *   data:     per point, 4 zigzag varints: age_ms, rpm*10,
+ *             setpoint*10, duty*10*2 + mode, each the difference to the
+ *             previous point in the chunk (to 0 for the first point), so
+ *             every chunk decodes on its own
+ *   Varints are LEB128 (7 bits per byte, low bits first). Points are
+ *   oldest first, age_ms is milliseconds before the request.
+ * 
+ * Chunks go out HISTORY_CHUNKS_PER_PUMP every HISTORY_PUMP_MS, after the
+ * RPM pipe has been drained, so live RPM is never delayed by a transfer.
+ */
+
+static guint put_varint(guint8 *p, guint32 v) {
+    guint n = 0;
+    while (v >= 0x80) {
+        p[n++] = (guint8)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (guint8)v;
+    return n;
+}
+
+static guint32 zigzag(gint32 v) {
+    return ((guint32)v << 1) ^ (guint32)(v >> 31);
+}
+
+/**
+ * ENCODE HISTORY CHUNKS
+ * Encodes history.points into history.chunks, chunk_size bytes at most
+ * each: the header chunk first, then data chunks. Every data chunk holds
+ * at least one point; the header counts the points actually encoded.
+ * @return Number of chunks
+ */
+static int encode_history_chunks(guint chunk_size) {
+    int seq = 1;
+    int i = 0;
+    int encoded = 0;
+    
+    while (i < history.num_points && seq < HISTORY_MAX_CHUNKS) {
+        guint8 *chunk = history.chunks[seq];
+        guint len = 3;
+        int count = 0;
+        history_point prev = {0, 0, 0, 0, 0};
         
-        // Wrap file descriptor in FILE* for easier reading
-        rpm_pipe_in = fdopen(fd, "r");
-        if (!rpm_pipe_in) {
-            close(fd);
-            return G_SOURCE_CONTINUE;  // Try again next time
+        while (i < history.num_points && count < HISTORY_CHUNK_POINTS) {
+            const history_point *pt = &history.points[i];
+            guint8 enc[20];
+            guint n = 0;
+            n += put_varint(enc + n, zigzag((gint32)(pt->age_ms - prev.age_ms)));
+            n += put_varint(enc + n, zigzag(pt->rpm10 - prev.rpm10));
+            n += put_varint(enc + n, zigzag(pt->setpoint10 - prev.setpoint10));
+            n += put_varint(enc + n, zigzag((pt->duty10 * 2 + pt->mode) - (prev.duty10 * 2 + prev.mode)));
+            if (len + n > chunk_size) {
+                if (count == 0) i++;  // Cannot fit even alone (bad input) - skip it
+                break;
+            }
+            memcpy(chunk + len, enc, n);
+            len += n;
+            prev = *pt;
+            count++;
+            i++;
+        }
+        if (count == 0) {
+            continue;  // Only a skipped point - no empty chunk
         }
         
-        printf("[BLE] RPM pipe opened!\n");
+        chunk[0] = seq & 0xff;
+        chunk[1] = seq >> 8;
+        chunk[2] = count;
+        history.chunk_len[seq] = len;
+        encoded += count;
+        seq++;
+    }
+    if (seq > 1 && i == history.num_points) {
+        history.chunks[seq - 1][2] |= HISTORY_FLAG_LAST;
     }
     
-    // READ RPM DATA (non-blocking)
-    // Use select() to check if data is available without blocking
-    fd_set readfds;
-    struct timeval tv = {0, 0};  // Non-blocking: return immediately
-    FD_ZERO(&readfds);
-    FD_SET(fileno(rpm_pipe_in), &readfds);
+    guint8 *header = history.chunks[0];
+    guint len = 3;
+    header[0] = 0;
+    header[1] = 0;
+    header[2] = HISTORY_FLAG_HEADER | (seq == 1 ? HISTORY_FLAG_LAST : 0);
+    len += put_varint(header + len, encoded);
+    len += put_varint(header + len, history.step_ms);
+    len += put_varint(header + len, seq);
+    history.chunk_len[0] = len;
+    return seq;
+}
+
+/**
+ * HANDLE HISTORY PIPE LINE
+ * Collects motor control's answer to "hist":
+ *   "begin,<points>,<step_ms>", "<age_ms>,<rpm>,<duty>,<setpoint>,<mode>", "end,<points>"
+ * and starts sending once it is complete. A reply cut short (motor control
+ * drops the rest when the pipe is full) has fewer points than announced,
+ * or no end line until the next begin, and is discarded.
+ */
+static void history_pipe_line(const char *line) {
+    if (strncmp(line, "begin,", 6) == 0) {
+        history.receiving = TRUE;
+        history.num_points = 0;
+        history.expected_points = -1;
+        history.step_ms = 0;
+        sscanf(line + 6, "%d,%u", &history.expected_points, &history.step_ms);
+        return;
+    }
+    if (!history.receiving) {
+        return;
+    }
+    int end_points;
+    if (sscanf(line, "end,%d", &end_points) == 1) {
+        history.receiving = FALSE;
+        if (end_points != history.expected_points || history.num_points != end_points) {
+            printf("[BLE] History: incomplete reply (%d of %d points) - dropped\n",
+                   history.num_points, history.expected_points);
+            history.num_chunks = 0;
+            return;
+        }
+        history.num_chunks = encode_history_chunks(history.chunk_size);
+        history.next_chunk = 0;
+        history.sending = TRUE;
+        printf("[BLE] History: %d points in %d chunks of up to %u bytes\n",
+               history.num_points, history.num_chunks, history.chunk_size);
+        return;
+    }
     
-    // Check if data is available to read
-    if (select(fileno(rpm_pipe_in) + 1, &readfds, NULL, NULL, &tv) > 0) {
-        if (fgets(rpm_buffer, sizeof(rpm_buffer), rpm_pipe_in)) {
-            // Remove newline character
-            rpm_buffer[strcspn(rpm_buffer, "\n")] = 0;
-            
-            // PARSE RPM FORMAT: "rpm:####.##"
-            if (strncmp(rpm_buffer, "rpm:", 4) == 0) {
-                // Extract just the number (skip "rpm:" prefix)
-                const char *rpm_value = rpm_buffer + 4;
-                
-                GError *error = NULL;
-                GVariantBuilder builder;
-                g_variant_builder_init(&builder, G_VARIANT_TYPE("ay"));
-                
-                // Convert string to byte array
-                for (const char *p = rpm_value; *p; p++) {
-                    g_variant_builder_add(&builder, "y", (guchar)*p);
-                }
-                g_variant_builder_add(&builder, "y", (guchar)'\n');
-                
-                GVariant *value = g_variant_builder_end(&builder);
-                
-                // Build the changed properties dictionary with the Value
-                GVariantBuilder changed_props;
-                g_variant_builder_init(&changed_props, G_VARIANT_TYPE("a{sv}"));
-                g_variant_builder_add(&changed_props, "{sv}", "Value", value);
-                
-                // Build empty invalidated properties array
-                GVariantBuilder invalidated;
-                g_variant_builder_init(&invalidated, G_VARIANT_TYPE("as"));
-                
-                // Emit PropertiesChanged signal for notification
-                g_dbus_connection_emit_signal(
-                    dbus_conn,
-                    NULL,  // destination (broadcast)
-                    STATUS_CHAR_PATH,
-                    "org.freedesktop.DBus.Properties",
-                    "PropertiesChanged",
-                    g_variant_new("(sa{sv}as)",
-                        GATT_CHRC_IFACE,
-                        &changed_props,
-                        &invalidated),
-                    &error);
-                
-                if (error) {
-                    // Don't print errors - RPM updates are too frequent
-                    g_error_free(error);
-                }
-            }
-        } else {
-            // Read error - close and reopen
-            if (ferror(rpm_pipe_in)) {
-                fclose(rpm_pipe_in);
-                rpm_pipe_in = NULL;
-            }
+    unsigned age_ms;
+    double rpm, duty, setpoint;
+    int mode;
+    if (history.num_points < HISTORY_MAX_POINTS &&
+        sscanf(line, "%u,%lf,%lf,%lf,%d", &age_ms, &rpm, &duty, &setpoint, &mode) == 5) {
+        history_point *pt = &history.points[history.num_points++];
+        pt->age_ms = age_ms;
+        pt->rpm10 = (gint32)(rpm * 10.0 + 0.5);
+        pt->duty10 = (gint32)(duty * 10.0 + 0.5);
+        pt->setpoint10 = (gint32)(setpoint * 10.0 + 0.5);
+        pt->mode = mode ? 1 : 0;
+    }
+}
+
+/**
+ * HANDLE HISTORY REQUEST
+ * Text written by the phone to the history characteristic.
+ * @param mtu: ATT MTU of the write (0 if BlueZ did not report it)
+ */
+static void handle_history_request(const char *request, guint mtu) {
+    double from_s = 0.0, to_s = 0.0;
+    int max_points = 120;
+    int resume;
+    
+    if (sscanf(request, "get %lf %lf %d", &from_s, &to_s, &max_points) >= 1) {
+        if (max_points > HISTORY_MAX_POINTS) max_points = HISTORY_MAX_POINTS;
+        history.chunk_size = mtu_payload(mtu);
+        history.sending = FALSE;
+        char command[64];
+        snprintf(command, sizeof(command), "hist %.1f %.1f %d\n", from_s, to_s, max_points);
+        write_to_pipe(command);
+    } else if (sscanf(request, "resume %d", &resume) == 1) {
+        if (resume < 0 || resume >= history.num_chunks) {
+            printf("[BLE] History: nothing to resume at chunk %d\n", resume);
+            return;
         }
+        history.next_chunk = resume;
+        history.sending = TRUE;
+    } else if (strncmp(request, "stop", 4) == 0) {
+        history.sending = FALSE;
+    } else {
+        printf("[BLE] History: unknown request: %s\n", request);
     }
+}
+
+/**
+ * HISTORY PUMP
+ * Called every HISTORY_PUMP_MS while the server runs. Live RPM first, then
+ * up to HISTORY_CHUNKS_PER_PUMP chunks of the current transfer.
+ * 
+ * @param user_data: Unused (required by GSourceFunc signature)
+ * @return G_SOURCE_CONTINUE to keep timer running
+ */
+static gboolean history_pump(gpointer user_data) {
+    if (!history.sending || !history.notifying) {
+        return G_SOURCE_CONTINUE;
+    }
+    
+    drain_rpm_pipe();  // Higher priority: pending RPM goes out first
     
+    for (int k = 0; k < HISTORY_CHUNKS_PER_PUMP && history.next_chunk < history.num_chunks; k++) {
+        int seq = history.next_chunk;
+        GVariant *notification = build_value_notification(history.chunks[seq], history.chunk_len[seq]);
+        gboolean ok = emit_notification(HISTORY_CHAR_PATH, notification);
+        PARMCO_TRACE2(history_chunk, seq, ok);
+        if (!ok) {
+            break;  // Try this chunk again next time
+        }
+        history.next_chunk++;
+    }
+    if (history.next_chunk >= history.num_chunks) {
+        history.sending = FALSE;
+    }
     return G_SOURCE_CONTINUE;
 }
 
@@ -326,8 +702,13 @@ static void handle_method_call(
         
         // Extract byte array from D-Bus parameters
         GVariant *value_variant = g_variant_get_child_value(parameters, 0);
+        GVariant *options = g_variant_get_child_value(parameters, 1);
         gsize len;
         gconstpointer data = g_variant_get_fixed_array(value_variant, &len, sizeof(guchar));
+        guint16 mtu = 0;
+        if (g_variant_lookup(options, "mtu", "q", &mtu)) {  // BlueZ >= 5.46
+            status_payload = mtu_payload(mtu);
+        }
         
         // Convert byte array to null-terminated string
         char *command = g_malloc(len + 1);
@@ -341,16 +722,56 @@ static void handle_method_call(
         
         // Clean up
         g_free(command);
+        g_variant_unref(options);
         g_variant_unref(value_variant);
         
         // Reply to iPhone (success)
         g_dbus_method_invocation_return_value(invocation, NULL);
     }
+    // HANDLE WriteValue ON HISTORY CHARACTERISTIC
+    // The iPhone requests a time range, or resumes/stops a transfer
+    else if (g_strcmp0(object_path, HISTORY_CHAR_PATH) == 0 &&
+             g_strcmp0(method_name, "WriteValue") == 0) {
+        GVariant *value_variant = g_variant_get_child_value(parameters, 0);
+        GVariant *options = g_variant_get_child_value(parameters, 1);
+        gsize len;
+        gconstpointer data = g_variant_get_fixed_array(value_variant, &len, sizeof(guchar));
+        guint16 mtu = 0;
+        if (g_variant_lookup(options, "mtu", "q", &mtu)) {  // BlueZ >= 5.46
+            status_payload = mtu_payload(mtu);
+        }
+        
+        char *request = g_malloc(len + 1);
+        memcpy(request, data, len);
+        request[len] = '\0';
+        request[strcspn(request, "\r\n")] = '\0';
+        printf("[BLE] History request: %s (MTU %u)\n", request, mtu);
+        handle_history_request(request, mtu);
+        
+        g_free(request);
+        g_variant_unref(options);
+        g_variant_unref(value_variant);
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    }
+    // HANDLE StartNotify/StopNotify ON HISTORY CHARACTERISTIC
+    else if (g_strcmp0(object_path, HISTORY_CHAR_PATH) == 0 &&
+             g_strcmp0(method_name, "StartNotify") == 0) {
+        history.notifying = TRUE;
+        printf("[BLE] Notifications started for %s\n", HISTORY_CHAR_UUID);
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    }
+    else if (g_strcmp0(object_path, HISTORY_CHAR_PATH) == 0 &&
+             g_strcmp0(method_name, "StopNotify") == 0) {
+        history.notifying = FALSE;  // Transfer is kept for "resume"
+        printf("[BLE] History notifications stopped\n");
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    }
     // HANDLE StartNotify ON TX CHARACTERISTIC
     // This is called when iPhone enables notifications for RPM updates
     else if (g_strcmp0(object_path, STATUS_CHAR_PATH) == 0 &&
              g_strcmp0(method_name, "StartNotify") == 0) {
         status_char_notifying = TRUE;  // Enable RPM notifications
+        status_payload = HISTORY_CHUNK_MIN;  // New subscriber: MTU unknown until it writes
         printf("[BLE] Notifications started for %s\n", STATUS_CHAR_UUID);
         g_dbus_method_invocation_return_value(invocation, NULL);
     }
@@ -399,6 +820,7 @@ static GVariant *handle_get_property(
             g_variant_builder_init(&builder, G_VARIANT_TYPE("ao"));
             g_variant_builder_add(&builder, "o", COMMAND_CHAR_PATH);
             g_variant_builder_add(&builder, "o", STATUS_CHAR_PATH);
+            g_variant_builder_add(&builder, "o", HISTORY_CHAR_PATH);
             return g_variant_builder_end(&builder);
         }
     }
@@ -436,6 +858,23 @@ static GVariant *handle_get_property(
             return g_variant_builder_end(&builder);
         }
     }
+    // History Characteristic properties
+    else if (g_strcmp0(object_path, HISTORY_CHAR_PATH) == 0) {
+        if (g_strcmp0(property_name, "UUID") == 0) {
+            return g_variant_new_string(HISTORY_CHAR_UUID);
+        } else if (g_strcmp0(property_name, "Service") == 0) {
+            return g_variant_new_object_path(SERVICE_PATH);
+        } else if (g_strcmp0(property_name, "Flags") == 0) {
+            const gchar *flags[] = {"write", "notify", NULL};
+            return g_variant_new_strv(flags, -1);
+        } else if (g_strcmp0(property_name, "Notifying") == 0) {
+            return g_variant_new_boolean(history.notifying);
+        } else if (g_strcmp0(property_name, "Value") == 0) {
+            GVariantBuilder builder;
+            g_variant_builder_init(&builder, G_VARIANT_TYPE("ay"));
+            return g_variant_builder_end(&builder);
+        }
+    }
     
     return NULL;
 }
@@ -465,6 +904,7 @@ static void register_app_callback(GDBusConnection *conn, GAsyncResult *res, gpoi
     printf("   Service UUID: %s\n", MOTOR_SERVICE_UUID);
     printf("   RX UUID: %s (commands)\n", COMMAND_CHAR_UUID);
     printf("   TX UUID: %s (RPM notifications)\n", STATUS_CHAR_UUID);
+    printf("   History UUID: %s (bulk history)\n", HISTORY_CHAR_UUID);
     printf("\n   Commands:\n");
     printf("   - Manual: on, off, s N, +, -, f, r\n");
     printf("   - Auto: auto N (target RPM), manual (exit auto mode)\n");
@@ -607,6 +1047,7 @@ static void handle_get_managed_objects(
     g_variant_builder_init(&char_builder, G_VARIANT_TYPE("ao"));
     g_variant_builder_add(&char_builder, "o", COMMAND_CHAR_PATH);
     g_variant_builder_add(&char_builder, "o", STATUS_CHAR_PATH);
+    g_variant_builder_add(&char_builder, "o", HISTORY_CHAR_PATH);
     g_variant_builder_add(&builder, "{sv}", "Characteristics", g_variant_builder_end(&char_builder));
     
     g_variant_builder_close(&builder);  // a{sv}
@@ -646,6 +1087,22 @@ static void handle_get_managed_objects(
     g_variant_builder_close(&builder);
     g_variant_builder_close(&builder);
     
+    // Add history characteristic
+    g_variant_builder_open(&builder, G_VARIANT_TYPE("{oa{sa{sv}}}"));
+    g_variant_builder_add(&builder, "o", HISTORY_CHAR_PATH);
+    g_variant_builder_open(&builder, G_VARIANT_TYPE("a{sa{sv}}"));
+    g_variant_builder_open(&builder, G_VARIANT_TYPE("{sa{sv}}"));
+    g_variant_builder_add(&builder, "s", GATT_CHRC_IFACE);
+    g_variant_builder_open(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&builder, "{sv}", "UUID", g_variant_new_string(HISTORY_CHAR_UUID));
+    g_variant_builder_add(&builder, "{sv}", "Service", g_variant_new_object_path(SERVICE_PATH));
+    const gchar *hist_flags[] = {"write", "notify", NULL};
+    g_variant_builder_add(&builder, "{sv}", "Flags", g_variant_new_strv(hist_flags, -1));
+    g_variant_builder_close(&builder);
+    g_variant_builder_close(&builder);
+    g_variant_builder_close(&builder);
+    g_variant_builder_close(&builder);
+    
     g_dbus_method_invocation_return_value(invocation, g_variant_new("(a{oa{sa{sv}}})", &builder));
 }
 
@@ -677,14 +1134,17 @@ static void cleanup_and_exit(int code) {
         pipe_out = NULL;
     }
     
-    if (rpm_pipe_in) {
-        fclose(rpm_pipe_in);
-        rpm_pipe_in = NULL;
+    if (rpm_pipe_fd >= 0) {
+        close(rpm_pipe_fd);
+        rpm_pipe_fd = -1;
     }
     
     if (rpm_timer_id) {
         g_source_remove(rpm_timer_id);
     }
+    if (history_timer_id) {
+        g_source_remove(history_timer_id);
+    }
     
     if (main_loop) {
         g_main_loop_quit(main_loop);
@@ -698,6 +1158,7 @@ static void signal_handler(int signum) {
     cleanup_and_exit(0);
 }
 
+#ifndef PARMCO_NO_MAIN
 int main(int argc, char *argv[]) {
     GError *error = NULL;
     
@@ -808,6 +1269,8 @@ int main(int argc, char *argv[]) {
         &service_vtable, NULL, NULL, &error);
     g_dbus_connection_register_object(dbus_conn, STATUS_CHAR_PATH, char_info->interfaces[0],
         &service_vtable, NULL, NULL, &error);
+    g_dbus_connection_register_object(dbus_conn, HISTORY_CHAR_PATH, char_info->interfaces[0],
+        &service_vtable, NULL, NULL, &error);
     g_dbus_node_info_unref(char_info);
     
     // Create main loop before registration (important!)
@@ -836,6 +1299,7 @@ int main(int argc, char *argv[]) {
     
     // Start RPM reading timer (100ms interval)
     rpm_timer_id = g_timeout_add(100, read_rpm_from_pipe, NULL);
+    history_timer_id = g_timeout_add(HISTORY_PUMP_MS, history_pump, NULL);
     
     // Run main loop - this processes the async registration
     printf("Starting event loop...\n");
@@ -844,4 +1308,4 @@ int main(int argc, char *argv[]) {
     cleanup_and_exit(0);
     return 0;
 }
-
+#endif // PARMCO_NO_MAIN
@@ -0,0 +1,214 @@
+/*
+ * hbridge.c
+ * H-bridge driver. See hbridge.h.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "hbridge.h"
+
+/*
+ * Direction inputs of a state: bit 0 = IN1, bit 1 = IN2
+ */
+static unsigned inputsOf(hbridge_state state) {
+    if (state == HB_FORWARD) return 1u;
+    if (state == HB_REVERSE) return 2u;
+    return 0u;
+}
+
+static int directionOf(hbridge_state state) {
+    if (state == HB_FORWARD) return 1;
+    if (state == HB_REVERSE) return -1;
+    return 0;
+}
+
+static double elapsedMs(uint32_t since) {
+    return (uint32_t)(halTick() - since) / 1000.0;
+}
+
+/*
+ * Enable pin duty on the active PWM generator
+ * @return Raw duty written (0-255 for sw PWM, millionths for hw PWM)
+ */
+static int writeDuty(const hbridge* hb, double duty) {
+    if (hb->pwm_hw) {
+        int raw = (int)lround(duty * (HAL_HW_PWM_RANGE / 100.0));
+        halHardwarePWM(hb->pins.enable_pin, hb->pwm_freq, raw);
+        return raw;
+    }
+    // Convert 0-100% to the 0-255 PWM range, nearest step (a dithered
+    // synchronized duty lands exactly on steps and must not be cut down)
+    int raw = (int)lround(duty * (HB_SW_PWM_RANGE / 100.0));
+    halPWM(hb->pins.enable_pin, raw);
+    return raw;
+}
+
+void hbridgeInit(hbridge* hb, const hal_motor_wiring* pins, int pwm_hw, unsigned pwm_freq,
+                 unsigned dead_time_us) {
+    memset(hb, 0, sizeof(*hb));
+    hb->pins = *pins;
+    hb->pwm_hw = pwm_hw;
+    hb->pwm_freq = pwm_freq;
+    hb->dead_time_us = dead_time_us;
+    hb->state = HB_COAST;
+}
+
+/**
+ * TAKE OVER RUNNING OUTPUTS
+ * Records the state a previous instance left on the pins (--adopt) without
+ * writing them.
+ */
+void hbridgeAdopt(hbridge* hb, hbridge_state state, double duty) {
+    hb->state = state;
+    hb->duty = duty;
+    hb->written = 1;
+    hb->spin = directionOf(state);
+}
+
+/**
+ * APPLY A STATE NOW
+ * Changing the direction inputs first drops the enable pin for the
+ * dead-time, then writes both inputs with halWriteBank().
+ *
+ * @param duty: Enable duty % (ignored for COAST)
+ * @return Raw duty written
+ */
+int hbridgeApply(hbridge* hb, hbridge_state state, double duty) {
+    if (state == HB_COAST) duty = 0.0;
+    unsigned old_in = inputsOf(hb->state);
+    unsigned new_in = inputsOf(state);
+
+    if (!hb->written || new_in != old_in) {
+        if (hb->duty > 0.0 || !hb->written) {
+            writeDuty(hb, 0.0);
+            if (hb->dead_time_us) usleep(hb->dead_time_us);
+        }
+        uint32_t set = 0, clear = 0;
+        uint32_t in1 = 1u << (hb->pins.in1_pin & 31);
+        uint32_t in2 = 1u << (hb->pins.in2_pin & 31);
+        if (hb->pins.in1_pin < 32 && hb->pins.in2_pin < 32) {
+            if (new_in & 1u) set |= in1; else clear |= in1;
+            if (new_in & 2u) set |= in2; else clear |= in2;
+            halWriteBank(set, clear);
+        } else {
+            // Not in bank 0: same order, pin by pin
+            if (!(new_in & 1u)) halWrite(hb->pins.in1_pin, 0);
+            if (!(new_in & 2u)) halWrite(hb->pins.in2_pin, 0);
+            if (new_in & 1u) halWrite(hb->pins.in1_pin, 1);
+            if (new_in & 2u) halWrite(hb->pins.in2_pin, 1);
+        }
+        hb->written = 1;
+    }
+
+    hb->state = state;
+    hb->duty = duty;
+    if (directionOf(state) && duty > 0.0) {
+        hb->spin = directionOf(state);
+    }
+    return writeDuty(hb, duty);
+}
+
+/**
+ * DRIVE IN A DIRECTION
+ * Applies the drive at once, unless the rotor still turns the other way
+ * faster than HB_REVERSE_RPM: then it brakes first and hbridgeStep() applies
+ * the drive. A new request during the brake only replaces the pending drive.
+ *
+ * @param rpm: Current speed (unsigned)
+ * @param rotation: +1/-1 from the direction sensor, 0 if unknown
+ * @return Raw duty written (0 while braking)
+ */
+int hbridgeDrive(hbridge* hb, int forward, double duty, double rpm, int rotation) {
+    hbridge_state state = forward ? HB_FORWARD : HB_REVERSE;
+    int want = forward ? 1 : -1;
+    int turning = rotation ? rotation : hb->spin;
+
+    if (hb->braking) {
+        if (turning != want) {
+            hb->next = state;
+            hb->next_duty = duty;
+            return 0;
+        }
+        hb->braking = 0;  // Asked to keep going the old way: drive on
+        hb->timing = 0;
+    } else if (turning == -want && rpm >= HB_REVERSE_RPM && duty > 0.0) {
+        hb->braking = 1;
+        hb->next = state;
+        hb->next_duty = duty;
+        hb->brake_start = halTick();
+        hb->timing = 2;
+        hb->timing_start = hb->brake_start;
+        hbridgeApply(hb, HB_BRAKE, HB_BRAKE_DUTY);
+        return 0;
+    } else if (turning == -want && rpm >= HB_STOP_RPM && duty > 0.0 && hb->timing != 2) {
+        // Slow enough to drive straight through zero; still timed
+        hb->timing = 2;
+        hb->timing_start = halTick();
+    }
+    return hbridgeApply(hb, state, duty);
+}
+
+/**
+ * STOP
+ * Active brake (held at standstill, so the rotor resists being turned) or
+ * coast (enable LOW). Cancels a pending reversal.
+ */
+void hbridgeStop(hbridge* hb, int brake, double rpm) {
+    hb->braking = 0;
+    hbridgeApply(hb, brake ? HB_BRAKE : HB_COAST, HB_BRAKE_DUTY);
+    if (rpm >= HB_STOP_RPM) {
+        hb->timing = 1;
+        hb->timing_start = halTick();
+    } else {
+        hb->timing = 0;
+    }
+}
+
+/**
+ * SEQUENCE STEP
+ * Ends the brake of a reversal and finishes stop/reversal timing.
+ *
+ * @param rpm: Current speed (unsigned)
+ * @param rotation: +1/-1 from the direction sensor, 0 if unknown
+ * @return 1 while a sequence or a timing runs (call again after HB_STEP_MS)
+ */
+int hbridgeStep(hbridge* hb, double rpm, int rotation) {
+    if (hb->braking) {
+        int want = directionOf(hb->next);
+        if (rpm < HB_REVERSE_RPM || (rotation && rotation == want) ||
+            elapsedMs(hb->brake_start) > HB_BRAKE_MAX_MS) {
+            hb->braking = 0;
+            hbridgeApply(hb, hb->next, hb->next_duty);
+        }
+    }
+
+    if (hb->timing) {
+        int turned = hb->timing == 2 && !hb->braking && rotation &&
+                     rotation == directionOf(hb->state);
+        double ms = elapsedMs(hb->timing_start);
+        if (rpm < HB_STOP_RPM || turned) {
+            if (hb->timing == 1) {
+                hb->stop_ms = ms;
+                hb->stops++;
+            } else {
+                hb->reverse_ms = ms;
+                hb->reversals++;
+            }
+            hb->timing = 0;
+        } else if (ms > HB_TIMING_MAX_MS) {
+            hb->timing = 0;
+        }
+    }
+    return hb->braking || hb->timing;
+}
+
+const char* hbridgeStateName(hbridge_state state) {
+    switch (state) {
+        case HB_COAST:   return "COAST";
+        case HB_BRAKE:   return "BRAKE";
+        case HB_FORWARD: return "FORWARD";
+        case HB_REVERSE: return "REVERSE";
+    }
+    return "?";
+}
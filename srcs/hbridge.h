@@ -0,0 +1,100 @@
+/*
+ * hbridge.h
+ * H-bridge driver: coast, active brake and drive states, dead-time and
+ * brake-then-reverse sequencing.
+ *
+ * An L298-style bridge has an enable input (PWM) and two direction inputs:
+ *
+ *   state      IN1 IN2  EN      motor terminals
+ *   COAST       0   0   0       open: the rotor runs down on friction
+ *   BRAKE       0   0   duty    shorted through the low side: the back-EMF
+ *                               drives a current that stops the rotor
+ *   FORWARD     1   0   duty    driven forward
+ *   REVERSE     0   1   duty    driven backward
+ *
+ * TRANSITIONS:
+ * The direction inputs are written together with halWriteBank(): the pins
+ * being cleared go LOW in one register write, then the pins being set go
+ * HIGH in the next, so IN1/IN2 pass through (0,0) and never (1,1). While
+ * the inputs change the enable pin is held LOW for dead_time_us, so no
+ * half-bridge switches with the other one still conducting.
+ *
+ * REVERSAL:
+ * Flipping the inputs of a fast rotor ("plugging") puts supply voltage plus
+ * back-EMF across the winding. hbridgeDrive() instead actively brakes at
+ * full duty while the rotor still turns the old way faster than
+ * HB_REVERSE_RPM, then applies the new direction; the reverse drive
+ * finishes the stop with little back-EMF left. The direction of rotation
+ * comes from the direction sensor when there is one, otherwise from the
+ * last driven direction.
+ *
+ * TIMING:
+ * Stops and reversals are timed from the command until the rotor is below
+ * HB_STOP_RPM (or the direction sensor sees the new direction): stop_ms and
+ * reverse_ms. hbridgeStep() advances the sequence and the timing; call it
+ * every HB_STEP_MS while it returns busy, with the latest speed estimate.
+ *
+ * All times are halTick() microseconds (wrapping 32-bit counter).
+ */
+
+#ifndef HBRIDGE_H
+#define HBRIDGE_H
+
+#include <stdint.h>
+#include "motor_hal.h"
+
+#define HB_DEAD_TIME_US    50      // Enable LOW while the direction inputs change (default)
+#define HB_BRAKE_DUTY      100.0   // Enable duty while actively braking, %
+#define HB_REVERSE_RPM     300.0   // Brake a reversal down to this speed, then drive
+#define HB_STOP_RPM        30.0    // Below this the rotor counts as stopped
+#define HB_BRAKE_MAX_MS    2000    // Give up braking (sensor lost) and drive anyway
+#define HB_TIMING_MAX_MS   5000    // Stops taking longer are not recorded
+#define HB_STEP_MS         5       // hbridgeStep() period while busy
+#define HB_SW_PWM_RANGE    255     // Software PWM steps (enable duty 0-255)
+
+typedef enum {
+    HB_COAST,
+    HB_BRAKE,
+    HB_FORWARD,
+    HB_REVERSE,
+} hbridge_state;
+
+typedef struct {
+    hal_motor_wiring pins;
+    int pwm_hw;                // Hardware PWM on the enable pin
+    unsigned pwm_freq;         // PWM frequency (hardware PWM sets it with every duty)
+    unsigned dead_time_us;
+
+    // Output
+    hbridge_state state;
+    double duty;               // Enable duty %
+    int written;               // Inputs written at least once
+    int spin;                  // Last driven direction: +1 forward, -1 reverse, 0 none
+
+    // Brake-then-reverse sequence
+    int braking;
+    hbridge_state next;        // Drive state after the brake
+    double next_duty;
+
+    // Stop/reversal timing
+    int timing;                // 0 = idle, 1 = stop, 2 = reversal
+    uint32_t timing_start;
+    uint32_t brake_start;
+
+    // Results
+    double stop_ms;            // Last stop, ms (0 = none yet)
+    double reverse_ms;         // Last reversal to standstill, ms
+    unsigned long stops;
+    unsigned long reversals;
+} hbridge;
+
+void hbridgeInit(hbridge* hb, const hal_motor_wiring* pins, int pwm_hw, unsigned pwm_freq,
+                 unsigned dead_time_us);
+void hbridgeAdopt(hbridge* hb, hbridge_state state, double duty);
+int hbridgeApply(hbridge* hb, hbridge_state state, double duty);
+int hbridgeDrive(hbridge* hb, int forward, double duty, double rpm, int rotation);
+void hbridgeStop(hbridge* hb, int brake, double rpm);
+int hbridgeStep(hbridge* hb, double rpm, int rotation);
+const char* hbridgeStateName(hbridge_state state);
+
+#endif // HBRIDGE_H
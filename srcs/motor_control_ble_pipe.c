@@ -5,12 +5,84 @@
  * The pipe is written to by ble_server.py (Python BLE server)
  * 
  * Compilation:
- * gcc -o motor_control_ble_pipe motor_control_ble_pipe.c -lpigpio -lrt -lpthread
+ * gcc -o motor_control_ble_pipe motor_control_ble_pipe.c motor_hal*.c rpm_estimator.c rpm_history.c rpm_sync.c rpm_angle.c rpm_quadrature.c rpm_spectrum.c hbridge.c motor_start.c motor_profile.c pwm_sweep.c motor_fault.c motor_sysid.c motor_observer.c -lpigpio -lrt -lpthread -lm
+ * (optional GPIO backends and their flags are listed in motor_hal.h)
  * 
  * Run:
  * 1. mkfifo /tmp/motor_pipe (one time only)
- * 2. sudo ./motor_control_ble_pipe
+ * 2. sudo ./motor_control_ble_pipe [--backend=pigpio|pigpiod|gpiod|sim]
  * 3. In another terminal: sudo ./ble_server_c
+ * 
+ * Hardware PWM on the enable pin (rewire ENA to GPIO 12, 13, 18 or 19):
+ *   sudo ./motor_control_ble_pipe --pwm=hw --enable-pin=18 [--pwm-freq=20000]
+ * 
+ * RPM capture: backend edge capture by default (pigpio DMA samples, gpiod
+ * kernel events); --capture=poll reads the pin every 100us instead.
+ * --edges=rising|falling|both selects the counted blade edges (default both,
+ * see rpm_estimator.h).
+ * Noise rejection: --glitch-us=N drops IR levels shorter than N us (default 0 = off),
+ * --outlier-k=K rejects blade intervals K robust deviations off the median
+ * (default 5, 0 = off). 'rpm' shows the rejected edge counters.
+ * Shaft angle: estimated between blade pulses at the control rate and shown
+ * by 'rpm', absolute once the blade spacing is learned (rpm_angle.h).
+ * Direction: an optional second IR sensor a little behind the first
+ * (--ir2-pin=N, or a 5th --motor pin) gives the sign of the RPM
+ * (rpm_quadrature.h), so automatic mode sees a reversal through zero.
+ * Vibration: a background thread analyses the blade timing jitter once a
+ * second (rpm_spectrum.h); 'spec' shows the shaft orders, jitter and
+ * imbalance score, 'spec base' takes the healthy rotor as the baseline.
+ * H-bridge: inputs change together (bank write) with the enable pin LOW for
+ * --dead-time-us=N (default 50); a reversal brakes the rotor before driving
+ * the other way, and 'off' brakes (--stop=brake, default) or lets the rotor
+ * run down ('coast', --stop=coast). 'rpm' shows the last stop and reversal
+ * times (hbridge.h).
+ * Starts: each start from standstill ramps the duty until the rotor moves
+ * and learns the breakaway duty; steady running gives the sustain duty
+ * (motor_start.h). Both are kept per motor in --profile=PATH (default
+ * /var/tmp/parmco_motors.conf) and used for the kickstart, the automatic
+ * mode's low-end clamp and its starting duty. 'start' shows them.
+ * PWM frequency: 'pwm sweep' runs the motor at several duties at each
+ * software PWM frequency and keeps the one with the most linear, least
+ * lossy response at 1% resolution (pwm_sweep.h), in the motor's profile;
+ * later runs start with it unless --pwm-freq is given. 'pwm' shows it.
+ * Faults: while a motor is driven its IR edges are watched every 5 ms; a
+ * rotor slowing too fast, edges that stop, or a speed far below the
+ * learned speed/duty line tell a stalled rotor from a lost IR sensor
+ * (motor_fault.h). A stall stops the motor (--on-stall=stop|warn), a lost
+ * sensor switches automatic mode to the feedforward duty until the edges
+ * return (--on-sensor-loss=openloop|stop|warn). Faults are printed and
+ * sent as "faultN:" lines.
+ * Frequency response: 'sysid chirp' or 'sysid prbs' perturbs the duty of a
+ * motor running steadily in manual mode by up to 10% and measures the
+ * speed response from 0.1 to 5 Hz on the raw IR edges; 'sysid' shows the
+ * Bode points, the motor's bandwidth, the PID's crossover, phase and gain
+ * margin, and the gain scale for a 60° margin (motor_sysid.h). Results are
+ * sent as "sysidN:" lines. The first-order fit's time constant is kept in
+ * the profile.
+ * Load compensation: with --dob (or 'dob on'), automatic mode adds a
+ * disturbance observer's estimate of a load change to the PID's duty
+ * every 5 ms, from the learned speed/duty line and the time constant
+ * (motor_observer.h); 'dob' shows the model and the load.
+ * History: RPM, duty, setpoint and mode are kept in memory for 24 h at
+ * decreasing resolution (rpm_history.h); 'hist FROM [TO [MAX]]' returns them.
+ * With pigpio, --sample-us=1 gives 1us edge timing (default 5us).
+ * 
+ * Several motors (up to MAX_MOTORS, each with its own H-bridge and IR sensor):
+ *   sudo ./motor_control_ble_pipe --motor=17,23,24,5 --motor=16,20,21,6
+ *   --motor=EN,IN1,IN2,IR[,IR2] once per motor; the first replaces the default wiring.
+ *   Commands prefixed with "mN " go to motor N (0-based, e.g. "m1 s 50"),
+ *   unprefixed ones to motor 0, except 'off', which stops every motor.
+ *   'mN sync M [RATIO [PHASE]]' makes motor N follow motor M at RATIO times
+ *   its speed, with PHASE also locking the blade phase (rpm_sync.h).
+ * 
+ * Fast restarts (pigpiod backend, no root needed):
+ *   ./motor_control_ble_pipe --backend=pigpiod --adopt --hold-on-exit
+ *   --adopt        take over a motor left running by a previous instance
+ *   --hold-on-exit leave the motor running on q/SIGTERM so the next
+ *                  instance can adopt it (BLE disconnect still stops it)
+ *
+ * Tracing:
+ * USDT probes (provider "parmco") are listed in parmco_trace.h
  */
 
 #include <stdio.h>
@@ -20,11 +92,26 @@
 #include <signal.h>
 #include <sys/select.h>
 #include <math.h>
-#include <pigpio.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <time.h>
+#include "motor_hal.h"
+#include "rpm_estimator.h"
+#include "rpm_history.h"
+#include "rpm_sync.h"
+#include "rpm_angle.h"
+#include "rpm_quadrature.h"
+#include "rpm_spectrum.h"
+#include "hbridge.h"
+#include "motor_start.h"
+#include "motor_profile.h"
+#include "pwm_sweep.h"
+#include "motor_fault.h"
+#include "motor_sysid.h"
+#include "motor_observer.h"
+#include "parmco_trace.h"
 
 // GPIO Pin Definitions
 #define MOTOR_ENABLE_PIN 17
@@ -35,27 +122,23 @@
 
 // Constants
 #define PWM_FREQ_HZ 1000
+#define HW_PWM_FREQ_HZ 20000   // Default with --pwm=hw: above the audible range
 #define NUM_BLADES 3
 #define RPM_CALCULATION_WINDOW_MS 500  // Reduced from 1000ms for faster response
 #define RPM_UPDATE_INTERVAL_MS 100
+#define SYNC_STATUS_MS 1000     // syncN: telemetry period (and on every lock change)
+#define PULSE_BUFFER_SIZE 1000  // Pulse timestamps kept by rpmThread
+#define EDGE_BATCH_SIZE 64      // Max edges fetched per halWaitEdges() call
+#define EDGE_WAIT_TIMEOUT_US 10000  // Wake up at least this often to publish RPM
 #define FIFO_PATH "/tmp/motor_pipe"
 #define RPM_FIFO_PATH "/tmp/rpm_pipe"
+#define HIST_DEFAULT_POINTS 120  // 'hist' points when MAX is not given
+#define HIST_MAX_POINTS 600      // Upper limit for MAX
+#define MAX_MOTORS HAL_MAX_MOTORS
 
 // Global state
-int g_speed = 0;
-int g_motor_on = 0;
-int g_direction = 1;
 volatile int g_quit = 0;
 
-// Control mode: 0 = manual, 1 = automatic
-int g_control_mode = 0;  // Start in manual mode
-double g_desired_rpm = 0.0;
-
-// PID controller state for automatic mode
-double g_pid_integral = 0.0;
-double g_pid_last_error = 0.0;
-uint32_t g_last_speed_change_time = 0;  // Track when we last changed speed
-
 // PID tuning parameters - VERY GENTLE for smooth operation
 #define KP 0.03   // Proportional gain (reduced from 0.15 - much gentler)
 #define KI 0.005  // Integral gain (reduced from 0.02 - slower accumulation)
@@ -63,13 +146,119 @@ uint32_t g_last_speed_change_time = 0;  // Track when we last changed speed
 #define MAX_INTEGRAL 50.0   // Anti-windup limit (reduced from 100)
 #define MAX_SPEED_CHANGE 2  // Max speed change per cycle (prevents spikes)
 #define RPM_STABILIZE_DELAY_US 500000  // Wait 500ms after speed change for RPM to stabilize
+#define PID_INTERVAL_S 0.1  // pidController() runs once per control tick (RPM_UPDATE_INTERVAL_MS)
+
+/**
+ * MOTOR CHANNEL
+ * Wiring and state of one motor. All channels share one RPM capture thread
+ * and one control loop; commands pick a channel with the "mN " prefix.
+ */
+typedef struct {
+    int id;
+    char tag[8];                 // "M1 " in messages when driving several motors
+    hal_motor_wiring pins;
+
+    // Drive state
+    int speed;                   // 0-100%
+    double speed_fraction;       // Manual duty beyond whole percent ('s 42.35')
+    int motor_on;
+    int direction;               // 1 = forward, 0 = reverse
+    int control_mode;            // 0 = manual, 1 = automatic, 2 = synchronized
+    double desired_rpm;
+    hbridge bridge;              // Driver states, dead-time, brake-then-reverse
+    motor_start start;           // Kickstart, learned breakaway/sustain duty
+    pwm_sweep sweep;             // PWM frequency characterization ('pwm sweep')
+    unsigned sweep_saved_freq;   // Frequency before the sweep
+    motor_fault fault;           // Stall and sensor dropout detection
+    motor_sysid sysid;           // Frequency response ('sysid')
+    int observe;                 // Load compensation in automatic mode ('dob', --dob)
+    motor_observer observer;     // Its disturbance observer
+
+    // PID controller state for automatic mode
+    double pid_integral;
+    uint32_t last_speed_change_time;  // Track when we last changed speed
+
+    // Capture state (rpmThread only)
+    int use_edges;               // Backend edge capture, otherwise polling
+    int last_state;              // Previous sensor state (for edge detection)
+    uint32_t pulse_times[PULSE_BUFFER_SIZE];  // Circular buffer of pulse timestamps
+    unsigned long pulse_count;   // Valid entries in pulse_times
+    unsigned long pulse_index;   // Current position in circular buffer
+    rpm_glitch_filter glitch;    // Software glitch filter
+    rpm_estimator est;           // Edge selection, period and duty
+    rpm_angle angle_obs;         // Shaft angle observer
+    int has_quad;                // Direction sensor wired and captured
+    int last_state_b;            // Previous direction sensor state (polling)
+    rpm_glitch_filter glitch_b;  // Glitch filter of the direction sensor
+    rpm_quadrature quad;         // Direction decoder
+    rpm_spectrum_feed spec_feed; // Reference edges for the spectrum thread (lock-free)
+
+    // Published by rpmThread, under g_rpm_mutex
+    unsigned long pulses;        // Total pulses counted
+    unsigned long motion_edges;  // IR edges after the glitch filter (every batch, for starts)
+    uint32_t motion_tick;        // Newest of them
+    uint32_t edge_ring[FAULT_EDGE_HISTORY];  // Newest of them by motion_edges (fault detection)
+    unsigned long accepted_periods;          // Blade periods past the estimator's outlier check
+    double period_ring[FAULT_PERIOD_HISTORY];        // Newest of them by accepted_periods (stall detection)
+    uint32_t period_tick_ring[FAULT_PERIOD_HISTORY]; // ... and the edges that ended them
+    uint32_t edges_until;        // Capture time the edges are complete up to
+    unsigned long b_edges;       // Direction sensor edges after the glitch filter
+    double current_rpm;          // Control RPM (PID)
+    rpm_views views;             // Fast/control/display/long-term RPM
+    uint32_t views_tick;         // halTick() of views
+    double blade_duty;           // Blade occlusion duty (both-edge mode)
+    double blade_spacing[RPM_MAX_BLADES];  // Learned gap shares (0 until calibrated)
+    unsigned long rejected[3];   // Glitch, short and long interval rejections
+    rpm_history history;         // Trend history
+    rpm_angle angle;             // Shaft angle observer snapshot
+    int rotation;                // +1 forward, -1 reverse, 0 unknown (no direction sensor)
+    unsigned long reversals;     // Direction changes seen by the direction sensor
+    rpm_spectrum spectrum;       // Latest analysis (spectrumThread)
+    rpm_spectrum spec_baseline;  // Healthy rotor, for the imbalance score ('spec base')
+    unsigned long spec_seq;      // Analyses published
+    rpm_sync sync;               // Follower controller (control_mode 2)
+} motor_channel;
+
+motor_channel g_motors[MAX_MOTORS];
+int g_num_motors = 1;
 
 // RPM state
-volatile unsigned long g_pulse_count = 0;
-volatile double g_current_rpm = 0.0;
+int g_edge_mode = RPM_EDGES_BOTH;    // --edges=rising|falling|both
+unsigned g_glitch_us = 0;            // --glitch-us=N software + backend glitch filter
+double g_outlier_k = RPM_OUTLIER_K;  // --outlier-k=K interval outlier threshold
 pthread_t g_rpm_thread;
+pthread_t g_spec_thread;
 pthread_mutex_t g_rpm_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Enable pin PWM generator (--pwm=sw|hw, --pwm-freq=, --enable-pin=)
+int g_pwm_hw = 0;
+unsigned g_pwm_freq = PWM_FREQ_HZ;
+
+// H-bridge (--dead-time-us=N, --stop=brake|coast)
+unsigned g_dead_time_us = HB_DEAD_TIME_US;
+int g_stop_brake = 1;
+
+// Fault reactions (--on-stall=stop|warn, --on-sensor-loss=openloop|stop|warn)
+#define FAULT_ACT_WARN      0
+#define FAULT_ACT_STOP      1
+#define FAULT_ACT_OPENLOOP  2
+const char* g_fault_action_names[] = { "warn", "stop", "openloop" };
+int g_stall_action = FAULT_ACT_STOP;
+int g_sensor_action = FAULT_ACT_OPENLOOP;
+
+// Load compensation of every motor at start (--dob)
+int g_observe = 0;
+
+// Learned motor parameters (--profile=PATH)
+const char* g_profile_path = PROFILE_PATH;
+
+// RPM capture (--capture=edges|poll)
+int g_capture_poll = 0;
+
+// Restart options (only honoured by persistent backends, i.e. pigpiod)
+int g_adopt_state = 0;    // --adopt
+int g_hold_on_exit = 0;   // --hold-on-exit
+
 // Pipe state
 int g_pipe_fd = -1;
 FILE* g_pipe_stream = NULL;
@@ -78,61 +267,396 @@ FILE* g_pipe_stream = NULL;
 int g_rpm_pipe_fd = -1;
 FILE* g_rpm_pipe_stream = NULL;
 
+/**
+ * COUNT PULSES IN TIME WINDOW
+ * Counts how many timestamps in the pulse_times circular buffer are no older
+ * than window_us microseconds at time 'now'.
+ * 
+ * @param pulse_times: Circular buffer of PULSE_BUFFER_SIZE timestamps
+ * @param pulse_count: Number of valid entries (up to PULSE_BUFFER_SIZE)
+ * @param pulse_index: Next write position in the buffer
+ * @param now: Current halTick() timestamp
+ * @param window_us: Window length in microseconds
+ * @return Number of pulses inside the window
+ */
+unsigned long countPulsesInWindow(const uint32_t* pulse_times, unsigned long pulse_count,
+                                  unsigned long pulse_index, uint32_t now, uint32_t window_us) {
+    unsigned long pulses_in_window = 0;
+    unsigned long count_to_check = (pulse_count < PULSE_BUFFER_SIZE) ? pulse_count : PULSE_BUFFER_SIZE;
+    
+    // Iterate through our circular buffer and count recent pulses
+    for (unsigned long i = 0; i < count_to_check; i++) {
+        unsigned long idx = (pulse_index + PULSE_BUFFER_SIZE - count_to_check + i) % PULSE_BUFFER_SIZE;
+        uint32_t pulse_time = pulse_times[idx];
+        
+        // Check if this pulse is within our time window
+        if (now >= pulse_time) {
+            uint32_t age = now - pulse_time;
+            if (age <= window_us) {
+                pulses_in_window++;
+            }
+        }
+    }
+    
+    return pulses_in_window;
+}
+
+/*
+ * Milliseconds on the monotonic clock (history timestamps)
+ */
+uint32_t monotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/*
+ * Duty plus the disturbance observer's load compensation (automatic mode),
+ * kept between the duty that keeps the rotor turning and 100%
+ */
+double observedDuty(const motor_channel* ch, double duty) {
+    if (ch->observer.compensation == 0.0 || ch->control_mode != 1) return duty;
+    double min_duty = motorStartMinDuty(&ch->start);
+    return fmin(fmax(duty + ch->observer.compensation, fmax(min_duty, 1.0)), 100.0);
+}
+
+/*
+ * Drive duty in percent (the fractional duty of a synchronized follower)
+ */
+double channelDuty(const motor_channel* ch) {
+    if (!ch->motor_on) return 0.0;
+    return ch->control_mode == 2 ? ch->sync.duty : observedDuty(ch, ch->speed + ch->speed_fraction);
+}
+
+/*
+ * Speed (or acceleration) along the commanded direction: negative while the
+ * rotor still turns the other way. Unsigned without a direction sensor.
+ * Caller holds g_rpm_mutex.
+ */
+double rpmAlongDirection(const motor_channel* ch, double rpm) {
+    if (ch->rotation == 0) return rpm;
+    return ch->rotation == (ch->direction ? 1 : -1) ? rpm : -rpm;
+}
+
+/*
+ * Blade phase of synchronized followers against their master: latest
+ * edges of the same polarity, once per new follower edge. The mode and
+ * sync settings change from the main thread, so all of it is read under
+ * g_rpm_mutex.
+ */
+void samplePhases() {
+    int pol = (g_edge_mode & RPM_EDGES_RISING) ? 1 : 0;
+    pthread_mutex_lock(&g_rpm_mutex);
+    for (int m = 0; m < g_num_motors; m++) {
+        motor_channel* ch = &g_motors[m];
+        if (ch->control_mode != 2 || !ch->sync.phase_lock) {
+            continue;
+        }
+        const rpm_estimator* master = &g_motors[ch->sync.master].est;
+        if (!ch->est.have_last[pol] || !master->have_last[pol]) {
+            continue;
+        }
+        rpmSyncPhaseSample(&ch->sync, ch->est.last_tick[pol], master->last_tick[pol],
+                           master->period_us);
+    }
+    pthread_mutex_unlock(&g_rpm_mutex);
+}
+
+/*
+ * Fetch the edges of one IR sensor of a channel: a batch from backend edge
+ * capture (blocking up to wait_us), or one edge from polling the pin
+ */
+int captureEdges(motor_channel* ch, unsigned pin, int* last_state, hal_edge* edges, uint32_t wait_us) {
+    int num_edges = 0;
+    
+    if (ch->use_edges) {
+        // EDGE EVENTS: Block until the backend has a batch of timestamped edges
+        num_edges = halWaitEdges(pin, edges, EDGE_BATCH_SIZE, wait_us);
+        if (num_edges < 0) {
+            num_edges = 0;
+            usleep(1000);  // Backend error - don't spin
+        }
+    } else {
+        // Read current sensor state
+        int current_state = halRead(pin);
+        
+        // EDGE DETECTION: Detect state change (blade passing sensor)
+        if (*last_state != -1 && *last_state != current_state) {
+            edges[0].tick = halTick();  // Get microsecond timestamp
+            edges[0].level = current_state;
+            num_edges = 1;
+        }
+        
+        *last_state = current_state;  // Update for next iteration
+    }
+    return num_edges;
+}
+
+/*
+ * Feed glitch-filtered edges to the channel's estimator and record the
+ * selected ones as pulses
+ */
+void recordPulses(motor_channel* ch, const hal_edge* filtered, int num_edges) {
+    double periods[EDGE_BATCH_SIZE + 1];
+    uint32_t period_ticks[EDGE_BATCH_SIZE + 1];
+    int num_periods = 0;
+
+    // Any edge means the rotor moved (kickstart, fault detection); published at once.
+    // No edge is news too: a late capture thread must not look like a dropout
+    uint32_t until = halTick();
+    pthread_mutex_lock(&g_rpm_mutex);
+    for (int i = 0; i < num_edges; i++) {
+        ch->edge_ring[(ch->motion_edges + i) % FAULT_EDGE_HISTORY] = filtered[i].tick;
+    }
+    ch->motion_edges += num_edges;
+    if (num_edges > 0) ch->motion_tick = filtered[num_edges - 1].tick;
+    ch->edges_until = until;
+    pthread_mutex_unlock(&g_rpm_mutex);
+    
+    for (int i = 0; i < num_edges; i++) {
+        // Direction from the second sensor, at every edge of the first
+        if (ch->has_quad) {
+            rpmQuadratureEdge(&ch->quad, filtered[i].tick, filtered[i].level);
+        }
+        
+        // Skip edges of the polarity not selected by --edges, and outliers
+        unsigned long accepted = ch->est.periods;
+        if (!rpmEstimatorEdge(&ch->est, filtered[i].tick, filtered[i].level)) {
+            continue;
+        }
+        if (ch->est.periods != accepted && num_periods <= EDGE_BATCH_SIZE) {
+            periods[num_periods] = ch->est.period_us;
+            period_ticks[num_periods++] = filtered[i].tick;
+        }
+        rpmAngleEdge(&ch->angle_obs, &ch->est, filtered[i].tick, filtered[i].level);
+        rpmSpectrumFeedEdge(&ch->spec_feed, &ch->est, filtered[i].tick, filtered[i].level);
+        ch->pulses++;                         // Increment channel counter
+        PARMCO_TRACE3(pulse, filtered[i].tick, filtered[i].level, ch->pulses);
+        
+        // Store timestamp in circular buffer
+        ch->pulse_times[ch->pulse_index] = filtered[i].tick;
+        ch->pulse_index = (ch->pulse_index + 1) % PULSE_BUFFER_SIZE;  // Wrap around at 1000
+        if (ch->pulse_count < PULSE_BUFFER_SIZE) {
+            ch->pulse_count++;  // Track how many pulses we have (up to 1000)
+        }
+    }
+    
+    // Stall detection reads only the periods the estimator accepted
+    if (num_periods > 0) {
+        pthread_mutex_lock(&g_rpm_mutex);
+        for (int i = 0; i < num_periods; i++) {
+            unsigned long k = (ch->accepted_periods + i) % FAULT_PERIOD_HISTORY;
+            ch->period_ring[k] = periods[i];
+            ch->period_tick_ring[k] = period_ticks[i];
+        }
+        ch->accepted_periods += num_periods;
+        pthread_mutex_unlock(&g_rpm_mutex);
+    }
+}
+
+/*
+ * Publish one channel's RPM views and record its history sample
+ */
+void publishRPM(motor_channel* ch, uint32_t current_time) {
+    rpm_estimator* est = &ch->est;
+    
+    pthread_mutex_lock(&g_rpm_mutex);
+    ch->angle = ch->angle_obs;
+    ch->rotation = ch->has_quad ? ch->quad.direction : 0;
+    ch->reversals = ch->quad.reversals;
+    ch->rejected[0] = ch->glitch.rejected;
+    ch->rejected[1] = est->rejected_short;
+    ch->rejected[2] = est->rejected_long;
+    pthread_mutex_unlock(&g_rpm_mutex);
+    
+    if (ch->pulse_count > 0) {
+        // COUNT PULSES IN TIME WINDOW
+        // We only count pulses from the last RPM_CALCULATION_WINDOW_MS (500ms)
+        // This gives us a more responsive RPM reading
+        
+        unsigned long pulses_in_window = countPulsesInWindow(
+            ch->pulse_times, ch->pulse_count, ch->pulse_index, current_time,
+            RPM_CALCULATION_WINDOW_MS * 1000);
+        
+        // CALCULATE RPM
+        // Preferred: blade-period views (rpm_estimator.c)
+        // Fallback:  RPM = (pulses / pulses_per_rev) * (60 seconds / window_seconds)
+        // - Divide by pulses per revolution (NUM_BLADES, or 2x in both-edge mode)
+        // - Multiply by 60 to convert revolutions/second to revolutions/minute
+        rpm_views views;
+        if (!rpmEstimatorViews(est, current_time, RPM_CALCULATION_WINDOW_MS * 1000, &views)) {
+            double window_seconds = RPM_CALCULATION_WINDOW_MS / 1000.0;
+            views.control = (pulses_in_window / (double)rpmEstimatorPulsesPerRev(est)) * (60.0 / window_seconds);
+            views.fast = views.control;
+            views.display = views.control;
+        }
+        double rpm = views.control;
+        pthread_mutex_lock(&g_rpm_mutex);  // Thread-safe update
+        ch->current_rpm = rpm;
+        ch->views = views;
+        ch->views_tick = current_time;
+        ch->blade_duty = rpm > 0.0 ? est->duty : 0.0;
+        if (rpmEstimatorCalibrated(est)) {
+            const rpm_blade_cal* cal = &est->cal[(g_edge_mode & RPM_EDGES_RISING) ? 1 : 0];
+            memcpy(ch->blade_spacing, cal->spacing, sizeof(ch->blade_spacing));
+        }
+        pthread_mutex_unlock(&g_rpm_mutex);
+        PARMCO_TRACE2(rpm_publish, PARMCO_CENTI(rpm), pulses_in_window);
+    } else {
+        // NO PULSES DETECTED - Motor stopped or sensor disconnected
+        rpm_views views;
+        rpmEstimatorViews(est, current_time, RPM_CALCULATION_WINDOW_MS * 1000, &views);
+        pthread_mutex_lock(&g_rpm_mutex);
+        ch->current_rpm = 0.0;
+        ch->views = views;
+        ch->views_tick = current_time;
+        ch->blade_duty = 0.0;
+        pthread_mutex_unlock(&g_rpm_mutex);
+        PARMCO_TRACE2(rpm_publish, 0L, 0UL);
+    }
+    
+    // TREND HISTORY: one sample per update (RPM_HIST_STEP_MS)
+    pthread_mutex_lock(&g_rpm_mutex);
+    double setpoint = 0.0;
+    if (ch->control_mode == 1) {
+        setpoint = ch->desired_rpm;
+    } else if (ch->control_mode == 2) {
+        setpoint = ch->sync.ratio * g_motors[ch->sync.master].current_rpm;
+    }
+    rpmHistoryRecord(&ch->history, monotonicMs(), ch->current_rpm, setpoint,
+                     channelDuty(ch), ch->control_mode);
+    pthread_mutex_unlock(&g_rpm_mutex);
+}
+
 /**
  * =============================================================================
  * RPM MONITORING THREAD
  * =============================================================================
  * This thread runs continuously in the background to monitor the IR sensor
- * and calculate the motor's RPM (Revolutions Per Minute).
+ * and calculate the motor's RPM (Revolutions Per Minute), for every motor
+ * channel in turn.
  * 
  * HOW IT WORKS:
- * 1. Reads the IR sensor pin to detect blade passes
- * 2. Records timestamps of each pulse (blade detection)
- * 3. Counts pulses within a time window (500ms by default)
- * 4. Calculates RPM: (pulses / num_blades) * (60 / window_seconds)
- * 5. Updates global g_current_rpm variable (thread-safe with mutex)
- * 6. Sends RPM updates to BLE server via named pipe for iPhone display
+ * 1. Detects blade passes on the IR sensor pin, either from backend edge
+ *    capture (pigpio DMA samples, gpiod, sim) or by polling the pin every 100us
+ * 2. Drops glitches (--glitch-us) and spurious edges (interval outliers),
+ *    keeps the edges selected by --edges (rising, falling or both) as
+ *    pulses and records their timestamps
+ * 3. Measures the blade period between edges of the same polarity
+ *    (rpm_estimator.c), corrects each interval for the learned blade
+ *    spacing
+ * 4. Calculates RPM: 60 / (period_seconds * num_blades) per interval, and
+ *    from the same edges every view in the channel's rpm_views:
+ *    - fast:    the latest interval
+ *    - control: Kalman-tracked RPM and dRPM/dt, low lag (PID, current_rpm)
+ *    - display: 0.5s average (status line, iPhone)
+ *    - 1s/10s/60s averages of counted revolutions (trends, 'rpm' command)
+ *    Until a period is known: (pulses / pulses_per_rev) * (60 / window_seconds)
+ *    over a time window (500ms by default)
+ * 5. Updates the channel's current_rpm and views (thread-safe with mutex)
+ * 6. Records RPM, duty, setpoint and mode into the channel's history
+ *    every update
+ * 7. Tracks the shaft angle between pulses (rpm_angle.h) and publishes
+ *    it with the RPM
+ * 8. Measures the blade phase of synchronized followers (rpm_sync.h)
+ * 9. With a direction sensor (ir2_pin), decodes the direction of rotation
+ *    from its level at each edge of the first sensor (rpm_quadrature.h);
+ *    the views stay unsigned and the direction is published beside them
+ * 10. Hands the reference edges to the spectrum thread (spectrumThread)
+ * 11. The main loop sends the display RPM to the BLE server via named pipe
  * 
  * SENSOR SETUP:
  * - IR sensor outputs HIGH when blade is detected, LOW otherwise
- * - Each state change (edge) is counted as a pulse
- * - With 3 blades, we get 3 pulses per revolution
+ * - Each blade gives a rising edge (arrives) and a falling edge (leaves)
+ * - With 3 blades: 3 pulses per revolution (rising or falling), 6 (both)
+ * - Both-edge mode also measures blade occlusion duty (HIGH time / period)
+ * 
+ * SEVERAL MOTORS:
+ * - One thread serves every channel: it blocks on the first channel's edge
+ *   capture and then collects what the others queued meanwhile. Backends
+ *   timestamp edges as they happen, so the wait does not delay their timing
+ * - With polling capture every channel's pin is read each 100us pass
  * 
  * THREAD SAFETY:
- * - Uses pthread_mutex to protect g_current_rpm from race conditions
+ * - Uses pthread_mutex to protect the published channel state from race conditions
  * - Multiple threads read this value (main loop, PID controller)
  */
 void* rpmThread(void* arg) {
-    int last_state = -1;                // Previous sensor state (for edge detection)
-    uint32_t pulse_times[1000];         // Circular buffer of pulse timestamps
-    unsigned long pulse_count = 0;       // Total pulse count
-    unsigned long pulse_index = 0;       // Current position in circular buffer
+    hal_edge edges[EDGE_BATCH_SIZE];     // Edges captured this iteration
+    hal_edge filtered[EDGE_BATCH_SIZE + 1];  // Edges that passed the glitch filter
+    int all_edges = 1;                   // Every channel has backend edge capture
     
-    // Initialize with current sensor state
-    last_state = gpioRead(IR_SENSOR_PIN);
+    for (int m = 0; m < g_num_motors; m++) {
+        motor_channel* ch = &g_motors[m];
+        rpmGlitchFilterInit(&ch->glitch, g_glitch_us);
+        rpmEstimatorInit(&ch->est, g_edge_mode, NUM_BLADES);
+        ch->est.outlier_k = g_outlier_k;
+        rpmAngleInit(&ch->angle_obs);
+        
+        // Use backend edge capture (DMA samples, kernel events or the sim model)
+        // when available, otherwise fall back to polling the pin every 100us
+        ch->use_edges = !g_capture_poll && (halEdgeCaptureStart(ch->pins.ir_pin) == 0);
+        if (!ch->use_edges) all_edges = 0;
+        printf("✓ %sRPM capture: %s, %s edges (%d pulses/rev)\n", ch->tag,
+               ch->use_edges ? "edge events" : "polling",
+               rpmEstimatorEdgesName(g_edge_mode), rpmEstimatorPulsesPerRev(&ch->est));
+        
+        // Initialize with current sensor state
+        ch->last_state = halRead(ch->pins.ir_pin);
+        
+        // Direction sensor: same capture method as the first sensor
+        if (ch->pins.ir2_pin != HAL_NO_PIN) {
+            ch->has_quad = !ch->use_edges || halEdgeCaptureStart(ch->pins.ir2_pin) == 0;
+            ch->last_state_b = halRead(ch->pins.ir2_pin);
+            rpmGlitchFilterInit(&ch->glitch_b, g_glitch_us);
+            rpmQuadratureInit(&ch->quad, ch->last_state_b);
+            if (ch->has_quad) {
+                printf("✓ %sDirection sensor on GPIO %u\n", ch->tag, ch->pins.ir2_pin);
+            } else {
+                printf("⚠️  %sNo edge capture on direction sensor GPIO %u - RPM unsigned\n",
+                       ch->tag, ch->pins.ir2_pin);
+            }
+        }
+    }
     
     while (!g_quit) {
-        // Read current sensor state
-        int current_state = gpioRead(IR_SENSOR_PIN);
-        
-        // EDGE DETECTION: Detect state change (blade passing sensor)
-        if (last_state != -1 && last_state != current_state) {
-            uint32_t current_time = gpioTick();  // Get microsecond timestamp
-            g_pulse_count++;                      // Increment global counter
+        for (int m = 0; m < g_num_motors; m++) {
+            motor_channel* ch = &g_motors[m];
+            
+            // Block on the first channel only; the others hand over what the
+            // backend queued meanwhile (their rings keep capturing)
+            // A held-back edge is released once it has been steady for g_glitch_us
+            uint32_t wait_us = 0;
+            if (m == 0 && all_edges) {
+                wait_us = EDGE_WAIT_TIMEOUT_US;
+                for (int k = 0; k < g_num_motors; k++) {
+                    if (g_motors[k].glitch.have_pending || g_motors[k].glitch_b.have_pending) {
+                        wait_us = g_glitch_us;
+                    }
+                }
+            }
+            int num_edges = captureEdges(ch, ch->pins.ir_pin, &ch->last_state, edges, wait_us);
+            num_edges = rpmGlitchFilterRun(&ch->glitch, edges, num_edges, halTick(), filtered);
             
-            // Store timestamp in circular buffer
-            pulse_times[pulse_index] = current_time;
-            pulse_index = (pulse_index + 1) % 1000;  // Wrap around at 1000
-            if (pulse_count < 1000) {
-                pulse_count++;  // Track how many pulses we have (up to 1000)
+            // Direction sensor edges up to now, queued for the decoder
+            if (ch->has_quad) {
+                hal_edge filtered_b[EDGE_BATCH_SIZE + 1];
+                int num_b = captureEdges(ch, ch->pins.ir2_pin, &ch->last_state_b, edges, 0);
+                num_b = rpmGlitchFilterRun(&ch->glitch_b, edges, num_b, halTick(), filtered_b);
+                rpmQuadratureSensorB(&ch->quad, filtered_b, num_b);
+                if (num_b > 0) {
+                    pthread_mutex_lock(&g_rpm_mutex);
+                    ch->b_edges += num_b;
+                    pthread_mutex_unlock(&g_rpm_mutex);
+                }
             }
+            recordPulses(ch, filtered, num_edges);
         }
-        
-        last_state = current_state;  // Update for next iteration
+        samplePhases();
         
         // RPM CALCULATION: Update every RPM_UPDATE_INTERVAL_MS (100ms)
         static uint32_t last_update = 0;
-        uint32_t current_time = gpioTick();
+        uint32_t current_time = halTick();
         
         // Initialize on first run
         if (last_update == 0) {
@@ -147,58 +671,54 @@ void* rpmThread(void* arg) {
         
         // Time to calculate RPM?
         if (elapsed >= (RPM_UPDATE_INTERVAL_MS * 1000)) {
-            if (pulse_count > 0) {
-                // COUNT PULSES IN TIME WINDOW
-                // We only count pulses from the last RPM_CALCULATION_WINDOW_MS (500ms)
-                // This gives us a more responsive RPM reading
-                
-                uint32_t window_ago = current_time - (RPM_CALCULATION_WINDOW_MS * 1000);
-                uint32_t window_ago_adjusted = window_ago;
-                if (current_time < window_ago) {  // Handle overflow
-                    window_ago_adjusted = 0;
-                }
-                
-                unsigned long pulses_in_window = 0;
-                unsigned long count_to_check = (pulse_count < 1000) ? pulse_count : 1000;
-                
-                // Iterate through our circular buffer and count recent pulses
-                for (unsigned long i = 0; i < count_to_check; i++) {
-                    unsigned long idx = (pulse_index + 1000 - count_to_check + i) % 1000;
-                    uint32_t pulse_time = pulse_times[idx];
-                    
-                    // Check if this pulse is within our time window
-                    if (current_time >= pulse_time) {
-                        uint32_t age = current_time - pulse_time;
-                        if (age <= (RPM_CALCULATION_WINDOW_MS * 1000)) {
-                            pulses_in_window++;
-                        }
-                    }
-                }
-                
-                // CALCULATE RPM
-                // Formula: RPM = (pulses / num_blades) * (60 seconds / window_seconds)
-                // - Divide by NUM_BLADES because each revolution triggers NUM_BLADES pulses
-                // - Multiply by 60 to convert revolutions/second to revolutions/minute
-                pthread_mutex_lock(&g_rpm_mutex);  // Thread-safe update
-                double window_seconds = RPM_CALCULATION_WINDOW_MS / 1000.0;
-                g_current_rpm = (pulses_in_window / (double)NUM_BLADES) * (60.0 / window_seconds);
-                pthread_mutex_unlock(&g_rpm_mutex);
-            } else {
-                // NO PULSES DETECTED - Motor stopped or sensor disconnected
-                pthread_mutex_lock(&g_rpm_mutex);
-                g_current_rpm = 0.0;
-                pthread_mutex_unlock(&g_rpm_mutex);
+            for (int m = 0; m < g_num_motors; m++) {
+                publishRPM(&g_motors[m], current_time);
             }
-            
             last_update = current_time;  // Reset update timer
         }
         
-        usleep(100);
+        if (!all_edges) {
+            usleep(100);
+        }
     }
     
     return NULL;
 }
 
+/**
+ * =============================================================================
+ * VIBRATION SPECTRUM THREAD
+ * =============================================================================
+ * Analyses each channel's blade timing jitter every RPM_SPEC_INTERVAL_MS
+ * (rpm_spectrum.h): shaft order amplitudes, non-synchronous jitter and the
+ * imbalance score. It only reads the lock-free edge feed that rpmThread
+ * fills, and takes g_rpm_mutex just to publish, so neither the capture
+ * thread nor the control loop waits for the analysis. The main loop sends
+ * each new result to the BLE server.
+ */
+void* spectrumThread(void* arg) {
+    while (!g_quit) {
+        for (int t = 0; t < RPM_SPEC_INTERVAL_MS / 100 && !g_quit; t++) {
+            usleep(100000);
+        }
+        for (int m = 0; m < g_num_motors; m++) {
+            motor_channel* ch = &g_motors[m];
+            rpm_spectrum baseline, spec;
+            pthread_mutex_lock(&g_rpm_mutex);
+            baseline = ch->spec_baseline;
+            pthread_mutex_unlock(&g_rpm_mutex);
+            
+            rpmSpectrumAnalyze(&ch->spec_feed, NUM_BLADES, &baseline, &spec);
+            
+            pthread_mutex_lock(&g_rpm_mutex);
+            ch->spectrum = spec;
+            ch->spec_seq++;
+            pthread_mutex_unlock(&g_rpm_mutex);
+        }
+    }
+    return NULL;
+}
+
 /**
  * =============================================================================
  * PID CONTROLLER FOR AUTOMATIC MODE
@@ -210,6 +730,8 @@ void* rpmThread(void* arg) {
  * - P (Proportional): Responds to current error (desired - actual)
  * - I (Integral): Eliminates steady-state error by accumulating past errors
  * - D (Derivative): Dampens oscillations by responding to rate of change
+ *   of the RPM, taken from the tracker's dRPM/dt instead of differencing
+ *   two noisy RPM readings
  * 
  * TUNING PARAMETERS (defined at top of file):
  * - KP = 0.03:  Gentle proportional response
@@ -223,35 +745,43 @@ void* rpmThread(void* arg) {
  * 1. Stabilization Delay: Waits 500ms after each speed change to let RPM
  *    sensor catch up. Prevents oscillations from acting on stale RPM data.
  * 2. Anti-Windup: Only accumulates integral when error < 500 RPM
- * 3. Kickstart: Jumps to 20% minimum speed when starting from 0
+ * 3. Low-end clamp: never below the learned sustain duty (the kickstart in
+ *    driveBridge() breaks the rotor away); with nothing learned yet, a
+ *    start from 0 jumps to 20%
  * 4. Rate Limiting: Max ±2% speed change per cycle for smooth operation
  * 
- * @param current_rpm: Measured RPM from sensor
+ * @param ch: Motor channel (its PID state and speed)
+ * @param current_rpm: Measured RPM from sensor, along the commanded direction
+ *                     (negative while a reversal is still slowing down)
  * @param desired_rpm: Target RPM from iPhone app
+ * @param rpm_accel: Tracked dRPM/dt in RPM per second
  * @return New motor speed (0-100%)
  */
-int pidController(double current_rpm, double desired_rpm) {
+int pidController(motor_channel* ch, double current_rpm, double desired_rpm, double rpm_accel) {
+    PARMCO_TRACE3(pid_enter, PARMCO_CENTI(current_rpm), PARMCO_CENTI(desired_rpm), ch->speed);
+    
     // SPECIAL CASE: Desired RPM is 0 → Turn off motor immediately
     if (desired_rpm < 1.0) {
-        g_pid_integral = 0.0;           // Reset integral accumulator
-        g_pid_last_error = 0.0;         // Reset derivative memory
-        g_last_speed_change_time = 0;    // Reset stabilization timer
+        ch->pid_integral = 0.0;           // Reset integral accumulator
+        ch->last_speed_change_time = 0;    // Reset stabilization timer
+        PARMCO_TRACE2(pid_exit, 0, 1);
         return 0;
     }
     
     // STABILIZATION DELAY: Wait for RPM sensor to catch up after last speed change
     // This prevents oscillations from acting on stale RPM readings
-    uint32_t current_time = gpioTick();
-    if (g_last_speed_change_time > 0) {
+    uint32_t current_time = halTick();
+    if (ch->last_speed_change_time > 0) {
         // Calculate how long since last speed change
-        uint32_t elapsed = current_time - g_last_speed_change_time;
-        if (current_time < g_last_speed_change_time) {  // Handle microsecond counter overflow
-            elapsed = (0xFFFFFFFF - g_last_speed_change_time) + current_time;
+        uint32_t elapsed = current_time - ch->last_speed_change_time;
+        if (current_time < ch->last_speed_change_time) {  // Handle microsecond counter overflow
+            elapsed = (0xFFFFFFFF - ch->last_speed_change_time) + current_time;
         }
         
         // If not enough time has passed (< 500ms), don't adjust speed yet
         if (elapsed < RPM_STABILIZE_DELAY_US) {
-            return g_speed;  // Keep current speed, wait for RPM to stabilize
+            PARMCO_TRACE2(pid_exit, ch->speed, 2);
+            return ch->speed;  // Keep current speed, wait for RPM to stabilize
         }
     }
     
@@ -266,20 +796,20 @@ int pidController(double current_rpm, double desired_rpm) {
     // Accumulates error over time to push toward target
     // ANTI-WINDUP: Only accumulate when close to target (error < 500 RPM)
     if (fabs(error) < 500.0) {
-        g_pid_integral += error;
+        ch->pid_integral += error;
         // Clamp integral to prevent windup (runaway accumulation)
-        if (g_pid_integral > MAX_INTEGRAL) g_pid_integral = MAX_INTEGRAL;
-        if (g_pid_integral < -MAX_INTEGRAL) g_pid_integral = -MAX_INTEGRAL;
+        if (ch->pid_integral > MAX_INTEGRAL) ch->pid_integral = MAX_INTEGRAL;
+        if (ch->pid_integral < -MAX_INTEGRAL) ch->pid_integral = -MAX_INTEGRAL;
     }
-    double i_term = KI * g_pid_integral;
+    double i_term = KI * ch->pid_integral;
     
     // D-TERM (Derivative): Dampen oscillations
-    // Responds to rate of change of error
-    double d_term = KD * (error - g_pid_last_error);
-    g_pid_last_error = error;  // Remember for next cycle
+    // Responds to rate of change of error. With a fixed target that is
+    // -dRPM/dt; scaled to one PID cycle so KD keeps its meaning
+    double d_term = KD * (-rpm_accel * PID_INTERVAL_S);
     
     // CALCULATE SPEED ADJUSTMENT
-    int current_speed = g_speed;
+    int current_speed = ch->speed;
     double adjustment = p_term + i_term + d_term;  // Combine all three terms
     
     // RATE LIMITING: Prevent sudden speed changes (max ±2% per cycle)
@@ -293,17 +823,22 @@ int pidController(double current_rpm, double desired_rpm) {
     if (new_speed < 0) new_speed = 0;
     if (new_speed > 100) new_speed = 100;
     
-    // KICKSTART: Motor won't spin at very low speeds
-    // If starting from 0, jump to 20% minimum
-    if (current_speed == 0 && new_speed > 0 && new_speed < 20) {
+    // LOW-END CLAMP: below the learned sustain duty the rotor stalls
+    // (the kickstart in driveBridge() gets it moving from standstill)
+    double min_duty = motorStartMinDuty(&ch->start);
+    if (min_duty > 0.0) {
+        if (new_speed < (int)ceil(min_duty)) new_speed = (int)ceil(min_duty);
+    } else if (current_speed == 0 && new_speed > 0 && new_speed < 20) {
+        // Nothing learned yet: if starting from 0, jump to 20% minimum
         new_speed = 20;
     }
     
     // RECORD TIMESTAMP: If we changed speed, start stabilization delay timer
     if (new_speed != current_speed) {
-        g_last_speed_change_time = gpioTick();
+        ch->last_speed_change_time = halTick();
     }
     
+    PARMCO_TRACE2(pid_exit, new_speed, 0);
     return new_speed;
 }
 
@@ -311,39 +846,122 @@ int pidController(double current_rpm, double desired_rpm) {
  * =============================================================================
  * MOTOR CONTROL FUNCTIONS
  * =============================================================================
- * These functions control the motor via an H-bridge driver using 3 GPIO pins:
+ * These functions control a motor channel via an H-bridge driver using 3 GPIO
+ * pins (defaults for motor 0, others come from --motor=EN,IN1,IN2,IR):
  * - MOTOR_ENABLE_PIN (GPIO 17): PWM signal controls speed (0-100% duty cycle)
+ *   (GPIO 12/13/18/19 when using hardware PWM)
  * - MOTOR_IN1_PIN (GPIO 23): Direction control bit 1
  * - MOTOR_IN2_PIN (GPIO 24): Direction control bit 2
  * 
  * H-BRIDGE TRUTH TABLE:
  * IN1=HIGH, IN2=LOW  → Motor spins FORWARD (clockwise)
  * IN1=LOW,  IN2=HIGH → Motor spins REVERSE (counter-clockwise)
- * IN1=LOW,  IN2=LOW  → Motor BRAKE (both sides grounded)
+ * IN1=LOW,  IN2=LOW  → Motor BRAKE with ENABLE on, COAST with ENABLE off
  * IN1=HIGH, IN2=HIGH → Motor BRAKE (not used, avoid this state)
+ * All pin writes go through the channel's hbridge (hbridge.h): both inputs
+ * change in one bank write behind a dead-time, and reversals brake first.
  * 
  * The ENABLE pin uses PWM (Pulse Width Modulation) to control speed:
  * - 0% duty cycle   → Motor off
  * - 50% duty cycle  → Half speed
  * - 100% duty cycle → Full speed
+ * 
+ * Two PWM generators are supported (--pwm=):
+ * - sw (default): pigpio DMA-timed PWM at PWM_FREQ_HZ, duty 0-255
+ * - hw: the SoC PWM peripheral via halHardwarePWM(), duty in millionths at
+ *   HW_PWM_FREQ_HZ (or --pwm-freq). No DMA/CPU load, no timing jitter, and
+ *   it can run above the audible range. Only GPIO 12, 13, 18 and 19 have it.
+ */
+
+/*
+ * Speed for the H-bridge sequencing: the published control RPM
+ * extrapolated with its acceleration, since views are only refreshed every
+ * RPM_UPDATE_INTERVAL_MS. A slowing rotor decays exponentially (braking or
+ * coasting), so deceleration is extrapolated as a decay, not a straight line
+ * that would reach zero too early.
+ */
+double bridgeRpm(motor_channel* ch, int* rotation) {
+    pthread_mutex_lock(&g_rpm_mutex);
+    double dt = (uint32_t)(halTick() - ch->views_tick) / 1e6;
+    double rpm = ch->views.control;
+    double accel = ch->views.accel;
+    *rotation = ch->rotation;
+    pthread_mutex_unlock(&g_rpm_mutex);
+    if (rpm <= 0.0) return 0.0;
+    return accel < 0.0 ? rpm * exp(accel / rpm * dt) : rpm + accel * dt;
+}
+
+/*
+ * Drive the channel's bridge in its direction at duty %. From standstill
+ * the kickstart ramp (motor_start.h) runs first; duty becomes its target.
+ * @return Raw duty written
  */
+int driveBridge(motor_channel* ch, double duty) {
+    int rotation;
+    double rpm = bridgeRpm(ch, &rotation);
+    motor_start* st = &ch->start;
+    int driving = ch->bridge.duty > 0.0 &&
+                  (ch->bridge.state == HB_FORWARD || ch->bridge.state == HB_REVERSE);
+    
+    if (duty <= 0.0) {
+        st->active = 0;
+    } else if (st->active) {
+        st->target = duty;
+        duty = st->duty;
+    } else if (rpm < HB_STOP_RPM && !driving && !ch->bridge.braking) {
+        pthread_mutex_lock(&g_rpm_mutex);
+        unsigned long edges = ch->motion_edges;
+        uint32_t edge_tick = ch->motion_tick;
+        pthread_mutex_unlock(&g_rpm_mutex);
+        motorStartBegin(st, duty, edges, edge_tick, halTick());
+        motorFaultReset(&ch->fault);  // Switched on again: a latched stall is over
+        duty = st->duty;
+    }
+    int raw = hbridgeDrive(&ch->bridge, ch->direction, duty, rpm, rotation);
+    motorObserverDuty(&ch->observer, ch->bridge.duty, halTick());
+    return raw;
+}
+
+/*
+ * Write every channel's learned parameters to --profile
+ */
+void saveProfiles() {
+    static int warned = 0;
+    motor_profile profiles[MAX_MOTORS];
+    for (int m = 0; m < g_num_motors; m++) {
+        profiles[m] = g_motors[m].start.profile;
+    }
+    if (motorProfileSave(g_profile_path, profiles, g_num_motors) < 0 && !warned) {
+        printf("\n⚠️  Cannot save learned motor parameters to %s\n", g_profile_path);
+        warned = 1;
+    }
+}
+
+/*
+ * Status LED: on while any motor runs
+ */
+void updateLed() {
+    int any_on = 0;
+    for (int m = 0; m < g_num_motors; m++) {
+        if (g_motors[m].motor_on) any_on = 1;
+    }
+    halWrite(LED_PIN, any_on);
+}
 
 /**
  * SET MOTOR DIRECTION
  * @param dir: 1 = forward (clockwise), 0 = reverse (counter-clockwise)
  */
-void setDirection(int dir) {
-    g_direction = dir;
-    if (dir == 1) {
-        // FORWARD: IN1=HIGH, IN2=LOW
-        printf("-> Direction: FORWARD\n");
-        gpioWrite(MOTOR_IN1_PIN, 1);
-        gpioWrite(MOTOR_IN2_PIN, 0);
-    } else {
-        // REVERSE: IN1=LOW, IN2=HIGH
-        printf("-> Direction: REVERSE\n");
-        gpioWrite(MOTOR_IN1_PIN, 0);
-        gpioWrite(MOTOR_IN2_PIN, 1);
+void setDirection(motor_channel* ch, int dir) {
+    ch->direction = dir;
+    printf("-> %sDirection: %s\n", ch->tag, dir == 1 ? "FORWARD" : "REVERSE");
+    
+    // A stopped motor keeps its brake/coast state until it is switched on
+    if (ch->motor_on) {
+        driveBridge(ch, channelDuty(ch));
+        if (ch->bridge.braking) {
+            printf("-> %sBraking before the reversal\n", ch->tag);
+        }
     }
 }
 
@@ -354,31 +972,77 @@ void setDirection(int dir) {
  * PWM (Pulse Width Modulation) works by rapidly switching the motor power on/off:
  * - Higher duty cycle = more time ON = faster speed
  * - Lower duty cycle = less time ON = slower speed
- * - Frequency: 800 Hz (set in initialization)
+ * - Frequency: PWM_FREQ_HZ, --pwm-freq or the one 'pwm sweep' picked
  * 
  * @param speed: Desired speed (0-100%)
  *               0 = stopped, 100 = full speed
  */
-void setSpeed(int speed) {
+void setSpeed(motor_channel* ch, int speed) {
     // Clamp speed to valid range
     if (speed < 0) speed = 0;
     if (speed > 100) speed = 100;
-    g_speed = speed;  // Update global state
+    ch->speed = speed;  // Update global state
+    ch->speed_fraction = 0.0;
     
-    printf("-> Speed: %d%%\n", speed);
+    printf("-> %sSpeed: %d%%\n", ch->tag, speed);
     
     if (speed == 0) {
         // Speed 0 = turn motor off completely
-        g_motor_on = 0;
-        gpioPWM(MOTOR_ENABLE_PIN, 0);  // Stop PWM
-        gpioWrite(LED_PIN, 0);          // Turn off LED
+        ch->motor_on = 0;
+        driveBridge(ch, 0);                // Stop PWM (coast)
+        PARMCO_TRACE2(pwm_write, 0, 0);
+        updateLed();                   // LED off unless another motor runs
     } else {
         // Speed > 0 = turn motor on and set PWM
-        g_motor_on = 1;
-        // Convert 0-100% to 0-255 PWM range (pigpio uses 0-255)
-        int pwm_value = (speed * 255) / 100;
-        gpioPWM(MOTOR_ENABLE_PIN, pwm_value);  // Apply PWM
-        gpioWrite(LED_PIN, 1);                   // Turn on LED
+        ch->motor_on = 1;
+        int pwm_value = driveBridge(ch, observedDuty(ch, speed));  // Apply PWM
+        PARMCO_TRACE2(pwm_write, speed, pwm_value);
+        updateLed();                            // Turn on LED
+    }
+}
+
+/**
+ * SET FRACTIONAL SPEED
+ * Manual 's N' with decimals: the duty resolves to 1/255 with software PWM
+ * and to millionths with hardware PWM. The whole percent stays in speed
+ * (status, '+'/'-'), the rest in speed_fraction.
+ * 
+ * @param duty: 0-100%
+ */
+void setFineSpeed(motor_channel* ch, double duty) {
+    if (duty < 0.0) duty = 0.0;
+    if (duty > 100.0) duty = 100.0;
+    int speed = (int)lround(duty);
+    if (speed == 0 || duty == speed) {
+        setSpeed(ch, speed);
+        return;
+    }
+    ch->speed = speed;
+    ch->speed_fraction = duty - speed;
+    printf("-> %sSpeed: %.2f%%\n", ch->tag, duty);
+    ch->motor_on = 1;
+    int pwm_value = driveBridge(ch, duty);
+    PARMCO_TRACE2(pwm_write, speed, pwm_value);
+    updateLed();
+}
+
+/**
+ * SET FOLLOWER DUTY
+ * Applies the synchronization controller's fractional duty every control
+ * cycle (quietly - setSpeed() would print 10 lines per second). Under
+ * software PWM the bridge gets the dithered duty (see rpmSyncDither()).
+ * 
+ * @param duty: 0-100%
+ */
+void setSyncDuty(motor_channel* ch, double duty) {
+    int was_on = ch->motor_on;
+    ch->speed = (int)(duty + 0.5);  // Whole percent for status
+    ch->speed_fraction = duty - ch->speed;  // Manual takeover holds the exact duty
+    ch->motor_on = duty > 0.0;
+    int pwm_value = driveBridge(ch, rpmSyncDither(&ch->sync));
+    PARMCO_TRACE2(pwm_write, ch->speed, pwm_value);
+    if (ch->motor_on != was_on) {
+        updateLed();
     }
 }
 
@@ -387,38 +1051,135 @@ void setSpeed(int speed) {
  * Enables the motor and applies the current speed setting.
  * If speed is 0, defaults to 50% to ensure motor spins.
  */
-void motorOn() {
+void motorOn(motor_channel* ch) {
     // Check if already on
-    if (g_motor_on) {
-        printf("-> Motor already ON\n");
+    if (ch->motor_on) {
+        printf("-> %sMotor already ON\n", ch->tag);
         return;
     }
     
     // Default to 50% speed if currently 0
-    if (g_speed == 0) g_speed = 50;
+    if (ch->speed == 0) ch->speed = 50;
     
-    g_motor_on = 1;                  // Update global state
-    setDirection(g_direction);       // Ensure direction is set
-    setSpeed(g_speed);               // Apply speed (starts PWM and LED)
-    printf("-> Motor ON\n");
+    setSpeed(ch, ch->speed);               // Apply direction and speed (starts PWM and LED)
+    printf("-> %sMotor ON\n", ch->tag);
 }
 
 /**
  * TURN MOTOR OFF
- * Stops the motor completely by:
- * 1. Setting PWM to 0 (no power)
- * 2. Setting both direction pins LOW (brake mode)
- * 3. Turning off status LED
+ * Stops the motor by:
+ * 1. Setting both direction pins LOW
+ * 2. BRAKE: enable pin at full duty, the shorted winding stops the rotor
+ *    and holds it (SAFE STOP - it resists being turned by hand)
+ *    COAST: enable pin LOW, the rotor runs down freely
+ * 3. Turning off status LED once no motor runs
  * 
- * This is a SAFE STOP - motor will not spin even if manually pushed.
+ * @param brake: Active brake, otherwise coast ('off' uses --stop=)
  */
-void motorOff() {
-    printf("-> Motor OFF\n");
-    g_motor_on = 0;                   // Update global state
-    gpioPWM(MOTOR_ENABLE_PIN, 0);     // Stop PWM (no power)
-    gpioWrite(MOTOR_IN1_PIN, 0);      // Set direction pins to brake mode
-    gpioWrite(MOTOR_IN2_PIN, 0);      // (both LOW = brake)
-    gpioWrite(LED_PIN, 0);             // Turn off status LED
+void motorStop(motor_channel* ch, int brake) {
+    printf("-> %sMotor OFF (%s)\n", ch->tag, brake ? "brake" : "coast");
+    ch->motor_on = 0;                   // Update global state
+    int rotation;
+    hbridgeStop(&ch->bridge, brake, bridgeRpm(ch, &rotation));
+    updateLed();                      // Turn off status LED (last motor)
+}
+
+void motorOff(motor_channel* ch) {
+    motorStop(ch, g_stop_brake);
+}
+
+/*
+ * Software PWM frequency of the channel's enable pin
+ * @return Frequency really set
+ */
+unsigned setPWMFrequency(motor_channel* ch, unsigned freq) {
+    int set = halSetPWMFrequency(ch->pins.enable_pin, freq);
+    ch->bridge.pwm_freq = set > 0 ? (unsigned)set : freq;
+    return ch->bridge.pwm_freq;
+}
+
+/**
+ * START PWM FREQUENCY SWEEP
+ * Finds the frequencies the backend really sets (it snaps requests to its
+ * own table), then hands the motor to the sweep (pwm_sweep.h).
+ */
+void startSweep(motor_channel* ch) {
+    unsigned freqs[SWEEP_MAX_FREQS];
+    int ranges[SWEEP_MAX_FREQS];
+    int n = 0;
+    ch->sweep_saved_freq = ch->bridge.pwm_freq;
+    for (int i = 0; i < SWEEP_NUM_CANDIDATES && n < SWEEP_MAX_FREQS; i++) {
+        unsigned freq = setPWMFrequency(ch, g_sweep_candidates[i]);
+        int duplicate = freq < SWEEP_MIN_HZ;
+        for (int k = 0; k < n; k++) {
+            if (freqs[k] == freq) duplicate = 1;
+        }
+        if (!duplicate) {
+            freqs[n] = freq;
+            ranges[n] = halGetPWMRealRange(ch->pins.enable_pin);
+            n++;
+        }
+    }
+    setPWMFrequency(ch, ch->sweep_saved_freq);
+    
+    pwmSweepBegin(&ch->sweep, freqs, ranges, n, monotonicMs());
+    printf("-> %sPWM SWEEP: %d frequencies x %d duties (about %d s, commands to it other than queries abort)\n",
+           ch->tag, n, SWEEP_DUTIES, n * SWEEP_DUTIES * SWEEP_POINT_MS / 1000);
+    ch->motor_on = 1;
+    updateLed();
+}
+
+/*
+ * Abort a running sweep: previous frequency, motor off
+ */
+void abortSweep(motor_channel* ch) {
+    if (!ch->sweep.active) return;
+    ch->sweep.active = 0;
+    setPWMFrequency(ch, ch->sweep_saved_freq);
+    printf("-> %sPWM sweep aborted, back to %u Hz\n", ch->tag, ch->bridge.pwm_freq);
+    motorOff(ch);
+}
+
+/*
+ * Sweep result table and the chosen frequency
+ */
+void printSweep(const motor_channel* ch) {
+    const pwm_sweep* sweep = &ch->sweep;
+    printf("   Hz     steps ");
+    for (int d = 0; d < SWEEP_DUTIES; d++) printf(" RPM@%2.0f%%", g_sweep_duties[d]);
+    printf("  drive linear score\n");
+    for (int i = 0; i < sweep->num_freqs; i++) {
+        const pwm_sweep_point* pt = &sweep->points[i];
+        printf("   %5u  %5d ", pt->freq, pt->real_range);
+        for (int d = 0; d < SWEEP_DUTIES; d++) printf(" %7.0f", pt->rpm[d]);
+        printf("  %5.3f %6.3f %5.3f%s\n", pt->drive, pt->linearity, pt->score,
+               i == sweep->best ? "  <- best" : "");
+    }
+}
+
+/*
+ * Sweep finished: keep the best frequency (and its speed/duty line, which
+ * the sustain fit had learned at the old frequency)
+ */
+void finishSweep(motor_channel* ch) {
+    printf("\n-> %sPWM sweep done\n", ch->tag);
+    printSweep(ch);
+    if (ch->sweep.best < 0) {
+        printf("⚠️  %sNo usable response - keeping %u Hz\n", ch->tag, ch->sweep_saved_freq);
+        setPWMFrequency(ch, ch->sweep_saved_freq);
+    } else {
+        const pwm_sweep_point* best = &ch->sweep.points[ch->sweep.best];
+        setPWMFrequency(ch, best->freq);
+        ch->start.profile.pwm_freq = ch->bridge.pwm_freq;
+        if (best->slope > 0.0 && best->sustain > 0.0) {
+            ch->start.profile.sustain = best->sustain;
+            ch->start.profile.slope = best->slope;
+        }
+        ch->start.num_points = 0;
+        saveProfiles();
+        printf("✓ %sPWM frequency: %u Hz (saved)\n", ch->tag, ch->bridge.pwm_freq);
+    }
+    motorOff(ch);
 }
 
 /**
@@ -520,6 +1281,20 @@ void closeRPMPipe() {
     }
 }
 
+/**
+ * FORMAT RPM PIPE MESSAGE
+ * Writes "rpm:####.##\n" into buf (the line format read by ble_server).
+ * Motors other than motor 0 are sent as "rpmN:####.##\n".
+ * @return Number of characters written (as snprintf)
+ */
+int formatRPM(char* buf, size_t size, int motor, double rpm) {
+    if (motor > 0) {
+        return snprintf(buf, size, "rpm%d:%.2f\n", motor, rpm);
+    }
+    // Format: "rpm:####.##\n"
+    return snprintf(buf, size, "rpm:%.2f\n", rpm);
+}
+
 /**
  * SEND RPM TO BLE SERVER
  * Writes current RPM to named pipe so BLE server can send it to iPhone.
@@ -531,13 +1306,13 @@ void closeRPMPipe() {
  * If pipe write fails (BLE server disconnected), closes pipe and tries
  * to reopen on next call.
  * 
+ * @param motor: Motor channel number (0 = the one shown by the app)
  * @param rpm: Current RPM value to send
  */
-void sendRPM(double rpm) {
+void sendRPM(int motor, double rpm) {
     if (g_rpm_pipe_stream) {
         char rpm_str[32];
-        // Format: "rpm:####.##\n"
-        snprintf(rpm_str, sizeof(rpm_str), "rpm:%.2f\n", rpm);
+        formatRPM(rpm_str, sizeof(rpm_str), motor, rpm);
         
         // Try to write to pipe
         if (fputs(rpm_str, g_rpm_pipe_stream) >= 0) {
@@ -550,42 +1325,556 @@ void sendRPM(double rpm) {
 }
 
 /**
- * =============================================================================
- * COMMAND PROCESSING
- * =============================================================================
- * Parses and executes commands from keyboard or BLE pipe.
- * 
- * COMMAND PROTOCOL:
- * Universal commands (work in both manual and automatic modes):
- *   - "on"   : Turn motor on
- *   - "off"  : Turn motor off
- *   - "f"    : Set direction forward (clockwise)
- *   - "r"    : Set direction reverse (counter-clockwise)
- *   - "rpm"  : Print current RPM
- *   - "q"    : Quit program
+ * SEND SYNC STATUS
+ * Lock-quality telemetry of a synchronized follower. Called every control
+ * cycle; sent when the lock state changes and otherwise every SYNC_STATUS_MS.
  * 
- * Manual mode commands:
- *   - "s N"  : Set speed to N% (0-100)
- *   - "+"    : Increase speed by 10%
- *   - "-"    : Decrease speed by 10%
- * 
- * Automatic mode commands:
- *   - "auto N" : Switch to automatic mode, target N RPM
- *   - "manual" : Switch back to manual mode
- * 
- * MODE BLOCKING:
- * In automatic mode, manual speed control commands (+, -, s) are blocked
- * to prevent interference with PID controller.
+ * FORMAT: "syncN:<speed error RPM>,<phase error deg>,<coherence>,<locked>\n"
+ * Example: "sync1:-2.4,3.1,0.97,1\n"
  */
-void processCommand(char* input) {
-    // Clean up input string - remove trailing newline/carriage return
-    input[strcspn(input, "\n")] = 0;
-    input[strcspn(input, "\r")] = 0;
-    
+void sendSyncStatus(const motor_channel* ch, const rpm_sync_status* status) {
+    static int sent[MAX_MOTORS];            // Locked state last sent + 1 (0 = none yet)
+    static uint32_t sent_ms[MAX_MOTORS];
+    uint32_t now_ms = monotonicMs();
+    if (sent[ch->id] == status->locked + 1 && now_ms - sent_ms[ch->id] < SYNC_STATUS_MS) {
+        return;
+    }
+    if (g_rpm_pipe_stream) {
+        sent[ch->id] = status->locked + 1;
+        sent_ms[ch->id] = now_ms;
+        if (fprintf(g_rpm_pipe_stream, "sync%d:%.1f,%.1f,%.2f,%d\n", ch->id, status->speed_err,
+                    status->phase_deg, status->coherence, status->locked) < 0 ||
+            fflush(g_rpm_pipe_stream) != 0) {
+            closeRPMPipe();  // Pipe broken (BLE server closed) - reopen later
+        }
+    }
+}
+
+/*
+ * Print a follower's lock quality
+ */
+void printSyncStatus(const motor_channel* ch) {
+    rpm_sync_status status;
+    pthread_mutex_lock(&g_rpm_mutex);
+    rpmSyncStatus(&ch->sync, &status);
+    double duty = ch->sync.duty;
+    pthread_mutex_unlock(&g_rpm_mutex);
+    printf("   Sync: following M%d x%.3f, speed error %+.1f RPM, duty %.2f%%, %s\n",
+           ch->sync.master, ch->sync.ratio, status.speed_err, duty,
+           status.locked ? "LOCKED" : "not locked");
+    if (ch->sync.phase_lock) {
+        printf("   Phase: error %+.1f° (target lag %.1f°), coherence %.2f\n", status.phase_deg,
+               ch->sync.phase_offset * 360.0 / ch->sync.blades, status.coherence);
+    }
+}
+
+/**
+ * SEND SPECTRUM
+ * Vibration telemetry, once per analysis (nothing while it is not valid).
+ * 
+ * FORMAT: "specN:<imbalance deg>,<jitter deg>,<peak order>,<peak deg>,<order 1 deg>[,<order 2 deg>...]\n"
+ * Example: "spec0:0.012,0.004,2.41,0.002,0.350\n"
+ */
+void sendSpectrum(const motor_channel* ch, const rpm_spectrum* spec) {
+    if (g_rpm_pipe_stream && spec->valid) {
+        int ok = fprintf(g_rpm_pipe_stream, "spec%d:%.3f,%.3f,%.2f,%.3f", ch->id, spec->imbalance,
+                         spec->jitter_deg, spec->peak_order, spec->peak_deg) >= 0;
+        for (int h = 0; h < spec->orders && ok; h++) {
+            ok = fprintf(g_rpm_pipe_stream, ",%.3f", spec->order_deg[h]) >= 0;
+        }
+        if (!ok || fputc('\n', g_rpm_pipe_stream) == EOF || fflush(g_rpm_pipe_stream) != 0) {
+            closeRPMPipe();  // Pipe broken (BLE server closed) - reopen later
+        }
+    }
+}
+
+/**
+ * SEND FAULT
+ * Raised faults and the end of a sensor outage.
+ * 
+ * FORMAT: "faultN:<stall|sensor|none>,<action>,<ms>,<RPM before>\n"
+ *   raised:  ms the evidence took (the edge gap, the slowing revolution)
+ *   cleared: kind "none", action "resume", ms the outage lasted
+ * Example: "fault0:sensor,openloop,31,2987\n"
+ */
+void sendFault(const motor_channel* ch, const char* action) {
+    if (g_rpm_pipe_stream) {
+        const motor_fault* f = &ch->fault;
+        if (fprintf(g_rpm_pipe_stream, "fault%d:%s,%s,%.0f,%.0f\n", ch->id, motorFaultName(f->fault),
+                    action, f->detect_ms, f->rpm_before) < 0 ||
+            fflush(g_rpm_pipe_stream) != 0) {
+            closeRPMPipe();  // Pipe broken (BLE server closed) - reopen later
+        }
+    }
+}
+
+/**
+ * SEND SYSTEM IDENTIFICATION
+ * Once per finished 'sysid', for the PID as tuned.
+ * 
+ * FORMAT: "sysidN:<signal>,<RPM per %>,<bandwidth Hz>,<crossover Hz>,<phase margin>,<gain margin dB>,<gain scale>,<its margin>\n"
+ *   0 where a value is outside the measured points
+ * Example: "sysid0:chirp,64.5,0.51,0.50,42.1,0.0,1.35,45.0\n"
+ */
+void sendSysid(const motor_channel* ch, const motor_sysid_loop* loop) {
+    if (g_rpm_pipe_stream) {
+        const motor_sysid* s = &ch->sysid;
+        if (fprintf(g_rpm_pipe_stream, "sysid%d:%s,%.1f,%.2f,%.2f,%.1f,%.1f,%.2f,%.1f\n", ch->id,
+                    motorSysidSignalName(s->signal), s->dc_gain, s->bandwidth_hz, loop->crossover_hz,
+                    loop->phase_margin, loop->gain_margin_db, loop->scale, loop->target_pm) < 0 ||
+            fflush(g_rpm_pipe_stream) != 0) {
+            closeRPMPipe();  // Pipe broken (BLE server closed) - reopen later
+        }
+    }
+}
+
+/*
+ * Print a channel's vibration spectrum
+ */
+void printSpectrum(const motor_channel* ch) {
+    pthread_mutex_lock(&g_rpm_mutex);
+    rpm_spectrum spec = ch->spectrum;
+    int have_baseline = ch->spec_baseline.valid;
+    pthread_mutex_unlock(&g_rpm_mutex);
+    if (!spec.valid) {
+        printf("-> %sSpectrum: not enough steady revolutions yet (%d needed)\n", ch->tag, RPM_SPEC_MIN_REVS);
+        return;
+    }
+    printf("-> %sSpectrum over %.0f revolutions at %.1f RPM:\n", ch->tag, spec.revs, spec.rpm);
+    for (int h = 0; h < spec.orders; h++) {
+        printf("   Order %d: %.3f°\n", h + 1, spec.order_deg[h]);
+    }
+    printf("   Jitter: %.3f° RMS, largest at order %.2f (%.3f°)\n", spec.jitter_deg,
+           spec.peak_order, spec.peak_deg);
+    printf("   Imbalance: %.3f° %s\n", spec.imbalance,
+           have_baseline ? "(change from baseline)" : "(order 1, no baseline)");
+}
+
+/**
+ * SEND HISTORY
+ * Answers a 'hist' query from the in-memory trend history (no disk access).
+ * With the BLE server connected the points go down the RPM pipe, otherwise
+ * they are printed.
+ * 
+ * FORMAT (one line each):
+ *   "hist:begin,<points>,<step_ms>\n"
+ *   "hist:<age_ms>,<rpm>,<duty %>,<setpoint>,<mode>\n"   oldest first
+ *   "hist:end,<points>\n"
+ * The writes are non-blocking. HIST_MAX_POINTS lines (~30 KB) usually fit
+ * in the pipe buffer (64 KB on Linux), but not when a slow BLE server has
+ * left it nearly full. Every write is checked: the first failure ends the
+ * reply without "hist:end" and drops the pipe. The BLE server discards a
+ * reply whose point count does not match the begin and end lines.
+ * 
+ * @param ch: Motor channel whose history is sent
+ * @param from_s: Start of the range in seconds before now
+ * @param to_s: End of the range in seconds before now
+ * @param max_points: Points returned at most (merged to fit)
+ */
+void sendHistory(const motor_channel* ch, double from_s, double to_s, int max_points) {
+    static rpm_history_sample points[HIST_MAX_POINTS];
+    uint32_t step_ms;
+    uint32_t now = monotonicMs();
+    
+    pthread_mutex_lock(&g_rpm_mutex);
+    int n = rpmHistoryQuery(&ch->history, now, (uint32_t)(from_s * 1000.0), (uint32_t)(to_s * 1000.0),
+                            points, max_points, &step_ms);
+    pthread_mutex_unlock(&g_rpm_mutex);
+    printf("-> %sHistory: %d points at %.1fs resolution\n", ch->tag, n, step_ms / 1000.0);
+    
+    FILE* out = g_rpm_pipe_stream ? g_rpm_pipe_stream : stdout;
+    int ok = fprintf(out, "hist:begin,%d,%u\n", n, step_ms) >= 0;
+    for (int i = 0; ok && i < n; i++) {
+        ok = fprintf(out, "hist:%u,%.2f,%.1f,%.2f,%d\n", now - points[i].t_ms, points[i].rpm,
+                     points[i].duty, points[i].setpoint, points[i].mode) >= 0;
+    }
+    ok = ok && fprintf(out, "hist:end,%d\n", n) >= 0 && fflush(out) == 0;
+    if (!ok && out == g_rpm_pipe_stream) {
+        printf("⚠️  %sHistory reply cut short (pipe full or closed)\n", ch->tag);
+        closeRPMPipe();  // Pipe full or broken (BLE server closed) - reopen later
+    }
+}
+
+/*
+ * Speed over the newest full revolution of IR edges, timed at its middle
+ * @return 0 until a revolution was seen
+ */
+int revolutionSpeed(motor_channel* ch, double* rpm, uint32_t* mid_tick) {
+    const unsigned long rev = 2 * NUM_BLADES;
+    pthread_mutex_lock(&g_rpm_mutex);
+    unsigned long edges = ch->motion_edges;
+    uint32_t last = ch->edge_ring[(edges - 1) % FAULT_EDGE_HISTORY];
+    uint32_t first = ch->edge_ring[(edges - 1 - rev) % FAULT_EDGE_HISTORY];
+    pthread_mutex_unlock(&g_rpm_mutex);
+    uint32_t span = last - first;
+    if (edges <= rev || span == 0) return 0;
+    *rpm = 60e6 / span;
+    *mid_tick = first + span / 2;
+    return 1;
+}
+
+/**
+ * START SYSTEM IDENTIFICATION
+ * Perturbs the duty of a motor running steadily in manual mode, staying
+ * above the duty that keeps the rotor turning (motor_sysid.h).
+ */
+void startSysid(motor_channel* ch, motor_sysid_signal signal) {
+    double min_duty = motorStartMinDuty(&ch->start);
+    if (min_duty <= 0.0) min_duty = FAULT_UNKNOWN_SUSTAIN;
+    double duty = ch->speed;
+    double amplitude = fmin(SYSID_AMPLITUDE, fmin(duty - min_duty, 100.0 - duty));
+    if (amplitude < SYSID_MIN_AMPLITUDE) {
+        printf("-> ERROR: %sNeeds %.0f%% of duty room around %d%% (the rotor stops under %.0f%%)\n",
+               ch->tag, SYSID_MIN_AMPLITUDE, ch->speed, min_duty);
+        return;
+    }
+    pthread_mutex_lock(&g_rpm_mutex);
+    double rpm = rpmAlongDirection(ch, ch->current_rpm);
+    double accel = ch->views.accel;
+    pthread_mutex_unlock(&g_rpm_mutex);
+    // Same duty long enough for a steady operating point (motor_start.h)
+    int settled = ch->start.steady_duty == duty &&
+                  (uint32_t)(halTick() - ch->start.steady_since) >= SUSTAIN_SETTLE_MS * 1000u;
+    if (!settled || fabs(accel) > SYSID_STEADY_ACCEL) {
+        printf("-> ERROR: %sSpeed still settling at %d%% (%+.0f RPM/s) - try again in a moment\n",
+               ch->tag, ch->speed, accel);
+        return;
+    }
+    motorSysidBegin(&ch->sysid, signal, duty, amplitude, rpm, halTick());
+    printf("-> %sSYSID: %s %.1f-%.0f Hz at %d%% +-%.0f%%, %.0f RPM (about %.0f s, commands to it other than queries abort)\n",
+           ch->tag, motorSysidSignalName(signal), SYSID_MIN_HZ, SYSID_MAX_HZ, ch->speed, amplitude, rpm,
+           ch->sysid.lead_s + ch->sysid.record_s);
+}
+
+/*
+ * Abort a running measurement: back to the operating point
+ */
+void abortSysid(motor_channel* ch) {
+    if (!ch->sysid.active) return;
+    ch->sysid.active = 0;
+    if (ch->motor_on) driveBridge(ch, ch->sysid.duty);
+    printf("-> %sSYSID aborted, back to %.0f%%\n", ch->tag, ch->sysid.duty);
+}
+
+/*
+ * Loop margins of one controller model
+ */
+void printSysidLoop(const char* name, const motor_sysid_controller* c, const motor_sysid_loop* loop) {
+    printf("   %s (every %.0f ms): ", name, c->period_s * 1000.0);
+    if (!loop->valid) {
+        printf("crossover outside the measured points\n");
+        return;
+    }
+    printf("crossover %.2f Hz, phase margin %.0f°", loop->crossover_hz, loop->phase_margin);
+    if (loop->gain_margin_db != 0.0) printf(", gain margin %.1f dB", loop->gain_margin_db);
+    printf("\n");
+    if (loop->target_pm >= SYSID_TARGET_PM) {
+        printf("      %.0f° margin: KP/KI/KD x%.2f -> crossover %.2f Hz\n", SYSID_TARGET_PM, loop->scale,
+               loop->target_hz);
+    } else if (loop->target_pm > 0.0) {
+        printf("      %.0f° margin out of reach; best %.0f° with KP/KI/KD x%.2f -> crossover %.2f Hz\n",
+               SYSID_TARGET_PM, loop->target_pm, loop->scale, loop->target_hz);
+    }
+}
+
+/*
+ * PID models: as tuned it acts at most every RPM_STABILIZE_DELAY_US (the
+ * hold after each change), its D term is the speed change over one tick
+ */
+void sysidControllers(motor_sysid_controller* tuned, motor_sysid_controller* tick) {
+    double hold_s = fmax(PID_INTERVAL_S, RPM_STABILIZE_DELAY_US / 1e6);
+    *tuned = (motor_sysid_controller){ hold_s, KP, KI, KD * PID_INTERVAL_S / hold_s };
+    *tick = (motor_sysid_controller){ PID_INTERVAL_S, KP, KI, KD };
+}
+
+/*
+ * Bode points, motor bandwidth and loop margins
+ */
+void printSysid(const motor_channel* ch) {
+    const motor_sysid* s = &ch->sysid;
+    printf("-> %sSYSID (%s at %.0f%% +-%.0f%%, %.0f RPM):\n", ch->tag, motorSysidSignalName(s->signal),
+           s->duty, s->amplitude, s->rpm);
+    printf("   Hz      RPM/%%    dB     phase  coherence\n");
+    for (int i = 0; i < SYSID_POINTS; i++) {
+        const motor_sysid_point* pt = &s->points[i];
+        if (pt->gain <= 0.0) {
+            printf("   %5.2f        -      -         -      -   (not excited)\n", pt->hz);
+            continue;
+        }
+        printf("   %5.2f  %7.2f  %5.1f  %7.1f°  %5.2f%s\n", pt->hz, pt->gain,
+               pt->gain > 0.0 ? 20.0 * log10(pt->gain) : 0.0, pt->phase_deg, pt->coherence,
+               pt->coherence < SYSID_MIN_COHERENCE ? "  (not used)" : "");
+    }
+    if (!s->valid) {
+        printf("⚠️  %sNo usable response - more amplitude or a steadier operating point\n", ch->tag);
+        return;
+    }
+    if (s->bandwidth_hz > 0.0) {
+        printf("   Motor: %.1f RPM/%% at low frequency, bandwidth %.2f Hz (-3 dB, %.0f°)\n", s->dc_gain,
+               s->bandwidth_hz, s->bandwidth_phase);
+    } else {
+        printf("   Motor: %.1f RPM/%% at low frequency, bandwidth above %.0f Hz\n", s->dc_gain, SYSID_MAX_HZ);
+    }
+    if (s->fit_tau > 0.0) {
+        printf("   First-order fit: %.1f RPM/%%, time constant %.0f ms\n", s->fit_gain, s->fit_tau * 1000.0);
+    }
+    motor_sysid_controller tuned, tick;
+    motor_sysid_loop loop;
+    sysidControllers(&tuned, &tick);
+    motorSysidLoop(s, &tuned, &loop);
+    printSysidLoop("PID as tuned", &tuned, &loop);
+    motorSysidLoop(s, &tick, &loop);
+    printSysidLoop("PID without the hold", &tick, &loop);
+}
+
+/*
+ * Measurement finished: result, telemetry, back to the operating point
+ */
+void finishSysid(motor_channel* ch) {
+    printf("\n-> %sSYSID done\n", ch->tag);
+    printSysid(ch);
+    motor_sysid_controller tuned, tick;
+    motor_sysid_loop loop;
+    sysidControllers(&tuned, &tick);
+    motorSysidLoop(&ch->sysid, &tuned, &loop);
+    sendSysid(ch, &loop);
+    driveBridge(ch, ch->sysid.duty);
+    if (ch->sysid.fit_tau > 0.0) {
+        ch->start.profile.tau = ch->sysid.fit_tau;  // The disturbance observer's model
+        saveProfiles();
+    }
+}
+
+/*
+ * Load compensation runs: automatic mode driving a motor whose model is
+ * known (learned speed/duty line, time constant from 'sysid')
+ */
+int observing(const motor_channel* ch) {
+    const hbridge* hb = &ch->bridge;
+    const motor_profile* p = &ch->start.profile;
+    return ch->observe && ch->control_mode == 1 && ch->motor_on && !ch->start.active &&
+           ch->fault.fault == FAULT_NONE && !hb->braking && !hb->timing &&
+           (hb->state == HB_FORWARD || hb->state == HB_REVERSE) &&
+           p->slope > 0.0 && p->sustain > 0.0 && p->tau > 0.0;
+}
+
+/*
+ * End load compensation: back to the PID's own duty
+ */
+void stopObserver(motor_channel* ch) {
+    int compensating = ch->observer.compensation != 0.0;
+    motorObserverReset(&ch->observer);
+    if (compensating && ch->motor_on && ch->control_mode != 2) {
+        driveBridge(ch, channelDuty(ch));
+    }
+}
+
+/*
+ * Observer state and model
+ */
+void printObserver(const motor_channel* ch) {
+    const motor_observer* o = &ch->observer;
+    const motor_profile* p = &ch->start.profile;
+    printf("-> %sDisturbance observer: %s\n", ch->tag, ch->observe ? "on (automatic mode)" : "off");
+    if (p->slope > 0.0 && p->sustain > 0.0) {
+        printf("   Model: %.1f RPM per %% above %.1f%%", p->slope, p->sustain);
+    } else {
+        printf("   Model: speed/duty line not learned yet (needs steady speeds %.0f%% duty apart)",
+               SUSTAIN_MIN_SPREAD);
+    }
+    if (p->tau > 0.0) {
+        printf(", time constant %.0f ms\n", p->tau * 1000.0);
+    } else {
+        printf(", time constant unknown - 'sysid chirp' measures it\n");
+    }
+    if (o->active) {
+        printf("   Load: %+.1f%% duty since it settled, compensating %+.1f%% (Q %.0f ms)\n",
+               o->estimate - o->base, o->compensation, o->q_s * 1000.0);
+    }
+}
+
+/*
+ * Fault detector inputs: the channel's newest pulse and drive state
+ */
+void faultInput(motor_channel* ch, motor_fault_input* in) {
+    const hbridge* hb = &ch->bridge;
+    const motor_profile* p = &ch->start.profile;
+    pthread_mutex_lock(&g_rpm_mutex);
+    in->edges = ch->motion_edges;
+    in->num_ticks = in->edges < FAULT_EDGE_HISTORY ? (int)in->edges : FAULT_EDGE_HISTORY;
+    for (int k = 0; k < in->num_ticks; k++) {
+        in->edge_ticks[k] = ch->edge_ring[(in->edges - in->num_ticks + k) % FAULT_EDGE_HISTORY];
+    }
+    unsigned long accepted = ch->accepted_periods;
+    in->num_periods = accepted < FAULT_PERIOD_HISTORY ? (int)accepted : FAULT_PERIOD_HISTORY;
+    for (int k = 0; k < in->num_periods; k++) {
+        unsigned long i = (accepted - in->num_periods + k) % FAULT_PERIOD_HISTORY;
+        in->periods[k] = ch->period_ring[i];
+        in->period_ticks[k] = ch->period_tick_ring[i];
+    }
+    in->b_edges = ch->b_edges;
+    in->edges_until = ch->edges_until;
+    in->rpm = rpmAlongDirection(ch, ch->current_rpm);
+    pthread_mutex_unlock(&g_rpm_mutex);
+    
+    double min_duty = motorStartMinDuty(&ch->start);
+    if (min_duty <= 0.0) min_duty = FAULT_UNKNOWN_SUSTAIN;
+    in->periods_per_rev = rpmEstimatorPulsesPerRev(&ch->est);
+    in->has_b = ch->has_quad;
+    in->starting = ch->start.active;
+    in->duty = hb->duty;
+    in->driven = ch->motor_on && !ch->start.active && !hb->braking && !hb->timing &&
+                 (hb->state == HB_FORWARD || hb->state == HB_REVERSE) && hb->duty >= min_duty;
+    in->model_rpm = p->sustain > 0.0 && p->slope > 0.0 && hb->duty > p->sustain ?
+                    p->slope * (hb->duty - p->sustain) : 0.0;
+}
+
+/**
+ * FAULT REACTION
+ * STALL: stop driving the rotor (--on-stall). Automatic and synchronized
+ * mode end, so nothing switches it on again by itself.
+ * SENSOR: automatic mode holds the feedforward duty for its target until
+ * the pulses return (--on-sensor-loss=openloop), the PID and followers of
+ * the motor pause meanwhile; or stop.
+ */
+void reactToFault(motor_channel* ch) {
+    motor_fault* f = &ch->fault;
+    int action = f->fault == FAULT_STALL ? g_stall_action : g_sensor_action;
+    printf("\n❌ %sFAULT: %s - %s", ch->tag, f->fault == FAULT_STALL ? "STALL" : "SENSOR LOST", f->reason);
+    if (f->detect_ms > 0.0) printf(" (in %.0f ms)", f->detect_ms);
+    printf("\n");
+    sendFault(ch, g_fault_action_names[action]);
+    if (action == FAULT_ACT_WARN) {
+        return;
+    }
+    abortSweep(ch);
+    abortSysid(ch);
+    
+    if (action == FAULT_ACT_STOP) {
+        if (ch->motor_on) motorOff(ch);
+        if (ch->control_mode != 0) {
+            ch->control_mode = 0;
+            printf("-> %sMANUAL MODE\n", ch->tag);
+        }
+        return;
+    }
+    if (ch->control_mode == 1 && ch->motor_on) {
+        double feedforward = motorStartDutyFor(&ch->start, ch->desired_rpm);
+        if (feedforward > 0.0) setSpeed(ch, (int)ceil(feedforward));
+    }
+    printf("-> %sOpen loop at %d%% until the IR sensor is back (at most %d s)\n", ch->tag,
+           ch->speed, FAULT_BLIND_MAX_MS / 1000);
+}
+
+/*
+ * Fault state for the status line
+ */
+const char* faultTag(const motor_channel* ch) {
+    switch (ch->fault.fault) {
+        case FAULT_STALL:  return " STALL";
+        case FAULT_SENSOR: return " NO-SENSOR";
+        default:           return "";
+    }
+}
+
+/*
+ * Commands that only report, or reset measurements without driving the
+ * motor: a running PWM sweep or sysid carries on through them
+ */
+int isQueryCommand(const char* input) {
+    static const char* const queries[] = {
+        "rpm", "pwm", "sysid", "dob", "start", "sync", "spec", "spec base", "spec clear",
+    };
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        if (strcmp(input, queries[i]) == 0) return 1;
+    }
+    return strncmp(input, "hist ", 5) == 0;
+}
+
+/**
+ * =============================================================================
+ * COMMAND PROCESSING
+ * =============================================================================
+ * Parses and executes commands from keyboard or BLE pipe.
+ * 
+ * COMMAND PROTOCOL:
+ * Universal commands (work in both manual and automatic modes):
+ *   - "on"   : Turn motor on
+ *   - "off"  : Turn motor off
+ *   - "f"    : Set direction forward (clockwise)
+ *   - "r"    : Set direction reverse (counter-clockwise)
+ *   - "rpm"  : Print current RPM
+ *   - "hist FROM [TO [MAX]]" : History from FROM to TO seconds ago
+ *              (default TO 0, MAX 120 points), see sendHistory()
+ *   - "spec" : Print the vibration spectrum; "spec base" takes the current
+ *              one as the healthy baseline, "spec clear" drops it
+ *   - "q"    : Quit program
+ * 
+ * Manual mode commands:
+ *   - "s N"  : Set speed to N% (0-100, decimals like 42.35 for finer duty)
+ *   - "+"    : Increase speed by 10%
+ *   - "-"    : Decrease speed by 10%
+ * 
+ * Automatic mode commands:
+ *   - "auto N" : Switch to automatic mode, target N RPM
+ *   - "manual" : Switch back to manual mode
+ * 
+ * MODE BLOCKING:
+ * In automatic mode, manual speed control commands (+, -, s) are blocked
+ * to prevent interference with PID controller.
+ * 
+ * MOTOR ADDRESS:
+ * With several motors, "mN <command>" sends a command to motor N (0-based),
+ * e.g. "m1 auto 1500". Without the prefix commands go to motor 0, except
+ * "off", which stops every motor (the app's stop button stays a full stop).
+ * Modes and targets are per motor.
+ * 
+ * SYNCHRONIZED MODE (several motors, see rpm_sync.h):
+ *   - "mN sync M [RATIO [PHASE]]" : Motor N follows motor M at RATIO times
+ *              its speed (default 1). With PHASE (degrees, ratio 1 only) the
+ *              blades are also phase locked, N lagging M by PHASE
+ *   - "mN sync" : Print lock quality
+ * The follower takes the master's direction and runs while it runs. 'manual',
+ * 'auto N' or 'off' on the follower end synchronization.
+ */
+void processCommand(char* input) {
+    // Clean up input string - remove trailing newline/carriage return
+    input[strcspn(input, "\n")] = 0;
+    input[strcspn(input, "\r")] = 0;
+    
     // Ignore empty commands
     if (strlen(input) == 0) return;
     
     printf("-> Command: [%s]\n", input);
+    PARMCO_TRACE1(command, input);
+    
+    // MOTOR ADDRESS: "mN <command>"
+    motor_channel* ch = &g_motors[0];
+    int addressed = 0;
+    if (input[0] == 'm' && input[1] >= '0' && input[1] <= '9') {
+        char* rest;
+        long id = strtol(&input[1], &rest, 10);
+        if (*rest != ' ' || id >= g_num_motors) {
+            printf("-> ERROR: Usage: mN <command>, N from 0 to %d\n", g_num_motors - 1);
+            return;
+        }
+        ch = &g_motors[id];
+        addressed = 1;
+        input = rest + 1;
+    }
+    
+    // A running PWM sweep or sysid owns its motor: anything else for that
+    // motor aborts it ('q', and 'off'/'coast' without an address, reach every motor)
+    if (!isQueryCommand(input)) {
+        int every = strcmp(input, "q") == 0 ||
+                    (!addressed && (strcmp(input, "off") == 0 || strcmp(input, "coast") == 0));
+        for (int m = 0; m < g_num_motors; m++) {
+            if (every || &g_motors[m] == ch) {
+                abortSweep(&g_motors[m]);
+                abortSysid(&g_motors[m]);
+            }
+        }
+    }
     
     // AUTOMATIC MODE COMMAND: "auto N"
     // Switch to automatic mode with target RPM of N
@@ -595,63 +1884,260 @@ void processCommand(char* input) {
         if (desired < 0) desired = 0;
         if (desired > 10000) desired = 10000;  // Safety limit: max 10,000 RPM
         
-        g_desired_rpm = desired;
-        g_control_mode = 1;  // Switch to automatic mode
+        ch->desired_rpm = desired;
+        ch->control_mode = 1;  // Switch to automatic mode
         
         // Reset PID controller state (fresh start)
-        g_pid_integral = 0.0;
-        g_pid_last_error = 0.0;
+        ch->pid_integral = 0.0;
         
-        printf("-> AUTOMATIC MODE: Target RPM = %.2f\n", g_desired_rpm);
+        printf("-> %sAUTOMATIC MODE: Target RPM = %.2f\n", ch->tag, ch->desired_rpm);
         
         // If desired RPM > 0, turn motor on
-        if (g_desired_rpm > 0) {
-            if (!g_motor_on) {
-                g_motor_on = 1;
-                setDirection(g_direction);
-                if (g_speed == 0) g_speed = 30;  // Start at reasonable speed
-                setSpeed(g_speed);
+        if (ch->desired_rpm > 0) {
+            if (!ch->motor_on) {
+                ch->motor_on = 1;
+                setDirection(ch, ch->direction);
+                // Start at the learned duty for the target, or a reasonable speed
+                double feedforward = motorStartDutyFor(&ch->start, ch->desired_rpm);
+                if (feedforward > 0.0) ch->speed = (int)ceil(feedforward);
+                else if (ch->speed == 0) ch->speed = 30;
+                setSpeed(ch, ch->speed);
             }
         } else {
             // Desired RPM is 0 → turn motor off
-            motorOff();
+            motorOff(ch);
         }
         return;
     }
     
+    // SYNCHRONIZED MODE COMMAND: "sync M [RATIO [PHASE]]"
+    if (strcmp(input, "sync") == 0) {
+        if (ch->control_mode != 2) {
+            printf("-> %sNot synchronized. Usage: mN sync M [RATIO [PHASE]]\n", ch->tag);
+        } else {
+            printSyncStatus(ch);
+        }
+        return;
+    } else if (strncmp(input, "sync ", 5) == 0) {
+        int master = -1;
+        double ratio = 1.0, phase = 0.0;
+        int n = sscanf(&input[5], "%d %lf %lf", &master, &ratio, &phase);
+        if (n < 1 || master < 0 || master >= g_num_motors || master == ch->id ||
+            ratio < 0.1 || ratio > 10.0) {
+            printf("-> ERROR: Usage: mN sync M [RATIO [PHASE]] (M another motor, RATIO 0.1-10)\n");
+            return;
+        }
+        if (g_motors[master].control_mode == 2) {
+            printf("-> ERROR: Motor %d follows another motor itself\n", master);
+            return;
+        }
+        if (n == 3 && fabs(ratio - 1.0) > 1e-9) {
+            printf("⚠️  Phase lock needs ratio 1 - locking speed only\n");
+        }
+        pthread_mutex_lock(&g_rpm_mutex);
+        rpmSyncStart(&ch->sync, master, ratio, n == 3, phase, NUM_BLADES,
+                     ch->bridge.pwm_hw ? 0.0 : 100.0 / HB_SW_PWM_RANGE);
+        ch->control_mode = 2;
+        pthread_mutex_unlock(&g_rpm_mutex);
+        setDirection(ch, g_motors[master].direction);
+        printf("-> %sSYNCHRONIZED MODE: following M%d x%.3f%s\n", ch->tag, master, ratio,
+               ch->sync.phase_lock ? ", blade phase locked" : "");
+        return;
+    }
+    
     // Check for manual mode command
     if (strcmp(input, "manual") == 0) {
-        g_control_mode = 0;  // Switch to manual mode
-        printf("-> MANUAL MODE\n");
+        ch->control_mode = 0;  // Switch to manual mode
+        printf("-> %sMANUAL MODE\n", ch->tag);
         return;
     }
     
-    // Commands that work in BOTH modes: on, off, f, r, rpm, q
+    // Commands that work in BOTH modes: on, off, f, r, rpm, hist, q
     if (strcmp(input, "on") == 0) {
-        motorOn();
+        motorOn(ch);
         return;
-    } else if (strcmp(input, "off") == 0) {
-        motorOff();
+    } else if (strcmp(input, "off") == 0 || strcmp(input, "coast") == 0) {
+        // Followers stop following, or the next control cycle restarts them
+        int brake = input[0] == 'o' && g_stop_brake;
+        for (int m = 0; m < g_num_motors; m++) {
+            motor_channel* target = &g_motors[m];
+            if (addressed && target != ch) continue;
+            if (target->control_mode == 2) target->control_mode = 0;
+            motorStop(target, brake);
+        }
         return;
     } else if (strcmp(input, "f") == 0) {
-        setDirection(1);
+        setDirection(ch, 1);
         return;
     } else if (strcmp(input, "r") == 0) {
-        setDirection(0);
+        setDirection(ch, 0);
         return;
     } else if (strcmp(input, "rpm") == 0) {
         pthread_mutex_lock(&g_rpm_mutex);
-        double rpm = g_current_rpm;
+        double rpm = ch->current_rpm;
+        rpm_views views = ch->views;
+        double duty = ch->blade_duty;
+        double spacing[RPM_MAX_BLADES];
+        unsigned long rejected[3];
+        rpm_angle angle = ch->angle;
+        int rotation = ch->rotation;
+        unsigned long reversals = ch->reversals;
+        memcpy(spacing, ch->blade_spacing, sizeof(spacing));
+        memcpy(rejected, ch->rejected, sizeof(rejected));
+        pthread_mutex_unlock(&g_rpm_mutex);
+        printf("-> %sRPM: %.2f (%+.0f RPM/s; display %.2f, fast %.2f)\n",
+               ch->tag, rpm, views.accel, views.display, views.fast);
+        printf("   Average: %.2f (1s), %.2f (10s), %.2f (60s)\n",
+               views.avg[0], views.avg[1], views.avg[2]);
+        if (duty > 0.0) {
+            printf("   Blade duty: %.1f%%\n", duty * 100.0);
+        }
+        if (spacing[0] > 0.0) {
+            printf("   Blade spacing:");
+            for (int k = 0; k < NUM_BLADES; k++) printf(" %.1f°", spacing[k] * 360.0);
+            printf("\n");
+        }
+        double angle_deg = rpmAngleAt(&angle, halTick());
+        if (angle_deg >= 0.0) {
+            printf("   Shaft angle: %.1f° %s (edge residual %+.1f°)\n", angle_deg,
+                   angle.indexed ? "from blade 0" : "(not indexed)", angle.residual * 360.0);
+        }
+        if (ch->has_quad) {
+            printf("   Rotation: %s (%lu reversals)\n",
+                   rotation > 0 ? "FORWARD" : rotation < 0 ? "REVERSE" : "unknown", reversals);
+        }
+        printf("   Rejected edges: %lu glitch, %lu spurious, %lu missed-edge intervals\n",
+               rejected[0], rejected[1], rejected[2]);
+        printf("   Bridge: %s", hbridgeStateName(ch->bridge.state));
+        if (ch->bridge.stops) printf("; last stop %.0f ms", ch->bridge.stop_ms);
+        if (ch->bridge.reversals) printf("; last reversal %.0f ms", ch->bridge.reverse_ms);
+        printf("\n");
+        if (ch->fault.fault != FAULT_NONE) {
+            printf("   Fault: %s for %.1f s - %s\n", ch->fault.fault == FAULT_STALL ? "STALL" : "SENSOR LOST",
+                   (uint32_t)(halTick() - ch->fault.since) / 1e6, ch->fault.reason);
+        }
+        if (ch->fault.stalls || ch->fault.sensor_losses) {
+            printf("   Faults: %lu stalls, %lu sensor losses\n", ch->fault.stalls, ch->fault.sensor_losses);
+        }
+        if (ch->control_mode == 2) {
+            printSyncStatus(ch);
+        }
+        return;
+    } else if (strcmp(input, "start") == 0) {
+        const motor_start* st = &ch->start;
+        const motor_profile* p = &st->profile;
+        if (p->breakaway > 0.0) {
+            printf("-> %sBreakaway duty: %.1f%% (%lu starts", ch->tag, p->breakaway, p->starts);
+            if (st->last_breakaway > 0.0) {
+                printf("; last %.1f%%, moving after %.0f ms", st->last_breakaway, st->last_ms);
+            }
+            printf(")\n");
+        } else {
+            printf("-> %sBreakaway duty: not learned yet\n", ch->tag);
+        }
+        if (p->sustain > 0.0) {
+            printf("   Sustain duty: %.1f%%, %.1f RPM per %% above it\n", p->sustain, p->slope);
+        } else {
+            printf("   Sustain duty: not learned yet (needs steady speeds %.0f%% duty apart)\n",
+                   SUSTAIN_MIN_SPREAD);
+        }
+        return;
+    } else if (strcmp(input, "start reset") == 0) {
+        memset(&ch->start.profile, 0, sizeof(ch->start.profile));
+        ch->start.num_points = 0;
+        ch->start.last_breakaway = 0.0;
+        saveProfiles();
+        printf("-> %sLearned start parameters cleared\n", ch->tag);
+        return;
+    } else if (strcmp(input, "pwm") == 0) {
+        int steps = halGetPWMRealRange(ch->pins.enable_pin);
+        printf("-> %sPWM: %s, %u Hz", ch->tag, g_pwm_hw ? "hardware" : "software", ch->bridge.pwm_freq);
+        if (!g_pwm_hw && steps > 0) printf(", %d real duty steps", steps);
+        printf("%s\n", ch->sweep.active ? " (sweeping)" : "");
+        if (!ch->sweep.active && ch->sweep.num_freqs > 0) {
+            printSweep(ch);
+        }
+        return;
+    } else if (strcmp(input, "pwm sweep") == 0) {
+        if (g_pwm_hw) {
+            printf("-> ERROR: The sweep covers software PWM frequencies; hardware PWM runs at --pwm-freq\n");
+        } else if (ch->control_mode != 0) {
+            printf("-> ERROR: %sUse 'manual' before 'pwm sweep'\n", ch->tag);
+        } else {
+            startSweep(ch);
+        }
+        return;
+    } else if (strcmp(input, "sysid") == 0) {
+        if (ch->sysid.active) {
+            printf("-> %sSYSID running (%s)\n", ch->tag, motorSysidSignalName(ch->sysid.signal));
+        } else if (ch->sysid.valid) {
+            printSysid(ch);
+        } else {
+            printf("-> %sNo frequency response yet - 'sysid chirp' or 'sysid prbs'\n", ch->tag);
+        }
+        return;
+    } else if (strcmp(input, "sysid chirp") == 0 || strcmp(input, "sysid prbs") == 0) {
+        if (ch->control_mode != 0) {
+            printf("-> ERROR: %sUse 'manual' before 'sysid'\n", ch->tag);
+        } else if (!ch->motor_on || ch->start.active || ch->bridge.braking || ch->bridge.timing) {
+            printf("-> ERROR: %sRun the motor at the operating point first (s N)\n", ch->tag);
+        } else if (ch->fault.fault != FAULT_NONE) {
+            printf("-> ERROR: %sFault: %s\n", ch->tag, ch->fault.reason);
+        } else {
+            startSysid(ch, strcmp(input, "sysid prbs") == 0 ? SYSID_PRBS : SYSID_CHIRP);
+        }
+        return;
+    } else if (strcmp(input, "dob") == 0) {
+        printObserver(ch);
+        return;
+    } else if (strcmp(input, "dob on") == 0 || strcmp(input, "dob off") == 0) {
+        ch->observe = strcmp(input, "dob on") == 0;
+        if (!ch->observe) stopObserver(ch);
+        printObserver(ch);
+        return;
+    } else if (strcmp(input, "spec") == 0) {
+        printSpectrum(ch);
+        return;
+    } else if (strcmp(input, "spec base") == 0) {
+        pthread_mutex_lock(&g_rpm_mutex);
+        int valid = ch->spectrum.valid;
+        if (valid) ch->spec_baseline = ch->spectrum;
         pthread_mutex_unlock(&g_rpm_mutex);
-        printf("-> RPM: %.2f\n", rpm);
+        printf(valid ? "-> %sSpectrum baseline recorded\n" : "-> ERROR: %sNo spectrum yet\n", ch->tag);
+        return;
+    } else if (strcmp(input, "spec clear") == 0) {
+        pthread_mutex_lock(&g_rpm_mutex);
+        ch->spec_baseline.valid = 0;
+        pthread_mutex_unlock(&g_rpm_mutex);
+        printf("-> %sSpectrum baseline cleared\n", ch->tag);
+        return;
+    } else if (strncmp(input, "hist ", 5) == 0) {
+        double from_s = 0.0, to_s = 0.0;
+        int max_points = HIST_DEFAULT_POINTS;
+        if (sscanf(&input[5], "%lf %lf %d", &from_s, &to_s, &max_points) < 1 ||
+            from_s <= 0.0 || to_s < 0.0 || to_s >= from_s) {
+            printf("-> ERROR: Usage: hist FROM [TO [MAX]] (seconds ago, FROM > TO)\n");
+            return;
+        }
+        if (from_s > 86400.0) from_s = 86400.0;  // Everything kept (24 h)
+        if (max_points < 1) max_points = 1;
+        if (max_points > HIST_MAX_POINTS) max_points = HIST_MAX_POINTS;
+        sendHistory(ch, from_s, to_s, max_points);
         return;
     } else if (strcmp(input, "q") == 0) {
         g_quit = 1;
         return;
     }
     
+    // In synchronized mode the follower's speed comes from its master
+    if (ch->control_mode == 2) {
+        printf("-> ERROR: In SYNCHRONIZED mode. Manual speed control disabled.\n");
+        printf("   Use 'manual' to stop following.\n");
+        return;
+    }
+    
     // In automatic mode, reject manual speed control commands
-    if (g_control_mode == 1) {
+    if (ch->control_mode == 1) {
         printf("-> ERROR: In AUTOMATIC mode. Manual speed control disabled.\n");
         printf("   Use 'auto <rpm>' to change target, or 'manual' to switch modes.\n");
         return;
@@ -659,12 +2145,11 @@ void processCommand(char* input) {
     
     // Manual mode ONLY commands: speed control
     if (strcmp(input, "+") == 0) {
-        setSpeed(g_speed + 10);
+        setSpeed(ch, ch->speed + 10);
     } else if (strcmp(input, "-") == 0) {
-        setSpeed(g_speed - 10);
+        setSpeed(ch, ch->speed - 10);
     } else if (input[0] == 's' && input[1] == ' ') {
-        int speed = atoi(&input[2]);
-        setSpeed(speed);
+        setFineSpeed(ch, atof(&input[2]));
     } else {
         printf("Unknown command: %s\n", input);
     }
@@ -674,55 +2159,264 @@ void cleanup(int sig) {
     printf("\n🛑 Shutting down...\n");
     g_quit = 1;
     
-    motorOff();
+    if (g_hold_on_exit && g_hal && g_hal->persistent) {
+        printf("-> Leaving motor running for the next instance (--hold-on-exit)\n");
+    } else {
+        for (int m = 0; m < g_num_motors; m++) motorOff(&g_motors[m]);
+    }
     closePipe();
     closeRPMPipe();
     
     if (g_rpm_thread) {
         pthread_join(g_rpm_thread, NULL);
     }
+    if (g_spec_thread) {
+        pthread_join(g_spec_thread, NULL);
+    }
     
-    gpioTerminate();
+    halTerminate();
     exit(0);
 }
 
-int main() {
+/**
+ * =============================================================================
+ * GPIO SETUP AND STATE ADOPTION
+ * =============================================================================
+ * With a persistent backend (pigpiod) the daemon keeps PWM and pin state
+ * when this program exits. On restart with --adopt we read that state back
+ * instead of forcing the motor off, and we only reprogram pins whose mode
+ * differs, so a running PWM output is never interrupted.
+ */
+
+/*
+ * Set pin mode unless it already has it (reprogramming an active PWM pin
+ * would glitch its output)
+ */
+void setupPin(unsigned pin, unsigned mode) {
+    if (halGetMode(pin) != (int)mode) {
+        halSetMode(pin, mode);
+    }
+}
+
+/**
+ * ADOPT RUNNING MOTOR STATE
+ * Reads duty and direction from the backend into the channel's speed,
+ * direction and motor_on. Control mode always restarts in MANUAL, holding the adopted
+ * speed, until the app or keyboard sends a new command. The caller keeps the
+ * PWM frequency the pin runs at (no frequency or range writes).
+ * 
+ * @return 1 if a running motor was adopted, 0 if the motor is stopped or
+ *         the backend cannot report its state
+ */
+int adoptMotorState(motor_channel* ch) {
+    if (!g_hal->persistent) {
+        printf("⚠️  --adopt ignored: backend '%s' does not keep state across restarts\n", g_hal->name);
+        return 0;
+    }
+    // A hardware PWM pin is in its ALT mode, not OUTPUT
+    if ((!g_pwm_hw && halGetMode(ch->pins.enable_pin) != HAL_OUTPUT) ||
+        halGetMode(ch->pins.in1_pin) != HAL_OUTPUT ||
+        halGetMode(ch->pins.in2_pin) != HAL_OUTPUT) {
+        return 0;  // Fresh daemon - nothing configured yet
+    }
+    
+    int duty = halGetPWM(ch->pins.enable_pin);
+    int range = g_pwm_hw ? HAL_HW_PWM_RANGE : HB_SW_PWM_RANGE;
+    int in1 = halRead(ch->pins.in1_pin);
+    int in2 = halRead(ch->pins.in2_pin);
+    if (duty <= 0 || in1 == in2) {
+        return 0;  // Stopped or braked
+    }
+    
+    double exact = (double)duty * 100.0 / range;  // Inverse of the bridge's duty write
+    ch->speed = (int)lround(exact);
+    ch->speed_fraction = g_pwm_hw ? exact - ch->speed : 0.0;  // Software PWM: whole percent
+    ch->direction = in1 ? 1 : 0;
+    ch->motor_on = 1;
+    hbridgeAdopt(&ch->bridge, in1 ? HB_FORWARD : HB_REVERSE, ch->speed + ch->speed_fraction);
+    printf("✓ %sAdopted running motor: %s at %d%%\n", ch->tag,
+           ch->direction ? "FORWARD" : "REVERSE", ch->speed);
+    return 1;
+}
+
+#ifndef PARMCO_NO_MAIN
+int main(int argc, char* argv[]) {
     printf("\n=== MOTOR CONTROL WITH BLE (via pipe) ===\n\n");
     
+    struct timespec start_time, ready_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--adopt") == 0) g_adopt_state = 1;
+        if (strcmp(argv[i], "--hold-on-exit") == 0) g_hold_on_exit = 1;
+        if (strncmp(argv[i], "--glitch-us=", 12) == 0) g_glitch_us = (unsigned)strtoul(argv[i] + 12, NULL, 10);
+        if (strncmp(argv[i], "--outlier-k=", 12) == 0) g_outlier_k = atof(argv[i] + 12);
+        if (strncmp(argv[i], "--dead-time-us=", 15) == 0) g_dead_time_us = (unsigned)strtoul(argv[i] + 15, NULL, 10);
+        if (strncmp(argv[i], "--profile=", 10) == 0) g_profile_path = argv[i] + 10;
+        if (strcmp(argv[i], "--dob") == 0) g_observe = 1;
+        if (strncmp(argv[i], "--stop=", 7) == 0) {
+            if (strcmp(argv[i] + 7, "brake") != 0 && strcmp(argv[i] + 7, "coast") != 0) {
+                fprintf(stderr, "❌ Invalid --stop mode '%s' (use brake or coast)\n", argv[i] + 7);
+                return 1;
+            }
+            g_stop_brake = strcmp(argv[i] + 7, "brake") == 0;
+        }
+        if (strncmp(argv[i], "--on-stall=", 11) == 0) {
+            if (strcmp(argv[i] + 11, "stop") != 0 && strcmp(argv[i] + 11, "warn") != 0) {
+                fprintf(stderr, "❌ Invalid --on-stall action '%s' (use stop or warn)\n", argv[i] + 11);
+                return 1;
+            }
+            g_stall_action = strcmp(argv[i] + 11, "stop") == 0 ? FAULT_ACT_STOP : FAULT_ACT_WARN;
+        }
+        if (strncmp(argv[i], "--on-sensor-loss=", 17) == 0) {
+            const char* action = argv[i] + 17;
+            if (strcmp(action, "openloop") == 0) g_sensor_action = FAULT_ACT_OPENLOOP;
+            else if (strcmp(action, "stop") == 0) g_sensor_action = FAULT_ACT_STOP;
+            else if (strcmp(action, "warn") == 0) g_sensor_action = FAULT_ACT_WARN;
+            else {
+                fprintf(stderr, "❌ Invalid --on-sensor-loss action '%s' (use openloop, stop or warn)\n", action);
+                return 1;
+            }
+        }
+        if (strncmp(argv[i], "--edges=", 8) == 0) {
+            g_edge_mode = rpmEstimatorParseEdges(argv[i] + 8);
+            if (g_edge_mode < 0) {
+                fprintf(stderr, "❌ Invalid --edges mode '%s' (use rising, falling or both)\n", argv[i] + 8);
+                return 1;
+            }
+        }
+    }
+    
+    // Select GPIO backend (--backend=..., see motor_hal.h)
+    motor_hal_config hal_cfg;
+    halConfigDefaults(&hal_cfg);
+    hal_cfg.motors[0].enable_pin = MOTOR_ENABLE_PIN;
+    hal_cfg.motors[0].in1_pin = MOTOR_IN1_PIN;
+    hal_cfg.motors[0].in2_pin = MOTOR_IN2_PIN;
+    hal_cfg.motors[0].ir_pin = IR_SENSOR_PIN;
+    hal_cfg.num_motors = 1;
+    hal_cfg.blades = NUM_BLADES;
+    if (halConfigFromArgs(&hal_cfg, argc, argv) < 0) {
+        return 1;
+    }
+    
+    g_capture_poll = hal_cfg.capture_poll;
+    g_pwm_hw = hal_cfg.pwm_hw;
+    g_pwm_freq = hal_cfg.pwm_freq ? hal_cfg.pwm_freq : (g_pwm_hw ? HW_PWM_FREQ_HZ : PWM_FREQ_HZ);
+    
+    // Motor channels (--motor=EN,IN1,IN2,IR[,IR2])
+    g_num_motors = hal_cfg.num_motors;
+    int pwm_channel_used[2] = {0, 0};
+    for (int m = 0; m < g_num_motors; m++) {
+        motor_channel* ch = &g_motors[m];
+        ch->id = m;
+        ch->pins = hal_cfg.motors[m];
+        ch->direction = 1;
+        if (g_num_motors > 1) {
+            snprintf(ch->tag, sizeof(ch->tag), "M%d ", m);
+        }
+        rpmHistoryInit(&ch->history);
+        
+        unsigned pin = ch->pins.enable_pin;
+        if (g_pwm_hw && pin != 12 && pin != 13 && pin != 18 && pin != 19) {
+            fprintf(stderr, "❌ Hardware PWM needs the enable pin on GPIO 12, 13, 18 or 19 (e.g. --enable-pin=18)\n");
+            return 1;
+        }
+        // GPIO 12/18 share PWM channel 0 and 13/19 channel 1
+        if (g_pwm_hw && pwm_channel_used[pin & 1]++) {
+            fprintf(stderr, "❌ Motors share hardware PWM channel %u (use one of 12/18 and one of 13/19)\n", pin & 1);
+            return 1;
+        }
+    }
+    
     signal(SIGINT, cleanup);
     signal(SIGTERM, cleanup);
     
     // Initialize GPIO
-    if (gpioInitialise() < 0) {
-        fprintf(stderr, "❌ Failed to initialize GPIO\n");
+    if (halInit(&hal_cfg) < 0) {
+        fprintf(stderr, "❌ Failed to initialize GPIO (backend: %s)\n", hal_cfg.backend);
+        return 1;
+    }
+    if (g_pwm_hw && g_hal->hardware_pwm == NULL) {
+        fprintf(stderr, "❌ Backend '%s' has no hardware PWM\n", g_hal->name);
+        halTerminate();
         return 1;
     }
     
-    // Setup GPIO
-    gpioSetMode(MOTOR_ENABLE_PIN, PI_OUTPUT);
-    gpioSetMode(MOTOR_IN1_PIN, PI_OUTPUT);
-    gpioSetMode(MOTOR_IN2_PIN, PI_OUTPUT);
-    gpioSetMode(LED_PIN, PI_OUTPUT);
-    gpioSetMode(IR_SENSOR_PIN, PI_INPUT);
-    
-    gpioSetPWMfrequency(MOTOR_ENABLE_PIN, PWM_FREQ_HZ);
-    gpioSetPWMrange(MOTOR_ENABLE_PIN, 255);
-    gpioSetPullUpDown(IR_SENSOR_PIN, PI_PUD_OFF);
-    gpioGlitchFilter(IR_SENSOR_PIN, 0);
+    // Learned breakaway/sustain duty from earlier runs
+    motor_profile profiles[MAX_MOTORS];
+    if (motorProfileLoad(g_profile_path, profiles, g_num_motors) > 0) {
+        printf("✓ Learned motor parameters from %s\n", g_profile_path);
+    }
+    for (int m = 0; m < g_num_motors; m++) {
+        g_motors[m].start.profile = profiles[m];
+        g_motors[m].observe = g_observe;
+    }
     
-    motorOff();
+    setupPin(LED_PIN, HAL_OUTPUT);
+    for (int m = 0; m < g_num_motors; m++) {
+        motor_channel* ch = &g_motors[m];
+        
+        // Software PWM at the frequency 'pwm sweep' picked, unless --pwm-freq
+        unsigned freq = g_pwm_freq;
+        int learned_freq = !g_pwm_hw && !hal_cfg.pwm_freq && ch->start.profile.pwm_freq;
+        if (learned_freq) freq = ch->start.profile.pwm_freq;
+        hbridgeInit(&ch->bridge, &ch->pins, g_pwm_hw, freq, g_dead_time_us);
+        int adopted = g_adopt_state && adoptMotorState(ch);
+        
+        // Setup GPIO
+        if (!g_pwm_hw) {
+            setupPin(ch->pins.enable_pin, HAL_OUTPUT);  // Hardware PWM selects the pin's ALT mode itself
+        }
+        setupPin(ch->pins.in1_pin, HAL_OUTPUT);
+        setupPin(ch->pins.in2_pin, HAL_OUTPUT);
+        setupPin(ch->pins.ir_pin, HAL_INPUT);
+        
+        if (adopted) {
+            // Never reprogram a running PWM output: keep the frequency it runs at
+            int running = halGetPWMFrequency(ch->pins.enable_pin);
+            if (running > 0) ch->bridge.pwm_freq = (unsigned)running;
+            learned_freq = 0;
+        } else if (!g_pwm_hw) {
+            setPWMFrequency(ch, freq);
+            halSetPWMRange(ch->pins.enable_pin, HB_SW_PWM_RANGE);
+        }
+        halSetPull(ch->pins.ir_pin, HAL_PUD_OFF);
+        halGlitchFilter(ch->pins.ir_pin, g_glitch_us);  // Backend filter too (gpiod kernel debounce)
+        if (ch->pins.ir2_pin != HAL_NO_PIN) {
+            setupPin(ch->pins.ir2_pin, HAL_INPUT);
+            halSetPull(ch->pins.ir2_pin, HAL_PUD_OFF);
+            halGlitchFilter(ch->pins.ir2_pin, g_glitch_us);
+        }
+        
+        if (!adopted) {
+            motorOff(ch);
+        }
+        printf("✓ %sPWM: %s on GPIO %u at %u Hz%s\n", ch->tag, g_pwm_hw ? "hardware" : "software",
+               ch->pins.enable_pin, ch->bridge.pwm_freq, learned_freq ? " (from 'pwm sweep')" : "");
+    }
+    updateLed();
     
-    printf("✓ GPIO initialized\n");
+    clock_gettime(CLOCK_MONOTONIC, &ready_time);
+    printf("✓ GPIO initialized (backend: %s) in %.1f ms\n", g_hal->name,
+           (ready_time.tv_sec - start_time.tv_sec) * 1000.0 +
+           (ready_time.tv_nsec - start_time.tv_nsec) / 1e6);
     
     // Start RPM thread
     if (pthread_create(&g_rpm_thread, NULL, rpmThread, NULL) != 0) {
         fprintf(stderr, "❌ Failed to create RPM thread\n");
-        gpioTerminate();
+        halTerminate();
         return 1;
     }
     
     printf("✓ RPM monitoring started\n");
     
+    // Vibration analysis is optional: run without it if the thread fails
+    if (pthread_create(&g_spec_thread, NULL, spectrumThread, NULL) != 0) {
+        fprintf(stderr, "⚠️  Failed to create spectrum thread - no vibration analysis\n");
+        g_spec_thread = 0;
+    }
+    
     // Create command pipe if it doesn't exist
     if (access(FIFO_PATH, F_OK) != 0) {
         if (mkfifo(FIFO_PATH, 0666) != 0) {
@@ -746,11 +2440,22 @@ int main() {
     printf("\n📱 Waiting for BLE server to connect...\n");
     printf("   Run: sudo python3 ble_server.py\n");
     printf("\n   === MANUAL MODE Commands ===\n");
-    printf("   on, off     - Turn motor on/off\n");
+    printf("   on, off     - Turn motor on/off (off brakes with --stop=brake)\n");
+    printf("   coast       - Turn motor off and let it run down\n");
     printf("   +, -        - Increase/decrease speed by 10%%\n");
-    printf("   s N         - Set speed to N%% (0-100)\n");
+    printf("   s N         - Set speed to N%% (0-100, decimals for finer duty)\n");
     printf("   f, r        - Forward/Reverse direction\n");
     printf("   rpm         - Display current RPM\n");
+    printf("   hist F [T]  - RPM history from F to T seconds ago\n");
+    printf("   spec [base] - Vibration spectrum [take as baseline]\n");
+    printf("   start [reset] - Learned breakaway/sustain duty [forget them]\n");
+    printf("   pwm [sweep] - PWM frequency [measure all and keep the best]\n");
+    printf("   sysid [chirp|prbs] - Frequency response and loop margins [measure around the running duty]\n");
+    printf("   dob [on|off] - Load compensation in automatic mode (disturbance observer)\n");
+    if (g_num_motors > 1) {
+        printf("   mN <cmd>    - Send a command to motor N (0-%d); 'off' alone stops all\n", g_num_motors - 1);
+        printf("   mN sync M [R [P]] - Motor N follows motor M at ratio R, phase P degrees\n");
+    }
     printf("\n   === AUTOMATIC MODE Commands ===\n");
     printf("   auto N      - Set target RPM and enable automatic control\n");
     printf("   manual      - Return to manual control mode\n");
@@ -759,6 +2464,12 @@ int main() {
     // Main loop
     char input[256];
     int pipe_reconnect_timer = 0;
+    int bridge_busy = 0;
+    int fault_watch = 0;
+    int sysid_busy = 0;
+    int observer_busy = 0;
+    int dither_busy = 0;
+    uint32_t last_tick_ms = monotonicMs();
     
     while (!g_quit) {
         fd_set readfds;
@@ -773,8 +2484,16 @@ int main() {
             if (g_pipe_fd > max_fd) max_fd = g_pipe_fd;
         }
         
+        // Control tick every RPM_UPDATE_INTERVAL_MS, H-bridge steps in between
+        uint32_t since_tick = monotonicMs() - last_tick_ms;
+        uint32_t wait_ms = since_tick < RPM_UPDATE_INTERVAL_MS ? RPM_UPDATE_INTERVAL_MS - since_tick : 0;
+        if (bridge_busy && wait_ms > HB_STEP_MS) wait_ms = HB_STEP_MS;
+        if (fault_watch && wait_ms > FAULT_STEP_MS) wait_ms = FAULT_STEP_MS;
+        if (sysid_busy && wait_ms > SYSID_STEP_MS) wait_ms = SYSID_STEP_MS;
+        if (observer_busy && wait_ms > OBS_STEP_MS) wait_ms = OBS_STEP_MS;
+        if (dither_busy && wait_ms > SYNC_DITHER_MS) wait_ms = SYNC_DITHER_MS;
         timeout.tv_sec = 0;
-        timeout.tv_usec = 100000;  // 100ms
+        timeout.tv_usec = wait_ms * 1000;
         
         int ready = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
         
@@ -795,8 +2514,12 @@ int main() {
             if (fgets(input, sizeof(input), g_pipe_stream) == NULL) {
                 // Pipe closed - SAFETY: turn off motor!
                 printf("⚠️  BLE server disconnected! TURNING MOTOR OFF FOR SAFETY!\n");
-                motorOff();
-                g_control_mode = 0;  // Return to manual mode
+                for (int m = 0; m < g_num_motors; m++) {
+                    abortSweep(&g_motors[m]);
+                    abortSysid(&g_motors[m]);
+                    motorOff(&g_motors[m]);
+                    g_motors[m].control_mode = 0;  // Return to manual mode
+                }
                 closePipe();
                 printf("   Waiting for reconnect...\n");
             } else {
@@ -804,62 +2527,243 @@ int main() {
             }
         }
         
-        // Try to reconnect pipe
-        if (g_pipe_fd == -1) {
-            pipe_reconnect_timer++;
-            if (pipe_reconnect_timer >= 10) {  // Every 1 second
-                pipe_reconnect_timer = 0;
-                openPipe();
+        // H-bridge sequences and kickstarts: end reversal brakes, time stops,
+        // ramp starting motors until they move
+        bridge_busy = 0;
+        for (int m = 0; m < g_num_motors; m++) {
+            motor_channel* ch = &g_motors[m];
+            hbridge* hb = &ch->bridge;
+            if (ch->start.active) {
+                pthread_mutex_lock(&g_rpm_mutex);
+                unsigned long edges = ch->motion_edges;
+                uint32_t edge_tick = ch->motion_tick;
+                pthread_mutex_unlock(&g_rpm_mutex);
+                double duty;
+                motor_start_result result = motorStartStep(&ch->start, edges, edge_tick, halTick(), &duty);
+                int rotation;
+                double rpm = bridgeRpm(ch, &rotation);
+                hbridgeDrive(hb, ch->direction, duty, rpm, rotation);
+                motorObserverDuty(&ch->observer, hb->duty, halTick());
+                if (result == START_DONE) {
+                    printf("\n-> %sMoving after %.0f ms: breakaway %.1f%% (learned %.1f%%)\n",
+                           ch->tag, ch->start.last_ms, ch->start.last_breakaway,
+                           ch->start.profile.breakaway);
+                    saveProfiles();
+                } else if (result == START_STALLED) {
+                    motor_fault_input in;
+                    faultInput(ch, &in);
+                    in.duty = ch->start.duty;
+                    if (motorFaultStartStalled(&ch->fault, &in, halTick()) == FAULT_RAISED) {
+                        reactToFault(ch);
+                    }
+                }
+                bridge_busy |= ch->start.active;
+            }
+            if (!hb->braking && !hb->timing) continue;
+            unsigned long stops = hb->stops, reversals = hb->reversals;
+            int rotation;
+            double rpm = bridgeRpm(ch, &rotation);
+            bridge_busy |= hbridgeStep(hb, rpm, rotation);
+            motorObserverDuty(&ch->observer, hb->duty, halTick());
+            if (hb->stops != stops) {
+                printf("\n-> %sStopped in %.0f ms\n", ch->tag, hb->stop_ms);
+            }
+            if (hb->reversals != reversals) {
+                printf("\n-> %sReversed through zero in %.0f ms\n", ch->tag, hb->reverse_ms);
+            }
+        }
+        
+        // Fault detection: the blade pulses of driven motors, every FAULT_STEP_MS
+        fault_watch = 0;
+        for (int m = 0; m < g_num_motors; m++) {
+            motor_channel* ch = &g_motors[m];
+            motor_fault_input in;
+            faultInput(ch, &in);
+            motor_fault_event event = motorFaultCheck(&ch->fault, &in, halTick());
+            if (event == FAULT_RAISED) {
+                reactToFault(ch);
+            } else if (event == FAULT_CLEARED) {
+                printf("\n✓ %sIR sensor back after %.0f ms%s\n", ch->tag, ch->fault.detect_ms,
+                       ch->control_mode != 0 ? " - closed loop again" : "");
+                sendFault(ch, "resume");
+            }
+            if (ch->fault.fault == FAULT_SENSOR && ch->motor_on &&
+                (uint32_t)(halTick() - ch->fault.since) >= FAULT_BLIND_MAX_MS * 1000u) {
+                printf("\n❌ %sNo IR sensor for %d s - stopping\n", ch->tag, FAULT_BLIND_MAX_MS / 1000);
+                sendFault(ch, "stop");
+                motorOff(ch);
             }
+            fault_watch |= in.driven || ch->fault.fault == FAULT_SENSOR;
         }
         
-        // Display RPM and send to BLE server
-        if (ready == 0) {
+        // System identification: perturb the duty, sample the speed every SYSID_STEP_MS
+        sysid_busy = 0;
+        for (int m = 0; m < g_num_motors; m++) {
+            motor_channel* ch = &g_motors[m];
+            if (!ch->sysid.active) continue;
+            double rpm = 0.0, duty;
+            uint32_t rpm_tick = 0;
+            int have_rpm = revolutionSpeed(ch, &rpm, &rpm_tick);
+            if (motorSysidStep(&ch->sysid, halTick(), have_rpm, rpm, rpm_tick, &duty) == SYSID_DONE) {
+                finishSysid(ch);
+            } else {
+                if (duty != ch->bridge.duty) driveBridge(ch, duty);
+                sysid_busy = 1;
+            }
+        }
+        
+        // Load compensation: a new revolution speed every OBS_STEP_MS
+        observer_busy = 0;
+        for (int m = 0; m < g_num_motors; m++) {
+            motor_channel* ch = &g_motors[m];
+            if (!observing(ch)) {
+                if (ch->observer.active) stopObserver(ch);
+                continue;
+            }
+            const motor_profile* p = &ch->start.profile;
+            motor_observer_model model = { p->slope, p->sustain, p->tau };
+            double rpm;
+            uint32_t rpm_tick;
+            observer_busy = 1;
             pthread_mutex_lock(&g_rpm_mutex);
-            double rpm = g_current_rpm;
+            int backwards = rpmAlongDirection(ch, 1.0) < 0.0;
             pthread_mutex_unlock(&g_rpm_mutex);
+            if (backwards || !revolutionSpeed(ch, &rpm, &rpm_tick)) continue;
+            motorObserverUpdate(&ch->observer, &model, rpm, rpm_tick);
+            double duty = channelDuty(ch);
+            if (duty != ch->bridge.duty) driveBridge(ch, duty);
+        }
+        
+        // Synchronized followers on software PWM: dither the duty every SYNC_DITHER_MS
+        dither_busy = 0;
+        for (int m = 0; m < g_num_motors; m++) {
+            motor_channel* ch = &g_motors[m];
+            if (ch->control_mode != 2 || !ch->motor_on || ch->sync.duty_step <= 0.0) continue;
+            dither_busy = 1;
+            double duty = rpmSyncDither(&ch->sync);
+            if (duty != ch->bridge.duty) driveBridge(ch, duty);
+        }
+        
+        // Display RPM and send to BLE server
+        if (monotonicMs() - last_tick_ms >= RPM_UPDATE_INTERVAL_MS) {
+            last_tick_ms = monotonicMs();
             
-            // Run PID controller in automatic mode
-            if (g_control_mode == 1 && g_motor_on) {
-                int new_speed = pidController(rpm, g_desired_rpm);
-                if (new_speed != g_speed) {
-                    setSpeed(new_speed);
+            // Try to reconnect pipe
+            if (g_pipe_fd == -1) {
+                pipe_reconnect_timer++;
+                if (pipe_reconnect_timer >= 10) {  // Every 1 second
+                    pipe_reconnect_timer = 0;
+                    openPipe();
                 }
             }
             
-            // Send RPM to BLE server via pipe
-            sendRPM(rpm);
+            // Control tick: every motor channel's controller
+            double display_rpm[MAX_MOTORS];
+            double signed_rpm[MAX_MOTORS];   // Negative when turning in reverse (direction sensor)
+            for (int m = 0; m < g_num_motors; m++) {
+                motor_channel* ch = &g_motors[m];
+                pthread_mutex_lock(&g_rpm_mutex);
+                double control_rpm = rpmAlongDirection(ch, ch->current_rpm);
+                double rpm_accel = rpmAlongDirection(ch, ch->views.accel);
+                display_rpm[m] = ch->views.display;  // Status line and iPhone
+                signed_rpm[m] = ch->rotation ? ch->rotation * display_rpm[m] : display_rpm[m];
+                pthread_mutex_unlock(&g_rpm_mutex);
+                
+                // PWM sweep: the sweep drives the motor instead of the controllers
+                if (ch->sweep.active) {
+                    unsigned freq;
+                    double duty;
+                    if (pwmSweepStep(&ch->sweep, control_rpm, rpm_accel, monotonicMs(), &freq, &duty) == SWEEP_DONE) {
+                        finishSweep(ch);
+                    } else {
+                        if (freq != ch->bridge.pwm_freq) setPWMFrequency(ch, freq);
+                        ch->speed = (int)duty;
+                        ch->speed_fraction = duty - ch->speed;
+                        driveBridge(ch, duty);
+                    }
+                }
+                
+                // Steady operating points refit the sustain duty
+                if (ch->motor_on && ch->control_mode != 2 && !ch->sweep.active && !ch->sysid.active &&
+                    !ch->fault.fault &&
+                    motorStartSteady(&ch->start, channelDuty(ch), control_rpm, rpm_accel, halTick())) {
+                    printf("\n-> %sLearned sustain duty %.1f%% (%.1f RPM per %%)\n", ch->tag,
+                           ch->start.profile.sustain, ch->start.profile.slope);
+                    saveProfiles();
+                }
+                
+                // Run PID controller in automatic mode (open loop while the sensor is lost)
+                if (ch->control_mode == 1 && ch->motor_on && ch->fault.fault != FAULT_SENSOR) {
+                    int new_speed = pidController(ch, control_rpm, ch->desired_rpm, rpm_accel);
+                    if (new_speed != ch->speed) {
+                        setSpeed(ch, new_speed);
+                    }
+                }
+                
+                // Synchronized follower: drive from the master (hold the duty
+                // while either sensor is lost)
+                if (ch->control_mode == 2 && ch->fault.fault != FAULT_SENSOR &&
+                    g_motors[ch->sync.master].fault.fault != FAULT_SENSOR) {
+                    motor_channel* master = &g_motors[ch->sync.master];
+                    if (ch->direction != master->direction) {
+                        setDirection(ch, master->direction);
+                    }
+                    rpm_sync_status status;
+                    pthread_mutex_lock(&g_rpm_mutex);
+                    double duty = rpmSyncUpdate(&ch->sync, channelDuty(master), master->current_rpm,
+                                                control_rpm, PID_INTERVAL_S);
+                    rpmSyncStatus(&ch->sync, &status);
+                    pthread_mutex_unlock(&g_rpm_mutex);
+                    setSyncDuty(ch, duty);
+                    sendSyncStatus(ch, &status);
+                }
+                
+                // Send RPM to BLE server via pipe
+                sendRPM(m, display_rpm[m]);
+                
+                // New vibration analysis
+                static unsigned long spec_sent[MAX_MOTORS];
+                pthread_mutex_lock(&g_rpm_mutex);
+                int new_spec = ch->spec_seq != spec_sent[m];
+                rpm_spectrum spec = ch->spectrum;
+                spec_sent[m] = ch->spec_seq;
+                pthread_mutex_unlock(&g_rpm_mutex);
+                if (new_spec) {
+                    sendSpectrum(ch, &spec);
+                }
+            }
             
             // Display status based on mode
-            const char* mode_str = g_control_mode == 1 ? "AUTO" : "MANUAL";
-            
-            if (g_pipe_fd != -1) {
-                if (g_control_mode == 1) {
-                    printf("\r[BLE:%s] RPM: %7.2f/%7.2f | Motor: %s | Speed: %d%% | > ",
-                           mode_str, rpm, g_desired_rpm, g_motor_on ? "ON" : "OFF", g_speed);
-                } else {
-                    printf("\r[BLE:%s] RPM: %7.2f | Motor: %s | Speed: %d%% | > ",
-                           mode_str, rpm, g_motor_on ? "ON" : "OFF", g_speed);
+            const char* link = g_pipe_fd != -1 ? "BLE" : "WAIT";
+            motor_channel* ch = &g_motors[0];
+            if (g_num_motors > 1) {
+                printf("\r[%s]", link);
+                for (int m = 0; m < g_num_motors; m++) {
+                    ch = &g_motors[m];
+                    printf(" M%d %s %7.2f", m, ch->control_mode == 2 ? "S" : ch->control_mode == 1 ? "A" : "M",
+                           signed_rpm[m]);
+                    if (ch->control_mode == 1) printf("/%.0f", ch->desired_rpm);
+                    if (ch->control_mode == 2) printf("%s", ch->sync.lock_time_s >= SYNC_LOCK_HOLD_S ? " LOCK" : "");
+                    printf(" %s%s %d%% |", ch->motor_on ? "ON" : "OFF", faultTag(ch), ch->speed);
                 }
+                printf(" > ");
+            } else if (ch->control_mode == 1) {
+                printf("\r[%s:AUTO] RPM: %7.2f/%7.2f | Motor: %s%s | Speed: %d%% | > ",
+                       link, signed_rpm[0], ch->desired_rpm, ch->motor_on ? "ON" : "OFF", faultTag(ch), ch->speed);
             } else {
-                if (g_control_mode == 1) {
-                    printf("\r[WAIT:%s] RPM: %7.2f/%7.2f | Motor: %s | Speed: %d%% | > ",
-                           mode_str, rpm, g_desired_rpm, g_motor_on ? "ON" : "OFF", g_speed);
-                } else {
-                    printf("\r[WAIT:%s] RPM: %7.2f | Motor: %s | Speed: %d%% | > ",
-                           mode_str, rpm, g_motor_on ? "ON" : "OFF", g_speed);
-                }
+                printf("\r[%s:MANUAL] RPM: %7.2f | Motor: %s%s | Speed: %d%% | > ",
+                       link, signed_rpm[0], ch->motor_on ? "ON" : "OFF", faultTag(ch), ch->speed);
             }
             fflush(stdout);
-        }
-        
-        // Try to reconnect RPM pipe
-        if (g_rpm_pipe_fd == -1) {
-            static int rpm_reconnect_timer = 0;
-            rpm_reconnect_timer++;
-            if (rpm_reconnect_timer >= 10) {  // Every 1 second
-                rpm_reconnect_timer = 0;
-                openRPMPipe();
+            
+            // Try to reconnect RPM pipe
+            if (g_rpm_pipe_fd == -1) {
+                static int rpm_reconnect_timer = 0;
+                rpm_reconnect_timer++;
+                if (rpm_reconnect_timer >= 10) {  // Every 1 second
+                    rpm_reconnect_timer = 0;
+                    openRPMPipe();
+                }
             }
         }
     }
@@ -867,4 +2771,4 @@ int main() {
     cleanup(0);
     return 0;
 }
-
+#endif // PARMCO_NO_MAIN
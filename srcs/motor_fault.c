@@ -0,0 +1,217 @@
+/*
+ * motor_fault.c
+ * Stall and IR sensor dropout detection. See motor_fault.h.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "motor_fault.h"
+
+/**
+ * RESET
+ * Clears the fault and the edge history; the counters are kept.
+ */
+void motorFaultReset(motor_fault* f) {
+    motor_fault keep = *f;
+    memset(f, 0, sizeof(*f));
+    f->last_edges = keep.last_edges;
+    f->b_base = keep.b_base;
+    f->stalls = keep.stalls;
+    f->sensor_losses = keep.sensor_losses;
+}
+
+static motor_fault_event raiseFault(motor_fault* f, motor_fault_kind kind, const motor_fault_input* in,
+                                    uint32_t now, double detect_ms) {
+    f->fault = kind;
+    f->since = now;
+    f->detect_ms = detect_ms;
+    f->rpm_before = f->last_rpm;
+    f->recover_from = in->edges;
+    f->mismatch = 0;
+    if (kind == FAULT_STALL) {
+        f->stalls++;
+    } else {
+        f->sensor_losses++;
+    }
+    return FAULT_RAISED;
+}
+
+/*
+ * Blade period (last two edges) in us, 0 if unknown
+ */
+static double bladePeriod(const motor_fault_input* in) {
+    int n = in->num_ticks;
+    return n >= 3 ? (uint32_t)(in->edge_ticks[n - 1] - in->edge_ticks[n - 3]) : 0.0;
+}
+
+/*
+ * Time constant the rotor slows with over each of the last revs
+ * revolutions: the accepted period at its end against the one a revolution
+ * earlier. Sets *window_ms to those revolutions.
+ * @return The slowest of them in ms, 0 if one is not slowing or too few periods
+ */
+static double slowingTau(const motor_fault_input* in, int revs, double* window_ms) {
+    int n = in->num_periods, rev = in->periods_per_rev;
+    if (rev < 1 || n < revs * rev + 1) {
+        return 0.0;
+    }
+    const double* p = in->periods;
+    const uint32_t* t = in->period_ticks;
+    double slowest = 0.0;
+    for (int k = 0; k < revs; k++) {
+        int i = n - 1 - k * rev;
+        double dt = (uint32_t)(t[i] - t[i - rev]);
+        if (p[i - rev] <= 0.0 || p[i] <= p[i - rev] || dt <= 0.0) {
+            return 0.0;
+        }
+        slowest = fmax(slowest, dt / log(p[i] / p[i - rev]) / 1000.0);
+    }
+    *window_ms = (uint32_t)(t[n - 1] - t[n - 1 - revs * rev]) / 1000.0;
+    return slowest;
+}
+
+/*
+ * Time constant the rotor slowed with before the edges stopped, from the
+ * raw edges: the last FAULT_GAP_SLOWING_PERIODS blade periods must each be
+ * FAULT_GAP_SLOWING longer than the one before.
+ * @return ms, 0 if not slowing that way or too few edges
+ */
+static double gapSlowingTau(const motor_fault_input* in) {
+    int n = in->num_ticks, last = FAULT_GAP_SLOWING_PERIODS - 1;
+    if (n < FAULT_GAP_SLOWING_PERIODS + 2) {
+        return 0.0;
+    }
+    const uint32_t* t = in->edge_ticks;
+    for (int k = 0; k < last; k++) {
+        double newer = (uint32_t)(t[n - 1 - k] - t[n - 3 - k]);
+        double older = (uint32_t)(t[n - 2 - k] - t[n - 4 - k]);
+        if (older <= 0.0 || newer < FAULT_GAP_SLOWING * older) {
+            return 0.0;
+        }
+    }
+    double now = (uint32_t)(t[n - 1] - t[n - 3]);
+    double before = (uint32_t)(t[n - 1 - last] - t[n - 3 - last]);
+    double dt = (uint32_t)(t[n - 1] - t[n - 1 - last]);
+    return dt / log(now / before) / 1000.0;
+}
+
+/*
+ * Edges stopped while driven: stall or sensor?
+ */
+static motor_fault_event classifyGap(motor_fault* f, const motor_fault_input* in, uint32_t now,
+                                     double gap_ms) {
+    double tau = gapSlowingTau(in);
+
+    if (in->has_b && in->b_edges - f->b_base >= FAULT_B_EDGES) {
+        snprintf(f->reason, sizeof(f->reason), "IR edges stopped, the direction sensor still sees the blades");
+        return raiseFault(f, FAULT_SENSOR, in, now, gap_ms);
+    }
+    if (in->has_b) {
+        snprintf(f->reason, sizeof(f->reason), "both IR sensors stopped at %.0f RPM", f->last_rpm);
+        return raiseFault(f, FAULT_STALL, in, now, gap_ms);
+    }
+    if (tau > 0.0 && tau < FAULT_DECEL_TAU_MS) {
+        snprintf(f->reason, sizeof(f->reason), "edges stopped after slowing with a %.0f ms time constant", tau);
+        return raiseFault(f, FAULT_STALL, in, now, gap_ms);
+    }
+    if (in->model_rpm >= FAULT_MODEL_MIN_RPM && f->last_rpm < FAULT_MODEL_RATIO * in->model_rpm) {
+        snprintf(f->reason, sizeof(f->reason), "edges stopped at %.0f RPM, the model expects %.0f",
+                 f->last_rpm, in->model_rpm);
+        return raiseFault(f, FAULT_STALL, in, now, gap_ms);
+    }
+    snprintf(f->reason, sizeof(f->reason), "edges stopped at a steady %.0f RPM", f->last_rpm);
+    return raiseFault(f, FAULT_SENSOR, in, now, gap_ms);
+}
+
+/**
+ * CHECK
+ * @param in: Latest IR edges and drive state of the channel
+ * @return FAULT_RAISED (see f->fault and f->reason), FAULT_CLEARED or FAULT_QUIET
+ */
+motor_fault_event motorFaultCheck(motor_fault* f, const motor_fault_input* in, uint32_t now) {
+    unsigned long new_edges = in->edges - f->last_edges;
+    f->last_edges = in->edges;
+    if (new_edges > 0 || (!in->driven && !in->starting)) {
+        f->b_base = in->b_edges;
+    }
+
+    // Sensor back?
+    if (f->fault == FAULT_SENSOR && in->edges - f->recover_from >= FAULT_RECOVER_EDGES) {
+        f->fault = FAULT_NONE;
+        f->detect_ms = (uint32_t)(now - f->since) / 1000.0;  // Outage
+        f->armed = 0;
+        return FAULT_CLEARED;
+    }
+    if (f->fault != FAULT_NONE) {
+        return FAULT_QUIET;
+    }
+    if (!in->driven) {
+        f->armed = 0;
+        f->mismatch = 0;
+        return FAULT_QUIET;
+    }
+    if (new_edges > 0) {
+        f->armed += new_edges;
+        f->last_rpm = in->rpm;
+    }
+    double period = bladePeriod(in);
+    if (f->armed < FAULT_ARM_EDGES || period <= 0.0) {
+        return FAULT_QUIET;
+    }
+
+    // SLOWING: faster than the rotor can run down
+    double window_ms;
+    double tau = new_edges > 0 ? slowingTau(in, FAULT_SLOWING_REVS, &window_ms) : 0.0;
+    if (tau > 0.0 && tau < FAULT_DECEL_TAU_MS) {
+        snprintf(f->reason, sizeof(f->reason), "rotor slowing with a %.0f ms time constant", tau);
+        return raiseFault(f, FAULT_STALL, in, now, window_ms);
+    }
+
+    // DROPOUT: no edge for several blade periods
+    double gap_us = (int32_t)(in->edges_until - in->edge_ticks[in->num_ticks - 1]);
+    if (gap_us > FAULT_GAP_PERIODS * period && gap_us > FAULT_MIN_GAP_MS * 1000.0) {
+        return classifyGap(f, in, now, gap_us / 1000.0);
+    }
+
+    // PLANT MODEL: turning, but far slower than the duty explains
+    if (in->model_rpm >= FAULT_MODEL_MIN_RPM && in->rpm < FAULT_MODEL_RATIO * in->model_rpm) {
+        if (!f->mismatch) {
+            f->mismatch = 1;
+            f->mismatch_since = now;
+        } else if ((uint32_t)(now - f->mismatch_since) >= FAULT_MODEL_MS * 1000u) {
+            f->last_rpm = in->rpm;
+            snprintf(f->reason, sizeof(f->reason), "overload: %.0f RPM at %.0f%% duty, the model expects %.0f",
+                     in->rpm, in->duty, in->model_rpm);
+            return raiseFault(f, FAULT_STALL, in, now, FAULT_MODEL_MS);
+        }
+    } else {
+        f->mismatch = 0;
+    }
+    return FAULT_QUIET;
+}
+
+/**
+ * KICKSTART FAILED
+ * The ramp reached its end without an edge: blocked rotor, unless the
+ * direction sensor saw it turn.
+ */
+motor_fault_event motorFaultStartStalled(motor_fault* f, const motor_fault_input* in, uint32_t now) {
+    f->last_rpm = 0.0;
+    if (in->has_b && in->b_edges - f->b_base >= FAULT_B_EDGES) {
+        snprintf(f->reason, sizeof(f->reason), "no IR edges at %.0f%% duty, the direction sensor sees the blades",
+                 in->duty);
+        return raiseFault(f, FAULT_SENSOR, in, now, 0.0);
+    }
+    snprintf(f->reason, sizeof(f->reason), "no rotation at %.0f%% duty (rotor blocked or IR sensor missing)",
+             in->duty);
+    return raiseFault(f, FAULT_STALL, in, now, 0.0);
+}
+
+const char* motorFaultName(motor_fault_kind kind) {
+    switch (kind) {
+        case FAULT_STALL:  return "stall";
+        case FAULT_SENSOR: return "sensor";
+        default:           return "none";
+    }
+}
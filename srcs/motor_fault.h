@@ -0,0 +1,145 @@
+/*
+ * motor_fault.h
+ * Stall and IR sensor dropout detection.
+ *
+ * When the IR sensor fails or is blocked the measured speed reads 0, and a
+ * closed loop (automatic mode, a synchronized follower) winds the duty up
+ * chasing a speed it cannot see. A jammed rotor looks the same to the
+ * sensor but needs the opposite reaction: stop driving it. The detector
+ * watches the IR edges while the motor is driven and tells the two apart
+ * within a few blade periods.
+ *
+ * SLOWING:
+ * Driven at or above the sustain duty, a rotor only slows as fast as it
+ * runs down on its own (a time constant of hundreds of ms). The blade
+ * period is compared with the one a revolution earlier; a rotor slowing
+ * with a time constant under FAULT_DECEL_TAU_MS over FAULT_SLOWING_REVS
+ * revolutions in a row is being stopped by something: STALL. The periods
+ * are the estimator's, spacing-corrected and past its outlier check: a
+ * single missed edge makes one raw period half as long again, which at
+ * speed reads as a time constant well under FAULT_DECEL_TAU_MS.
+ *
+ * DROPOUT:
+ * Once FAULT_ARM_EDGES edges were seen while driven, no edge for
+ * FAULT_GAP_PERIODS blade periods (at least FAULT_MIN_GAP_MS) is a fault:
+ * about 35 ms at 2500 RPM with 3 blades. What stopped the edges:
+ *   - the direction sensor still sees blades                  -> SENSOR
+ *   - the direction sensor is silent as well                  -> STALL
+ *   without a direction sensor:
+ *   - the rotor was slowing fast before the gap                -> STALL
+ *     (FAULT_GAP_SLOWING_PERIODS raw blade periods in a row, each
+ *     FAULT_GAP_SLOWING longer, with a SLOWING time constant: a jam
+ *     stops the edges before the estimator accepts its periods, and a
+ *     missed edge lengthens one period but shortens the next)
+ *   - the speed was below FAULT_MODEL_RATIO of the model       -> STALL
+ *   - the edges stopped at a steady speed                      -> SENSOR
+ * Without a direction sensor, a rotor that jams within a blade period or
+ * two leaves no slowing edges and reads as SENSOR; the caller bounds
+ * open-loop running (FAULT_BLIND_MAX_MS).
+ *
+ * PLANT MODEL:
+ * With the learned sustain duty and slope (motor_start.h) the duty predicts
+ * the steady speed. Edges still arriving, but the speed below
+ * FAULT_MODEL_RATIO of the prediction for FAULT_MODEL_MS is a STALL
+ * (overload, binding bearing): a closed loop would only push more current.
+ *
+ * STARTS:
+ * A kickstart that sees no motion (START_STALLED) is classified by
+ * motorFaultStartStalled(): SENSOR if the direction sensor saw blades.
+ *
+ * RECOVERY:
+ * A SENSOR fault clears after FAULT_RECOVER_EDGES edges; a STALL stays
+ * until motorFaultReset() (the motor is switched on again).
+ *
+ * Gaps are measured up to edges_until, not the time of the check, so a
+ * capture thread that runs late is not a dropout.
+ *
+ * Call motorFaultCheck() every FAULT_STEP_MS while a motor is driven or has
+ * a SENSOR fault. All times are halTick() microseconds (wrapping 32-bit
+ * counter).
+ */
+
+#ifndef MOTOR_FAULT_H
+#define MOTOR_FAULT_H
+
+#include <stdint.h>
+#include "rpm_estimator.h"
+
+#define FAULT_STEP_MS         5       // motorFaultCheck() period while watching
+#define FAULT_EDGE_HISTORY    (2 * RPM_MAX_BLADES + 3)  // Newest IR edges kept (a revolution and 3 edges)
+#define FAULT_SLOWING_REVS    2       // Revolutions in a row slowing fast = stalling
+#define FAULT_PERIOD_HISTORY  ((FAULT_SLOWING_REVS + 1) * 2 * RPM_MAX_BLADES)  // Accepted periods kept
+#define FAULT_ARM_EDGES       12      // Edges while driven before a gap counts
+#define FAULT_GAP_PERIODS     4.0     // No edge for this many blade periods = dropout
+#define FAULT_MIN_GAP_MS      25      // ... and at least this long (capture batches)
+#define FAULT_DECEL_TAU_MS    100.0   // Slowing faster than this time constant = stalling
+#define FAULT_GAP_SLOWING_PERIODS 3   // Blade periods in a row lengthening before a gap = stalling
+#define FAULT_GAP_SLOWING     1.1     // ... each this much longer than the one before
+#define FAULT_B_EDGES         2       // Direction sensor edges during a gap = the rotor turns
+#define FAULT_MODEL_RATIO     0.4     // Speed below this share of the model = overloaded
+#define FAULT_MODEL_MIN_RPM   300.0   // Model check only above this predicted speed
+#define FAULT_MODEL_MS        1000    // ... for this long
+#define FAULT_RECOVER_EDGES   6       // Edges that end a SENSOR fault
+#define FAULT_BLIND_MAX_MS    30000   // Longest open-loop run without a sensor
+#define FAULT_UNKNOWN_SUSTAIN 20.0    // Duty % assumed to keep the rotor turning while none is learned
+
+typedef enum {
+    FAULT_NONE,
+    FAULT_STALL,               // Rotor stopped or overloaded while driven
+    FAULT_SENSOR,              // IR sensor lost while the rotor turns
+} motor_fault_kind;
+
+typedef enum {
+    FAULT_QUIET,
+    FAULT_RAISED,              // New fault in fault/reason
+    FAULT_CLEARED,             // SENSOR fault over: edges are back
+} motor_fault_event;
+
+typedef struct {
+    unsigned long edges;       // IR edges seen (after the glitch filter)
+    uint32_t edge_ticks[FAULT_EDGE_HISTORY];  // The newest of them, oldest first
+    int num_ticks;
+    uint32_t edges_until;      // Capture time the edges are complete up to
+    double periods[FAULT_PERIOD_HISTORY];        // Newest accepted blade periods, us, oldest first
+    uint32_t period_ticks[FAULT_PERIOD_HISTORY]; // ... and the edges that ended them
+    int num_periods;
+    int periods_per_rev;       // Accepted periods in a revolution (rpmEstimatorPulsesPerRev)
+    int has_b;                 // Direction sensor captured
+    unsigned long b_edges;     // Its edges
+    int driven;                // Driving at or above the sustain duty (no start, brake or reversal)
+    int starting;              // Kickstart ramp running
+    double duty;               // Drive duty %
+    double rpm;                // Control RPM
+    double model_rpm;          // Steady RPM the model predicts for duty (0 = unknown)
+} motor_fault_input;
+
+typedef struct {
+    motor_fault_kind fault;
+    char reason[96];
+    uint32_t since;            // Raised
+    double detect_ms;          // Evidence time: the gap, the slowing revolution, the overload
+    double rpm_before;         // Speed before the fault
+
+    // Edges since armed
+    unsigned long last_edges;
+    unsigned long armed;
+    double last_rpm;
+    unsigned long b_base;      // Direction sensor edges at the last edge (or start)
+
+    // Model check
+    int mismatch;
+    uint32_t mismatch_since;
+
+    unsigned long recover_from;
+
+    // Counters
+    unsigned long stalls;
+    unsigned long sensor_losses;
+} motor_fault;
+
+void motorFaultReset(motor_fault* f);
+motor_fault_event motorFaultCheck(motor_fault* f, const motor_fault_input* in, uint32_t now);
+motor_fault_event motorFaultStartStalled(motor_fault* f, const motor_fault_input* in, uint32_t now);
+const char* motorFaultName(motor_fault_kind kind);
+
+#endif // MOTOR_FAULT_H
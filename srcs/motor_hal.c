@@ -0,0 +1,246 @@
+/*
+ * motor_hal.c
+ * Backend registry and selection for the motor hardware-abstraction layer.
+ * See motor_hal.h for the list of backends and build flags.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "motor_hal.h"
+
+const motor_hal_ops* g_hal = NULL;
+
+// Compiled-in backends, first entry is the default
+static const motor_hal_ops* const hal_backends[] = {
+#ifndef PARMCO_NO_PIGPIO
+    &motor_hal_pigpio,
+#endif
+#ifdef PARMCO_WITH_PIGPIOD
+    &motor_hal_pigpiod,
+#endif
+#ifdef PARMCO_WITH_GPIOD
+    &motor_hal_gpiod,
+#endif
+    &motor_hal_sim,
+};
+
+#define HAL_NUM_BACKENDS (sizeof(hal_backends) / sizeof(hal_backends[0]))
+
+void halConfigDefaults(motor_hal_config* cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->backend = getenv("PARMCO_BACKEND");
+    if (cfg->backend == NULL) {
+        cfg->backend = hal_backends[0]->name;
+    }
+    cfg->gpiochip = "/dev/gpiochip0";
+    cfg->pwmchip = NULL;
+    cfg->pwm_channel = 0;
+    for (int m = 0; m < HAL_MAX_MOTORS; m++) {
+        cfg->motors[m].ir2_pin = HAL_NO_PIN;
+    }
+}
+
+/**
+ * PARSE BACKEND OPTIONS
+ * Recognises --backend=, --host=, --port=, --gpiochip=, --pwmchip=,
+ * --pwm-channel=, --pwm=, --pwm-freq=, --enable-pin=, --ir2-pin=, --motor=,
+ * --capture=, --sample-us= and --sim-fault=. Unknown arguments are left for
+ * the caller.
+ *
+ * The first --motor=EN,IN1,IN2,IR[,IR2] replaces the default wiring, each
+ * further one adds a motor channel (up to HAL_MAX_MOTORS). IR2 is the
+ * optional direction sensor; --ir2-pin= sets it for the first motor.
+ *
+ * @return 0 on success, -1 if an option value is invalid
+ */
+int halConfigFromArgs(motor_hal_config* cfg, int argc, char* argv[]) {
+    int motors_given = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--backend=", 10) == 0) {
+            cfg->backend = arg + 10;
+        } else if (strncmp(arg, "--host=", 7) == 0) {
+            cfg->host = arg + 7;
+        } else if (strncmp(arg, "--port=", 7) == 0) {
+            cfg->port = arg + 7;
+        } else if (strncmp(arg, "--gpiochip=", 11) == 0) {
+            cfg->gpiochip = arg + 11;
+        } else if (strncmp(arg, "--pwmchip=", 10) == 0) {
+            cfg->pwmchip = arg + 10;
+        } else if (strncmp(arg, "--pwm-channel=", 14) == 0) {
+            cfg->pwm_channel = atoi(arg + 14);
+        } else if (strncmp(arg, "--pwm=", 6) == 0) {
+            if (strcmp(arg + 6, "hw") == 0) {
+                cfg->pwm_hw = 1;
+            } else if (strcmp(arg + 6, "sw") == 0) {
+                cfg->pwm_hw = 0;
+            } else {
+                fprintf(stderr, "❌ Invalid --pwm mode '%s' (use sw or hw)\n", arg + 6);
+                return -1;
+            }
+        } else if (strncmp(arg, "--pwm-freq=", 11) == 0) {
+            cfg->pwm_freq = (unsigned)strtoul(arg + 11, NULL, 10);
+        } else if (strncmp(arg, "--enable-pin=", 13) == 0) {
+            cfg->motors[0].enable_pin = (unsigned)strtoul(arg + 13, NULL, 10);
+        } else if (strncmp(arg, "--ir2-pin=", 10) == 0) {
+            cfg->motors[0].ir2_pin = (unsigned)strtoul(arg + 10, NULL, 10);
+        } else if (strncmp(arg, "--motor=", 8) == 0) {
+            hal_motor_wiring w;
+            w.ir2_pin = HAL_NO_PIN;
+            int n = sscanf(arg + 8, "%u,%u,%u,%u,%u", &w.enable_pin, &w.in1_pin, &w.in2_pin,
+                           &w.ir_pin, &w.ir2_pin);
+            if (n != 4 && n != 5) {
+                fprintf(stderr, "❌ Invalid --motor '%s' (use EN,IN1,IN2,IR[,IR2] pin numbers)\n", arg + 8);
+                return -1;
+            }
+            if (motors_given == HAL_MAX_MOTORS) {
+                fprintf(stderr, "❌ Too many --motor options (max %d)\n", HAL_MAX_MOTORS);
+                return -1;
+            }
+            cfg->motors[motors_given++] = w;
+            cfg->num_motors = motors_given;
+        } else if (strncmp(arg, "--capture=", 10) == 0) {
+            if (strcmp(arg + 10, "poll") == 0) {
+                cfg->capture_poll = 1;
+            } else if (strcmp(arg + 10, "edges") == 0) {
+                cfg->capture_poll = 0;
+            } else {
+                fprintf(stderr, "❌ Invalid --capture mode '%s' (use edges or poll)\n", arg + 10);
+                return -1;
+            }
+        } else if (strncmp(arg, "--sample-us=", 12) == 0) {
+            cfg->sample_us = (unsigned)strtoul(arg + 12, NULL, 10);
+        } else if (strncmp(arg, "--sim-fault=", 12) == 0) {
+            cfg->sim_fault = arg + 12;
+        }
+    }
+
+    if (halFind(cfg->backend) == NULL) {
+        fprintf(stderr, "❌ Unknown GPIO backend '%s'. Available:", cfg->backend);
+        halListBackends(stderr);
+        return -1;
+    }
+    return 0;
+}
+
+const motor_hal_ops* halFind(const char* name) {
+    for (size_t i = 0; i < HAL_NUM_BACKENDS; i++) {
+        if (name && strcmp(hal_backends[i]->name, name) == 0) {
+            return hal_backends[i];
+        }
+    }
+    return NULL;
+}
+
+void halListBackends(FILE* out) {
+    for (size_t i = 0; i < HAL_NUM_BACKENDS; i++) {
+        fprintf(out, " %s", hal_backends[i]->name);
+    }
+    fprintf(out, "\n");
+}
+
+int halInit(const motor_hal_config* cfg) {
+    const motor_hal_ops* ops = halFind(cfg->backend);
+    if (ops == NULL) {
+        return -1;
+    }
+    if (ops->init(cfg) < 0) {
+        return -1;
+    }
+    g_hal = ops;
+    return 0;
+}
+
+void halTerminate(void) {
+    if (g_hal) {
+        g_hal->terminate();
+        g_hal = NULL;
+    }
+}
+
+/**
+ * WRITE SEVERAL OUTPUTS
+ * Drives the pins in clear_bits LOW, then the pins in set_bits HIGH (GPIO
+ * 0-31). With a bank-capable backend each group changes in a single
+ * register write, so e.g. the H-bridge inputs go from (1,0) to (0,1) through
+ * (0,0) and never through (1,1). Other backends get the same order pin by
+ * pin.
+ *
+ * @return 0 on success, < 0 on error
+ */
+int halWriteBank(uint32_t set_bits, uint32_t clear_bits) {
+    if (g_hal->write_bank) {
+        return g_hal->write_bank(set_bits, clear_bits);
+    }
+    int ret = 0;
+    for (unsigned pin = 0; pin < 32; pin++) {
+        if ((clear_bits >> pin) & 1u) {
+            if (g_hal->write(pin, 0) < 0) ret = -1;
+        }
+    }
+    for (unsigned pin = 0; pin < 32; pin++) {
+        if ((set_bits >> pin) & 1u) {
+            if (g_hal->write(pin, 1) < 0) ret = -1;
+        }
+    }
+    return ret;
+}
+
+/**
+ * SCAN LEVEL SAMPLES FOR EDGES
+ * Turns a batch of GPIO bank samples (tick + levels of GPIO 0-31, as
+ * delivered by pigpio's gpioSetGetSamplesFunc) into the edges of the pins
+ * in mask.
+ *
+ * Edges are rare compared with samples (a few per thousand even at full
+ * speed), so the batch is scanned in blocks of HAL_SCAN_BLOCK samples: the
+ * block's level changes are OR-reduced first, a loop without branches that
+ * the compiler vectorizes (NEON on the Pi, SSE/AVX on x86 at -O2/-O3), and
+ * only blocks with a change on mask are walked sample by sample.
+ *
+ * @param samples: Bank samples in time order (hal_edge layout, level = bank bits)
+ * @param num_samples: Number of samples
+ * @param mask: Bit of the pin to extract (1 << pin)
+ * @param last_level: Bank levels before samples[0]; updated to the last sample
+ * @param edges: Output, room for num_samples entries; level is the pin's new level
+ * @return Number of edges stored
+ */
+#define HAL_SCAN_BLOCK 16
+
+int halScanEdges(const hal_edge* samples, int num_samples, uint32_t mask,
+                 uint32_t* last_level, hal_edge* edges) {
+    uint32_t prev = *last_level;
+    int count = 0;
+    int i = 0;
+
+    while (i < num_samples) {
+        if (i + HAL_SCAN_BLOCK <= num_samples) {
+            // Fast path: any change on mask inside this block?
+            uint32_t changed = samples[i].level ^ prev;
+            for (int j = 1; j < HAL_SCAN_BLOCK; j++) {
+                changed |= samples[i + j].level ^ samples[i + j - 1].level;
+            }
+            if ((changed & mask) == 0) {
+                prev = samples[i + HAL_SCAN_BLOCK - 1].level;
+                i += HAL_SCAN_BLOCK;
+                continue;
+            }
+        }
+
+        // Slow path: the block with an edge, or the tail of the batch
+        int end = (i + HAL_SCAN_BLOCK <= num_samples) ? i + HAL_SCAN_BLOCK : num_samples;
+        for (; i < end; i++) {
+            uint32_t level = samples[i].level;
+            if ((level ^ prev) & mask) {
+                edges[count].tick = samples[i].tick;
+                edges[count].level = (level & mask) != 0;
+                count++;
+            }
+            prev = level;
+        }
+    }
+
+    *last_level = prev;
+    return count;
+}
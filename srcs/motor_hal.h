@@ -0,0 +1,203 @@
+/*
+ * motor_hal.h
+ * Hardware-abstraction layer for the motor controller's GPIO/PWM access.
+ *
+ * motor_control_ble_pipe.c talks to the hardware only through the hal*()
+ * wrappers below. The wrappers dispatch to one backend selected at startup:
+ *
+ *   pigpio   - pigpio linked in-process (default, needs root, DMA-sampled capture)
+ *   pigpiod  - remote pigpio daemon via pigpiod_if2   (-DPARMCO_WITH_PIGPIOD -lpigpiod_if2)
+ *   gpiod    - libgpiod v2 character device + sysfs PWM chip (-DPARMCO_WITH_GPIOD -lgpiod)
+ *   sim      - simulated motor, H-bridge and IR sensor (always available)
+ *
+ * Build without pigpio (e.g. sim only on a laptop) with -DPARMCO_NO_PIGPIO.
+ *
+ * All backends follow pigpio semantics: pin numbers are BCM GPIOs, PWM duty
+ * is 0..range on the pin's PWM range, tick is a wrapping 32-bit microsecond
+ * counter, and calls return >= 0 on success or < 0 on error.
+ */
+
+#ifndef MOTOR_HAL_H
+#define MOTOR_HAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define HAL_INPUT   0
+#define HAL_OUTPUT  1
+#define HAL_ALT     2   // Pin owned by a peripheral such as hardware PWM (get_mode only)
+
+#define HAL_PUD_OFF  0
+#define HAL_PUD_DOWN 1
+#define HAL_PUD_UP   2
+
+#define HAL_HW_PWM_RANGE 1000000   // Hardware PWM duty is in millionths
+
+#define HAL_MAX_MOTORS   4         // Motor channels one process can drive
+
+/**
+ * CAPTURED EDGE
+ * One level change on an input, timestamped by the backend as close to the
+ * hardware as it can (DMA sample tick for pigpio, kernel timestamp for
+ * gpiod). Same layout as pigpio's gpioSample_t.
+ */
+typedef struct {
+    uint32_t tick;    // halTick() timebase, microseconds
+    uint32_t level;   // Level after the edge (1 = rising edge)
+} hal_edge;
+
+#define HAL_NO_PIN 0xFFFFFFFFu   // Optional pin not wired
+
+/**
+ * MOTOR WIRING
+ * H-bridge and IR sensor pins of one motor channel. ir2_pin is an optional
+ * second IR sensor, offset from the first along the blade path, used to
+ * sense the direction of rotation (HAL_NO_PIN if absent).
+ */
+typedef struct {
+    unsigned enable_pin;
+    unsigned in1_pin;
+    unsigned in2_pin;
+    unsigned ir_pin;
+    unsigned ir2_pin;
+} hal_motor_wiring;
+
+/**
+ * BACKEND CONFIGURATION
+ * Filled from command-line options by halConfigFromArgs().
+ * Pin fields describe the wiring so backends that need it (sim, gpiod PWM)
+ * know which pin is which.
+ */
+typedef struct {
+    const char* backend;       // --backend=pigpio|pigpiod|gpiod|sim (default pigpio, or $PARMCO_BACKEND)
+
+    // pigpiod
+    const char* host;          // --host=ADDR (NULL = localhost / $PIGPIO_ADDR)
+    const char* port;          // --port=PORT (NULL = 8888 / $PIGPIO_PORT)
+
+    // gpiod
+    const char* gpiochip;      // --gpiochip=/dev/gpiochip0
+    const char* pwmchip;       // --pwmchip=/sys/class/pwm/pwmchip0 (PWM for the enable pin)
+    int pwm_channel;           // --pwm-channel=N
+
+    // Enable pin PWM generator
+    int pwm_hw;                // --pwm=sw|hw (hw = PWM peripheral, GPIO 12/13/18/19 on a Pi)
+    unsigned pwm_freq;         // --pwm-freq=HZ (0 = control program default)
+
+    // Edge capture
+    int capture_poll;          // --capture=edges|poll (poll = ignore backend edge capture)
+    unsigned sample_us;        // --sample-us=1|2|4|5|8|10 pigpio DMA sample period (0 = pigpio default, 5)
+
+    // sim
+    const char* sim_fault;     // --sim-fault=sensor|jam|load:AT_S[:FOR_S] fault injected into motor 0
+
+    // Wiring (set by the control program; --enable-pin=N overrides motor 0,
+    // --motor=EN,IN1,IN2,IR replaces the defaults, repeat it for more motors)
+    hal_motor_wiring motors[HAL_MAX_MOTORS];
+    int num_motors;
+    int blades;
+} motor_hal_config;
+
+/**
+ * BACKEND OPERATIONS
+ * One instance per backend. Every operation is mandatory except those
+ * marked optional, which are NULL when the backend cannot support them.
+ */
+typedef struct {
+    const char* name;
+    int      persistent;   // Outputs keep running after this process exits (resident daemon)
+    int      (*init)(const motor_hal_config* cfg);
+    void     (*terminate)(void);
+    int      (*set_mode)(unsigned pin, unsigned mode);
+    int      (*set_pull)(unsigned pin, unsigned pud);
+    int      (*read)(unsigned pin);
+    int      (*write)(unsigned pin, unsigned level);
+    int      (*pwm)(unsigned pin, unsigned duty);
+    int      (*set_pwm_frequency)(unsigned pin, unsigned hz);   // Returns the frequency set (> 0) if known
+    int      (*set_pwm_range)(unsigned pin, unsigned range);
+    int      (*glitch_filter)(unsigned pin, unsigned steady_us);
+    uint32_t (*tick)(void);
+
+    // Optional read-back of output state, used to adopt a running motor.
+    // get_pwm reports hardware PWM duty in millionths, get_pwm_frequency
+    // the running software or hardware PWM frequency in Hz.
+    int      (*get_mode)(unsigned pin);
+    int      (*get_pwm)(unsigned pin);
+    int      (*get_pwm_frequency)(unsigned pin);
+
+    // Optional: duty steps the PWM generator really has at the pin's
+    // frequency (pigpio's DMA PWM: 25 at 8 kHz, 200 at 1 kHz with 5us
+    // samples); duty written with set_pwm_range is scaled onto them.
+    int      (*get_pwm_real_range)(unsigned pin);
+
+    // Optional hardware PWM: frequency in Hz, duty 0..HAL_HW_PWM_RANGE.
+    // Takes the pin over from set_mode/pwm until the next set_mode.
+    int      (*hardware_pwm)(unsigned pin, unsigned hz, unsigned duty);
+
+    // Optional edge capture: start timestamping both edges on pin, then fetch them in
+    // batches. wait_edges blocks up to timeout_us and returns the number of
+    // edges stored (0 on timeout, < 0 on error).
+    int      (*edge_capture_start)(unsigned pin);
+    int      (*wait_edges)(unsigned pin, hal_edge* edges, int max_edges, uint32_t timeout_us);
+
+    // Optional bank write of GPIO 0-31: clears clear_bits in one write, then
+    // sets set_bits in one write. Without it halWriteBank() writes the pins
+    // one by one (clears first).
+    int      (*write_bank)(uint32_t set_bits, uint32_t clear_bits);
+} motor_hal_ops;
+
+// Backends (defined in motor_hal_<name>.c when compiled in)
+extern const motor_hal_ops motor_hal_pigpio;
+extern const motor_hal_ops motor_hal_pigpiod;
+extern const motor_hal_ops motor_hal_gpiod;
+extern const motor_hal_ops motor_hal_sim;
+
+// Active backend (set by halInit)
+extern const motor_hal_ops* g_hal;
+
+void halConfigDefaults(motor_hal_config* cfg);
+int halConfigFromArgs(motor_hal_config* cfg, int argc, char* argv[]);
+const motor_hal_ops* halFind(const char* name);
+void halListBackends(FILE* out);
+int halInit(const motor_hal_config* cfg);
+void halTerminate(void);
+int halScanEdges(const hal_edge* samples, int num_samples, uint32_t mask,
+                 uint32_t* last_level, hal_edge* edges);
+int halWriteBank(uint32_t set_bits, uint32_t clear_bits);
+
+static inline int halSetMode(unsigned pin, unsigned mode) { return g_hal->set_mode(pin, mode); }
+static inline int halSetPull(unsigned pin, unsigned pud) { return g_hal->set_pull(pin, pud); }
+static inline int halRead(unsigned pin) { return g_hal->read(pin); }
+static inline int halWrite(unsigned pin, unsigned level) { return g_hal->write(pin, level); }
+static inline int halPWM(unsigned pin, unsigned duty) { return g_hal->pwm(pin, duty); }
+static inline int halSetPWMFrequency(unsigned pin, unsigned hz) { return g_hal->set_pwm_frequency(pin, hz); }
+static inline int halSetPWMRange(unsigned pin, unsigned range) { return g_hal->set_pwm_range(pin, range); }
+static inline int halGlitchFilter(unsigned pin, unsigned steady_us) { return g_hal->glitch_filter(pin, steady_us); }
+static inline uint32_t halTick(void) { return g_hal->tick(); }
+
+static inline int halGetMode(unsigned pin) {
+    return g_hal->get_mode ? g_hal->get_mode(pin) : -1;
+}
+static inline int halGetPWM(unsigned pin) {
+    return g_hal->get_pwm ? g_hal->get_pwm(pin) : -1;
+}
+static inline int halGetPWMFrequency(unsigned pin) {
+    return g_hal->get_pwm_frequency ? g_hal->get_pwm_frequency(pin) : -1;
+}
+
+static inline int halGetPWMRealRange(unsigned pin) {
+    return g_hal->get_pwm_real_range ? g_hal->get_pwm_real_range(pin) : -1;
+}
+
+static inline int halHardwarePWM(unsigned pin, unsigned hz, unsigned duty) {
+    return g_hal->hardware_pwm ? g_hal->hardware_pwm(pin, hz, duty) : -1;
+}
+
+static inline int halEdgeCaptureStart(unsigned pin) {
+    return g_hal->edge_capture_start ? g_hal->edge_capture_start(pin) : -1;
+}
+static inline int halWaitEdges(unsigned pin, hal_edge* edges, int max_edges, uint32_t timeout_us) {
+    return g_hal->wait_edges(pin, edges, max_edges, timeout_us);
+}
+
+#endif // MOTOR_HAL_H
@@ -0,0 +1,339 @@
+/*
+ * motor_hal_gpiod.c
+ * HAL backend: libgpiod v2 (GPIO character device) plus a sysfs PWM chip.
+ *
+ * Works on any kernel with /dev/gpiochipN, without pigpio or root (given
+ * membership of the gpio group). The character device has no PWM, so the
+ * enable pin is driven by a hardware PWM channel exported through
+ * /sys/class/pwm. On a Pi, enable it with e.g. dtoverlay=pwm,pin=18,func=2
+ * and wire the H-bridge enable input to that pin. Only motor 0 gets the
+ * PWM channel; with several motors use the pigpio backends.
+ *
+ * TACHOMETER CAPTURE:
+ * The IR sensor line is requested with edge detection on both edges. The
+ * kernel timestamps each edge in its interrupt handler (CLOCK_MONOTONIC, the
+ * same clock as gpiodTick), applies the debounce period set through
+ * glitch_filter, and queues the events; wait_edges() reads them in batches.
+ * bench/bench_gpiod_edges.c exercises this path on the gpio-sim module.
+ *
+ * Build: add -DPARMCO_WITH_GPIOD ... -lgpiod
+ * Run:   ./motor_control_ble_pipe --backend=gpiod --gpiochip=/dev/gpiochip0 \
+ *            --pwmchip=/sys/class/pwm/pwmchip0 --pwm-channel=0
+ */
+
+#ifdef PARMCO_WITH_GPIOD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <gpiod.h>
+#include "motor_hal.h"
+
+#define GPIOD_MAX_PINS 64
+#define GPIOD_CONSUMER "parmco"
+#define GPIOD_EVENT_QUEUE 1024   // Kernel edge event queue per input line
+#define GPIOD_EVENT_BATCH 64     // Edge events read per syscall
+
+// Requested configuration of one line, reapplied whenever it changes
+typedef struct {
+    struct gpiod_line_request* request;
+    int mode;              // HAL_INPUT / HAL_OUTPUT, -1 = not requested
+    int pull;              // HAL_PUD_*
+    unsigned debounce_us;
+    int edges;             // Edge detection enabled (input only)
+    int value;             // Last written output value
+} gpiod_pin;
+
+static struct gpiod_chip* g_chip = NULL;
+static gpiod_pin g_pins[GPIOD_MAX_PINS];
+static struct gpiod_edge_event_buffer* g_event_buffer = NULL;
+
+// sysfs PWM channel for the enable pin
+static char g_pwm_dir[256];
+static unsigned g_pwm_pin = 0;
+static int g_pwm_enabled = 0;
+static unsigned g_pwm_range = 255;
+static unsigned long g_pwm_period_ns = 1000000;  // 1 kHz
+
+// ============================================================================
+// SYSFS PWM
+// ============================================================================
+
+static int sysfsWrite(const char* dir, const char* attr, const char* value) {
+    char path[320];
+    snprintf(path, sizeof(path), "%s/%s", dir, attr);
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) return -1;
+    ssize_t n = write(fd, value, strlen(value));
+    close(fd);
+    return n < 0 ? -1 : 0;
+}
+
+static int sysfsWriteUL(const char* dir, const char* attr, unsigned long value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lu", value);
+    return sysfsWrite(dir, attr, buf);
+}
+
+static int pwmOpen(const motor_hal_config* cfg) {
+    char channel[16];
+    snprintf(channel, sizeof(channel), "%d", cfg->pwm_channel);
+    snprintf(g_pwm_dir, sizeof(g_pwm_dir), "%s/pwm%d", cfg->pwmchip, cfg->pwm_channel);
+
+    // Export the channel if it does not exist yet (EBUSY if already exported)
+    if (access(g_pwm_dir, F_OK) != 0) {
+        sysfsWrite(cfg->pwmchip, "export", channel);
+        // udev may need a moment to fix up permissions on the new directory
+        for (int i = 0; i < 50 && access(g_pwm_dir, W_OK) != 0; i++) {
+            usleep(10000);
+        }
+    }
+
+    // Period must be set before duty; duty 0 first in case the old period was shorter
+    sysfsWriteUL(g_pwm_dir, "duty_cycle", 0);
+    if (sysfsWriteUL(g_pwm_dir, "period", g_pwm_period_ns) < 0) {
+        fprintf(stderr, "❌ Cannot configure PWM channel %s\n", g_pwm_dir);
+        return -1;
+    }
+    g_pwm_pin = cfg->motors[0].enable_pin;  // One PWM channel: motor 0 only
+    g_pwm_enabled = 1;
+    return 0;
+}
+
+// ============================================================================
+// LINE REQUESTS
+// ============================================================================
+
+// (Re)request a line with its current settings
+static int pinApply(unsigned pin) {
+    gpiod_pin* p = &g_pins[pin];
+    struct gpiod_line_settings* settings = gpiod_line_settings_new();
+    struct gpiod_line_config* line_cfg = gpiod_line_config_new();
+    struct gpiod_request_config* req_cfg = gpiod_request_config_new();
+    int ret = -1;
+
+    if (!settings || !line_cfg || !req_cfg) goto out;
+
+    if (p->mode == HAL_OUTPUT) {
+        gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+        gpiod_line_settings_set_output_value(settings,
+            p->value ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+    } else {
+        gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+        gpiod_line_settings_set_debounce_period_us(settings, p->debounce_us);
+        if (p->edges) {
+            gpiod_line_settings_set_edge_detection(settings, GPIOD_LINE_EDGE_BOTH);
+            gpiod_line_settings_set_event_clock(settings, GPIOD_LINE_CLOCK_MONOTONIC);
+        }
+    }
+
+    if (p->pull == HAL_PUD_UP) {
+        gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_PULL_UP);
+    } else if (p->pull == HAL_PUD_DOWN) {
+        gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_PULL_DOWN);
+    } else {
+        gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_DISABLED);
+    }
+
+    unsigned int offset = pin;
+    if (gpiod_line_config_add_line_settings(line_cfg, &offset, 1, settings) < 0) goto out;
+
+    if (p->request) {
+        ret = gpiod_line_request_reconfigure_lines(p->request, line_cfg);
+    } else {
+        gpiod_request_config_set_consumer(req_cfg, GPIOD_CONSUMER);
+        if (p->mode == HAL_INPUT) {
+            gpiod_request_config_set_event_buffer_size(req_cfg, GPIOD_EVENT_QUEUE);
+        }
+        p->request = gpiod_chip_request_lines(g_chip, req_cfg, line_cfg);
+        ret = p->request ? 0 : -1;
+    }
+
+out:
+    if (req_cfg) gpiod_request_config_free(req_cfg);
+    if (line_cfg) gpiod_line_config_free(line_cfg);
+    if (settings) gpiod_line_settings_free(settings);
+    return ret;
+}
+
+// ============================================================================
+// BACKEND OPERATIONS
+// ============================================================================
+
+static int gpiodInit(const motor_hal_config* cfg) {
+    g_chip = gpiod_chip_open(cfg->gpiochip);
+    if (!g_chip) {
+        fprintf(stderr, "❌ Cannot open %s\n", cfg->gpiochip);
+        return -1;
+    }
+    for (int i = 0; i < GPIOD_MAX_PINS; i++) {
+        g_pins[i].request = NULL;
+        g_pins[i].mode = -1;
+        g_pins[i].pull = HAL_PUD_OFF;
+        g_pins[i].debounce_us = 0;
+        g_pins[i].edges = 0;
+        g_pins[i].value = 0;
+    }
+    if (cfg->pwmchip) {
+        if (pwmOpen(cfg) < 0) {
+            gpiod_chip_close(g_chip);
+            g_chip = NULL;
+            return -1;
+        }
+    } else {
+        fprintf(stderr, "⚠️  No --pwmchip given: motor enable pin cannot be PWM driven\n");
+    }
+    return 0;
+}
+
+static void gpiodTerminate(void) {
+    if (g_pwm_enabled) {
+        sysfsWriteUL(g_pwm_dir, "duty_cycle", 0);
+        sysfsWrite(g_pwm_dir, "enable", "0");
+        g_pwm_enabled = 0;
+    }
+    for (int i = 0; i < GPIOD_MAX_PINS; i++) {
+        if (g_pins[i].request) {
+            gpiod_line_request_release(g_pins[i].request);
+            g_pins[i].request = NULL;
+        }
+    }
+    if (g_event_buffer) {
+        gpiod_edge_event_buffer_free(g_event_buffer);
+        g_event_buffer = NULL;
+    }
+    if (g_chip) {
+        gpiod_chip_close(g_chip);
+        g_chip = NULL;
+    }
+}
+
+static int gpiodSetMode(unsigned pin, unsigned mode) {
+    if (pin >= GPIOD_MAX_PINS) return -1;
+    // The PWM pin belongs to the PWM chip, not the GPIO character device
+    if (g_pwm_enabled && pin == g_pwm_pin) return 0;
+    g_pins[pin].mode = mode;
+    return pinApply(pin);
+}
+
+static int gpiodSetPull(unsigned pin, unsigned pud) {
+    if (pin >= GPIOD_MAX_PINS) return -1;
+    g_pins[pin].pull = pud;
+    return g_pins[pin].mode < 0 ? 0 : pinApply(pin);
+}
+
+static int gpiodRead(unsigned pin) {
+    if (pin >= GPIOD_MAX_PINS || !g_pins[pin].request) return -1;
+    return gpiod_line_request_get_value(g_pins[pin].request, pin) == GPIOD_LINE_VALUE_ACTIVE;
+}
+
+static int gpiodPWM(unsigned pin, unsigned duty) {
+    if (!g_pwm_enabled || pin != g_pwm_pin) return -1;
+    if (duty > g_pwm_range) duty = g_pwm_range;
+    unsigned long duty_ns = (unsigned long)((unsigned long long)g_pwm_period_ns * duty / g_pwm_range);
+    if (sysfsWriteUL(g_pwm_dir, "duty_cycle", duty_ns) < 0) return -1;
+    return sysfsWrite(g_pwm_dir, "enable", duty ? "1" : "0");
+}
+
+static int gpiodWrite(unsigned pin, unsigned level) {
+    if (pin >= GPIOD_MAX_PINS) return -1;
+    if (g_pwm_enabled && pin == g_pwm_pin) {
+        // Digital write on the PWM pin: fully on or off
+        return gpiodPWM(pin, level ? g_pwm_range : 0);
+    }
+    if (!g_pins[pin].request) return -1;
+    g_pins[pin].value = level ? 1 : 0;
+    return gpiod_line_request_set_value(g_pins[pin].request, pin,
+        level ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+}
+
+static int gpiodSetPWMFrequency(unsigned pin, unsigned hz) {
+    if (!g_pwm_enabled || pin != g_pwm_pin || hz == 0) return -1;
+    sysfsWriteUL(g_pwm_dir, "duty_cycle", 0);
+    g_pwm_period_ns = 1000000000UL / hz;
+    return sysfsWriteUL(g_pwm_dir, "period", g_pwm_period_ns);
+}
+
+static int gpiodSetPWMRange(unsigned pin, unsigned range) {
+    if (!g_pwm_enabled || pin != g_pwm_pin || range == 0) return -1;
+    g_pwm_range = range;
+    return 0;
+}
+
+// The sysfs channel already is hardware PWM; this only uses its full resolution
+static int gpiodHardwarePWM(unsigned pin, unsigned hz, unsigned duty) {
+    if (!g_pwm_enabled || pin != g_pwm_pin || hz == 0) return -1;
+    if (duty > HAL_HW_PWM_RANGE) duty = HAL_HW_PWM_RANGE;
+    unsigned long period_ns = 1000000000UL / hz;
+    if (period_ns != g_pwm_period_ns) {
+        sysfsWriteUL(g_pwm_dir, "duty_cycle", 0);
+        if (sysfsWriteUL(g_pwm_dir, "period", period_ns) < 0) return -1;
+        g_pwm_period_ns = period_ns;
+    }
+    unsigned long duty_ns = (unsigned long)((unsigned long long)period_ns * duty / HAL_HW_PWM_RANGE);
+    if (sysfsWriteUL(g_pwm_dir, "duty_cycle", duty_ns) < 0) return -1;
+    return sysfsWrite(g_pwm_dir, "enable", duty ? "1" : "0");
+}
+
+static int gpiodGlitchFilter(unsigned pin, unsigned steady_us) {
+    if (pin >= GPIOD_MAX_PINS) return -1;
+    // Kernel debounce is the character-device equivalent of pigpio's glitch filter
+    g_pins[pin].debounce_us = steady_us;
+    return g_pins[pin].mode < 0 ? 0 : pinApply(pin);
+}
+
+static uint32_t gpiodTick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static int gpiodEdgeCaptureStart(unsigned pin) {
+    if (pin >= GPIOD_MAX_PINS || g_pins[pin].mode != HAL_INPUT) return -1;
+    if (!g_event_buffer) {
+        g_event_buffer = gpiod_edge_event_buffer_new(GPIOD_EVENT_BATCH);
+        if (!g_event_buffer) return -1;
+    }
+    g_pins[pin].edges = 1;
+    return pinApply(pin);
+}
+
+static int gpiodWaitEdges(unsigned pin, hal_edge* edges, int max_edges, uint32_t timeout_us) {
+    if (pin >= GPIOD_MAX_PINS || !g_pins[pin].request || !g_pins[pin].edges) return -1;
+    struct gpiod_line_request* req = g_pins[pin].request;
+
+    int ready = gpiod_line_request_wait_edge_events(req, (int64_t)timeout_us * 1000);
+    if (ready <= 0) return ready;
+
+    if (max_edges > GPIOD_EVENT_BATCH) max_edges = GPIOD_EVENT_BATCH;
+    int n = gpiod_line_request_read_edge_events(req, g_event_buffer, max_edges);
+    for (int i = 0; i < n; i++) {
+        struct gpiod_edge_event* ev = gpiod_edge_event_buffer_get_event(g_event_buffer, i);
+        edges[i].tick = (uint32_t)(gpiod_edge_event_get_timestamp_ns(ev) / 1000);
+        edges[i].level = gpiod_edge_event_get_event_type(ev) == GPIOD_EDGE_EVENT_RISING_EDGE;
+    }
+    return n;
+}
+
+const motor_hal_ops motor_hal_gpiod = {
+    .name = "gpiod",
+    .init = gpiodInit,
+    .terminate = gpiodTerminate,
+    .set_mode = gpiodSetMode,
+    .set_pull = gpiodSetPull,
+    .read = gpiodRead,
+    .write = gpiodWrite,
+    .pwm = gpiodPWM,
+    .set_pwm_frequency = gpiodSetPWMFrequency,
+    .set_pwm_range = gpiodSetPWMRange,
+    .glitch_filter = gpiodGlitchFilter,
+    .tick = gpiodTick,
+    .hardware_pwm = gpiodHardwarePWM,
+    .edge_capture_start = gpiodEdgeCaptureStart,
+    .wait_edges = gpiodWaitEdges,
+};
+
+#endif // PARMCO_WITH_GPIOD
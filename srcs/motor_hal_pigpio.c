@@ -0,0 +1,222 @@
+/*
+ * motor_hal_pigpio.c
+ * HAL backend: pigpio linked into the control process.
+ *
+ * This is the original hardware path of motor_control_ble_pipe. It needs
+ * root, and gpioInitialise() takes over the DMA/PWM hardware for as long as
+ * the process runs.
+ *
+ * EDGE CAPTURE:
+ * pigpio's DMA engine samples GPIO 0-31 every 1-10 us (--sample-us, default
+ * 5) and hands the samples to a gpioSetGetSamplesFunc callback about once a
+ * millisecond. The callback turns each batch into edges with halScanEdges()
+ * and queues them per pin, so wait_edges gets DMA-exact timestamps with one
+ * wakeup per batch instead of polling gpioRead.
+ */
+
+#ifndef PARMCO_NO_PIGPIO
+
+#include <stdlib.h>
+#include <time.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <pigpio.h>
+#include "motor_hal.h"
+
+#define PIGPIO_CAPTURE_PINS 32     // Sample callback covers GPIO 0-31
+#define PIGPIO_EDGE_QUEUE   4096   // Per pin, ~16 ms of edges at 1 edge/4 us
+#define PIGPIO_SCAN_CHUNK   1024   // Samples scanned per halScanEdges() call
+
+typedef struct {
+    hal_edge* queue;       // PIGPIO_EDGE_QUEUE entries once capture started
+    unsigned head;         // Next write
+    unsigned tail;         // Next read
+    uint32_t last_level;   // Bank levels at the end of the previous batch
+} pigpio_capture;
+
+static pthread_mutex_t g_capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_capture_cond;
+static int g_capture_cond_ready = 0;
+static uint32_t g_capture_bits = 0;
+static pigpio_capture g_capture[PIGPIO_CAPTURE_PINS];
+
+static int pigpioInit(const motor_hal_config* cfg) {
+    if (cfg->sample_us) {
+        // Must precede gpioInitialise(); also sets the PWM/servo timing base
+        if (gpioCfgClock(cfg->sample_us, PI_CLOCK_PCM, 0) < 0) {
+            fprintf(stderr, "❌ Invalid --sample-us=%u (use 1, 2, 4, 5, 8 or 10)\n", cfg->sample_us);
+            return -1;
+        }
+    }
+    return gpioInitialise() < 0 ? -1 : 0;
+}
+
+static void pigpioTerminate(void) {
+    if (g_capture_bits) {
+        gpioSetGetSamplesFunc(NULL, 0);
+        g_capture_bits = 0;
+    }
+    gpioTerminate();
+    for (int i = 0; i < PIGPIO_CAPTURE_PINS; i++) {
+        free(g_capture[i].queue);
+        g_capture[i].queue = NULL;
+    }
+}
+
+static int pigpioSetMode(unsigned pin, unsigned mode) {
+    return gpioSetMode(pin, mode == HAL_OUTPUT ? PI_OUTPUT : PI_INPUT);
+}
+
+static int pigpioSetPull(unsigned pin, unsigned pud) {
+    unsigned p = PI_PUD_OFF;
+    if (pud == HAL_PUD_UP) p = PI_PUD_UP;
+    if (pud == HAL_PUD_DOWN) p = PI_PUD_DOWN;
+    return gpioSetPullUpDown(pin, p);
+}
+
+static int pigpioRead(unsigned pin) {
+    return gpioRead(pin);
+}
+
+static int pigpioWrite(unsigned pin, unsigned level) {
+    return gpioWrite(pin, level);
+}
+
+static int pigpioWriteBank(uint32_t set_bits, uint32_t clear_bits) {
+    if (clear_bits && gpioWrite_Bits_0_31_Clear(clear_bits) < 0) return -1;
+    if (set_bits && gpioWrite_Bits_0_31_Set(set_bits) < 0) return -1;
+    return 0;
+}
+
+static int pigpioPWM(unsigned pin, unsigned duty) {
+    return gpioPWM(pin, duty);
+}
+
+static int pigpioSetPWMFrequency(unsigned pin, unsigned hz) {
+    return gpioSetPWMfrequency(pin, hz);
+}
+
+static int pigpioGetPWMRealRange(unsigned pin) {
+    return gpioGetPWMrealRange(pin);
+}
+
+static int pigpioSetPWMRange(unsigned pin, unsigned range) {
+    return gpioSetPWMrange(pin, range);
+}
+
+static int pigpioGlitchFilter(unsigned pin, unsigned steady_us) {
+    return gpioGlitchFilter(pin, steady_us);
+}
+
+static uint32_t pigpioTick(void) {
+    return gpioTick();
+}
+
+static int pigpioHardwarePWM(unsigned pin, unsigned hz, unsigned duty) {
+    return gpioHardwarePWM(pin, hz, duty);
+}
+
+// Runs on pigpio's alert thread once per sample batch
+static void samplesCallback(const gpioSample_t* samples, int num_samples) {
+    static hal_edge found[PIGPIO_SCAN_CHUNK];
+    const hal_edge* batch = (const hal_edge*)samples;  // Same layout
+
+    pthread_mutex_lock(&g_capture_mutex);
+    int queued = 0;
+    for (unsigned pin = 0; pin < PIGPIO_CAPTURE_PINS; pin++) {
+        if (!(g_capture_bits & (1u << pin))) continue;
+        pigpio_capture* cap = &g_capture[pin];
+        for (int off = 0; off < num_samples; off += PIGPIO_SCAN_CHUNK) {
+            int n = num_samples - off < PIGPIO_SCAN_CHUNK ? num_samples - off : PIGPIO_SCAN_CHUNK;
+            int edges = halScanEdges(batch + off, n, 1u << pin, &cap->last_level, found);
+            for (int i = 0; i < edges; i++) {
+                cap->queue[cap->head % PIGPIO_EDGE_QUEUE] = found[i];
+                cap->head++;
+            }
+            queued += edges;
+        }
+        // Drop the oldest edges if the reader fell behind
+        if (cap->head - cap->tail > PIGPIO_EDGE_QUEUE) {
+            cap->tail = cap->head - PIGPIO_EDGE_QUEUE;
+        }
+    }
+    if (queued) pthread_cond_broadcast(&g_capture_cond);
+    pthread_mutex_unlock(&g_capture_mutex);
+}
+
+static int pigpioEdgeCaptureStart(unsigned pin) {
+    if (pin >= PIGPIO_CAPTURE_PINS) return -1;
+
+    pthread_mutex_lock(&g_capture_mutex);
+    if (!g_capture_cond_ready) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&g_capture_cond, &attr);
+        pthread_condattr_destroy(&attr);
+        g_capture_cond_ready = 1;
+    }
+    pigpio_capture* cap = &g_capture[pin];
+    if (!cap->queue) {
+        cap->queue = malloc(PIGPIO_EDGE_QUEUE * sizeof(hal_edge));
+        if (!cap->queue) {
+            pthread_mutex_unlock(&g_capture_mutex);
+            return -1;
+        }
+    }
+    cap->head = cap->tail = 0;
+    cap->last_level = gpioRead_Bits_0_31();
+    g_capture_bits |= 1u << pin;
+    uint32_t bits = g_capture_bits;
+    pthread_mutex_unlock(&g_capture_mutex);
+
+    return gpioSetGetSamplesFunc(samplesCallback, bits) < 0 ? -1 : 0;
+}
+
+static int pigpioWaitEdges(unsigned pin, hal_edge* edges, int max_edges, uint32_t timeout_us) {
+    if (pin >= PIGPIO_CAPTURE_PINS || !(g_capture_bits & (1u << pin))) return -1;
+    pigpio_capture* cap = &g_capture[pin];
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_us / 1000000;
+    deadline.tv_nsec += (long)(timeout_us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&g_capture_mutex);
+    while (cap->head == cap->tail) {
+        if (pthread_cond_timedwait(&g_capture_cond, &g_capture_mutex, &deadline) != 0) break;
+    }
+    int n = 0;
+    while (n < max_edges && cap->tail != cap->head) {
+        edges[n++] = cap->queue[cap->tail % PIGPIO_EDGE_QUEUE];
+        cap->tail++;
+    }
+    pthread_mutex_unlock(&g_capture_mutex);
+    return n;
+}
+
+const motor_hal_ops motor_hal_pigpio = {
+    .name = "pigpio",
+    .init = pigpioInit,
+    .terminate = pigpioTerminate,
+    .set_mode = pigpioSetMode,
+    .set_pull = pigpioSetPull,
+    .read = pigpioRead,
+    .write = pigpioWrite,
+    .pwm = pigpioPWM,
+    .set_pwm_frequency = pigpioSetPWMFrequency,
+    .set_pwm_range = pigpioSetPWMRange,
+    .get_pwm_real_range = pigpioGetPWMRealRange,
+    .glitch_filter = pigpioGlitchFilter,
+    .tick = pigpioTick,
+    .hardware_pwm = pigpioHardwarePWM,
+    .edge_capture_start = pigpioEdgeCaptureStart,
+    .wait_edges = pigpioWaitEdges,
+    .write_bank = pigpioWriteBank,
+};
+
+#endif // PARMCO_NO_PIGPIO
@@ -0,0 +1,136 @@
+/*
+ * motor_hal_pigpiod.c
+ * HAL backend: remote pigpio daemon through pigpiod_if2.
+ *
+ * The daemon owns the GPIO/DMA hardware; this process only holds a socket
+ * connection to it, so it needs no root, connects in milliseconds instead of
+ * running gpioInitialise(), and disconnecting (pigpio_stop) leaves PWM and
+ * pin state running. Combined with --adopt and --hold-on-exit in
+ * motor_control_ble_pipe this allows restarts and upgrades of the control
+ * program without stopping the motor.
+ *
+ * Build: add -DPARMCO_WITH_PIGPIOD ... -lpigpiod_if2
+ * Run:   sudo pigpiod   (once, e.g. systemctl enable --now pigpiod)
+ *        ./motor_control_ble_pipe --backend=pigpiod [--host=ADDR] [--port=PORT]
+ */
+
+#ifdef PARMCO_WITH_PIGPIOD
+
+#include <stdio.h>
+#include <pigpiod_if2.h>
+#include "motor_hal.h"
+
+static int g_pi = -1;  // pigpiod connection handle
+
+static int pigpiodInit(const motor_hal_config* cfg) {
+    // NULL host/port fall back to $PIGPIO_ADDR/$PIGPIO_PORT, then localhost:8888
+    g_pi = pigpio_start((char*)cfg->host, (char*)cfg->port);
+    if (g_pi < 0) {
+        fprintf(stderr, "❌ Cannot connect to pigpiod: %s\n", pigpio_error(g_pi));
+        fprintf(stderr, "   Is it running? Try: sudo pigpiod\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void pigpiodTerminate(void) {
+    if (g_pi >= 0) {
+        pigpio_stop(g_pi);
+        g_pi = -1;
+    }
+}
+
+static int pigpiodSetMode(unsigned pin, unsigned mode) {
+    return set_mode(g_pi, pin, mode == HAL_OUTPUT ? PI_OUTPUT : PI_INPUT);
+}
+
+static int pigpiodSetPull(unsigned pin, unsigned pud) {
+    unsigned p = PI_PUD_OFF;
+    if (pud == HAL_PUD_UP) p = PI_PUD_UP;
+    if (pud == HAL_PUD_DOWN) p = PI_PUD_DOWN;
+    return set_pull_up_down(g_pi, pin, p);
+}
+
+static int pigpiodRead(unsigned pin) {
+    return gpio_read(g_pi, pin);
+}
+
+static int pigpiodWrite(unsigned pin, unsigned level) {
+    return gpio_write(g_pi, pin, level);
+}
+
+static int pigpiodWriteBank(uint32_t set_bits, uint32_t clear_bits) {
+    if (clear_bits && clear_bank_1(g_pi, clear_bits) < 0) return -1;
+    if (set_bits && set_bank_1(g_pi, set_bits) < 0) return -1;
+    return 0;
+}
+
+static int pigpiodPWM(unsigned pin, unsigned duty) {
+    return set_PWM_dutycycle(g_pi, pin, duty);
+}
+
+static int pigpiodSetPWMFrequency(unsigned pin, unsigned hz) {
+    return set_PWM_frequency(g_pi, pin, hz);
+}
+
+static int pigpiodGetPWMRealRange(unsigned pin) {
+    return get_PWM_real_range(g_pi, pin);
+}
+
+static int pigpiodSetPWMRange(unsigned pin, unsigned range) {
+    return set_PWM_range(g_pi, pin, range);
+}
+
+static int pigpiodGlitchFilter(unsigned pin, unsigned steady_us) {
+    return set_glitch_filter(g_pi, pin, steady_us);
+}
+
+static uint32_t pigpiodTick(void) {
+    return get_current_tick(g_pi);
+}
+
+static int pigpiodGetMode(unsigned pin) {
+    int mode = get_mode(g_pi, pin);
+    if (mode < 0) return mode;
+    if (mode == PI_OUTPUT) return HAL_OUTPUT;
+    if (mode == PI_INPUT) return HAL_INPUT;
+    return HAL_ALT;
+}
+
+static int pigpiodGetPWM(unsigned pin) {
+    // PI_NOT_PWM_GPIO (< 0) when no PWM is active on the pin
+    return get_PWM_dutycycle(g_pi, pin);
+}
+
+static int pigpiodGetPWMFrequency(unsigned pin) {
+    // Hardware PWM reports the frequency hardware_PWM() set
+    return get_PWM_frequency(g_pi, pin);
+}
+
+static int pigpiodHardwarePWM(unsigned pin, unsigned hz, unsigned duty) {
+    return hardware_PWM(g_pi, pin, hz, duty);
+}
+
+const motor_hal_ops motor_hal_pigpiod = {
+    .name = "pigpiod",
+    .persistent = 1,
+    .init = pigpiodInit,
+    .terminate = pigpiodTerminate,
+    .set_mode = pigpiodSetMode,
+    .set_pull = pigpiodSetPull,
+    .read = pigpiodRead,
+    .write = pigpiodWrite,
+    .pwm = pigpiodPWM,
+    .set_pwm_frequency = pigpiodSetPWMFrequency,
+    .set_pwm_range = pigpiodSetPWMRange,
+    .get_pwm_real_range = pigpiodGetPWMRealRange,
+    .glitch_filter = pigpiodGlitchFilter,
+    .tick = pigpiodTick,
+    .get_mode = pigpiodGetMode,
+    .get_pwm = pigpiodGetPWM,
+    .get_pwm_frequency = pigpiodGetPWMFrequency,
+    .hardware_pwm = pigpiodHardwarePWM,
+    .write_bank = pigpiodWriteBank,
+};
+
+#endif // PARMCO_WITH_PIGPIOD
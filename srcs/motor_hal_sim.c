@@ -0,0 +1,517 @@
+/*
+ * motor_hal_sim.c
+ * HAL backend: simulated H-bridge, DC motor and IR blade sensor.
+ *
+ * Lets the whole control program (PID, pipes, BLE bridge) run on any Linux
+ * machine without GPIO hardware:
+ *   ./motor_control_ble_pipe --backend=sim
+ *
+ * Every motor in cfg->motors gets its own plant. The motors are not
+ * identical: motor k reaches g_sim_motor_gain[k] times SIM_MAX_RPM.
+ *
+ * PLANT MODEL:
+ * - Drive = PWM duty on the enable pin, signed by IN1/IN2 (IN1=IN2 = brake)
+ * - Steady-state speed is linear in duty above a breakaway duty:
+ *     rpm_ss = gain * SIM_MAX_RPM * (duty - SIM_BREAKAWAY) / (1 - SIM_BREAKAWAY)
+ * - PWM like pigpio's: software PWM snaps to the frequencies of the 5us
+ *   sample rate, with 200000 / freq real duty steps (25 at 8 kHz). The drive
+ *   loses SIM_SWITCH_S of every period to the bridge's switching, and at low
+ *   frequencies some torque to current ripple (SIM_RIPPLE_LOSS, worst at 50%
+ *   duty, fading above SIM_RIPPLE_HZ), which bends the speed/duty line
+ * - Static friction: a rotor at rest only breaks away above
+ *   g_sim_motor_stiction[k] duty; once turning it runs down to SIM_BREAKAWAY
+ * - First-order response with time constant SIM_TAU_S (SIM_BRAKE_TAU_S when braking)
+ * - Shaft angle is integrated from speed; the IR sensor reads HIGH while one
+ *   of cfg->blades blades covers it (SIM_BLADE_COVER of each blade sector)
+ * - Blades are not perfectly spaced: blade k sits g_sim_blade_offset[k]
+ *   sectors from its nominal position, like a real moulded propeller
+ * - Imbalance: motor k's speed ripples by g_sim_motor_imbalance[k] once per
+ *   revolution (the rotor speeds up and slows down around the shaft)
+ * - A second IR sensor (ir2_pin, optional) sits SIM_IR2_OFFSET blade sectors
+ *   behind the first: turning forward (IN1 high) a blade reaches the first
+ *   sensor, then the second
+ * - Faults (--sim-fault=KIND:AT_S[:FOR_S], motor 0, AT_S seconds after
+ *   start, for FOR_S seconds or for good): 'sensor' darkens the first IR
+ *   sensor (reads LOW, no edges), 'jam' locks the rotor within SIM_JAM_TAU_S,
+ *   'load' brakes it by SIM_LOAD_DUTY worth of duty (a load or airflow step)
+ *
+ * The model advances lazily on every call using the real monotonic clock, so
+ * sensor edges appear at the same wall-clock rate as on the real rig.
+ * With edge capture started, each sensor edge is timestamped at its exact
+ * (interpolated) crossing time, like a kernel or DMA timestamp would be.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "motor_hal.h"
+
+#define SIM_MAX_PINS      64
+#define SIM_MAX_RPM       6000.0
+#define SIM_BREAKAWAY     0.12    // Duty fraction below which the motor stalls
+#define SIM_SWITCH_S      1e-6    // Bridge switching time per PWM edge
+#define SIM_RIPPLE_LOSS   0.2     // Torque lost to current ripple at low PWM frequency (x duty x (1 - duty))
+#define SIM_RIPPLE_HZ     125.0   // PWM frequency where the ripple loss has halved
+#define SIM_PWM_BASE_HZ   200000  // pigpio software PWM: frequency x real range (5us samples)
+#define SIM_STUCK_RPM     5.0     // Below this the rotor is at rest (static friction)
+#define SIM_TAU_S         0.35    // Spin-up/coast time constant
+#define SIM_BRAKE_TAU_S   0.08    // Time constant with both H-bridge inputs equal
+#define SIM_JAM_TAU_S     0.02    // Time constant of a jamming rotor (--sim-fault=jam)
+#define SIM_LOAD_DUTY     0.10    // Duty fraction an added load takes (--sim-fault=load)
+#define SIM_BLADE_COVER   0.30    // Fraction of each blade sector that covers the sensor
+#define SIM_IR2_OFFSET    0.15    // Second sensor position, blade sectors behind the first
+#define SIM_MAX_STEP_US   200     // Integration step
+#define SIM_EDGE_QUEUE    1024    // Captured edges not yet fetched
+#define SIM_MAX_BLADES    16
+
+// Blade position error in blade sectors (blade 0 is the reference)
+static const double g_sim_blade_offset[SIM_MAX_BLADES] = {
+    0.0, 0.03, -0.025, 0.015, -0.02, 0.01, -0.015, 0.02,
+    -0.01, 0.025, -0.03, 0.005, -0.005, 0.02, -0.02, 0.01,
+};
+
+// Software PWM frequencies at the 5us sample rate (gpioSetPWMfrequency)
+static const unsigned g_sim_pwm_freqs[] = {
+    8000, 4000, 2000, 1600, 1000, 800, 500, 400, 320, 250, 200, 160, 100, 80, 50, 40, 20, 10,
+};
+
+// Speed of each motor relative to SIM_MAX_RPM (small manufacturing spread)
+static const double g_sim_motor_gain[HAL_MAX_MOTORS] = { 1.0, 0.94, 1.05, 0.9 };
+
+// Breakaway duty from rest of each motor (bearings and load differ)
+static const double g_sim_motor_stiction[HAL_MAX_MOTORS] = { 0.18, 0.22, 0.16, 0.25 };
+
+// Once-per-revolution speed ripple of each motor (fraction of the speed)
+static const double g_sim_motor_imbalance[HAL_MAX_MOTORS] = { 0.0, 0.01, 0.0, 0.005 };
+
+typedef struct {
+    int mode;
+    int level;
+    unsigned duty;
+    unsigned range;
+    unsigned freq;
+} sim_pin;
+
+typedef struct {
+    unsigned pin;
+    double offset;           // Position behind the first sensor, blade sectors
+    int level;
+
+    // Edge capture on the sensor pin
+    int capture;
+    hal_edge edges[SIM_EDGE_QUEUE];
+    unsigned edge_head;      // Next write
+    unsigned edge_tail;      // Next read
+} sim_sensor;
+
+typedef enum {
+    SIM_FAULT_NONE,
+    SIM_FAULT_SENSOR,        // First IR sensor dark
+    SIM_FAULT_JAM,           // Rotor locked
+    SIM_FAULT_LOAD,          // Extra braking load
+} sim_fault_kind;
+
+typedef struct {
+    hal_motor_wiring pins;
+    sim_fault_kind fault;    // --sim-fault, between fault_from and fault_to (model time)
+    uint64_t fault_from, fault_to;
+    double gain;             // g_sim_motor_gain of this motor
+    double imbalance;        // g_sim_motor_imbalance of this motor
+    double stiction;         // g_sim_motor_stiction of this motor
+    double rpm;              // Signed shaft speed
+    double angle;            // Shaft angle in revolutions [0, 1)
+    sim_sensor sensors[2];   // IR sensor, optional direction sensor
+    int num_sensors;
+} sim_motor;
+
+static pthread_mutex_t g_sim_mutex = PTHREAD_MUTEX_INITIALIZER;
+static motor_hal_config g_sim_cfg;
+static sim_pin g_sim_pins[SIM_MAX_PINS];
+static sim_motor g_sim_motors[HAL_MAX_MOTORS];
+static int g_sim_num_motors = 0;
+static uint64_t g_sim_time_us = 0;    // Model time
+
+static uint64_t simNowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// IR sensor on pin, or NULL
+static sim_sensor* simSensorByPin(unsigned pin) {
+    for (int k = 0; k < g_sim_num_motors; k++) {
+        for (int i = 0; i < g_sim_motors[k].num_sensors; i++) {
+            if (g_sim_motors[k].sensors[i].pin == pin) return &g_sim_motors[k].sensors[i];
+        }
+    }
+    return NULL;
+}
+
+// Injected fault of the motor at the current model time
+static sim_fault_kind simFault(const sim_motor* m) {
+    if (m->fault != SIM_FAULT_NONE && g_sim_time_us >= m->fault_from && g_sim_time_us < m->fault_to) {
+        return m->fault;
+    }
+    return SIM_FAULT_NONE;
+}
+
+// Target speed and time constant from the current pin state
+static void simDrive(const sim_motor* m, double* target_rpm, double* tau) {
+    const sim_pin* en = &g_sim_pins[m->pins.enable_pin];
+    int in1 = g_sim_pins[m->pins.in1_pin].level;
+    int in2 = g_sim_pins[m->pins.in2_pin].level;
+
+    double duty = en->range ? (double)en->duty / en->range : 0.0;
+    if (en->duty > 0 && en->freq > 0) {
+        // Real duty steps, switching and ripple losses (hardware PWM: no steps)
+        if (en->mode != HAL_ALT) {
+            double steps = (double)SIM_PWM_BASE_HZ / en->freq;
+            duty = round(duty * steps) / steps;
+        }
+        duty -= 2.0 * SIM_SWITCH_S * en->freq;
+        duty -= SIM_RIPPLE_LOSS * duty * (1.0 - duty) / (1.0 + en->freq / SIM_RIPPLE_HZ);
+        if (duty < 0.0) duty = 0.0;
+    }
+    if (en->duty == 0 && en->level) duty = 1.0;  // Digital HIGH on enable
+
+    if (simFault(m) == SIM_FAULT_JAM) {
+        *target_rpm = 0.0;
+        *tau = SIM_JAM_TAU_S;
+        return;
+    }
+    if (simFault(m) == SIM_FAULT_LOAD && in1 != in2) {
+        duty = duty > SIM_LOAD_DUTY ? duty - SIM_LOAD_DUTY : 0.0;
+    }
+    if (in1 == in2) {
+        *target_rpm = 0.0;
+        *tau = duty > 0.0 ? SIM_BRAKE_TAU_S : SIM_TAU_S;
+        return;
+    }
+    if (fabs(m->rpm) < SIM_STUCK_RPM && duty <= m->stiction) {
+        *target_rpm = 0.0;         // Held by static friction
+        *tau = SIM_BRAKE_TAU_S;
+        return;
+    }
+
+    double rpm = 0.0;
+    if (duty > SIM_BREAKAWAY) {
+        rpm = m->gain * SIM_MAX_RPM * (duty - SIM_BREAKAWAY) / (1.0 - SIM_BREAKAWAY);
+    }
+    *target_rpm = in1 ? rpm : -rpm;
+    *tau = SIM_TAU_S;
+}
+
+static int simBlades(void) {
+    if (g_sim_cfg.blades <= 0) return 1;
+    return g_sim_cfg.blades < SIM_MAX_BLADES ? g_sim_cfg.blades : SIM_MAX_BLADES;
+}
+
+// Leading edge of the blade nearest sector position 'base' (an integer)
+static double simBladeStart(double base) {
+    int blades = simBlades();
+    int k = (int)fmod(base, blades);
+    if (k < 0) k += blades;
+    return base + g_sim_blade_offset[k];
+}
+
+// IR sensor level at the current shaft angle
+static int simSensorLevel(const sim_motor* m, const sim_sensor* sensor) {
+    double sector = m->angle * simBlades() - sensor->offset;
+    // The covering blade is either this sector's or the previous one's
+    for (double base = floor(sector) - 1.0; base <= floor(sector) + 1.0; base += 1.0) {
+        double start = simBladeStart(base);
+        if (sector >= start && sector < start + SIM_BLADE_COVER) return 1;
+    }
+    return 0;
+}
+
+// Queue an edge for wait_edges (oldest edge is dropped when full)
+static void simQueueEdge(sim_sensor* sensor, uint32_t tick, int level) {
+    sensor->edges[sensor->edge_head % SIM_EDGE_QUEUE].tick = tick;
+    sensor->edges[sensor->edge_head % SIM_EDGE_QUEUE].level = level;
+    sensor->edge_head++;
+    if (sensor->edge_head - sensor->edge_tail > SIM_EDGE_QUEUE) {
+        sensor->edge_tail = sensor->edge_head - SIM_EDGE_QUEUE;
+    }
+}
+
+/*
+ * Time fraction of a step at which the sensor changed level. Blade edges sit
+ * at sector positions simBladeStart(k) and simBladeStart(k) + SIM_BLADE_COVER;
+ * a step is short enough to cross at most one of them.
+ */
+static double simCrossing(double s0, double s1) {
+    double lo = fmin(s0, s1), hi = fmax(s0, s1);
+    for (double base = floor(lo) - 1.0; base <= floor(lo) + 1.0; base += 1.0) {
+        double start = simBladeStart(base);
+        const double bounds[2] = { start, start + SIM_BLADE_COVER };
+        for (int i = 0; i < 2; i++) {
+            if (bounds[i] > lo && bounds[i] <= hi) {
+                return (bounds[i] - s0) / (s1 - s0);
+            }
+        }
+    }
+    return 1.0;
+}
+
+// Advance the plant model to 'now' (caller holds g_sim_mutex)
+static void simAdvance(uint64_t now) {
+    int blades = simBlades();
+    while (g_sim_time_us < now) {
+        uint64_t step = now - g_sim_time_us;
+        if (step > SIM_MAX_STEP_US) step = SIM_MAX_STEP_US;
+        double dt = step / 1e6;
+
+        for (int k = 0; k < g_sim_num_motors; k++) {
+            sim_motor* m = &g_sim_motors[k];
+            double target, tau;
+            simDrive(m, &target, &tau);
+            m->rpm += (target - m->rpm) * (1.0 - exp(-dt / tau));
+
+            double sector_before = m->angle * blades;
+            double ripple = 1.0 + m->imbalance * sin(2.0 * M_PI * m->angle);
+            m->angle += m->rpm * ripple / 60.0 * dt;
+            double sector_after = m->angle * blades;
+            m->angle -= floor(m->angle);
+
+            for (int i = 0; i < m->num_sensors; i++) {
+                sim_sensor* sensor = &m->sensors[i];
+                int level = simSensorLevel(m, sensor);
+                int dark = i == 0 && simFault(m) == SIM_FAULT_SENSOR;
+                if (dark) level = 0;
+                if (level != sensor->level && sensor->capture) {
+                    double frac = dark ? 1.0 : simCrossing(sector_before - sensor->offset,
+                                                           sector_after - sensor->offset);
+                    simQueueEdge(sensor, (uint32_t)(g_sim_time_us + (uint64_t)(frac * step)), level);
+                }
+                sensor->level = level;
+            }
+        }
+        g_sim_time_us += step;
+    }
+}
+
+static int simInit(const motor_hal_config* cfg) {
+    pthread_mutex_lock(&g_sim_mutex);
+    g_sim_cfg = *cfg;
+    memset(g_sim_pins, 0, sizeof(g_sim_pins));
+    for (int i = 0; i < SIM_MAX_PINS; i++) {
+        g_sim_pins[i].range = 255;
+        g_sim_pins[i].freq = 800;
+    }
+    memset(g_sim_motors, 0, sizeof(g_sim_motors));
+    g_sim_num_motors = cfg->num_motors > 0 ? cfg->num_motors : 1;
+    if (g_sim_num_motors > HAL_MAX_MOTORS) g_sim_num_motors = HAL_MAX_MOTORS;
+    for (int k = 0; k < g_sim_num_motors; k++) {
+        g_sim_motors[k].pins = cfg->motors[k];
+        g_sim_motors[k].gain = g_sim_motor_gain[k];
+        g_sim_motors[k].stiction = g_sim_motor_stiction[k];
+        g_sim_motors[k].imbalance = g_sim_motor_imbalance[k];
+        g_sim_motors[k].sensors[0].pin = cfg->motors[k].ir_pin;
+        g_sim_motors[k].num_sensors = 1;
+        if (cfg->motors[k].ir2_pin != HAL_NO_PIN) {
+            g_sim_motors[k].sensors[1].pin = cfg->motors[k].ir2_pin;
+            g_sim_motors[k].sensors[1].offset = SIM_IR2_OFFSET;
+            g_sim_motors[k].num_sensors = 2;
+        }
+        for (int i = 0; i < g_sim_motors[k].num_sensors; i++) {
+            g_sim_motors[k].sensors[i].level = simSensorLevel(&g_sim_motors[k], &g_sim_motors[k].sensors[i]);
+        }
+    }
+    g_sim_time_us = simNowUs();
+
+    // Injected fault: KIND:AT_S[:FOR_S]
+    if (cfg->sim_fault) {
+        char kind[16];
+        double at = 0.0, length = -1.0;
+        sim_motor* m = &g_sim_motors[0];
+        if (sscanf(cfg->sim_fault, "%15[a-z]:%lf:%lf", kind, &at, &length) >= 2 &&
+            (strcmp(kind, "sensor") == 0 || strcmp(kind, "jam") == 0 || strcmp(kind, "load") == 0)) {
+            m->fault = strcmp(kind, "jam") == 0 ? SIM_FAULT_JAM :
+                       strcmp(kind, "load") == 0 ? SIM_FAULT_LOAD : SIM_FAULT_SENSOR;
+            m->fault_from = g_sim_time_us + (uint64_t)(at * 1e6);
+            m->fault_to = length >= 0.0 ? m->fault_from + (uint64_t)(length * 1e6) : UINT64_MAX;
+        } else {
+            fprintf(stderr, "⚠️  Ignoring --sim-fault=%s (use sensor|jam|load:AT_S[:FOR_S])\n", cfg->sim_fault);
+        }
+    }
+    pthread_mutex_unlock(&g_sim_mutex);
+    for (int k = 0; k < g_sim_num_motors; k++) {
+        printf("✓ Simulated motor %d: %.0f RPM max, %d blades%s\n", k,
+               g_sim_motor_gain[k] * SIM_MAX_RPM, cfg->blades,
+               g_sim_motors[k].num_sensors > 1 ? ", direction sensor" : "");
+    }
+    return 0;
+}
+
+static void simTerminate(void) {
+}
+
+static int simSetMode(unsigned pin, unsigned mode) {
+    if (pin >= SIM_MAX_PINS) return -1;
+    pthread_mutex_lock(&g_sim_mutex);
+    g_sim_pins[pin].mode = mode;
+    pthread_mutex_unlock(&g_sim_mutex);
+    return 0;
+}
+
+static int simSetPull(unsigned pin, unsigned pud) {
+    (void)pud;
+    return pin < SIM_MAX_PINS ? 0 : -1;
+}
+
+static int simRead(unsigned pin) {
+    if (pin >= SIM_MAX_PINS) return -1;
+    pthread_mutex_lock(&g_sim_mutex);
+    simAdvance(simNowUs());
+    const sim_sensor* sensor = simSensorByPin(pin);
+    int level = sensor ? sensor->level : g_sim_pins[pin].level;
+    pthread_mutex_unlock(&g_sim_mutex);
+    return level;
+}
+
+static int simWrite(unsigned pin, unsigned level) {
+    if (pin >= SIM_MAX_PINS) return -1;
+    pthread_mutex_lock(&g_sim_mutex);
+    simAdvance(simNowUs());
+    g_sim_pins[pin].level = level ? 1 : 0;
+    g_sim_pins[pin].duty = 0;
+    pthread_mutex_unlock(&g_sim_mutex);
+    return 0;
+}
+
+static int simWriteBank(uint32_t set_bits, uint32_t clear_bits) {
+    pthread_mutex_lock(&g_sim_mutex);
+    simAdvance(simNowUs());
+    for (unsigned pin = 0; pin < 32 && pin < SIM_MAX_PINS; pin++) {
+        if (((set_bits | clear_bits) >> pin) & 1u) {
+            g_sim_pins[pin].level = (set_bits >> pin) & 1u;
+            g_sim_pins[pin].duty = 0;
+        }
+    }
+    pthread_mutex_unlock(&g_sim_mutex);
+    return 0;
+}
+
+static int simPWM(unsigned pin, unsigned duty) {
+    if (pin >= SIM_MAX_PINS) return -1;
+    pthread_mutex_lock(&g_sim_mutex);
+    simAdvance(simNowUs());
+    if (duty > g_sim_pins[pin].range) duty = g_sim_pins[pin].range;
+    g_sim_pins[pin].duty = duty;
+    g_sim_pins[pin].level = duty > 0;
+    pthread_mutex_unlock(&g_sim_mutex);
+    return 0;
+}
+
+static int simSetPWMFrequency(unsigned pin, unsigned hz) {
+    if (pin >= SIM_MAX_PINS) return -1;
+    // Nearest available frequency, like pigpio
+    unsigned best = g_sim_pwm_freqs[0];
+    for (size_t i = 0; i < sizeof(g_sim_pwm_freqs) / sizeof(g_sim_pwm_freqs[0]); i++) {
+        if (abs((int)g_sim_pwm_freqs[i] - (int)hz) < abs((int)best - (int)hz)) best = g_sim_pwm_freqs[i];
+    }
+    pthread_mutex_lock(&g_sim_mutex);
+    simAdvance(simNowUs());
+    g_sim_pins[pin].freq = best;
+    pthread_mutex_unlock(&g_sim_mutex);
+    return (int)best;
+}
+
+static int simGetPWMRealRange(unsigned pin) {
+    if (pin >= SIM_MAX_PINS) return -1;
+    pthread_mutex_lock(&g_sim_mutex);
+    int range = g_sim_pins[pin].mode == HAL_ALT ? HAL_HW_PWM_RANGE
+                                               : (int)(SIM_PWM_BASE_HZ / g_sim_pins[pin].freq);
+    pthread_mutex_unlock(&g_sim_mutex);
+    return range;
+}
+
+static int simSetPWMRange(unsigned pin, unsigned range) {
+    if (pin >= SIM_MAX_PINS || range == 0) return -1;
+    pthread_mutex_lock(&g_sim_mutex);
+    g_sim_pins[pin].range = range;
+    pthread_mutex_unlock(&g_sim_mutex);
+    return 0;
+}
+
+static int simHardwarePWM(unsigned pin, unsigned hz, unsigned duty) {
+    if (pin >= SIM_MAX_PINS || hz == 0) return -1;
+    pthread_mutex_lock(&g_sim_mutex);
+    simAdvance(simNowUs());
+    if (duty > HAL_HW_PWM_RANGE) duty = HAL_HW_PWM_RANGE;
+    g_sim_pins[pin].mode = HAL_ALT;
+    g_sim_pins[pin].range = HAL_HW_PWM_RANGE;
+    g_sim_pins[pin].duty = duty;
+    g_sim_pins[pin].freq = hz;
+    g_sim_pins[pin].level = duty > 0;
+    pthread_mutex_unlock(&g_sim_mutex);
+    return 0;
+}
+
+static int simGlitchFilter(unsigned pin, unsigned steady_us) {
+    (void)steady_us;
+    return pin < SIM_MAX_PINS ? 0 : -1;
+}
+
+static uint32_t simTick(void) {
+    return (uint32_t)simNowUs();
+}
+
+static int simEdgeCaptureStart(unsigned pin) {
+    sim_sensor* sensor = simSensorByPin(pin);
+    if (sensor == NULL) return -1;
+    pthread_mutex_lock(&g_sim_mutex);
+    simAdvance(simNowUs());
+    sensor->capture = 1;
+    sensor->edge_head = sensor->edge_tail = 0;
+    pthread_mutex_unlock(&g_sim_mutex);
+    return 0;
+}
+
+static int simWaitEdges(unsigned pin, hal_edge* edges, int max_edges, uint32_t timeout_us) {
+    sim_sensor* sensor = simSensorByPin(pin);
+    if (sensor == NULL || !sensor->capture) return -1;
+    uint64_t deadline = simNowUs() + timeout_us;
+    int n = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&g_sim_mutex);
+        simAdvance(simNowUs());
+        while (n < max_edges && sensor->edge_tail != sensor->edge_head) {
+            edges[n++] = sensor->edges[sensor->edge_tail % SIM_EDGE_QUEUE];
+            sensor->edge_tail++;
+        }
+        pthread_mutex_unlock(&g_sim_mutex);
+
+        uint64_t now = simNowUs();
+        if (n > 0 || now >= deadline) return n;
+        // Nothing yet: sleep a little (the model has no interrupts to wait on)
+        uint64_t nap = deadline - now;
+        usleep(nap < 500 ? (useconds_t)nap : 500);
+    }
+}
+
+const motor_hal_ops motor_hal_sim = {
+    .name = "sim",
+    .init = simInit,
+    .terminate = simTerminate,
+    .set_mode = simSetMode,
+    .set_pull = simSetPull,
+    .read = simRead,
+    .write = simWrite,
+    .pwm = simPWM,
+    .set_pwm_frequency = simSetPWMFrequency,
+    .set_pwm_range = simSetPWMRange,
+    .get_pwm_real_range = simGetPWMRealRange,
+    .glitch_filter = simGlitchFilter,
+    .tick = simTick,
+    .hardware_pwm = simHardwarePWM,
+    .edge_capture_start = simEdgeCaptureStart,
+    .wait_edges = simWaitEdges,
+    .write_bank = simWriteBank,
+};
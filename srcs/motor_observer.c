@@ -0,0 +1,113 @@
+/*
+ * motor_observer.c
+ * Disturbance observer. See motor_observer.h.
+ */
+
+#include <math.h>
+#include "motor_observer.h"
+
+/**
+ * RESET
+ * Stops observing; the duty history is kept.
+ */
+void motorObserverReset(motor_observer* o) {
+    o->active = 0;
+    o->settled = 0;
+    o->estimate = 0.0;
+    o->base = 0.0;
+    o->compensation = 0.0;
+}
+
+/**
+ * APPLIED DUTY
+ * Records a change of the duty the bridge drives with.
+ */
+void motorObserverDuty(motor_observer* o, double duty, uint32_t now) {
+    if (o->num_duties > 0 && o->duties[(o->num_duties - 1) % OBS_DUTY_HISTORY] == duty) {
+        return;
+    }
+    o->duty_ticks[o->num_duties % OBS_DUTY_HISTORY] = now;
+    o->duties[o->num_duties % OBS_DUTY_HISTORY] = duty;
+    o->num_duties++;
+}
+
+/*
+ * Mean applied duty from 'from' to 'to' (the oldest kept duty before the
+ * history, the newest after it)
+ */
+static double dutyAverage(const motor_observer* o, uint32_t from, uint32_t to) {
+    unsigned long n = o->num_duties < OBS_DUTY_HISTORY ? o->num_duties : OBS_DUTY_HISTORY;
+    unsigned long first = o->num_duties - n;
+    double span = (uint32_t)(to - from);
+    double sum = 0.0;
+    if (n == 0) {
+        return 0.0;
+    }
+    for (unsigned long k = first; k < o->num_duties; k++) {
+        double duty = o->duties[k % OBS_DUTY_HISTORY];
+        double begin = k == first ? -INFINITY : (int32_t)(o->duty_ticks[k % OBS_DUTY_HISTORY] - from);
+        double end = k + 1 == o->num_duties ? INFINITY : (int32_t)(o->duty_ticks[(k + 1) % OBS_DUTY_HISTORY] - from);
+        if (span <= 0.0) {
+            if (begin <= 0.0 && end > 0.0) return duty;   // Duty at 'to'
+            continue;
+        }
+        begin = fmax(begin, 0.0);
+        end = fmin(end, span);
+        if (end > begin) sum += duty * (end - begin);
+    }
+    return span > 0.0 ? sum / span : o->duties[(o->num_duties - 1) % OBS_DUTY_HISTORY];
+}
+
+/*
+ * Q time constant: OBS_Q_REVS revolutions at rpm, within OBS_MIN_Q_MS..OBS_MAX_Q_MS
+ */
+static double qTime(double rpm) {
+    double q_ms = rpm > 0.0 ? OBS_Q_REVS * 60e3 / rpm : OBS_MAX_Q_MS;
+    return fmin(fmax(q_ms, OBS_MIN_Q_MS), OBS_MAX_Q_MS) / 1000.0;
+}
+
+/**
+ * UPDATE
+ * @param rpm: Speed over the newest revolution, along the drive direction
+ * @param rpm_tick: halTick() in the middle of that revolution
+ * @return Compensation to add to the duty, %
+ */
+double motorObserverUpdate(motor_observer* o, const motor_observer_model* m, double rpm, uint32_t rpm_tick) {
+    double dt = (int32_t)(rpm_tick - o->last_tick) / 1e6;
+    if (o->active && dt <= 0.0) {
+        return o->compensation;                // No new revolution
+    }
+    if (!o->active || dt > OBS_MAX_GAP_MS / 1000.0) {
+        // Start as if steady: the filters settle within a few Q
+        motorObserverReset(o);
+        o->active = 1;
+        o->since = o->last_tick = rpm_tick;
+        o->q_s = qTime(rpm);
+        o->rpm_q = rpm;
+        o->duty_q = dutyAverage(o, rpm_tick, rpm_tick) - m->sustain;
+        o->estimate = o->base = o->duty_q - rpm / m->slope;
+        return 0.0;
+    }
+
+    o->q_s = qTime(rpm);
+    double a = 1.0 - exp(-dt / o->q_s);
+    double u = dutyAverage(o, o->last_tick, rpm_tick) - m->sustain;
+    double rpm_q = o->rpm_q + a * (rpm - o->rpm_q);
+    double accel_q = (rpm_q - o->rpm_q) / dt;
+    o->rpm_q = rpm_q;
+    o->duty_q += a * (u - o->duty_q);
+    o->last_tick = rpm_tick;
+    o->estimate = o->duty_q - (m->tau * accel_q + rpm_q) / m->slope;
+
+    if (!o->settled) {
+        o->base = o->estimate;
+        o->settled = (uint32_t)(rpm_tick - o->since) >= OBS_SETTLE_Q * o->q_s * 1e6 &&
+                     fabs(accel_q) <= OBS_SETTLE_ACCEL;
+        return 0.0;
+    }
+    // Hand the load over to the PID: the base follows the estimate slowly,
+    // so the compensation returns to 0 once the PID has taken the new duty
+    o->base += (1.0 - exp(-dt / OBS_HANDOFF_S)) * (o->estimate - o->base);
+    o->compensation = fmin(fmax(o->estimate - o->base, -OBS_MAX_DUTY), OBS_MAX_DUTY);
+    return o->compensation;
+}
@@ -0,0 +1,89 @@
+/*
+ * motor_observer.h
+ * Disturbance observer: load changes rejected within a few blade passes.
+ *
+ * A step in airflow or load changes the duty a speed needs. The PID only
+ * sees it as a speed error, and with its small KI and the hold after each
+ * change it takes seconds to find the new duty. The observer instead asks
+ * the plant model what duty explains the speed it measures, and adds the
+ * difference to the PID's output directly.
+ *
+ * MODEL (first order, duty % -> RPM):
+ *   tau dw/dt + w = slope (u - sustain - d)
+ * slope and sustain are the learned speed/duty line (motor_start.h), tau
+ * the time constant 'sysid' fitted (motor_sysid.h). d is the load in duty
+ * %: what the model misses.
+ *
+ * ESTIMATE:
+ * Inverting the model needs dw/dt, so both sides pass the same low-pass Q
+ * (time constant OBS_Q_REVS revolutions, OBS_MIN_Q_MS to OBS_MAX_Q_MS):
+ *   d = Q(u - sustain) - (tau d/dt Q(w) + Q(w)) / slope
+ * The speed is the high rate one: one revolution of raw IR edges, timed at
+ * its middle (blade spacing errors cancel). The duty is averaged over the
+ * same interval from the history of applied duties, so the observer's own
+ * compensation cancels out of the estimate instead of feeding back. A load
+ * step shows in the estimate after about a revolution and Q: a few blade
+ * passes.
+ *
+ * COMPENSATION:
+ * The model's static error (the speed/duty line is not exact) is part of d
+ * and the PID has already absorbed it, so what is added to the duty is the
+ * change of d since the observer settled (OBS_SETTLE_Q time constants of Q
+ * after it began, once the speed changes slower than OBS_SETTLE_ACCEL: the
+ * line fits least at the kickstart), at most +-OBS_MAX_DUTY. That reference
+ * then follows d with time constant OBS_HANDOFF_S: a load step is rejected
+ * at once and handed over to the PID within seconds, and in steady state
+ * the compensation is 0. A lasting one would sit between the PID's whole
+ * percent steps and, wherever the line is off, move with each of them: the
+ * loop would hunt.
+ *
+ * Call motorObserverDuty() with every duty applied, and motorObserverUpdate()
+ * with every new revolution speed (every OBS_STEP_MS). All times are halTick()
+ * microseconds (wrapping 32-bit counter).
+ */
+
+#ifndef MOTOR_OBSERVER_H
+#define MOTOR_OBSERVER_H
+
+#include <stdint.h>
+
+#define OBS_STEP_MS           5       // Update period while observing
+#define OBS_Q_REVS            1.0     // Q filter time constant in revolutions
+#define OBS_MIN_Q_MS          10.0
+#define OBS_MAX_Q_MS          100.0
+#define OBS_SETTLE_Q          5.0     // Q time constants before compensating
+#define OBS_SETTLE_ACCEL      500.0   // ... and at most this RPM/s
+#define OBS_MAX_DUTY          25.0    // Compensation limit, duty %
+#define OBS_HANDOFF_S         5.0     // Compensation decay as the PID takes over, s
+#define OBS_MAX_GAP_MS        200     // Speed samples further apart start over
+#define OBS_DUTY_HISTORY      16      // Applied duties kept
+
+typedef struct {
+    double slope;              // Steady RPM per duty % above sustain
+    double sustain;            // Duty %
+    double tau;                // Speed time constant, s
+} motor_observer_model;
+
+typedef struct {
+    int active;                // Running since 'since'
+    uint32_t since;
+    uint32_t last_tick;        // Last speed sample (middle of its revolution)
+    double q_s;                // Q time constant now
+    double rpm_q;              // Q(w)
+    double duty_q;             // Q(u - sustain)
+    double estimate;           // Load d, duty %
+    double base;               // d when the observer settled, then following it slowly
+    int settled;
+    double compensation;       // Added to the duty, %
+
+    // Applied duties, oldest first in the ring
+    uint32_t duty_ticks[OBS_DUTY_HISTORY];
+    double duties[OBS_DUTY_HISTORY];
+    unsigned long num_duties;
+} motor_observer;
+
+void motorObserverReset(motor_observer* o);
+void motorObserverDuty(motor_observer* o, double duty, uint32_t now);
+double motorObserverUpdate(motor_observer* o, const motor_observer_model* m, double rpm, uint32_t rpm_tick);
+
+#endif // MOTOR_OBSERVER_H
@@ -0,0 +1,77 @@
+/*
+ * motor_profile.c
+ * Learned per-motor parameters. See motor_profile.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "motor_profile.h"
+
+/**
+ * LOAD PROFILES
+ * Clears profiles[0..num_motors-1], then fills in the values found in path.
+ *
+ * @return Number of values read, or -1 if the file cannot be opened
+ */
+int motorProfileLoad(const char* path, motor_profile* profiles, int num_motors) {
+    memset(profiles, 0, sizeof(*profiles) * num_motors);
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    char line[128];
+    int values = 0;
+    while (fgets(line, sizeof(line), f)) {
+        int motor;
+        char key[32];
+        double value;
+        if (sscanf(line, "m%d %31s %lf", &motor, key, &value) != 3 ||
+            motor < 0 || motor >= num_motors || value < 0.0) {
+            continue;
+        }
+        motor_profile* p = &profiles[motor];
+        if (strcmp(key, "breakaway") == 0) p->breakaway = value;
+        else if (strcmp(key, "sustain") == 0) p->sustain = value;
+        else if (strcmp(key, "slope") == 0) p->slope = value;
+        else if (strcmp(key, "tau") == 0) p->tau = value;
+        else if (strcmp(key, "starts") == 0) p->starts = (unsigned long)value;
+        else if (strcmp(key, "pwm_freq") == 0) p->pwm_freq = (unsigned)value;
+        else continue;
+        values++;
+    }
+    fclose(f);
+    return values;
+}
+
+/**
+ * SAVE PROFILES
+ * @return 0 on success, -1 on error
+ */
+int motorProfileSave(const char* path, const motor_profile* profiles, int num_motors) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "w");
+    if (!f) {
+        return -1;
+    }
+
+    fprintf(f, "# parmco learned motor parameters\n");
+    for (int m = 0; m < num_motors; m++) {
+        const motor_profile* p = &profiles[m];
+        if (p->breakaway > 0.0) fprintf(f, "m%d breakaway %.2f\n", m, p->breakaway);
+        if (p->sustain > 0.0) fprintf(f, "m%d sustain %.2f\n", m, p->sustain);
+        if (p->slope > 0.0) fprintf(f, "m%d slope %.3f\n", m, p->slope);
+        if (p->tau > 0.0) fprintf(f, "m%d tau %.3f\n", m, p->tau);
+        if (p->starts > 0) fprintf(f, "m%d starts %lu\n", m, p->starts);
+        if (p->pwm_freq > 0) fprintf(f, "m%d pwm_freq %u\n", m, p->pwm_freq);
+    }
+
+    int ok = fflush(f) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
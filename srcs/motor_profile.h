@@ -0,0 +1,38 @@
+/*
+ * motor_profile.h
+ * Learned per-motor parameters, kept in a small text file across restarts.
+ *
+ * Each line holds one value of one motor:
+ *
+ *   # parmco learned motor parameters
+ *   m0 breakaway 17.8
+ *   m0 sustain 12.1
+ *   m0 slope 68.3
+ *   m0 tau 0.352
+ *   m0 starts 42
+ *   m0 pwm_freq 1600
+ *
+ * Unknown keys and malformed lines are skipped, so files written by other
+ * versions still load. A missing value reads as 0 (not learned yet). The
+ * file is rewritten through a temporary file and rename(), so a crash while
+ * saving leaves the previous version.
+ */
+
+#ifndef MOTOR_PROFILE_H
+#define MOTOR_PROFILE_H
+
+#define PROFILE_PATH  "/var/tmp/parmco_motors.conf"   // Default (--profile=PATH); survives reboots
+
+typedef struct {
+    double breakaway;          // Duty % that starts the rotor from standstill (0 = unknown)
+    double sustain;            // Lowest duty % that keeps it turning (0 = unknown)
+    double slope;              // Steady RPM per duty % above sustain (0 = unknown)
+    double tau;                // Speed time constant from 'sysid', s (0 = unknown)
+    unsigned long starts;      // Starts measured
+    unsigned pwm_freq;         // Software PWM frequency chosen by 'pwm sweep', Hz (0 = default)
+} motor_profile;
+
+int motorProfileLoad(const char* path, motor_profile* profiles, int num_motors);
+int motorProfileSave(const char* path, const motor_profile* profiles, int num_motors);
+
+#endif // MOTOR_PROFILE_H
@@ -0,0 +1,189 @@
+/*
+ * motor_start.c
+ * Kickstart and breakaway/sustain learning. See motor_start.h.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "motor_start.h"
+
+/**
+ * BEGIN A START FROM STANDSTILL
+ * @param target: Duty % to apply once the rotor moves
+ * @param edges: IR edges counted so far (any polarity)
+ * @param edge_tick: Timestamp of the newest of them
+ */
+void motorStartBegin(motor_start* st, double target, unsigned long edges, uint32_t edge_tick,
+                     uint32_t now) {
+    double breakaway = st->profile.breakaway;
+    st->active = 1;
+    st->t0 = now;
+    st->from = breakaway > 0.0 ? fmax(START_FLOOR, breakaway - START_WINDOW) : START_FLOOR;
+    st->duty = st->from;
+    st->target = target;
+    st->edges0 = edges;
+    st->coasting = edges > 0 && (uint32_t)(now - edge_tick) <= START_CONFIRM_MS * 1000u;
+    st->first_seen = 0;
+}
+
+/*
+ * Average a new breakaway measurement into the profile
+ */
+static void learnBreakaway(motor_start* st, double measured) {
+    motor_profile* p = &st->profile;
+    p->breakaway = p->breakaway > 0.0 ? p->breakaway + START_ALPHA * (measured - p->breakaway)
+                                      : measured;
+    p->starts++;
+    st->last_breakaway = measured;
+}
+
+/**
+ * START STEP
+ * Call every few milliseconds while st->active with the latest IR edge
+ * count and the timestamp of the newest edge.
+ *
+ * @param duty: Receives the duty % to apply now
+ */
+motor_start_result motorStartStep(motor_start* st, unsigned long edges, uint32_t edge_tick,
+                                  uint32_t now, double* duty) {
+    double t = (uint32_t)(now - st->t0) / 1e6;
+
+    // Motion: an edge confirmed by another soon after it
+    int moving = 0;
+    if (edges != st->edges0) {
+        if (!st->first_seen) {
+            st->first_seen = 1;
+            st->first_edges = edges;
+            st->first_tick = edge_tick;
+            moving = edges - st->edges0 >= 2;  // Several in one batch
+        } else if (edges != st->first_edges) {
+            if ((uint32_t)(edge_tick - st->first_tick) <= START_CONFIRM_MS * 1000u) {
+                moving = 1;
+            } else {
+                // Stale first edge (the rotor only rocked): start over from this one
+                st->first_edges = edges;
+                st->first_tick = edge_tick;
+            }
+        }
+    }
+
+    if (moving) {
+        st->active = 0;
+        *duty = st->target;
+        double t_first = (int32_t)(st->first_tick - st->t0) / 1e6;
+        if (t_first < 0.0) t_first = 0.0;
+        st->last_ms = (uint32_t)(edge_tick - st->t0) / 1000.0;
+        if (st->coasting) {
+            return START_MOVING;  // Was still turning: the ramp measured nothing
+        }
+        if (t_first * 1000.0 < START_MIN_MS) {
+            // Moved from rest at once: the breakaway is lower than the ramp
+            // start, let the next ramp start a little lower
+            if (st->profile.breakaway > 0.0) {
+                st->profile.breakaway -= START_ALPHA * START_WINDOW;
+                if (st->profile.breakaway < START_FLOOR) st->profile.breakaway = START_FLOOR;
+            }
+            return START_MOVING;
+        }
+        // The rotor left rest before the first edge: about as long before it
+        // as the next edge took (it had to travel to the blade first)
+        double t_onset = t_first - (uint32_t)(edge_tick - st->first_tick) / 1e6;
+        if (t_onset < 0.0) t_onset = 0.0;
+        learnBreakaway(st, fmin(st->from + START_RAMP * t_onset, 100.0));
+        return START_DONE;
+    }
+
+    if (t * 1000.0 > START_TIMEOUT_MS) {
+        st->active = 0;
+        *duty = st->target;
+        return START_STALLED;
+    }
+
+    st->duty = fmin(st->from + START_RAMP * t, 100.0);
+    *duty = st->duty;
+    return START_RUNNING;
+}
+
+/*
+ * Least-squares line through the steady points: sustain = zero crossing
+ */
+static int fitSustain(motor_start* st) {
+    int n = st->num_points;
+    double lo = 100.0, hi = 0.0, md = 0.0, mr = 0.0;
+    for (int i = 0; i < n; i++) {
+        lo = fmin(lo, st->point_duty[i]);
+        hi = fmax(hi, st->point_duty[i]);
+        md += st->point_duty[i] / n;
+        mr += st->point_rpm[i] / n;
+    }
+    if (n < 2 || hi - lo < SUSTAIN_MIN_SPREAD) {
+        return 0;
+    }
+    double sdd = 0.0, sdr = 0.0;
+    for (int i = 0; i < n; i++) {
+        sdd += (st->point_duty[i] - md) * (st->point_duty[i] - md);
+        sdr += (st->point_duty[i] - md) * (st->point_rpm[i] - mr);
+    }
+    double slope = sdr / sdd;
+    if (slope <= 0.0) {
+        return 0;
+    }
+    double sustain = md - mr / slope;
+    if (sustain < 0.0 || sustain > 100.0) {
+        return 0;
+    }
+    st->profile.sustain = sustain;
+    st->profile.slope = slope;
+    return 1;
+}
+
+/**
+ * STEADY OPERATING POINT
+ * Call every control cycle with the applied duty and the speed along the
+ * driven direction.
+ *
+ * @return 1 if the sustain duty and slope were refitted
+ */
+int motorStartSteady(motor_start* st, double duty, double rpm, double accel, uint32_t now) {
+    if (st->active || duty <= 0.0) {
+        st->steady_duty = -1.0;
+        return 0;
+    }
+    if (duty != st->steady_duty) {
+        st->steady_duty = duty;
+        st->steady_since = now;
+        st->steady_taken = 0;
+        return 0;
+    }
+    if (st->steady_taken || (uint32_t)(now - st->steady_since) < SUSTAIN_SETTLE_MS * 1000u ||
+        fabs(accel) > SUSTAIN_MAX_ACCEL || rpm <= 0.0) {
+        return 0;
+    }
+
+    st->steady_taken = 1;
+    st->point_duty[st->next_point] = duty;
+    st->point_rpm[st->next_point] = rpm;
+    st->next_point = (st->next_point + 1) % SUSTAIN_POINTS;
+    if (st->num_points < SUSTAIN_POINTS) st->num_points++;
+    return fitSustain(st);
+}
+
+/**
+ * LOW-END CLAMP
+ * @return Lowest duty % that keeps the rotor turning, 0 while unknown
+ */
+double motorStartMinDuty(const motor_start* st) {
+    return st->profile.sustain > 0.0 ? fmin(st->profile.sustain + START_MARGIN, 100.0) : 0.0;
+}
+
+/**
+ * FEEDFORWARD DUTY
+ * @return Duty % expected to hold rpm, 0 while the fit is unknown
+ */
+double motorStartDutyFor(const motor_start* st, double rpm) {
+    const motor_profile* p = &st->profile;
+    if (p->sustain <= 0.0 || p->slope <= 0.0) {
+        return 0.0;
+    }
+    return fmin(p->sustain + rpm / p->slope, 100.0);
+}
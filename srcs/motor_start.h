@@ -0,0 +1,102 @@
+/*
+ * motor_start.h
+ * Kickstart from standstill and learning of the breakaway and sustain duty.
+ *
+ * A DC motor at rest needs more drive to break static friction (breakaway
+ * duty) than to keep turning once it moves (sustain duty). Both depend on
+ * the motor, its bearings and the load, so they are measured rather than
+ * configured, and kept in the motor's profile (motor_profile.h).
+ *
+ * KICKSTART:
+ * Every start from standstill ramps the duty at START_RAMP %/s, from
+ * START_WINDOW below the learned breakaway (START_FLOOR while unknown),
+ * until the IR sensor sees the rotor move: a first edge confirmed by
+ * another within START_CONFIRM_MS. The rotor had to travel to the first
+ * edge after breaking away, taking about as long as it then took to the
+ * second, so the duty that long before the first edge's timestamp is this
+ * start's breakaway; it is averaged into the profile (START_ALPHA). The
+ * requested duty is then applied. With the breakaway learned, the ramp is
+ * at the threshold in START_WINDOW / START_RAMP seconds whatever the load,
+ * so starts are fast and repeatable; a rotor that does not move by 100% or
+ * START_TIMEOUT_MS is reported as stalled. A rotor that is still coasting
+ * (an edge within START_CONFIRM_MS before the start) teaches nothing: it
+ * moves at once whatever the breakaway is.
+ *
+ * SUSTAIN:
+ * A rotor is not stopped to find the sustain duty. Above static friction
+ * the steady speed is linear in duty,
+ *
+ *   rpm = slope * (duty - sustain)
+ *
+ * so each steady operating point (duty unchanged for SUSTAIN_SETTLE_MS,
+ * |accel| below SUSTAIN_MAX_ACCEL) is kept, and a line fitted through the
+ * last SUSTAIN_POINTS of them once they span SUSTAIN_MIN_SPREAD duty. Its
+ * zero crossing is the sustain duty and its slope gives the feedforward
+ * duty for a target speed (motorStartDutyFor()).
+ *
+ * All times are halTick() microseconds (wrapping 32-bit counter).
+ */
+
+#ifndef MOTOR_START_H
+#define MOTOR_START_H
+
+#include <stdint.h>
+#include "motor_profile.h"
+
+#define START_FLOOR          5.0     // Ramp start while the breakaway is unknown, duty %
+#define START_WINDOW         4.0     // Ramp starts this far below the learned breakaway, duty %
+#define START_RAMP           50.0    // Duty % per second
+#define START_CONFIRM_MS     300     // Second edge within this after the first = moving
+#define START_MIN_MS         20      // Motion sooner than this: the rotor was not at rest
+#define START_TIMEOUT_MS     4000    // Give up (stalled or sensor missing)
+#define START_ALPHA          0.3     // Weight of a new breakaway measurement
+#define START_MARGIN         1.0     // Low-end clamp above the sustain duty, %
+#define SUSTAIN_POINTS       16      // Steady operating points kept for the fit
+#define SUSTAIN_SETTLE_MS    1500    // Duty unchanged this long before a point is taken
+#define SUSTAIN_MAX_ACCEL    50.0    // RPM/s; faster changes are not steady
+#define SUSTAIN_MIN_SPREAD   10.0    // Duty % spread of the points before fitting
+
+typedef enum {
+    START_RUNNING,
+    START_DONE,                // Moving; breakaway measured
+    START_MOVING,              // Moving, but it was already (not measured)
+    START_STALLED,             // No motion up to 100% duty
+} motor_start_result;
+
+typedef struct {
+    motor_profile profile;     // Learned values (persisted)
+
+    // Start in progress
+    int active;
+    uint32_t t0;
+    double from;               // Ramp start duty %
+    double duty;               // Ramp duty now
+    double target;             // Duty to apply once moving
+    unsigned long edges0;      // Edge count at the start
+    int coasting;              // Rotor still turning at the start: nothing to learn
+    int first_seen;
+    unsigned long first_edges;
+    uint32_t first_tick;
+
+    // Last start
+    double last_breakaway;
+    double last_ms;            // Standstill to confirmed motion
+
+    // Sustain fit
+    double point_duty[SUSTAIN_POINTS];
+    double point_rpm[SUSTAIN_POINTS];
+    int num_points, next_point;
+    double steady_duty;
+    uint32_t steady_since;
+    int steady_taken;
+} motor_start;
+
+void motorStartBegin(motor_start* st, double target, unsigned long edges, uint32_t edge_tick,
+                     uint32_t now);
+motor_start_result motorStartStep(motor_start* st, unsigned long edges, uint32_t edge_tick,
+                                  uint32_t now, double* duty);
+int motorStartSteady(motor_start* st, double duty, double rpm, double accel, uint32_t now);
+double motorStartMinDuty(const motor_start* st);
+double motorStartDutyFor(const motor_start* st, double rpm);
+
+#endif // MOTOR_START_H
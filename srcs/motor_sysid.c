@@ -0,0 +1,334 @@
+/*
+ * motor_sysid.c
+ * Frequency response measurement and loop margins. See motor_sysid.h.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "motor_sysid.h"
+
+#define SYSID_PRBS_TAPS  0xB8u    // x^8 + x^6 + x^5 + x^4 + 1 (Galois form)
+
+/*
+ * Frequency of point i, offset by a share of the spacing to the next
+ */
+static double pointHz(int i, double offset) {
+    return SYSID_MIN_HZ * pow(SYSID_MAX_HZ / SYSID_MIN_HZ, (i + offset) / (SYSID_POINTS - 1));
+}
+
+/**
+ * START A MEASUREMENT
+ * @param duty: Operating point, duty %
+ * @param amplitude: Perturbation, duty % (the caller keeps duty +- amplitude
+ *                   in the range the rotor keeps turning in)
+ * @param rpm: Steady speed at the operating point
+ */
+void motorSysidBegin(motor_sysid* s, motor_sysid_signal signal, double duty, double amplitude,
+                     double rpm, uint32_t now) {
+    memset(s, 0, sizeof(*s));
+    s->signal = signal;
+    s->duty = duty;
+    s->amplitude = amplitude;
+    s->rpm = rpm;
+    if (signal == SYSID_PRBS) {
+        double period = ((1 << SYSID_PRBS_ORDER) - 1) * SYSID_PRBS_BIT_S;
+        s->lead_s = period;
+        s->record_s = SYSID_PRBS_PERIODS * period;
+    } else {
+        s->lead_s = SYSID_LEAD_S;
+        s->record_s = SYSID_CHIRP_S;
+    }
+    s->start = now + (uint32_t)(s->lead_s * 1e6);
+    s->last_step = now - SYSID_STEP_MS * 1000u;
+    s->prbs_state = 1;
+    s->prbs_bit = -1;
+
+    // Log spaced points, each the middle of SYSID_BAND lines filling its
+    // share. A PRBS only excites the harmonics of its period: its lines are
+    // the harmonics in the share (none: the point is not measured)
+    for (int i = 0; i < SYSID_POINTS; i++) {
+        double* lines = &s->line_hz[i * SYSID_BAND];
+        if (signal == SYSID_PRBS) {
+            double period = s->record_s / SYSID_PRBS_PERIODS;
+            long first = (long)ceil(pointHz(i, -0.5) * period);
+            long last = (long)ceil(pointHz(i, 0.5) * period) - 1;
+            for (int b = 0; b < SYSID_BAND; b++) {
+                lines[b] = last < first ? 0.0 : (first + (last - first) * b / (SYSID_BAND - 1)) / period;
+            }
+        } else {
+            for (int b = 0; b < SYSID_BAND; b++) {
+                lines[b] = pointHz(i, (b - (SYSID_BAND - 1) / 2.0) / SYSID_BAND);
+            }
+        }
+    }
+    s->active = 1;
+}
+
+/*
+ * Perturbation at record time t (negative during the lead)
+ */
+static double perturbation(motor_sysid* s, double t) {
+    if (s->signal == SYSID_PRBS) {
+        long bit = (long)((t + s->lead_s) / SYSID_PRBS_BIT_S);
+        while (s->prbs_bit < bit) {
+            s->prbs_state = (s->prbs_state >> 1) ^ (-(s->prbs_state & 1u) & SYSID_PRBS_TAPS);
+            s->prbs_bit++;
+        }
+        return (s->prbs_state & 1u) ? s->amplitude : -s->amplitude;
+    }
+    if (t < 0.0) {
+        return s->amplitude * sin(2.0 * M_PI * SYSID_MIN_HZ * t);
+    }
+    double k = SYSID_MAX_HZ / SYSID_MIN_HZ;
+    double phase = 2.0 * M_PI * SYSID_MIN_HZ * s->record_s / log(k) * (pow(k, t / s->record_s) - 1.0);
+    return s->amplitude * sin(phase);
+}
+
+/*
+ * Add v over [t - dt/2, t + dt/2] to the Fourier sums (midpoint rule)
+ */
+static void addSample(motor_sysid_sums* sums, const double* line_hz, double t, double v, double dt) {
+    for (int l = 0; l < SYSID_LINES; l++) {
+        if (line_hz[l] <= 0.0) continue;
+        double w = 2.0 * M_PI * line_hz[l] * t;
+        double c = cos(w) * dt, sn = -sin(w) * dt;
+        sums->x_re[l] += v * c;
+        sums->x_im[l] += v * sn;
+        sums->w0_re[l] += c;
+        sums->w0_im[l] += sn;
+        sums->w1_re[l] += t * c;
+        sums->w1_im[l] += t * sn;
+    }
+    sums->s0 += dt;
+    sums->s1 += t * dt;
+    sums->s2 += t * t * dt;
+    sums->sv += v * dt;
+    sums->stv += t * v * dt;
+}
+
+/*
+ * Transform of line l with the signal's mean and drift removed
+ */
+static void lineValue(const motor_sysid_sums* sums, int l, double* re, double* im) {
+    double det = sums->s0 * sums->s2 - sums->s1 * sums->s1;
+    double b = det > 1e-12 ? (sums->s0 * sums->stv - sums->s1 * sums->sv) / det : 0.0;
+    double a = sums->s0 > 0.0 ? (sums->sv - b * sums->s1) / sums->s0 : 0.0;
+    *re = sums->x_re[l] - a * sums->w0_re[l] - b * sums->w1_re[l];
+    *im = sums->x_im[l] - a * sums->w0_im[l] - b * sums->w1_im[l];
+}
+
+/*
+ * Linear interpolation on a log frequency axis
+ */
+static double logInterp(double f0, double f1, double frac) {
+    return exp(log(f0) + frac * (log(f1) - log(f0)));
+}
+
+/*
+ * First-order model K / (1 + j w tau) through the trusted points down to
+ * SYSID_FIT_MIN_GAIN of dc_gain: 1/|H|^2 = 1/K^2 + (tau/K)^2 w^2 is a line
+ * in w^2. Higher up, the lags the model leaves out dominate.
+ */
+static void fitFirstOrder(motor_sysid* s) {
+    double n = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    s->fit_gain = 0.0;
+    s->fit_tau = 0.0;
+    for (int i = 0; i < SYSID_POINTS; i++) {
+        const motor_sysid_point* pt = &s->points[i];
+        if (pt->coherence < SYSID_MIN_COHERENCE || pt->gain < SYSID_FIT_MIN_GAIN * s->dc_gain ||
+            pt->gain <= 0.0) {
+            continue;
+        }
+        double w = 2.0 * M_PI * pt->hz;
+        double x = w * w, y = 1.0 / (pt->gain * pt->gain);
+        n += 1.0;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    double det = n * sxx - sx * sx;
+    if (n < 3.0 || det <= 0.0) {
+        return;
+    }
+    double slope = (n * sxy - sx * sy) / det;
+    double offset = (sy - slope * sx) / n;
+    if (slope <= 0.0 || offset <= 0.0) {
+        return;
+    }
+    s->fit_gain = 1.0 / sqrt(offset);
+    s->fit_tau = sqrt(slope / offset);
+}
+
+static void finish(motor_sysid* s) {
+    double last_phase = 0.0;
+    for (int i = 0; i < SYSID_POINTS; i++) {
+        double cross_re = 0.0, cross_im = 0.0, uu = 0.0, yy = 0.0;
+        for (int b = 0; b < SYSID_BAND; b++) {
+            double u_re, u_im, y_re, y_im;
+            lineValue(&s->u, i * SYSID_BAND + b, &u_re, &u_im);
+            lineValue(&s->y, i * SYSID_BAND + b, &y_re, &y_im);
+            cross_re += y_re * u_re + y_im * u_im;     // Y conj(U)
+            cross_im += y_im * u_re - y_re * u_im;
+            uu += u_re * u_re + u_im * u_im;
+            yy += y_re * y_re + y_im * y_im;
+        }
+        motor_sysid_point* pt = &s->points[i];
+        pt->hz = s->line_hz[i * SYSID_BAND + SYSID_BAND / 2];
+        if (pt->hz <= 0.0) {
+            pt->hz = pointHz(i, 0.0);
+            continue;              // Not excited
+        }
+        pt->gain = uu > 0.0 ? hypot(cross_re, cross_im) / uu : 0.0;
+        pt->coherence = uu > 0.0 && yy > 0.0 ? (cross_re * cross_re + cross_im * cross_im) / (uu * yy) : 0.0;
+        double phase = atan2(cross_im, cross_re) * 180.0 / M_PI;
+        while (i > 0 && phase - last_phase > 180.0) phase -= 360.0;
+        while (i > 0 && phase - last_phase < -180.0) phase += 360.0;
+        pt->phase_deg = last_phase = phase;
+    }
+
+    // Bandwidth: first trusted point 3 dB under the lowest one
+    s->dc_gain = 0.0;
+    s->bandwidth_hz = 0.0;
+    const motor_sysid_point* prev = NULL;
+    for (int i = 0; i < SYSID_POINTS; i++) {
+        const motor_sysid_point* pt = &s->points[i];
+        if (pt->coherence < SYSID_MIN_COHERENCE || pt->gain <= 0.0) continue;
+        if (s->dc_gain <= 0.0) {
+            s->dc_gain = pt->gain;
+        } else if (pt->gain < s->dc_gain / M_SQRT2) {
+            double frac = (log(prev->gain) - log(s->dc_gain / M_SQRT2)) / (log(prev->gain) - log(pt->gain));
+            s->bandwidth_hz = logInterp(prev->hz, pt->hz, frac);
+            s->bandwidth_phase = prev->phase_deg + frac * (pt->phase_deg - prev->phase_deg);
+            break;
+        }
+        prev = pt;
+    }
+    s->valid = s->dc_gain > 0.0;
+    fitFirstOrder(s);
+}
+
+/**
+ * MEASUREMENT STEP
+ * Call as often as the main loop runs while s->active; acts every
+ * SYSID_STEP_MS.
+ *
+ * @param have_rpm: rpm/rpm_tick hold a new one-revolution speed
+ * @param rpm_tick: halTick() in the middle of that revolution
+ * @param duty: Receives the duty % to run at
+ */
+motor_sysid_status motorSysidStep(motor_sysid* s, uint32_t now, int have_rpm, double rpm,
+                                  uint32_t rpm_tick, double* duty) {
+    if (!s->active) {
+        return SYSID_DONE;
+    }
+    *duty = s->duty + s->u_last;
+    if (now - s->last_step < SYSID_STEP_MS * 1000u) {
+        return SYSID_RUNNING;
+    }
+    s->last_step = now;
+    double t = (int32_t)(now - s->start) / 1e6;
+
+    // The duty held since the last step, inside the record
+    if (s->have_u) {
+        double a = fmax(s->u_t, 0.0), b = fmin(t, s->record_s);
+        if (b > a) addSample(&s->u, s->line_hz, (a + b) / 2.0, s->u_last, b - a);
+    }
+
+    // Speed between the last two revolutions
+    if (have_rpm) {
+        double tau = (int32_t)(rpm_tick - s->start) / 1e6;
+        double v = rpm - s->rpm;
+        if (!s->have_y || tau > s->y_t) {
+            if (s->have_y && s->y_t >= 0.0 && tau <= s->record_s) {
+                addSample(&s->y, s->line_hz, (s->y_t + tau) / 2.0, (s->y_last + v) / 2.0, tau - s->y_t);
+            }
+            s->y_t = tau;
+            s->y_last = v;
+            s->have_y = 1;
+        }
+    }
+
+    if (t >= s->record_s) {
+        s->active = 0;
+        s->u_last = 0.0;
+        finish(s);
+        *duty = s->duty;
+        return SYSID_DONE;
+    }
+    s->u_last = perturbation(s, t);
+    s->u_t = t;
+    s->have_u = 1;
+    *duty = s->duty + s->u_last;
+    return SYSID_RUNNING;
+}
+
+/**
+ * LOOP MARGINS
+ * Closes the measured plant with controller c (see LOOP in motor_sysid.h).
+ * Only trusted points below the controller's Nyquist frequency count.
+ */
+void motorSysidLoop(const motor_sysid* s, const motor_sysid_controller* c, motor_sysid_loop* loop) {
+    memset(loop, 0, sizeof(*loop));
+    double hz[SYSID_POINTS], mag[SYSID_POINTS], phase[SYSID_POINTS];
+    int n = 0;
+    for (int i = 0; i < SYSID_POINTS && s->valid; i++) {
+        const motor_sysid_point* pt = &s->points[i];
+        double wt = 2.0 * M_PI * pt->hz * c->period_s;
+        if (pt->coherence < SYSID_MIN_COHERENCE || pt->gain <= 0.0 || wt >= M_PI) continue;
+
+        // C(z) ZOH = (kp d + ki + kd d^2) / (d j w T), d = 1 - z^-1
+        double d_re = 1.0 - cos(wt), d_im = sin(wt);
+        double num_re = c->kp * d_re + c->ki + c->kd * (d_re * d_re - d_im * d_im);
+        double num_im = c->kp * d_im + c->kd * 2.0 * d_re * d_im;
+        hz[n] = pt->hz;
+        mag[n] = pt->gain * hypot(num_re, num_im) / (hypot(d_re, d_im) * wt);
+        phase[n] = pt->phase_deg + (atan2(num_im, num_re) - atan2(d_im, d_re)) * 180.0 / M_PI - 90.0;
+        while (n > 0 && phase[n] - phase[n - 1] > 180.0) phase[n] -= 360.0;
+        while (n > 0 && phase[n] - phase[n - 1] < -180.0) phase[n] += 360.0;
+        n++;
+    }
+    if (n < 2) {
+        return;
+    }
+
+    for (int i = 1; i < n; i++) {
+        double frac;
+        // Crossover: the first time |L| falls through 1
+        if (!loop->valid && mag[i - 1] >= 1.0 && mag[i] < 1.0) {
+            frac = log(mag[i - 1]) / (log(mag[i - 1]) - log(mag[i]));
+            loop->valid = 1;
+            loop->crossover_hz = logInterp(hz[i - 1], hz[i], frac);
+            loop->phase_margin = 180.0 + phase[i - 1] + frac * (phase[i] - phase[i - 1]);
+        }
+        // Gain margin at -180 deg, gain scale at the target margin
+        if (loop->gain_margin_db == 0.0 && phase[i - 1] > -180.0 && phase[i] <= -180.0) {
+            frac = (phase[i - 1] + 180.0) / (phase[i - 1] - phase[i]);
+            loop->gain_margin_db = -20.0 * (log10(mag[i - 1]) + frac * (log10(mag[i]) - log10(mag[i - 1])));
+        }
+        double target = SYSID_TARGET_PM - 180.0;
+        if (loop->scale == 0.0 && phase[i - 1] > target && phase[i] <= target) {
+            frac = (phase[i - 1] - target) / (phase[i - 1] - phase[i]);
+            loop->target_hz = logInterp(hz[i - 1], hz[i], frac);
+            loop->scale = 1.0 / exp(log(mag[i - 1]) + frac * (log(mag[i]) - log(mag[i - 1])));
+            loop->target_pm = SYSID_TARGET_PM;
+        }
+    }
+
+    // Margin out of reach: cross where the phase is highest
+    if (loop->scale == 0.0) {
+        int best = 0;
+        for (int i = 1; i < n; i++) {
+            if (phase[i] > phase[best]) best = i;
+        }
+        if (phase[best] > -180.0) {
+            loop->scale = 1.0 / mag[best];
+            loop->target_hz = hz[best];
+            loop->target_pm = 180.0 + phase[best];
+        }
+    }
+}
+
+const char* motorSysidSignalName(motor_sysid_signal signal) {
+    return signal == SYSID_PRBS ? "prbs" : "chirp";
+}
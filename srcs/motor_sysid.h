@@ -0,0 +1,148 @@
+/*
+ * motor_sysid.h
+ * Frequency response of the motor (duty % -> RPM) around an operating
+ * point, and what it means for the speed loop.
+ *
+ * A step shows the time constant; it says little about how much phase the
+ * motor, the speed measurement and the controller's sample-and-hold lose
+ * near the loop's crossover. 'sysid' perturbs the duty of a motor running
+ * at a steady duty and measures the response at SYSID_POINTS frequencies
+ * from SYSID_MIN_HZ to SYSID_MAX_HZ.
+ *
+ * PERTURBATION (+-amplitude around the operating duty, every SYSID_STEP_MS):
+ *   chirp - logarithmic sine sweep over SYSID_CHIRP_S: every frequency
+ *           band gets the same number of cycles, the best signal to noise
+ *   prbs  - maximum length binary sequence (SYSID_PRBS_ORDER bits, one
+ *           every SYSID_PRBS_BIT_S): flat spectrum, least time at a
+ *           single frequency (gentle on resonances)
+ * SYSID_LEAD_S of chirp (one period of PRBS) runs before recording, so the
+ * start transient is not measured.
+ *
+ * SPEED:
+ * The high rate path: one revolution of raw IR edge times (blade spacing
+ * errors cancel), timed at the middle of that revolution. A revolution
+ * average has no phase lag at its middle time.
+ *
+ * ESTIMATE:
+ * Both signals are Fourier transformed while they are recorded (no sample
+ * buffer): SYSID_BAND lines around each point, the duty as the held value
+ * it is, the speed with its mean and drift removed. Per point
+ *   H = sum(Y conj(U)) / sum(|U|^2)                  RPM per duty %
+ *   coherence = |sum(Y conj(U))|^2 / (sum(|U|^2) sum(|Y|^2))
+ * Points with coherence under SYSID_MIN_COHERENCE (noise, disturbances,
+ * nonlinearity) are shown but not used. A first-order model is fitted to
+ * the gains (fit_gain, fit_tau): the time constant the disturbance
+ * observer (motor_observer.h) inverts.
+ *
+ * LOOP:
+ * motorSysidLoop() closes the measured plant with an incremental PID
+ *   du = kp e + ki sum(e) + kd (e - e_prev)   every period_s
+ * behind a zero-order hold, L = C(z) ZOH(f) H(f), and reads off the
+ * crossover (|L| = 1), phase margin and gain margin (phase -180 deg), and
+ * the gain scale that would give SYSID_TARGET_PM of phase margin: the
+ * fastest crossover the controller structure and its period allow. Where
+ * no gain reaches that margin, the scale for the best one. This is a
+ * small-signal model (no rate limit, no whole-percent duty steps).
+ */
+
+#ifndef MOTOR_SYSID_H
+#define MOTOR_SYSID_H
+
+#include <stdint.h>
+
+#define SYSID_STEP_MS         10      // Duty update and speed sample period
+#define SYSID_MIN_HZ          0.1
+#define SYSID_MAX_HZ          5.0
+#define SYSID_POINTS          16      // Bode points, log spaced
+#define SYSID_BAND            5       // DFT lines averaged per point
+#define SYSID_LINES           (SYSID_POINTS * SYSID_BAND)
+#define SYSID_CHIRP_S         40.0    // Recorded chirp
+#define SYSID_LEAD_S          3.0     // Chirp before recording (at SYSID_MIN_HZ)
+#define SYSID_PRBS_ORDER      8       // 255-bit sequence
+#define SYSID_PRBS_BIT_S      0.04    // 10.2 s period: lines from 0.1 Hz
+#define SYSID_PRBS_PERIODS    3       // Recorded periods (one more runs before)
+#define SYSID_AMPLITUDE       10.0    // Duty % around the operating point
+#define SYSID_MIN_AMPLITUDE   3.0     // Less does not lift the speed out of the noise
+#define SYSID_MIN_COHERENCE   0.8
+#define SYSID_STEADY_ACCEL    100.0   // RPM/s: the operating point must be steady
+#define SYSID_TARGET_PM       60.0    // Phase margin the gain advice aims for, deg
+#define SYSID_FIT_MIN_GAIN    0.25    // First-order fit down to this share of dc_gain
+
+typedef enum {
+    SYSID_CHIRP,
+    SYSID_PRBS,
+} motor_sysid_signal;
+
+typedef enum {
+    SYSID_RUNNING,             // Apply *duty
+    SYSID_DONE,                // Result in points/bandwidth
+} motor_sysid_status;
+
+typedef struct {
+    double hz;
+    double gain;               // RPM per duty %
+    double phase_deg;          // Unwrapped from the lowest point
+    double coherence;
+} motor_sysid_point;
+
+// Fourier sums of one recorded signal
+typedef struct {
+    double x_re[SYSID_LINES], x_im[SYSID_LINES];     // sum v e^-jwt dt
+    double w0_re[SYSID_LINES], w0_im[SYSID_LINES];   // sum e^-jwt dt (mean)
+    double w1_re[SYSID_LINES], w1_im[SYSID_LINES];   // sum t e^-jwt dt (drift)
+    double s0, s1, s2, sv, stv;                      // sum dt, t dt, t^2 dt, v dt, t v dt
+} motor_sysid_sums;
+
+typedef struct {
+    int active;
+    motor_sysid_signal signal;
+    double duty;               // Operating point
+    double amplitude;
+    double rpm;                // Speed at the start
+    double lead_s, record_s;
+    uint32_t start;            // halTick() of the record start (after the lead)
+
+    // Recording
+    double line_hz[SYSID_LINES];
+    motor_sysid_sums u, y;
+    int have_u, have_y;
+    double u_t, u_last;        // Last duty step (record time, perturbation)
+    double y_t, y_last;        // Last speed sample
+    uint32_t last_step;
+    unsigned prbs_state;
+    long prbs_bit;
+
+    // Result
+    int valid;
+    motor_sysid_point points[SYSID_POINTS];
+    double dc_gain;            // Lowest trusted point, RPM per duty %
+    double bandwidth_hz;       // Gain 3 dB under dc_gain (0 = above SYSID_MAX_HZ)
+    double bandwidth_phase;    // Phase there, deg
+    double fit_gain;           // First-order fit: RPM per duty % (0 = no fit)
+    double fit_tau;            // ... and time constant, s
+} motor_sysid;
+
+// Controller the loop is closed with (see LOOP)
+typedef struct {
+    double period_s;
+    double kp, ki, kd;
+} motor_sysid_controller;
+
+typedef struct {
+    int valid;                 // Crossover inside the trusted points
+    double crossover_hz;
+    double phase_margin;       // deg
+    double gain_margin_db;     // 0 = phase never reaches -180 deg in range
+    double scale;              // Gain factor for SYSID_TARGET_PM, or the best margin below it
+    double target_hz;          // Crossover with it
+    double target_pm;          // Phase margin with it (0 = none in range)
+} motor_sysid_loop;
+
+void motorSysidBegin(motor_sysid* s, motor_sysid_signal signal, double duty, double amplitude,
+                     double rpm, uint32_t now);
+motor_sysid_status motorSysidStep(motor_sysid* s, uint32_t now, int have_rpm, double rpm,
+                                  uint32_t rpm_tick, double* duty);
+void motorSysidLoop(const motor_sysid* s, const motor_sysid_controller* c, motor_sysid_loop* loop);
+const char* motorSysidSignalName(motor_sysid_signal signal);
+
+#endif // MOTOR_SYSID_H
@@ -0,0 +1,63 @@
+/*
+ * parmco_trace.h
+ * Static tracepoints (USDT) for the PARMCO command and control pipeline.
+ *
+ * Each PARMCO_TRACEn() marks a point in motor_control_ble_pipe.c (with
+ * rpm_estimator.c) or ble_server.c that perf, bpftrace or SystemTap can attach to at runtime.
+ * When nothing is attached a probe is a single NOP instruction, so they stay
+ * compiled into production builds.
+ *
+ * Enabling:
+ *   Probes are emitted when <sys/sdt.h> is available
+ *   (Raspberry Pi OS: sudo apt install systemtap-sdt-dev).
+ *   Without it, or with -DPARMCO_NO_TRACE, every probe compiles to nothing.
+ *
+ * Usage:
+ *   sudo bpftrace -l 'usdt:./motor_control_ble_pipe:parmco:*'
+ *   sudo bpftrace -e 'usdt:./motor_control_ble_pipe:parmco:pid_exit { @speed = lhist(arg0, 0, 100, 5); }'
+ *   sudo perf buildid-cache --add ./ble_server && sudo perf record -e sdt_parmco:notify_emit -a
+ *
+ * Arguments are integers only (bpftrace cannot read floating point probe
+ * arguments), so RPM values are passed as centi-RPM (rpm * 100).
+ *
+ * PROBES (provider "parmco"):
+ *   motor_control_ble_pipe:
+ *     pulse        (tick_us, level, total_pulses)     IR edge captured
+ *     edge_reject  (tick_us, reason)                  0=glitch 1=short interval 2=long interval
+ *     rpm_publish  (centi_rpm, pulses_in_window)      Control RPM of a motor updated
+ *     pid_enter    (centi_rpm, centi_desired, speed)  pidController() called
+ *     pid_exit     (new_speed, reason)                0=adjusted 1=target zero 2=stabilizing
+ *     pwm_write    (speed, pwm_value)                 setSpeed() GPIO write
+ *     command      (input)                            processCommand() parsed line
+ *   ble_server:
+ *     pipe_write   (command, ok)                      write_to_pipe()
+ *     notify_emit  (value, ok)                        Status PropertiesChanged emitted
+ *     history_chunk (seq, ok)                         History chunk notification emitted
+ */
+
+#ifndef PARMCO_TRACE_H
+#define PARMCO_TRACE_H
+
+#if !defined(PARMCO_NO_TRACE) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PARMCO_TRACE_ENABLED 1
+#endif
+#endif
+
+#define PARMCO_CENTI(x) ((long)((x) * 100.0))
+
+#ifdef PARMCO_TRACE_ENABLED
+#define PARMCO_TRACE0(name)             DTRACE_PROBE(parmco, name)
+#define PARMCO_TRACE1(name, a)          DTRACE_PROBE1(parmco, name, a)
+#define PARMCO_TRACE2(name, a, b)       DTRACE_PROBE2(parmco, name, a, b)
+#define PARMCO_TRACE3(name, a, b, c)    DTRACE_PROBE3(parmco, name, a, b, c)
+#else
+// Arguments are still referenced so probe-only locals don't trigger warnings
+#define PARMCO_TRACE0(name)             do { } while (0)
+#define PARMCO_TRACE1(name, a)          do { (void)(a); } while (0)
+#define PARMCO_TRACE2(name, a, b)       do { (void)(a); (void)(b); } while (0)
+#define PARMCO_TRACE3(name, a, b, c)    do { (void)(a); (void)(b); (void)(c); } while (0)
+#endif
+
+#endif // PARMCO_TRACE_H
@@ -0,0 +1,138 @@
+/*
+ * pwm_sweep.c
+ * PWM frequency characterization. See pwm_sweep.h.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "pwm_sweep.h"
+
+const double g_sweep_duties[SWEEP_DUTIES] = { 30.0, 50.0, 70.0, 90.0 };
+
+const unsigned g_sweep_candidates[SWEEP_NUM_CANDIDATES] = {
+    40000, 20000, 10000, 8000, 5000, 4000, 2500, 2000, 1600, 1250,
+    1000, 800, 500, 400, 320, 250, 200, 160, 100,
+};
+
+/**
+ * START A SWEEP
+ * @param freqs: Candidate frequencies as the backend really sets them
+ *               (duplicates removed by the caller)
+ * @param real_ranges: Real duty steps at each frequency (-1 = unknown)
+ */
+void pwmSweepBegin(pwm_sweep* sweep, const unsigned* freqs, const int* real_ranges, int num_freqs,
+                   uint32_t now_ms) {
+    memset(sweep, 0, sizeof(*sweep));
+    if (num_freqs > SWEEP_MAX_FREQS) num_freqs = SWEEP_MAX_FREQS;
+    for (int i = 0; i < num_freqs; i++) {
+        sweep->points[i].freq = freqs[i];
+        sweep->points[i].real_range = real_ranges[i];
+    }
+    sweep->num_freqs = num_freqs;
+    sweep->active = num_freqs > 0;
+    sweep->point_start = now_ms;
+    sweep->best = -1;
+}
+
+/*
+ * Speed/duty line, its largest deviation and the score inputs
+ */
+static void fitPoint(pwm_sweep_point* pt) {
+    double md = 0.0, mr = 0.0;
+    for (int d = 0; d < SWEEP_DUTIES; d++) {
+        md += g_sweep_duties[d] / SWEEP_DUTIES;
+        mr += pt->rpm[d] / SWEEP_DUTIES;
+    }
+    double sdd = 0.0, sdr = 0.0;
+    for (int d = 0; d < SWEEP_DUTIES; d++) {
+        sdd += (g_sweep_duties[d] - md) * (g_sweep_duties[d] - md);
+        sdr += (g_sweep_duties[d] - md) * (pt->rpm[d] - mr);
+    }
+    pt->slope = sdr / sdd;
+    pt->sustain = pt->slope > 0.0 ? md - mr / pt->slope : 0.0;
+
+    double worst = 0.0;
+    for (int d = 0; d < SWEEP_DUTIES; d++) {
+        double line = mr + pt->slope * (g_sweep_duties[d] - md);
+        worst = fmax(worst, fabs(pt->rpm[d] - line));
+    }
+    double span = pt->rpm[SWEEP_DUTIES - 1] - pt->rpm[0];
+    pt->linearity = span > 0.0 ? fmax(0.0, 1.0 - worst / span) : 0.0;
+    pt->resolution = pt->real_range > 0 ? fmin(1.0, (double)pt->real_range / SWEEP_MIN_STEPS) : 1.0;
+    pt->drive = mr;  // Normalized in scoreSweep()
+}
+
+static void scoreSweep(pwm_sweep* sweep) {
+    double best_drive = 0.0;
+    for (int i = 0; i < sweep->num_freqs; i++) {
+        fitPoint(&sweep->points[i]);
+        best_drive = fmax(best_drive, sweep->points[i].drive);
+    }
+
+    double best_score = 0.0;
+    for (int i = 0; i < sweep->num_freqs; i++) {
+        pwm_sweep_point* pt = &sweep->points[i];
+        pt->drive = best_drive > 0.0 ? pt->drive / best_drive : 0.0;
+        pt->score = pt->drive * pt->linearity * pt->resolution;
+        best_score = fmax(best_score, pt->score);
+    }
+
+    // Quietest (highest frequency) of the equally good ones
+    sweep->best = -1;
+    for (int i = 0; i < sweep->num_freqs; i++) {
+        const pwm_sweep_point* pt = &sweep->points[i];
+        if (best_score > 0.0 && pt->score >= best_score * (1.0 - SWEEP_TIE) &&
+            (sweep->best < 0 || pt->freq > sweep->points[sweep->best].freq)) {
+            sweep->best = i;
+        }
+    }
+}
+
+/**
+ * SWEEP STEP
+ * Call once per control cycle while sweep->active with the speed along the
+ * driven direction.
+ *
+ * @param freq: Receives the frequency to run at
+ * @param duty: Receives the duty % to run at
+ */
+pwm_sweep_status pwmSweepStep(pwm_sweep* sweep, double rpm, double accel, uint32_t now_ms,
+                              unsigned* freq, double* duty) {
+    if (!sweep->active) {
+        return SWEEP_DONE;
+    }
+
+    // Duties rise at even frequencies and fall at odd ones, so the motor
+    // never coasts down from the top duty to the bottom one
+    int d = sweep->freq_index % 2 ? SWEEP_DUTIES - 1 - sweep->duty_index : sweep->duty_index;
+
+    uint32_t elapsed = now_ms - sweep->point_start;
+    if (elapsed >= SWEEP_SETTLE_MS &&
+        (fabs(accel) < SWEEP_STEADY_ACCEL || elapsed >= SWEEP_MAX_SETTLE_MS)) {
+        sweep->sum += rpm;
+        sweep->samples++;
+    } else {
+        sweep->sum = 0.0;      // Consecutive steady samples only
+        sweep->samples = 0;
+    }
+
+    if (sweep->samples >= SWEEP_AVG_SAMPLES) {
+        sweep->points[sweep->freq_index].rpm[d] = sweep->sum / sweep->samples;
+        sweep->sum = 0.0;
+        sweep->samples = 0;
+        sweep->point_start = now_ms;
+        if (++sweep->duty_index == SWEEP_DUTIES) {
+            sweep->duty_index = 0;
+            if (++sweep->freq_index == sweep->num_freqs) {
+                sweep->active = 0;
+                scoreSweep(sweep);
+                return SWEEP_DONE;
+            }
+        }
+    }
+
+    d = sweep->freq_index % 2 ? SWEEP_DUTIES - 1 - sweep->duty_index : sweep->duty_index;
+    *freq = sweep->points[sweep->freq_index].freq;
+    *duty = g_sweep_duties[d];
+    return SWEEP_RUNNING;
+}
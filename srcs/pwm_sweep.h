@@ -0,0 +1,85 @@
+/*
+ * pwm_sweep.h
+ * PWM frequency characterization: pick the enable pin frequency from the
+ * motor's measured response.
+ *
+ * The PWM frequency changes how the duty reaches the motor:
+ *   - low frequencies: the winding current ripples within each period, so
+ *     the speed/duty line bends and the motor hums loudly
+ *   - high frequencies: the bridge loses a fixed switching time every
+ *     period, and pigpio's software PWM has fewer real duty steps
+ *     (200000 / freq with 5us samples: 25 steps at 8 kHz)
+ *
+ * SWEEP:
+ * For each candidate frequency (those the backend really sets, from
+ * SWEEP_MIN_HZ up), the motor runs at SWEEP_DUTIES duties, rising at one
+ * frequency and falling at the next; at each, once the speed is steady
+ * (|accel| < SWEEP_STEADY_ACCEL after SWEEP_SETTLE_MS, at most
+ * SWEEP_MAX_SETTLE_MS), SWEEP_AVG_SAMPLES consecutive control cycles of RPM
+ * are averaged. A sweep takes about SWEEP_POINT_MS per point.
+ *
+ * SCORE (per frequency):
+ *   drive      - mean RPM over the duties / best mean RPM (less lost duty)
+ *   linearity  - 1 - largest deviation from the fitted speed/duty line,
+ *                relative to the RPM span
+ *   resolution - real duty steps / SWEEP_MIN_STEPS, at most 1 (1% steps)
+ *   score      = drive * linearity * resolution
+ * The highest frequency within SWEEP_TIE of the best score wins: it is
+ * the quietest of the equally good ones.
+ */
+
+#ifndef PWM_SWEEP_H
+#define PWM_SWEEP_H
+
+#include <stdint.h>
+
+#define SWEEP_MAX_FREQS       24
+#define SWEEP_DUTIES          4
+#define SWEEP_MIN_HZ          100     // Lower frequencies only buzz
+#define SWEEP_SETTLE_MS       800     // Minimum time at each point
+#define SWEEP_MAX_SETTLE_MS   4000    // Measure anyway after this
+#define SWEEP_STEADY_ACCEL    100.0   // RPM/s
+#define SWEEP_AVG_SAMPLES     5       // Control cycles averaged per point
+#define SWEEP_MIN_STEPS       100     // Real duty steps for full resolution score
+#define SWEEP_TIE             0.01    // Scores this close count as equal
+#define SWEEP_POINT_MS        2500    // Typical time per point (for the estimate)
+
+// Duties measured at each frequency, %
+extern const double g_sweep_duties[SWEEP_DUTIES];
+
+// Frequencies to try: pigpio's software PWM frequencies at the 1us and 5us
+// sample rates from SWEEP_MIN_HZ up (the backend snaps them to its own)
+#define SWEEP_NUM_CANDIDATES  19
+extern const unsigned g_sweep_candidates[SWEEP_NUM_CANDIDATES];
+
+typedef struct {
+    unsigned freq;
+    int real_range;            // Real duty steps (-1 = unknown)
+    double rpm[SWEEP_DUTIES];
+    double slope;              // RPM per duty %
+    double sustain;            // Zero crossing of the speed/duty line, duty %
+    double drive, linearity, resolution, score;
+} pwm_sweep_point;
+
+typedef struct {
+    int active;
+    int num_freqs;
+    pwm_sweep_point points[SWEEP_MAX_FREQS];
+    int freq_index, duty_index;
+    uint32_t point_start;      // ms
+    double sum;
+    int samples;
+    int best;                  // Index of the chosen frequency (-1 = none)
+} pwm_sweep;
+
+typedef enum {
+    SWEEP_RUNNING,             // Apply *freq and *duty
+    SWEEP_DONE,                // Result in sweep->best
+} pwm_sweep_status;
+
+void pwmSweepBegin(pwm_sweep* sweep, const unsigned* freqs, const int* real_ranges, int num_freqs,
+                   uint32_t now_ms);
+pwm_sweep_status pwmSweepStep(pwm_sweep* sweep, double rpm, double accel, uint32_t now_ms,
+                              unsigned* freq, double* duty);
+
+#endif // PWM_SWEEP_H
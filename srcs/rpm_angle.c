@@ -0,0 +1,105 @@
+/*
+ * rpm_angle.c
+ * Shaft angle observer. See rpm_angle.h.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "rpm_angle.h"
+
+/*
+ * Wrap to 0..1 and to -0.5..0.5 revolutions
+ */
+static double fracRev(double x) {
+    return x - floor(x);
+}
+
+static double wrapRev(double x) {
+    return x - floor(x + 0.5);
+}
+
+void rpmAngleInit(rpm_angle* obs) {
+    memset(obs, 0, sizeof(*obs));
+}
+
+/*
+ * Blade spacing table is both learned and measurably uneven, so its
+ * numbering is tied to the physical blades
+ */
+static int spacingIndexed(const rpm_estimator* est, const rpm_blade_cal* cal) {
+    if (est->blades < 2 || cal->revs < RPM_CAL_MIN_REVS) {
+        return 0;
+    }
+    for (int k = 0; k < est->blades; k++) {
+        if (fabs(cal->spacing[k] - 1.0 / est->blades) > RPM_CAL_MATCH_TOL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * FEED ONE EDGE
+ * Call after rpmEstimatorEdge() accepted an edge; edges of the other
+ * polarity are ignored.
+ */
+void rpmAngleEdge(rpm_angle* obs, const rpm_estimator* est, uint32_t tick, int level) {
+    int ref = (est->edges & RPM_EDGES_RISING) ? 1 : 0;
+    if ((level ? 1 : 0) != ref) {
+        return;
+    }
+
+    // Blade that starts the next gap, and its angle from blade 0
+    const rpm_blade_cal* cal = &est->cal[ref];
+    int indexed = spacingIndexed(est, cal);
+    double measured = 0.0;
+    for (int k = 0; k < cal->gap; k++) {
+        measured += indexed ? cal->spacing[k] : 1.0 / est->blades;
+    }
+
+    double rpm, accel;
+    rpmTrackerPredict(&est->tracker, tick, &rpm, &accel);
+    double dt = (double)(uint32_t)(tick - obs->tick) / 1e6;
+
+    if (obs->valid && obs->indexed == indexed && dt < RPM_ANGLE_MAX_GAP_S) {
+        double predicted = obs->angle + (obs->rps + obs->trim) * dt + 0.5 * obs->accel * dt * dt;
+        double residual = wrapRev(measured - predicted);
+        obs->residual = residual;
+        if (fabs(residual) > 0.5 / est->blades) {
+            // Numbering moved (calibration, missed blades): take the edge as is
+            obs->angle = measured;
+            obs->trim = 0.0;
+        } else {
+            obs->angle = fracRev(predicted + RPM_ANGLE_K1 * residual);
+            if (dt > 0.0) {
+                double limit = RPM_ANGLE_MAX_TRIM * fabs(rpm / 60.0);
+                obs->trim += RPM_ANGLE_K2 * residual / dt;
+                if (obs->trim > limit) obs->trim = limit;
+                if (obs->trim < -limit) obs->trim = -limit;
+            }
+        }
+    } else {
+        obs->angle = measured;
+        obs->trim = 0.0;
+        obs->residual = 0.0;
+    }
+
+    obs->valid = 1;
+    obs->indexed = indexed;
+    obs->tick = tick;
+    obs->rps = rpm / 60.0;
+    obs->accel = accel / 60.0;
+}
+
+/**
+ * ANGLE AT A TIME
+ * @return Shaft angle in degrees (0-360), or -1 if unknown (no recent edge)
+ */
+double rpmAngleAt(const rpm_angle* obs, uint32_t now) {
+    double dt = (double)(int32_t)(now - obs->tick) / 1e6;
+    if (!obs->valid || dt > RPM_ANGLE_MAX_GAP_S) {
+        return -1.0;
+    }
+    double travel = (obs->rps + obs->trim) * dt + 0.5 * obs->accel * dt * dt;
+    return fracRev(obs->angle + travel) * 360.0;
+}
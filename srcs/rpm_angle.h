@@ -0,0 +1,59 @@
+/*
+ * rpm_angle.h
+ * Shaft angle observer: rotor position between blade pulses.
+ *
+ * Blade edges say exactly where the rotor was at a few instants per
+ * revolution. Between them the observer extrapolates with the tracked speed
+ * and acceleration (rpm_tracker), so the angle is available at any time, not
+ * only at the edges:
+ *
+ *   angle(t) = angle_edge + (rps + trim) * dt + accel * dt^2 / 2
+ *
+ * At each edge of the reference polarity (rising if counted, else falling)
+ * the prediction is compared with the blade's known angle; the residual
+ * corrects the angle (RPM_ANGLE_K1) and a small speed trim (RPM_ANGLE_K2)
+ * that absorbs the tracker's remaining lag. A copy of the observer taken at
+ * the control rate extrapolates the same way, so readers do not need every
+ * edge. RPM_ANGLE_MAX_GAP_S after the last edge the angle is unknown (the
+ * rotor may have stopped anywhere).
+ *
+ * INDEX:
+ * Angle 0 is the reference edge of blade 0 of the estimator's blade
+ * numbering. Once the blade spacing is calibrated (rpm_estimator.h) and the
+ * blades are measurably unequal, that numbering follows the physical blades,
+ * so the spacing pattern acts as a once-per-revolution index: the angle is
+ * then absolute ('indexed'). Otherwise it is only known relative to an
+ * arbitrary blade (the same one while the sensor keeps tracking), and blade
+ * angles are taken as evenly spaced.
+ *
+ * All times are halTick() microseconds (wrapping 32-bit counter). Angles
+ * are in revolutions (0..1) internally and degrees in reports.
+ */
+
+#ifndef RPM_ANGLE_H
+#define RPM_ANGLE_H
+
+#include <stdint.h>
+#include "rpm_estimator.h"
+
+#define RPM_ANGLE_K1         0.5     // Angle correction per edge (fraction of residual)
+#define RPM_ANGLE_K2         0.05    // Speed trim correction per edge
+#define RPM_ANGLE_MAX_TRIM   0.05    // Trim limit, fraction of the speed
+#define RPM_ANGLE_MAX_GAP_S  0.5     // Longer gaps between edges restart the observer (angle unknown)
+
+typedef struct {
+    int valid;
+    int indexed;               // Angle referenced to the blade pattern
+    uint32_t tick;             // Time of the estimate
+    double angle;              // Revolutions, 0..1
+    double rps;                // Tracked speed, revolutions per second
+    double accel;              // Tracked acceleration, revolutions per second^2
+    double trim;               // Speed correction, revolutions per second
+    double residual;           // Last edge residual, revolutions
+} rpm_angle;
+
+void rpmAngleInit(rpm_angle* obs);
+void rpmAngleEdge(rpm_angle* obs, const rpm_estimator* est, uint32_t tick, int level);
+double rpmAngleAt(const rpm_angle* obs, uint32_t now);
+
+#endif // RPM_ANGLE_H
@@ -0,0 +1,575 @@
+/*
+ * rpm_estimator.c
+ * Glitch filter, blade pulse selection, period estimator with outlier
+ * rejection, blade spacing calibration and blade duty measurement.
+ * See rpm_estimator.h.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "rpm_estimator.h"
+#include "parmco_trace.h"
+
+static void calReset(rpm_blade_cal* cal, int blades) {
+    memset(cal, 0, sizeof(*cal));
+    for (int k = 0; k < blades; k++) {
+        cal->spacing[k] = 1.0 / blades;
+    }
+}
+
+/**
+ * =============================================================================
+ * SPEED/ACCELERATION TRACKER
+ * =============================================================================
+ * Kalman filter over x = [rpm, accel] with
+ *   predict: F = [1 dt; 0 1], Q = jerk^2 * [dt^3/3 dt^2/2; dt^2/2 dt]
+ *   measure: z = rpm at the interval midpoint = rpm - accel * interval/2,
+ *            H = [1, -interval/2], R = sigma_rpm^2
+ */
+
+void rpmTrackerInit(rpm_tracker* trk, double jerk) {
+    memset(trk, 0, sizeof(*trk));
+    trk->jerk = jerk;
+}
+
+static void trackerPredict(rpm_tracker* trk, double dt) {
+    double q = trk->jerk * trk->jerk;
+    double (*p)[2] = trk->p;
+
+    trk->rpm += trk->accel * dt;
+    p[0][0] += dt * (2.0 * p[0][1] + dt * p[1][1]) + q * dt * dt * dt / 3.0;
+    p[0][1] += dt * p[1][1] + q * dt * dt / 2.0;
+    p[1][0] = p[0][1];
+    p[1][1] += q * dt;
+}
+
+/**
+ * FUSE ONE SPEED MEASUREMENT
+ * @param tick: End of the measured interval (halTick() microseconds)
+ * @param rpm: Average RPM over the interval
+ * @param interval_us: Length of the measured interval
+ * @param sigma_rpm: Standard deviation of the measurement
+ */
+void rpmTrackerUpdate(rpm_tracker* trk, uint32_t tick, double rpm, double interval_us, double sigma_rpm) {
+    double dt = (double)(uint32_t)(tick - trk->tick) / 1e6;
+    double r = sigma_rpm * sigma_rpm;
+
+    if (!trk->valid || dt > RPM_KF_MAX_GAP_S) {
+        // (Re)start at the measurement with unknown acceleration
+        trk->valid = 1;
+        trk->tick = tick;
+        trk->rpm = rpm;
+        trk->accel = 0.0;
+        trk->p[0][0] = r;
+        trk->p[0][1] = trk->p[1][0] = 0.0;
+        trk->p[1][1] = RPM_KF_ACCEL0 * RPM_KF_ACCEL0;
+        return;
+    }
+
+    trackerPredict(trk, dt);
+    trk->tick = tick;
+
+    double (*p)[2] = trk->p;
+    double h = -interval_us / 2e6;  // Midpoint of the interval, in seconds before tick
+    double hp0 = p[0][0] + h * p[1][0];
+    double hp1 = p[0][1] + h * p[1][1];
+    double s = hp0 + h * hp1 + r;
+    double k0 = hp0 / s;
+    double k1 = hp1 / s;
+    double y = rpm - (trk->rpm + h * trk->accel);
+
+    trk->rpm += k0 * y;
+    trk->accel += k1 * y;
+    p[0][0] -= k0 * hp0;
+    p[0][1] -= k0 * hp1;
+    p[1][1] -= k1 * hp1;
+    p[1][0] = p[0][1];
+}
+
+/**
+ * EXTRAPOLATE TO NOW
+ * @param rpm, accel: Tracked speed and acceleration at 'now'
+ */
+void rpmTrackerPredict(const rpm_tracker* trk, uint32_t now, double* rpm, double* accel) {
+    double dt = (double)(uint32_t)(now - trk->tick) / 1e6;
+    *rpm = trk->rpm + trk->accel * dt;
+    *accel = trk->accel;
+}
+
+/**
+ * =============================================================================
+ * GLITCH FILTER
+ * =============================================================================
+ */
+
+void rpmGlitchFilterInit(rpm_glitch_filter* filter, uint32_t glitch_us) {
+    memset(filter, 0, sizeof(*filter));
+    filter->glitch_us = glitch_us;
+}
+
+/**
+ * FILTER A BATCH OF EDGES
+ * Passes on edges whose level then stayed steady for glitch_us. The newest
+ * edge is held back until a later edge or 'now' shows it was steady, so
+ * call this on every capture loop iteration, even with no new edges.
+ *
+ * @param in: Captured edges in time order
+ * @param num_edges: Number of edges in 'in'
+ * @param now: Current halTick() timestamp
+ * @param out: Filtered edges, room for num_edges + 1 entries (may not alias 'in')
+ * @return Number of edges stored in 'out'
+ */
+int rpmGlitchFilterRun(rpm_glitch_filter* filter, const hal_edge* in, int num_edges,
+                       uint32_t now, hal_edge* out) {
+    if (filter->glitch_us == 0) {
+        memcpy(out, in, sizeof(hal_edge) * num_edges);
+        return num_edges;
+    }
+
+    int n = 0;
+    for (int i = 0; i < num_edges; i++) {
+        if (!filter->have_pending) {
+            filter->pending = in[i];
+            filter->have_pending = 1;
+        } else if ((uint32_t)(in[i].tick - filter->pending.tick) < filter->glitch_us) {
+            // Short pulse: drop it and the edge that started it
+            PARMCO_TRACE2(edge_reject, filter->pending.tick, 0);
+            PARMCO_TRACE2(edge_reject, in[i].tick, 0);
+            filter->have_pending = 0;
+            filter->rejected += 2;
+        } else {
+            out[n++] = filter->pending;
+            filter->pending = in[i];
+        }
+    }
+    if (filter->have_pending && (uint32_t)(now - filter->pending.tick) >= filter->glitch_us) {
+        out[n++] = filter->pending;
+        filter->have_pending = 0;
+    }
+    return n;
+}
+
+/**
+ * =============================================================================
+ * PERIOD ESTIMATOR
+ * =============================================================================
+ */
+
+void rpmEstimatorInit(rpm_estimator* est, int edges, int blades) {
+    memset(est, 0, sizeof(*est));
+    est->edges = edges;
+    est->outlier_k = RPM_OUTLIER_K;
+    rpmTrackerInit(&est->tracker, RPM_KF_JERK);
+    est->blades = blades > 0 ? blades : 1;
+    if (est->blades > RPM_MAX_BLADES) est->blades = RPM_MAX_BLADES;
+    calReset(&est->cal[0], est->blades);
+    calReset(&est->cal[1], est->blades);
+}
+
+/*
+ * Learn from the revolution just completed in cal->rev_us[]. First checks
+ * that gap numbering still matches the table (an edge lost or added shifts
+ * it), then moves the table towards this revolution's gap shares.
+ */
+static void calLearnRevolution(rpm_blade_cal* cal, int blades) {
+    double rev_us = 0.0;
+    for (int k = 0; k < blades; k++) rev_us += cal->rev_us[k];
+    if (rev_us <= 0.0) return;
+
+    // Only learn from steady revolutions: acceleration stretches later gaps
+    int steady = cal->last_rev_us > 0.0 &&
+                 rev_us > cal->last_rev_us * (1.0 - RPM_CAL_STEADY) &&
+                 rev_us < cal->last_rev_us * (1.0 + RPM_CAL_STEADY);
+    cal->last_rev_us = rev_us;
+    if (!steady) return;
+
+    double share[RPM_MAX_BLADES];
+    for (int k = 0; k < blades; k++) share[k] = cal->rev_us[k] / rev_us;
+
+    if (cal->revs >= RPM_CAL_MIN_REVS) {
+        // Find the rotation of our numbering that best matches the table
+        int best_shift = 0;
+        double best_err = 0.0, err0 = 0.0, noise = 0.0;
+        for (int s = 0; s < blades; s++) {
+            double err = 0.0;
+            for (int k = 0; k < blades; k++) {
+                double d = share[(k + s) % blades] - cal->spacing[k];
+                err += d * d;
+            }
+            if (s == 0) err0 = err;
+            if (s == 0 || err < best_err) {
+                best_err = err;
+                best_shift = s;
+            }
+        }
+        // Spread of the table itself: shifts only make sense if blades differ
+        for (int k = 0; k < blades; k++) {
+            double d = cal->spacing[k] - 1.0 / blades;
+            noise += d * d;
+        }
+
+        if (best_err > noise + blades * RPM_CAL_MATCH_TOL * RPM_CAL_MATCH_TOL) {
+            // Matches no rotation (e.g. direction reversed): relearn after a few
+            if (++cal->mismatches >= RPM_CAL_RELEARN) {
+                calReset(cal, blades);
+            }
+            return;
+        }
+        cal->mismatches = 0;
+        if (best_shift != 0 && best_err * 4.0 < err0) {
+            // Our gap k is really table gap k - shift
+            double rotated[RPM_MAX_BLADES];
+            for (int k = 0; k < blades; k++) rotated[k] = share[(k + best_shift) % blades];
+            memcpy(share, rotated, sizeof(double) * blades);
+            cal->gap = (cal->gap - best_shift + blades) % blades;
+        }
+    }
+
+    // Running average while converging, then a slow exponential average
+    double gain = 1.0 / (cal->revs + 1);
+    if (gain < RPM_CAL_GAIN) gain = RPM_CAL_GAIN;
+    for (int k = 0; k < blades; k++) {
+        cal->spacing[k] += gain * (share[k] - cal->spacing[k]);
+    }
+    cal->revs++;
+}
+
+/*
+ * Next same-polarity interval corrected to an average blade pitch
+ * (interval / (gap share * blades)); the interval is not recorded
+ */
+static double calCorrect(const rpm_blade_cal* cal, int blades, double interval_us) {
+    double share = cal->spacing[cal->gap];
+    if (blades < 2 || cal->revs < RPM_CAL_MIN_REVS || share <= 0.0) {
+        return interval_us;
+    }
+    return interval_us / (share * blades);
+}
+
+// Record an accepted interval for its gap and move to the next gap
+static void calRecord(rpm_blade_cal* cal, int blades, double interval_us) {
+    if (blades < 2) return;
+    int gap = cal->gap;
+    cal->rev_us[gap] = interval_us;
+    if (cal->filled < blades) cal->filled++;
+    cal->gap = (gap + 1) % blades;
+    if (cal->gap == 0 && cal->filled == blades) {
+        calLearnRevolution(cal, blades);
+    }
+}
+
+static double medianOf(double* values, int n) {
+    // Insertion sort: n <= RPM_OUTLIER_WINDOW
+    for (int i = 1; i < n; i++) {
+        double v = values[i];
+        int j = i - 1;
+        while (j >= 0 && values[j] > v) {
+            values[j + 1] = values[j];
+            j--;
+        }
+        values[j + 1] = v;
+    }
+    return (n & 1) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+/*
+ * Classify a period against the median/MAD history:
+ * -1 = too short, +1 = too long, 0 = fine (or not enough history yet)
+ */
+static int outlierCheck(const rpm_outlier_history* hist, double k, double period_us) {
+    if (k <= 0.0 || hist->count < RPM_OUTLIER_WINDOW) return 0;
+
+    double sorted[RPM_OUTLIER_WINDOW], dev[RPM_OUTLIER_WINDOW];
+    memcpy(sorted, hist->period_us, sizeof(sorted));
+    double median = medianOf(sorted, RPM_OUTLIER_WINDOW);
+    for (int i = 0; i < RPM_OUTLIER_WINDOW; i++) dev[i] = fabs(hist->period_us[i] - median);
+    double scale = 1.4826 * medianOf(dev, RPM_OUTLIER_WINDOW);  // MAD -> standard deviation
+    if (scale < RPM_OUTLIER_FLOOR * median) scale = RPM_OUTLIER_FLOOR * median;
+
+    if (period_us < median - k * scale) return -1;
+    if (period_us > median + k * scale) return 1;
+    return 0;
+}
+
+static void outlierAdd(rpm_outlier_history* hist, double period_us) {
+    hist->period_us[hist->next] = period_us;
+    hist->next = (hist->next + 1) % RPM_OUTLIER_WINDOW;
+    if (hist->count < RPM_OUTLIER_WINDOW) hist->count++;
+}
+
+/**
+ * PARSE EDGE MODE
+ * @param name: "rising", "falling" or "both"
+ * @return RPM_EDGES_* or -1 if unknown
+ */
+int rpmEstimatorParseEdges(const char* name) {
+    if (strcmp(name, "rising") == 0) return RPM_EDGES_RISING;
+    if (strcmp(name, "falling") == 0) return RPM_EDGES_FALLING;
+    if (strcmp(name, "both") == 0) return RPM_EDGES_BOTH;
+    return -1;
+}
+
+const char* rpmEstimatorEdgesName(int edges) {
+    switch (edges) {
+        case RPM_EDGES_RISING:  return "rising";
+        case RPM_EDGES_FALLING: return "falling";
+        default:                return "both";
+    }
+}
+
+/**
+ * PULSES PER REVOLUTION
+ * One pulse per blade for single-edge modes, two in both-edge mode.
+ */
+int rpmEstimatorPulsesPerRev(const rpm_estimator* est) {
+    return est->edges == RPM_EDGES_BOTH ? 2 * est->blades : est->blades;
+}
+
+// Long-term average windows, in the order of rpm_views.avg
+static const uint32_t view_window_us[RPM_VIEW_WINDOWS] = {1000000, 10000000, 60000000};
+
+/*
+ * Close the buckets that ended before 'now' into the long-term history,
+ * keeping the 1 s/10 s/60 s window sums up to date
+ */
+static void viewsAdvance(rpm_view_history* v, uint32_t now) {
+    if (!v->started) {
+        v->bucket_start = now;
+        v->started = 1;
+        return;
+    }
+    int32_t elapsed = (int32_t)(now - v->bucket_start);
+    if (elapsed <= 0) {
+        return;         // Late edge (stamped before a views call moved on): counts into the open bucket
+    }
+    if (elapsed >= (int32_t)(RPM_VIEW_BUCKETS * RPM_VIEW_BUCKET_US)) {
+        // Idle longer than the whole history: everything in it is stale
+        memset(v->revs, 0, sizeof(v->revs));
+        memset(v->window_revs, 0, sizeof(v->window_revs));
+        v->next = 0;
+        v->count = RPM_VIEW_BUCKETS;
+        v->open_revs = 0.0;
+        v->bucket_start = now;
+        return;
+    }
+    while ((int32_t)(now - v->bucket_start) >= RPM_VIEW_BUCKET_US) {
+        for (int w = 0; w < RPM_VIEW_WINDOWS; w++) {
+            int n = (int)(view_window_us[w] / RPM_VIEW_BUCKET_US);
+            v->window_revs[w] += v->open_revs;
+            if (v->count >= n) {
+                v->window_revs[w] -= v->revs[(v->next - n + RPM_VIEW_BUCKETS) % RPM_VIEW_BUCKETS];
+            }
+        }
+        v->revs[v->next] = v->open_revs;
+        v->next = (v->next + 1) % RPM_VIEW_BUCKETS;
+        if (v->count < RPM_VIEW_BUCKETS) v->count++;
+        v->open_revs = 0.0;
+        v->bucket_start += RPM_VIEW_BUCKET_US;
+    }
+}
+
+/*
+ * Count 'gaps' blade gaps of revolution into the open bucket. With both
+ * polarities counted each gap is seen twice, once per polarity.
+ */
+static void viewsCount(rpm_estimator* est, int gaps) {
+    int polarities = est->edges == RPM_EDGES_BOTH ? 2 : 1;
+    est->views.open_revs += (double)gaps / (est->blades * polarities);
+}
+
+/**
+ * FEED ONE EDGE
+ * Updates period and duty from an edge of the IR sensor.
+ *
+ * @param tick: Edge timestamp (halTick() microseconds)
+ * @param level: Level after the edge (1 = blade arrived, 0 = blade left)
+ * @return 1 if the edge counts as a pulse in the selected mode, 0 if ignored
+ */
+int rpmEstimatorEdge(rpm_estimator* est, uint32_t tick, int level) {
+    int rising = level ? 1 : 0;
+    if (!(est->edges & (rising ? RPM_EDGES_RISING : RPM_EDGES_FALLING))) {
+        return 0;
+    }
+    viewsAdvance(&est->views, tick);
+
+    // Full blade period from the previous edge of the same polarity
+    if (est->have_last[rising]) {
+        double interval = (double)(uint32_t)(tick - est->last_tick[rising]);
+        if (interval <= 0.0) {
+            return 0;
+        }
+        double period = calCorrect(&est->cal[rising], est->blades, interval);
+        rpm_outlier_history* hist = &est->history[rising];
+        int outlier = outlierCheck(hist, est->outlier_k, period);
+
+        if (outlier != 0 && ++hist->run >= RPM_OUTLIER_MAX_RUN) {
+            // Persistent change: start the history again from here
+            hist->count = 0;
+            hist->next = 0;
+            outlier = 0;
+        }
+        if (outlier < 0) {
+            est->rejected_short++;
+            PARMCO_TRACE2(edge_reject, tick, 1);
+            return 0;  // Spurious edge: keep measuring from the last good one
+        }
+        if (outlier > 0) {
+            est->rejected_long++;
+            PARMCO_TRACE2(edge_reject, tick, 2);
+            // Skip the gaps of the missed edges and the revolution they broke
+            rpm_blade_cal* cal = &est->cal[rising];
+            int gaps = est->period_us > 0.0 ? (int)lround(period / est->period_us) : 1;
+            cal->gap = (cal->gap + gaps) % est->blades;
+            cal->filled = 0;
+            // A long dropout spans more gaps than the stale period says:
+            // credit the averages a few at most
+            viewsCount(est, gaps < RPM_VIEW_MAX_GAPS ? gaps : RPM_VIEW_MAX_GAPS);
+        } else {
+            hist->run = 0;
+            outlierAdd(hist, period);
+            calRecord(&est->cal[rising], est->blades, interval);
+            est->interval_us = interval;
+            est->period_us = period;
+            est->periods++;
+
+            double rpm = 60000000.0 / (period * est->blades);
+            int calibrated = est->blades < 2 || est->cal[rising].revs >= RPM_CAL_MIN_REVS;
+            double sigma = rpm * (calibrated ? RPM_KF_SIGMA_CAL : RPM_KF_SIGMA_RAW);
+            rpmTrackerUpdate(&est->tracker, tick, rpm, interval, sigma);
+
+            // Display view: time-constant average, so its smoothing does not
+            // depend on the edge rate
+            if (est->display_rpm <= 0.0) {
+                est->display_rpm = rpm;
+            } else {
+                double alpha = 1.0 - exp(-interval / (RPM_DISPLAY_TAU_S * 1e6));
+                est->display_rpm += alpha * (rpm - est->display_rpm);
+            }
+            viewsCount(est, 1);
+        }
+    }
+
+    // Blade occlusion time: rising edge to the following falling edge
+    if (!rising && est->edges == RPM_EDGES_BOTH && est->have_last[1]) {
+        est->high_us = (double)(uint32_t)(tick - est->last_tick[1]);
+        if (est->period_us > 0.0 && est->high_us < est->period_us) {
+            est->duty = est->high_us / est->period_us;
+        }
+    }
+
+    est->last_tick[rising] = tick;
+    est->have_last[rising] = 1;
+    est->last_pulse_tick = tick;
+    est->have_pulse = 1;
+    return 1;
+}
+
+/*
+ * The next edge of each counted polarity is due one period after the last
+ * one, so the period is at least the shortest wait so far
+ */
+static double waitedPeriod(const rpm_estimator* est, uint32_t now) {
+    uint32_t waited = UINT32_MAX;
+    for (int p = 0; p < 2; p++) {
+        if (est->have_last[p] && (uint32_t)(now - est->last_tick[p]) < waited) {
+            waited = now - est->last_tick[p];
+        }
+    }
+    return (double)waited;
+}
+
+/**
+ * TRACKED RPM
+ * Kalman tracker output extrapolated to 'now'. When edges stop arriving the
+ * motor is slowing down or stopped: the speed is limited to what the time
+ * already waited for the next edge allows, and drops to 0 once no edge has
+ * arrived for timeout_us.
+ *
+ * @param rpm: Tracked RPM (>= 0)
+ * @param accel: Tracked dRPM/dt in RPM per second
+ * @return 1 if valid, 0 if the tracker has no measurement yet
+ */
+int rpmEstimatorTrack(const rpm_estimator* est, uint32_t now, uint32_t timeout_us,
+                      double* rpm, double* accel) {
+    if (!est->tracker.valid) {
+        *rpm = 0.0;
+        *accel = 0.0;
+        return 0;
+    }
+    if ((uint32_t)(now - est->last_pulse_tick) > timeout_us) {
+        *rpm = 0.0;
+        *accel = 0.0;
+        return 1;
+    }
+
+    rpmTrackerPredict(&est->tracker, now, rpm, accel);
+
+    // Overdue edge: the speed is at most what that wait implies
+    double waited = waitedPeriod(est, now);
+    if (waited > est->period_us) {
+        double bound = 60000000.0 / (waited * est->blades);
+        if (*rpm > bound) {
+            *rpm = bound;
+            if (*accel > 0.0) *accel = 0.0;
+        }
+    }
+    if (*rpm < 0.0) *rpm = 0.0;
+    return 1;
+}
+
+/**
+ * RPM VIEWS
+ * All outputs at once, for the time 'now' (see rpm_views). Closes the
+ * long-term buckets up to 'now', so call it regularly (every update
+ * interval) even when no edges arrive.
+ *
+ * @param views: Filled in; all zero until the first period is measured
+ * @return 1 if fast/control/display are valid, 0 before the first period
+ */
+int rpmEstimatorViews(rpm_estimator* est, uint32_t now, uint32_t timeout_us, rpm_views* views) {
+    rpm_view_history* v = &est->views;
+    viewsAdvance(v, now);
+    for (int w = 0; w < RPM_VIEW_WINDOWS; w++) {
+        int n = (int)(view_window_us[w] / RPM_VIEW_BUCKET_US);
+        int have = v->count < n ? v->count : n;
+        views->avg[w] = have > 0 ? v->window_revs[w] * 60000000.0 / ((double)have * RPM_VIEW_BUCKET_US) : 0.0;
+    }
+
+    if (!rpmEstimatorTrack(est, now, timeout_us, &views->control, &views->accel) ||
+        est->period_us <= 0.0) {
+        views->fast = 0.0;
+        views->display = 0.0;
+        return 0;
+    }
+    if ((uint32_t)(now - est->last_pulse_tick) > timeout_us) {
+        views->fast = 0.0;
+        views->display = 0.0;
+        est->display_rpm = 0.0;  // Restart from the first interval after a stop
+        return 1;
+    }
+
+    views->fast = 60000000.0 / (est->period_us * est->blades);
+    views->display = est->display_rpm;
+
+    // Overdue edge: same bound as the tracked speed
+    double waited = waitedPeriod(est, now);
+    if (waited > est->period_us) {
+        double bound = 60000000.0 / (waited * est->blades);
+        if (views->fast > bound) views->fast = bound;
+        if (views->display > bound) views->display = bound;
+    }
+    return 1;
+}
+
+/**
+ * CALIBRATION STATE
+ * @return 1 once every counted edge polarity has a learned spacing table
+ */
+int rpmEstimatorCalibrated(const rpm_estimator* est) {
+    if (est->blades < 2) return 1;
+    for (int p = 0; p < 2; p++) {
+        int counted = est->edges & (p ? RPM_EDGES_RISING : RPM_EDGES_FALLING);
+        if (counted && est->cal[p].revs < RPM_CAL_MIN_REVS) return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,228 @@
+/*
+ * rpm_estimator.h
+ * Turns timestamped IR sensor edges into blade pulses, blade period, RPM and
+ * blade occlusion duty.
+ *
+ * The IR sensor reads HIGH while a blade covers it, so every blade pass
+ * produces one rising and one falling edge. Which edges count is configurable:
+ *
+ *   rising  - one pulse per blade at the leading edge of each blade
+ *   falling - one pulse per blade at the trailing edge
+ *   both    - two pulses per blade (default). Each edge gives a full blade
+ *             period measured from the previous edge of the SAME polarity,
+ *             so the period estimate updates twice per blade and does not
+ *             depend on blade width. Rise-to-fall time also gives the blade
+ *             occlusion duty (blade width / blade pitch).
+ *
+ * BLADE SPACING CALIBRATION:
+ * Real blades are not exactly 360/blades degrees apart, so raw blade periods
+ * ripple at blade frequency and needed long averaging. The estimator learns
+ * each gap's share of a revolution online (one table per edge polarity) from
+ * steady-speed revolutions, and divides every interval by its gap's share.
+ * Once calibrated (RPM_CAL_MIN_REVS revolutions) a single interval gives
+ * full-revolution accuracy. Missed or extra edges shift the gap numbering;
+ * this is detected by matching each revolution against the rotated table,
+ * and a table that no longer matches at all (reversal, new propeller) is
+ * relearned.
+ *
+ * NOISE REJECTION (two stages, each with a counter):
+ * 1. Glitch filter (rpm_glitch_filter, before the estimator): a level that
+ *    does not stay steady for glitch_us is dropped together with the edge
+ *    that started it, like pigpio's gpioGlitchFilter but also for DMA
+ *    samples and polling. Edges are delayed by up to glitch_us.
+ * 2. Interval outliers (in rpmEstimatorEdge): each spacing-corrected period
+ *    is compared with the median of the last RPM_OUTLIER_WINDOW periods of
+ *    the same polarity. Periods more than outlier_k robust deviations (MAD,
+ *    at least RPM_OUTLIER_FLOOR of the median) away are outliers:
+ *    - too short: a spurious edge (flicker at a blade edge). The edge is
+ *      dropped and the next real edge is measured from the last good one.
+ *    - too long: a missed edge. The edge is real and kept as the timing
+ *      reference, but its interval is not used.
+ *    RPM_OUTLIER_MAX_RUN outliers in a row mean the speed really changed:
+ *    the history restarts from the new period.
+ *
+ * SPEED/ACCELERATION TRACKER:
+ * Every accepted period also updates a two-state Kalman filter (rpm_tracker)
+ * with state [RPM, dRPM/dt] and a constant-acceleration model driven by
+ * white jerk. A period is the average speed over its interval, so it is
+ * applied as a measurement of the speed at the interval's midpoint, which
+ * removes the half-interval lag of plain averaging. The measurement noise
+ * follows the calibration state (blade ripple until calibrated). The result
+ * is a smooth RPM that still follows fast transients, and an acceleration
+ * estimate for the PID D-term.
+ *
+ * MULTI-RESOLUTION OUTPUTS (rpm_views):
+ * The same pass over the accepted edges feeds every consumer, each with the
+ * resolution it needs:
+ *   fast    - latest single interval, spacing-corrected (updates every edge)
+ *   control - Kalman-tracked speed and acceleration (PID)
+ *   display - exponential average with RPM_DISPLAY_TAU_S time constant
+ *             (console status line, phone)
+ *   1s/10s/60s - revolutions counted over the last 1, 10 and 60 seconds
+ *             divided by the time, from a ring of RPM_VIEW_BUCKET_US buckets
+ *             with running window sums (trend reporting)
+ * fast, control and display fall like the tracker when edges stop arriving;
+ * the long-term averages include the stopped time. A missed edge credits
+ * them the blade gaps it spanned at the last period, at most
+ * RPM_VIEW_MAX_GAPS: after a long sensor dropout the averages read low
+ * rather than extrapolate a speed nobody measured.
+ *
+ * All times are halTick() microseconds (wrapping 32-bit counter).
+ */
+
+#ifndef RPM_ESTIMATOR_H
+#define RPM_ESTIMATOR_H
+
+#include <stdint.h>
+#include "motor_hal.h"
+
+#define RPM_EDGES_RISING   1
+#define RPM_EDGES_FALLING  2
+#define RPM_EDGES_BOTH     (RPM_EDGES_RISING | RPM_EDGES_FALLING)
+
+#define RPM_MAX_BLADES     16
+#define RPM_CAL_MIN_REVS   8       // Steady revolutions before corrections are applied
+#define RPM_CAL_GAIN       0.05    // Learning rate once converged
+#define RPM_CAL_STEADY     0.05    // Max revolution-to-revolution change to learn from
+#define RPM_CAL_RELEARN    3       // Mismatching revolutions before relearning
+#define RPM_CAL_MATCH_TOL  0.01    // Per-gap share error still counted as a match (timing jitter)
+
+#define RPM_OUTLIER_WINDOW   9       // Periods in the median/MAD history
+#define RPM_OUTLIER_K        5.0     // Default rejection threshold in robust deviations
+#define RPM_OUTLIER_FLOOR    0.03    // Minimum deviation scale, fraction of the median
+#define RPM_OUTLIER_MAX_RUN  3       // Consecutive outliers accepted as a real speed change
+
+#define RPM_KF_JERK          3.0e4   // Process noise: RMS jerk density, RPM/s^2 per sqrt(Hz)
+#define RPM_KF_SIGMA_RAW     0.03    // Relative period noise before spacing calibration
+#define RPM_KF_SIGMA_CAL     0.003   // Relative period noise once calibrated
+#define RPM_KF_ACCEL0        2.0e4   // Initial acceleration uncertainty, RPM/s
+#define RPM_KF_MAX_GAP_S     0.5     // Longer gaps between measurements restart the filter
+
+#define RPM_DISPLAY_TAU_S    0.5     // Display view smoothing time constant
+#define RPM_VIEW_BUCKET_US   100000  // Long-term average resolution
+#define RPM_VIEW_BUCKETS     600     // Buckets kept (60 s)
+#define RPM_VIEW_WINDOWS     3       // 1 s, 10 s and 60 s averages
+#define RPM_VIEW_MAX_GAPS    3       // Missed blade gaps credited to the averages per edge
+
+/**
+ * Speed and acceleration tracker (two-state Kalman filter)
+ */
+typedef struct {
+    int valid;
+    uint32_t tick;             // Time of the estimate
+    double rpm;                // Speed
+    double accel;              // dRPM/dt in RPM per second
+    double p[2][2];            // Estimate covariance
+    double jerk;               // RPM_KF_JERK unless tuned
+} rpm_tracker;
+
+/**
+ * Simultaneous RPM outputs for the different consumers
+ */
+typedef struct {
+    double fast;               // Latest single interval
+    double control;            // Tracked speed
+    double accel;              // Tracked dRPM/dt in RPM per second
+    double display;            // Smoothed for display
+    double avg[RPM_VIEW_WINDOWS];     // 1 s, 10 s, 60 s averages (over less until filled)
+} rpm_views;
+
+/**
+ * Revolution counts per time bucket for the long-term averages
+ */
+typedef struct {
+    double revs[RPM_VIEW_BUCKETS];    // Revolutions in each closed bucket
+    int next;                         // Next bucket to write
+    int count;                        // Closed buckets (saturates at RPM_VIEW_BUCKETS)
+    double window_revs[RPM_VIEW_WINDOWS];   // Running sums over the last 10, 100, 600 buckets
+    uint32_t bucket_start;            // Start of the open bucket
+    int started;
+    double open_revs;                 // Revolutions in the open bucket
+} rpm_view_history;
+
+/**
+ * Software glitch filter for captured edges
+ */
+typedef struct {
+    uint32_t glitch_us;        // Minimum steady time of a level (0 = off)
+    hal_edge pending;          // Newest edge, held until it has been steady for glitch_us
+    int have_pending;
+    unsigned long rejected;    // Edges dropped
+} rpm_glitch_filter;
+
+/**
+ * Median/MAD history of one edge polarity
+ */
+typedef struct {
+    double period_us[RPM_OUTLIER_WINDOW];
+    int count;                 // Valid entries (saturates at RPM_OUTLIER_WINDOW)
+    int next;                  // Next write
+    int run;                   // Consecutive outliers
+} rpm_outlier_history;
+
+/**
+ * Learned blade spacing for one edge polarity
+ */
+typedef struct {
+    double spacing[RPM_MAX_BLADES];   // Share of a revolution of each gap (sums to 1)
+    double rev_us[RPM_MAX_BLADES];    // Intervals of the revolution in progress
+    int gap;                          // Gap number of the next interval
+    int filled;                       // Intervals seen (saturates at blades)
+    double last_rev_us;               // Previous revolution time, for the steady check
+    unsigned revs;                    // Revolutions learned from
+    int mismatches;                   // Consecutive revolutions not matching the table
+} rpm_blade_cal;
+
+typedef struct {
+    int edges;                 // RPM_EDGES_*
+    int blades;
+
+    // Edge history, indexed by level after the edge (0 = falling, 1 = rising)
+    uint32_t last_tick[2];
+    int have_last[2];
+    uint32_t last_pulse_tick;  // Last edge that counted as a pulse
+    int have_pulse;
+
+    // Blade spacing calibration, indexed like last_tick
+    rpm_blade_cal cal[2];
+
+    // Interval outlier rejection, indexed like last_tick
+    double outlier_k;          // 0 = off
+    rpm_outlier_history history[2];
+    unsigned long rejected_short;   // Spurious edges dropped
+    unsigned long rejected_long;    // Intervals spanning a missed edge, not used
+
+    // Latest measurements
+    double interval_us;        // Last raw same-polarity interval
+    double period_us;          // Blade period, spacing-corrected (0 until two same-polarity edges)
+    unsigned long periods;     // Periods accepted by the outlier check (period_us is the newest)
+    double high_us;            // Time the last blade covered the sensor (both mode)
+    double duty;               // high_us / period_us, 0 if not measured
+
+    // Speed/acceleration tracker, updated with every accepted period
+    rpm_tracker tracker;
+
+    // Display average and long-term revolution counts
+    double display_rpm;
+    rpm_view_history views;
+} rpm_estimator;
+
+void rpmTrackerInit(rpm_tracker* trk, double jerk);
+void rpmTrackerUpdate(rpm_tracker* trk, uint32_t tick, double rpm, double interval_us, double sigma_rpm);
+void rpmTrackerPredict(const rpm_tracker* trk, uint32_t now, double* rpm, double* accel);
+
+void rpmGlitchFilterInit(rpm_glitch_filter* filter, uint32_t glitch_us);
+int rpmGlitchFilterRun(rpm_glitch_filter* filter, const hal_edge* in, int num_edges,
+                       uint32_t now, hal_edge* out);
+
+void rpmEstimatorInit(rpm_estimator* est, int edges, int blades);
+int rpmEstimatorParseEdges(const char* name);
+const char* rpmEstimatorEdgesName(int edges);
+int rpmEstimatorPulsesPerRev(const rpm_estimator* est);
+int rpmEstimatorEdge(rpm_estimator* est, uint32_t tick, int level);
+int rpmEstimatorTrack(const rpm_estimator* est, uint32_t now, uint32_t timeout_us,
+                      double* rpm, double* accel);
+int rpmEstimatorViews(rpm_estimator* est, uint32_t now, uint32_t timeout_us, rpm_views* views);
+int rpmEstimatorCalibrated(const rpm_estimator* est);
+
+#endif // RPM_ESTIMATOR_H
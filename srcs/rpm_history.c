@@ -0,0 +1,156 @@
+/*
+ * rpm_history.c
+ * Round-robin history tiers of the motor state. See rpm_history.h.
+ */
+
+#include <string.h>
+#include "rpm_history.h"
+
+void rpmHistoryInit(rpm_history* hist) {
+    static const int sizes[RPM_HIST_TIERS] = {
+        RPM_HIST_TIER0_SIZE, RPM_HIST_TIER1_SIZE, RPM_HIST_TIER2_SIZE
+    };
+    static const int ratios[RPM_HIST_TIERS] = {1, 10, 60};   // 100 ms -> 1 s -> 1 min
+
+    memset(hist, 0, sizeof(*hist));
+    uint32_t step_ms = RPM_HIST_STEP_MS;
+    int offset = 0;
+    for (int k = 0; k < RPM_HIST_TIERS; k++) {
+        rpm_history_tier* tier = &hist->tiers[k];
+        step_ms *= ratios[k];
+        tier->step_ms = step_ms;
+        tier->ratio = ratios[k];
+        tier->size = sizes[k];
+        tier->offset = offset;
+        offset += sizes[k];
+    }
+}
+
+/*
+ * Accumulate one point of the tier below into tier k; every 'ratio' points
+ * store their mean and pass it on to the next tier
+ */
+static void tierAdd(rpm_history* hist, int k, const rpm_history_sample* s) {
+    rpm_history_tier* tier = &hist->tiers[k];
+    tier->sum_rpm += s->rpm;
+    tier->sum_setpoint += s->setpoint;
+    tier->sum_duty += s->duty;
+    if (++tier->acc < tier->ratio) {
+        return;
+    }
+
+    rpm_history_sample* out = &hist->pool[tier->offset + tier->next];
+    out->t_ms = s->t_ms;
+    out->rpm = (float)(tier->sum_rpm / tier->acc);
+    out->setpoint = (float)(tier->sum_setpoint / tier->acc);
+    out->duty = (float)(tier->sum_duty / tier->acc);
+    out->mode = s->mode;
+    tier->sum_rpm = tier->sum_setpoint = tier->sum_duty = 0.0;
+    tier->acc = 0;
+
+    tier->next = (tier->next + 1) % tier->size;
+    if (tier->count < tier->size) tier->count++;
+    if (k + 1 < RPM_HIST_TIERS) {
+        tierAdd(hist, k + 1, out);
+    }
+}
+
+/**
+ * RECORD SAMPLE
+ * Call every RPM_HIST_STEP_MS; the coarser tiers are filled from it.
+ *
+ * @param t_ms: Sample time (monotonic milliseconds)
+ * @param duty: Motor speed command in percent
+ * @param mode: 0 = manual, 1 = automatic
+ */
+void rpmHistoryRecord(rpm_history* hist, uint32_t t_ms, double rpm, double setpoint,
+                      double duty, int mode) {
+    rpm_history_sample s;
+    s.t_ms = t_ms;
+    s.rpm = (float)rpm;
+    s.setpoint = (float)setpoint;
+    s.duty = (float)duty;
+    s.mode = (uint8_t)mode;
+    tierAdd(hist, 0, &s);
+}
+
+/*
+ * Finest tier that reaches back to from_ms_ago, or the one reaching back
+ * furthest while the coarse tiers are still filling
+ */
+static const rpm_history_tier* pickTier(const rpm_history* hist, uint32_t from_ms_ago) {
+    const rpm_history_tier* best = &hist->tiers[0];
+    for (int k = 0; k < RPM_HIST_TIERS; k++) {
+        const rpm_history_tier* tier = &hist->tiers[k];
+        uint64_t span = (uint64_t)tier->count * tier->step_ms;
+        if (span >= from_ms_ago) {
+            return tier;
+        }
+        if (span > (uint64_t)best->count * best->step_ms) {
+            best = tier;
+        }
+    }
+    return best;
+}
+
+/**
+ * QUERY TIME RANGE
+ * Points between from_ms_ago and to_ms_ago before now_ms, oldest first.
+ * When more points fall in the range than max_points, groups of
+ * neighbouring points are merged (mean) to fit.
+ *
+ * @param out: Receives up to max_points points
+ * @param step_ms: Resolution of the returned points
+ * @return Number of points written to out
+ */
+int rpmHistoryQuery(const rpm_history* hist, uint32_t now_ms, uint32_t from_ms_ago,
+                    uint32_t to_ms_ago, rpm_history_sample* out, int max_points,
+                    uint32_t* step_ms) {
+    const rpm_history_tier* tier = pickTier(hist, from_ms_ago);
+    const rpm_history_sample* ring = &hist->pool[tier->offset];
+    int first = (tier->next - tier->count + tier->size) % tier->size;
+    *step_ms = tier->step_ms;
+    if (max_points <= 0 || from_ms_ago < to_ms_ago) {
+        return 0;
+    }
+
+    // Points in range (oldest first, so ages only decrease)
+    int matched = 0;
+    for (int i = 0; i < tier->count; i++) {
+        uint32_t age = now_ms - ring[(first + i) % tier->size].t_ms;
+        if (age <= from_ms_ago && age >= to_ms_ago) matched++;
+    }
+    int group = (matched + max_points - 1) / max_points;
+    if (group < 1) group = 1;
+    *step_ms = tier->step_ms * group;
+
+    // Groups end at the newest point; a partial group is left at the old end
+    int skip = matched % group;
+    int n = 0, acc = 0;
+    double sum_rpm = 0.0, sum_setpoint = 0.0, sum_duty = 0.0;
+    for (int i = 0; i < tier->count; i++) {
+        const rpm_history_sample* s = &ring[(first + i) % tier->size];
+        uint32_t age = now_ms - s->t_ms;
+        if (age > from_ms_ago || age < to_ms_ago) {
+            continue;
+        }
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+        sum_rpm += s->rpm;
+        sum_setpoint += s->setpoint;
+        sum_duty += s->duty;
+        if (++acc == group) {
+            out[n].t_ms = s->t_ms;
+            out[n].rpm = (float)(sum_rpm / acc);
+            out[n].setpoint = (float)(sum_setpoint / acc);
+            out[n].duty = (float)(sum_duty / acc);
+            out[n].mode = s->mode;
+            n++;
+            acc = 0;
+            sum_rpm = sum_setpoint = sum_duty = 0.0;
+        }
+    }
+    return n;
+}
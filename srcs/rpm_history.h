@@ -0,0 +1,76 @@
+/*
+ * rpm_history.h
+ * Fixed-memory, downsampled history of the motor state (RPM, duty,
+ * setpoint, control mode) for trend charts.
+ *
+ * Samples are recorded at 10 Hz and kept in round-robin tiers:
+ *
+ *   tier  resolution  kept   samples
+ *   0     100 ms      1 min   600
+ *   1     1 s         1 h    3600
+ *   2     1 min       24 h   1440
+ *
+ * Each tier is filled with the mean of RPM_HIST_TIER_RATIO samples of the
+ * tier below (the mode is the last one), so a coarse point summarizes
+ * everything that happened in its interval instead of picking one sample.
+ * All memory is allocated in the struct (about 90 KB); nothing goes to disk.
+ *
+ * A query for a time range picks the finest tier that still covers its
+ * start, and merges neighbouring points (mean) when the range holds more
+ * than the caller asked for.
+ *
+ * Times are milliseconds from any monotonic clock (wrapping 32-bit counter,
+ * about 49 days); queries are relative to 'now'.
+ */
+
+#ifndef RPM_HISTORY_H
+#define RPM_HISTORY_H
+
+#include <stdint.h>
+
+#define RPM_HIST_TIERS        3
+#define RPM_HIST_STEP_MS      100     // Tier 0 resolution (record interval)
+#define RPM_HIST_TIER0_SIZE   600     // 1 min
+#define RPM_HIST_TIER1_SIZE   3600    // 1 h
+#define RPM_HIST_TIER2_SIZE   1440    // 24 h
+#define RPM_HIST_TOTAL        (RPM_HIST_TIER0_SIZE + RPM_HIST_TIER1_SIZE + RPM_HIST_TIER2_SIZE)
+
+/**
+ * One history point (mean over its interval)
+ */
+typedef struct {
+    uint32_t t_ms;             // End of the interval
+    float rpm;
+    float setpoint;            // Target RPM (automatic mode)
+    float duty;                // Motor speed command in percent
+    uint8_t mode;              // Control mode at the end of the interval: 0 = manual, 1 = auto
+} rpm_history_sample;
+
+/**
+ * One round-robin tier, plus the accumulator building its next point
+ */
+typedef struct {
+    uint32_t step_ms;          // Resolution
+    int ratio;                 // Points of the tier below per point of this tier
+    int size;                  // Capacity
+    int offset;                // First entry in rpm_history.pool
+    int next;                  // Next write
+    int count;                 // Valid entries (saturates at size)
+
+    double sum_rpm, sum_setpoint, sum_duty;
+    int acc;                   // Points accumulated
+} rpm_history_tier;
+
+typedef struct {
+    rpm_history_tier tiers[RPM_HIST_TIERS];
+    rpm_history_sample pool[RPM_HIST_TOTAL];
+} rpm_history;
+
+void rpmHistoryInit(rpm_history* hist);
+void rpmHistoryRecord(rpm_history* hist, uint32_t t_ms, double rpm, double setpoint,
+                      double duty, int mode);
+int rpmHistoryQuery(const rpm_history* hist, uint32_t now_ms, uint32_t from_ms_ago,
+                    uint32_t to_ms_ago, rpm_history_sample* out, int max_points,
+                    uint32_t* step_ms);
+
+#endif // RPM_HISTORY_H
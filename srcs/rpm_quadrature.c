@@ -0,0 +1,73 @@
+/*
+ * rpm_quadrature.c
+ * Direction of rotation from a second IR sensor. See rpm_quadrature.h.
+ */
+
+#include <string.h>
+#include "rpm_quadrature.h"
+
+/**
+ * @param b_level: Current sensor B level (halRead), or -1 if unknown
+ */
+void rpmQuadratureInit(rpm_quadrature* quad, int b_level) {
+    memset(quad, 0, sizeof(*quad));
+    quad->b_level = b_level;
+}
+
+/*
+ * Apply queued B edges up to and including tick
+ */
+static void applySensorB(rpm_quadrature* quad, uint32_t tick) {
+    int used = 0;
+    while (used < quad->num_pending && (int32_t)(quad->pending[used].tick - tick) <= 0) {
+        quad->b_level = quad->pending[used].level ? 1 : 0;
+        used++;
+    }
+    if (used > 0) {
+        quad->num_pending -= used;
+        memmove(quad->pending, quad->pending + used, quad->num_pending * sizeof(hal_edge));
+    }
+}
+
+/**
+ * QUEUE SENSOR B EDGES
+ * In time order, as fetched. When the queue is full (A has stopped
+ * delivering edges) the oldest edges are applied straight away.
+ */
+void rpmQuadratureSensorB(rpm_quadrature* quad, const hal_edge* edges, int num_edges) {
+    for (int i = 0; i < num_edges; i++) {
+        if (quad->num_pending == RPM_QUAD_PENDING) {
+            applySensorB(quad, quad->pending[0].tick);
+        }
+        quad->pending[quad->num_pending++] = edges[i];
+    }
+}
+
+/**
+ * DECODE ONE SENSOR A EDGE
+ * @return Direction after this edge: +1 forward, -1 reverse, 0 unknown
+ */
+int rpmQuadratureEdge(rpm_quadrature* quad, uint32_t tick, int level) {
+    applySensorB(quad, tick);
+    if (quad->b_level < 0) {
+        return quad->direction;
+    }
+
+    int seen = quad->b_level != (level ? 1 : 0) ? 1 : -1;
+    if (quad->direction == 0) {
+        quad->direction = seen;
+    } else if (seen == quad->direction) {
+        quad->votes = 0;
+    } else {
+        if (seen != quad->candidate) {
+            quad->candidate = seen;
+            quad->votes = 0;
+        }
+        if (++quad->votes >= RPM_QUAD_CONFIRM) {
+            quad->direction = seen;
+            quad->votes = 0;
+            quad->reversals++;
+        }
+    }
+    return quad->direction;
+}
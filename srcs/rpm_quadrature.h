@@ -0,0 +1,53 @@
+/*
+ * rpm_quadrature.h
+ * Direction of rotation from a second, offset IR sensor.
+ *
+ * One sensor gives the speed but not its sign: a rotor slowing down through
+ * zero and spinning up backwards produces the same edges as one that keeps
+ * turning forward. A second sensor B, mounted a fraction of a blade pitch
+ * behind sensor A (less than the blade width), sees every blade shortly
+ * after A when turning forward and shortly before A when turning backward.
+ * Sampling B at each edge of A decodes the direction like a quadrature
+ * encoder:
+ *
+ *   forward:  A rises while B is still uncovered, A falls while B is covered
+ *             (B level != new A level)
+ *   reverse:  B level == new A level
+ *
+ * Only B's level at A's edges is used, so the blade duty need not be 50%
+ * and B's edges need no period measurement. A changed direction is only
+ * accepted after RPM_QUAD_CONFIRM consecutive agreeing A edges, so a single
+ * glitch cannot flip the sign. If the reported direction is inverted, swap
+ * the two sensor pins.
+ *
+ * B edges are queued with rpmQuadratureSensorB() and applied in time order
+ * as A edges arrive, so the two sensors may be fetched (and glitch-filtered)
+ * separately.
+ *
+ * All times are halTick() microseconds (wrapping 32-bit counter).
+ */
+
+#ifndef RPM_QUADRATURE_H
+#define RPM_QUADRATURE_H
+
+#include <stdint.h>
+#include "motor_hal.h"
+
+#define RPM_QUAD_CONFIRM   2      // Agreeing A edges before the direction changes
+#define RPM_QUAD_PENDING   64     // B edges held until an A edge is at least as new
+
+typedef struct {
+    int b_level;               // Sensor B level (-1 = unknown)
+    int direction;             // +1 forward, -1 reverse, 0 unknown
+    int candidate;             // Opposite direction being confirmed
+    int votes;                 // Consecutive A edges agreeing with candidate
+    unsigned long reversals;   // Confirmed direction changes
+    hal_edge pending[RPM_QUAD_PENDING];
+    int num_pending;
+} rpm_quadrature;
+
+void rpmQuadratureInit(rpm_quadrature* quad, int b_level);
+void rpmQuadratureSensorB(rpm_quadrature* quad, const hal_edge* edges, int num_edges);
+int rpmQuadratureEdge(rpm_quadrature* quad, uint32_t tick, int level);
+
+#endif // RPM_QUADRATURE_H
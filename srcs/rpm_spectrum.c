@@ -0,0 +1,206 @@
+/*
+ * rpm_spectrum.c
+ * Vibration and imbalance spectrum from blade pulse timing. See rpm_spectrum.h.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "rpm_spectrum.h"
+
+#define SPEC_MAX_EDGES  (RPM_SPEC_REVS * RPM_MAX_BLADES + 1)
+#define SPEC_MAX_GAP_US 500000   // Longer pauses between edges end the window
+#define SPEC_FIT_ROUNDS 4        // Joint speed fit / blade pattern refinements
+
+void rpmSpectrumFeedInit(rpm_spectrum_feed* feed) {
+    memset(feed, 0, sizeof(*feed));
+}
+
+/**
+ * FEED ONE EDGE (capture thread)
+ * Call after rpmEstimatorEdge() accepted an edge; edges of the other
+ * polarity are ignored.
+ */
+void rpmSpectrumFeedEdge(rpm_spectrum_feed* feed, const rpm_estimator* est, uint32_t tick, int level) {
+    int ref = (est->edges & RPM_EDGES_RISING) ? 1 : 0;
+    if ((level ? 1 : 0) != ref) {
+        return;
+    }
+    unsigned head = feed->head;
+    feed->tick[head % RPM_SPEC_FEED] = tick;
+    feed->blade[head % RPM_SPEC_FEED] = (uint8_t)(est->blades > 1 ? est->cal[ref].gap : 0);
+    __atomic_store_n(&feed->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Least-squares theta = c[0] + c[1] * t + c[2] * t^2
+ */
+static void fitQuadratic(const double* t, const double* theta, int n, double c[3]) {
+    double s[5] = {0}, y[3] = {0};
+    for (int i = 0; i < n; i++) {
+        double p = 1.0;
+        for (int k = 0; k < 5; k++) {
+            s[k] += p;
+            if (k < 3) y[k] += p * theta[i];
+            p *= t[i];
+        }
+    }
+    // Normal equations, Cramer's rule
+    double m[3][3] = { { s[0], s[1], s[2] }, { s[1], s[2], s[3] }, { s[2], s[3], s[4] } };
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                 m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                 m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    for (int col = 0; col < 3; col++) {
+        double a[3][3];
+        memcpy(a, m, sizeof(a));
+        for (int row = 0; row < 3; row++) a[row][col] = y[row];
+        double d = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) -
+                   a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+                   a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+        c[col] = det != 0.0 ? d / det : 0.0;
+    }
+}
+
+/*
+ * Goertzel magnitude of bin 'bin' of x[0..len-1]
+ */
+static double goertzel(const double* x, int len, double bin) {
+    double w = 2.0 * M_PI * bin / len;
+    double coeff = 2.0 * cos(w);
+    double s1 = 0.0, s2 = 0.0;
+    for (int i = 0; i < len; i++) {
+        double s = x[i] + coeff * s1 - s2;
+        s2 = s1;
+        s1 = s;
+    }
+    return sqrt(fmax(s1 * s1 + s2 * s2 - coeff * s1 * s2, 0.0));
+}
+
+/**
+ * ANALYZE (analysis thread)
+ * @param baseline: Spectrum of the healthy rotor for the imbalance score, or NULL
+ * @return 1 if spec is valid, 0 if there are too few contiguous revolutions
+ */
+int rpmSpectrumAnalyze(const rpm_spectrum_feed* feed, int blades, const rpm_spectrum* baseline,
+                       rpm_spectrum* spec) {
+    uint32_t tick[SPEC_MAX_EDGES];
+    uint8_t blade[SPEC_MAX_EDGES];
+    int pos[SPEC_MAX_EDGES];
+    double t[SPEC_MAX_EDGES], theta[SPEC_MAX_EDGES], adjusted[SPEC_MAX_EDGES], resid[SPEC_MAX_EDGES];
+    double uniform[RPM_SPEC_REVS * RPM_MAX_BLADES];
+
+    memset(spec, 0, sizeof(*spec));
+    if (blades < 1) blades = 1;
+    if (blades > RPM_MAX_BLADES) blades = RPM_MAX_BLADES;
+
+    // Copy the newest edges; if the writer lapped the copy, skip this round
+    unsigned head = __atomic_load_n(&feed->head, __ATOMIC_ACQUIRE);
+    int n = RPM_SPEC_REVS * blades + 1;
+    if ((unsigned)n > head) n = (int)head;
+    for (int i = 0; i < n; i++) {
+        unsigned idx = (head - n + i) % RPM_SPEC_FEED;
+        tick[i] = feed->tick[idx];
+        blade[i] = feed->blade[idx];
+    }
+    if (__atomic_load_n(&feed->head, __ATOMIC_ACQUIRE) - head > (unsigned)(RPM_SPEC_FEED - n)) {
+        return 0;
+    }
+    if (n < 2) return 0;
+
+    // Contiguous run ending at the newest edge, positions in blade steps
+    int start = n - 1;
+    pos[n - 1] = 0;
+    for (int i = n - 2; i >= 0; i--) {
+        int step = blades > 1 ? (blade[i + 1] - blade[i] + blades) % blades : 1;
+        if (step == 0 || (uint32_t)(tick[i + 1] - tick[i]) > SPEC_MAX_GAP_US) break;
+        pos[i] = pos[i + 1] - step;
+        start = i;
+        if (-pos[i] >= RPM_SPEC_REVS * blades) break;
+    }
+
+    // Whole revolutions only, so every blade slot counts equally
+    int revs = -pos[start] / blades;
+    if (revs < RPM_SPEC_MIN_REVS) return 0;
+    int first = n - 1;
+    while (first > start && pos[first - 1] > -revs * blades) first--;
+    int count = n - first;
+
+    // Speed and acceleration: quadratic fit around the window centre
+    uint32_t t0 = tick[first + count / 2];
+    for (int i = 0; i < count; i++) {
+        t[i] = (int32_t)(tick[first + i] - t0) / 1e6;
+        theta[i] = (double)pos[first + i] / blades;
+    }
+
+    // Residual: blade arrival angle error, degrees. The blade pattern is
+    // correlated with time inside each revolution, so the fit and the
+    // pattern are refined together (a few rounds converge)
+    double c[3];
+    double pattern[RPM_MAX_BLADES] = {0};
+    for (int round = 0; round < SPEC_FIT_ROUNDS; round++) {
+        for (int i = 0; i < count; i++) {
+            adjusted[i] = theta[i] - pattern[blade[first + i] % blades] / 360.0;
+        }
+        fitQuadratic(t, adjusted, count, c);
+        if (c[1] <= 0.0) return 0;
+
+        int slot_count[RPM_MAX_BLADES] = {0};
+        memset(pattern, 0, sizeof(pattern));
+        for (int i = 0; i < count; i++) {
+            resid[i] = (theta[i] - (c[0] + c[1] * t[i] + c[2] * t[i] * t[i])) * 360.0;
+            int slot = blade[first + i] % blades;
+            pattern[slot] += resid[i];
+            slot_count[slot]++;
+        }
+        for (int k = 0; k < blades; k++) {
+            if (slot_count[k] > 0) pattern[k] /= slot_count[k];
+        }
+    }
+
+    // Shaft orders of the synchronous pattern
+    spec->orders = blades / 2;
+    for (int h = 1; h <= spec->orders; h++) {
+        double scale = (2 * h == blades) ? 1.0 / blades : 2.0 / blades;
+        double re = 0.0, im = 0.0;
+        for (int k = 0; k < blades; k++) {
+            re += pattern[k] * cos(2.0 * M_PI * h * k / blades);
+            im -= pattern[k] * sin(2.0 * M_PI * h * k / blades);
+        }
+        spec->order_re[h - 1] = scale * re;
+        spec->order_im[h - 1] = scale * im;
+        spec->order_deg[h - 1] = scale * hypot(re, im);
+    }
+
+    // Non-synchronous part on a uniform blade grid (missed edges are zeros)
+    int len = revs * blades;
+    memset(uniform, 0, len * sizeof(double));
+    double sum_sq = 0.0;
+    for (int i = 0; i < count; i++) {
+        double j = resid[i] - pattern[blade[first + i] % blades];
+        uniform[pos[first + i] + len - 1] = j;
+        sum_sq += j * j;
+    }
+    spec->jitter_deg = sqrt(sum_sq / count);
+    for (int m = 1; m <= len / 2; m++) {
+        if (m % revs == 0) continue;   // Shaft orders, removed above
+        double amp = 2.0 * goertzel(uniform, len, m) / count;
+        if (amp > spec->peak_deg) {
+            spec->peak_deg = amp;
+            spec->peak_order = (double)m / revs;
+        }
+    }
+
+    // Imbalance: order-1 change against the baseline
+    if (spec->orders >= 1) {
+        if (baseline && baseline->valid && baseline->orders >= 1) {
+            spec->imbalance = hypot(spec->order_re[0] - baseline->order_re[0],
+                                    spec->order_im[0] - baseline->order_im[0]);
+        } else {
+            spec->imbalance = spec->order_deg[0];
+        }
+    }
+
+    spec->revs = revs;
+    spec->rpm = c[1] * 60.0;
+    spec->valid = 1;
+    return 1;
+}
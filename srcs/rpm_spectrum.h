@@ -0,0 +1,81 @@
+/*
+ * rpm_spectrum.h
+ * Vibration and imbalance spectrum from blade pulse timing jitter.
+ *
+ * A perfectly smooth rotor with perfect blades would pass its blades at
+ * exactly evenly spaced times. Imbalance, a damaged or bent blade, bearing
+ * wear and shaft vibration all modulate those times. The analysis works in
+ * the angle domain, on the edges of the reference polarity (rising if
+ * counted, else falling) of the last RPM_SPEC_REVS revolutions:
+ *
+ * 1. Each edge gets its nominal angle from the estimator's blade numbering,
+ *    theta_n = blade count / blades (missed edges skip their blades)
+ * 2. A quadratic fit theta(t) removes speed and acceleration; the residual
+ *    r_n (degrees) is how far each blade arrived early or late
+ * 3. Shaft orders: the mean residual of each blade slot over the window is
+ *    the synchronous pattern; its order-h component (h = 1..blades/2, the
+ *    highest order the blade count can resolve) is the per-order amplitude
+ * 4. Jitter: the residual minus the synchronous pattern is everything not
+ *    locked to the shaft. Its RMS is the jitter; a Goertzel sweep over
+ *    fractional orders (resolution 1/RPM_SPEC_REVS) finds its largest
+ *    non-synchronous peak (bearing defects, structural resonances)
+ *
+ * IMBALANCE:
+ * Order 1 is the once-per-revolution pattern. At one speed it cannot be
+ * told apart from fixed blade spacing errors (both move each blade's
+ * arrival the same way every revolution), so the imbalance score compares
+ * it with a baseline taken on the healthy rotor: the length of the vector
+ * change of the order-1 component, in degrees. Without a baseline the score
+ * is the order-1 amplitude itself.
+ *
+ * THREADING:
+ * The capture thread only appends each reference edge to an rpm_spectrum_feed
+ * (no locks, no maths); rpmSpectrumAnalyze() runs on a separate, slow
+ * thread and copies the feed without stopping the writer. All times are
+ * halTick() microseconds (wrapping 32-bit counter).
+ */
+
+#ifndef RPM_SPECTRUM_H
+#define RPM_SPECTRUM_H
+
+#include <stdint.h>
+#include "rpm_estimator.h"
+
+#define RPM_SPEC_FEED        1024    // Edges kept in a feed (power of two)
+#define RPM_SPEC_REVS        32      // Revolutions analysed
+#define RPM_SPEC_MIN_REVS    8       // Fewer contiguous revolutions: no spectrum
+#define RPM_SPEC_ORDERS      (RPM_MAX_BLADES / 2)
+#define RPM_SPEC_INTERVAL_MS 1000    // Analysis period
+
+/**
+ * Edge feed: single writer (capture thread), single reader (analysis thread)
+ */
+typedef struct {
+    uint32_t tick[RPM_SPEC_FEED];
+    uint8_t blade[RPM_SPEC_FEED];     // Estimator blade number of the edge
+    unsigned head;                    // Edges written (wraps), published last
+} rpm_spectrum_feed;
+
+/**
+ * Analysis result
+ */
+typedef struct {
+    int valid;
+    double revs;                      // Revolutions analysed
+    double rpm;                       // Mean speed over the window
+    int orders;                       // Shaft orders resolved (blades / 2)
+    double order_deg[RPM_SPEC_ORDERS];    // Amplitude of orders 1.., degrees
+    double order_re[RPM_SPEC_ORDERS];     // Order component, real/imaginary (degrees)
+    double order_im[RPM_SPEC_ORDERS];
+    double jitter_deg;                // RMS of the non-synchronous residual
+    double peak_order;                // Largest non-synchronous component (fractional order)
+    double peak_deg;
+    double imbalance;                 // Order-1 change against the baseline, degrees
+} rpm_spectrum;
+
+void rpmSpectrumFeedInit(rpm_spectrum_feed* feed);
+void rpmSpectrumFeedEdge(rpm_spectrum_feed* feed, const rpm_estimator* est, uint32_t tick, int level);
+int rpmSpectrumAnalyze(const rpm_spectrum_feed* feed, int blades, const rpm_spectrum* baseline,
+                       rpm_spectrum* spec);
+
+#endif // RPM_SPECTRUM_H
@@ -0,0 +1,149 @@
+/*
+ * rpm_sync.c
+ * Master/follower speed ratio and blade phase lock. See rpm_sync.h.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "rpm_sync.h"
+
+/*
+ * Wrap to -0.5..0.5 blade pitches
+ */
+static double wrapPitch(double x) {
+    return x - floor(x + 0.5);
+}
+
+/**
+ * START FOLLOWING
+ * Resets the controller; the follower then tracks ratio * master RPM.
+ *
+ * @param phase_lock: Also lock the blade phase (ratio 1 only)
+ * @param offset_deg: Follower lag behind the master in degrees of rotation
+ *                    (taken modulo one blade pitch)
+ * @param duty_step: PWM resolution in duty % to dither over (0 = exact duty)
+ */
+void rpmSyncStart(rpm_sync* sync, int master, double ratio, int phase_lock,
+                  double offset_deg, int blades, double duty_step) {
+    memset(sync, 0, sizeof(*sync));
+    sync->master = master;
+    sync->ratio = ratio;
+    sync->blades = blades > 0 ? blades : 1;
+    sync->phase_lock = phase_lock && fabs(ratio - 1.0) < 1e-9;
+    sync->phase_offset = wrapPitch(offset_deg * sync->blades / 360.0);
+    sync->duty_step = duty_step > 0.0 ? duty_step : 0.0;
+}
+
+/**
+ * PHASE SAMPLE
+ * Call with the latest follower and master edges of the same polarity;
+ * repeated calls without a new follower edge are ignored.
+ *
+ * @param master_period_us: Master blade period (0 while unknown)
+ */
+void rpmSyncPhaseSample(rpm_sync* sync, uint32_t follower_tick, uint32_t master_tick,
+                        double master_period_us) {
+    if (sync->have_edge && follower_tick == sync->last_edge) {
+        return;
+    }
+    sync->last_edge = follower_tick;
+    sync->have_edge = 1;
+    if (master_period_us <= 0.0) {
+        return;
+    }
+
+    // Signed difference: the master edge may be newer than the follower's
+    double phase = (int32_t)(follower_tick - master_tick) / master_period_us;
+    double err = wrapPitch(phase - sync->phase_offset);
+    double a = sync->phase_samples ? SYNC_PHASE_ALPHA : 1.0;
+    sync->phasor_cos += a * (cos(2.0 * M_PI * err) - sync->phasor_cos);
+    sync->phasor_sin += a * (sin(2.0 * M_PI * err) - sync->phasor_sin);
+    sync->phase_samples++;
+}
+
+/*
+ * Circular mean of the phase error in blade pitches
+ */
+static double phaseError(const rpm_sync* sync) {
+    return atan2(sync->phasor_sin, sync->phasor_cos) / (2.0 * M_PI);
+}
+
+/**
+ * CONTROLLER STEP
+ * Call once per control cycle while the follower is synchronized.
+ *
+ * @param master_duty: Master drive, duty %
+ * @param dt: Time since the last call in seconds
+ * @return Follower duty % (0-100, fractional)
+ */
+double rpmSyncUpdate(rpm_sync* sync, double master_duty, double master_rpm,
+                     double follower_rpm, double dt) {
+    double target = sync->ratio * master_rpm;
+
+    // Phase loop: a lagging follower gets a slightly higher target
+    double speed_match = target > 0.0 ? fabs(target - follower_rpm) / target : 1.0;
+    if (sync->phase_lock && sync->phase_samples > 0 && speed_match < SYNC_PHASE_CAPTURE) {
+        target += phaseError(sync) * 60.0 / (sync->blades * SYNC_PHASE_TAU_S);
+    }
+
+    double err = target - follower_rpm;
+    if (master_duty <= 0.0) {
+        // Master stopped: hold the learned trim for the restart
+        sync->duty = 0.0;
+        sync->lock_time_s = 0.0;
+        return 0.0;
+    }
+
+    sync->integral += SYNC_KI * err * dt;
+    if (sync->integral > SYNC_MAX_TRIM) sync->integral = SYNC_MAX_TRIM;
+    if (sync->integral < -SYNC_MAX_TRIM) sync->integral = -SYNC_MAX_TRIM;
+
+    double duty = sync->ratio * master_duty + SYNC_KP * err + sync->integral;
+    if (duty < 0.0) duty = 0.0;
+    if (duty > 100.0) duty = 100.0;
+    sync->duty = duty;
+
+    // Lock quality
+    double a = 1.0 - exp(-dt / SYNC_ERR_TAU_S);
+    sync->speed_err += a * ((sync->ratio * master_rpm - follower_rpm) - sync->speed_err);
+    rpm_sync_status status;
+    rpmSyncStatus(sync, &status);
+    int inside = target > 0.0 && fabs(sync->speed_err) < SYNC_LOCK_SPEED * sync->ratio * master_rpm;
+    if (sync->phase_lock) {
+        inside = inside && status.coherence > SYNC_LOCK_COHERENCE &&
+                 fabs(phaseError(sync)) < SYNC_LOCK_PHASE;
+    }
+    sync->lock_time_s = inside ? sync->lock_time_s + dt : 0.0;
+    return duty;
+}
+
+/**
+ * DUTY DITHER
+ * Call every SYNC_DITHER_MS. Spreads the controller's fractional duty over
+ * the two neighbouring PWM steps so that it is right on average.
+ *
+ * @return Duty % to write: a whole number of duty_steps, or the exact duty
+ *         without a step
+ */
+double rpmSyncDither(rpm_sync* sync) {
+    if (sync->duty_step <= 0.0 || sync->duty <= 0.0) {
+        sync->dither = 0.0;
+        return sync->duty;
+    }
+    double want = sync->duty + sync->dither;
+    double out = floor(want / sync->duty_step + 0.5) * sync->duty_step;
+    if (out < 0.0) out = 0.0;
+    if (out > 100.0) out = 100.0;
+    sync->dither = want - out;
+    return out;
+}
+
+/**
+ * LOCK-QUALITY TELEMETRY
+ */
+void rpmSyncStatus(const rpm_sync* sync, rpm_sync_status* status) {
+    status->speed_err = sync->speed_err;
+    status->phase_deg = sync->phase_samples ? phaseError(sync) * 360.0 / sync->blades : 0.0;
+    status->coherence = sync->phase_samples ? hypot(sync->phasor_cos, sync->phasor_sin) : 0.0;
+    status->locked = sync->lock_time_s >= SYNC_LOCK_HOLD_S;
+}
@@ -0,0 +1,117 @@
+/*
+ * rpm_sync.h
+ * Master/follower synchronization of two motor channels: speed ratio and,
+ * optionally, blade phase lock.
+ *
+ * Two rotors running at nearly the same speed beat against each other: the
+ * rig vibrates at the difference frequency. The follower is therefore driven
+ * from the master instead of from its own RPM target:
+ *
+ *   duty = ratio * master_duty        feedforward (similar motors)
+ *        + SYNC_KP * speed_error      fast correction
+ *        + integral                   motor-to-motor differences
+ *
+ *   speed_error = ratio * master_rpm + phase_trim - follower_rpm
+ *
+ * The duty is fractional (not whole percent like the manual and PID speed),
+ * so the speeds can be matched closer than one duty step.
+ *
+ * PHASE LOCK (ratio 1 only):
+ * Blades are identical, so only the phase within one blade pitch
+ * (360/blades degrees) matters. Each new follower blade edge is compared
+ * with the master's latest edge of the same polarity:
+ *
+ *   phase = (follower_tick - master_tick) / master_period   (mod 1)
+ *
+ * i.e. how far the master had turned, in blade pitches, when the follower
+ * blade arrived. phase - offset (wrapped to -0.5..0.5) is the phase error.
+ * Its circular mean (exponential average of the unit phasor) feeds the
+ * speed target, which moves the follower until the error is gone: a phase
+ * error of one whole pitch asks for 60 / (blades * SYNC_PHASE_TAU_S) RPM.
+ * The phase loop only runs once the speeds match within
+ * SYNC_PHASE_CAPTURE, because the phase is meaningless while it slides.
+ *
+ * DUTY DITHERING (software PWM):
+ * The phase trim is tiny - an error of SYNC_LOCK_PHASE asks for well under
+ * 1 RPM - while one software PWM step (1/255) is worth about 20 RPM. A duty
+ * rounded to whole steps therefore cannot settle the phase: it swings
+ * between the two neighbouring steps. With a PWM step given (duty_step),
+ * rpmSyncDither() is called every SYNC_DITHER_MS and returns whole-step
+ * duties whose running average is the fractional duty (first-order
+ * sigma-delta). The rotor's time constant (a few hundred ms) averages the
+ * alternation out. Hardware PWM resolves the duty directly (duty_step 0).
+ *
+ * LOCK QUALITY:
+ *   speed error - averaged follower RPM error, RPM
+ *   phase error - circular mean, degrees of rotation
+ *   coherence   - length of the averaged phasor: 1 = constant phase,
+ *                 0 = phase sliding (phase-locking value)
+ *   locked      - speed within SYNC_LOCK_SPEED (and, with phase lock,
+ *                 coherence above SYNC_LOCK_COHERENCE and phase within
+ *                 SYNC_LOCK_PHASE) for SYNC_LOCK_HOLD_S
+ *
+ * All times are halTick() microseconds (wrapping 32-bit counter).
+ */
+
+#ifndef RPM_SYNC_H
+#define RPM_SYNC_H
+
+#include <stdint.h>
+
+#define SYNC_KP               0.005   // Duty % per RPM of speed error
+#define SYNC_KI               0.02    // Duty % per RPM second
+#define SYNC_MAX_TRIM         20.0    // Integral limit, duty %
+#define SYNC_PHASE_TAU_S      4.0     // Phase error correction time constant
+#define SYNC_PHASE_ALPHA      0.1     // Phasor average weight per phase sample
+#define SYNC_PHASE_CAPTURE    0.02    // Speed match (fraction) before phase locking
+#define SYNC_ERR_TAU_S        1.0     // Speed error average time constant
+#define SYNC_LOCK_SPEED       0.01    // Max speed error (fraction) when locked
+#define SYNC_LOCK_PHASE       0.05    // Max phase error (blade pitches) when locked
+#define SYNC_LOCK_COHERENCE   0.9     // Min phasor length when locked
+#define SYNC_LOCK_HOLD_S      1.0     // Time inside the limits before reporting lock
+#define SYNC_DITHER_MS        5       // rpmSyncDither() period under software PWM
+
+/**
+ * Lock-quality telemetry
+ */
+typedef struct {
+    double speed_err;          // Averaged follower error, RPM
+    double phase_deg;          // Circular mean phase error, degrees of rotation
+    double coherence;          // 0..1, phase stability
+    int locked;
+} rpm_sync_status;
+
+typedef struct {
+    int master;                // Channel followed
+    double ratio;              // Follower RPM / master RPM
+    int phase_lock;
+    double phase_offset;       // Follower lag behind the master, blade pitches
+    int blades;
+
+    // Phase detector
+    uint32_t last_edge;        // Follower edge of the last phase sample
+    int have_edge;
+    double phasor_cos, phasor_sin;   // Averaged unit phasor of the phase error
+    unsigned long phase_samples;
+
+    // Controller
+    double integral;           // Duty %
+    double duty;               // Last output, duty %
+    double speed_err;          // Averaged speed error, RPM
+    double lock_time_s;        // Time inside the lock limits
+
+    // Duty dither
+    double duty_step;          // PWM resolution, duty % (0 = exact duty)
+    double dither;             // Sigma-delta residue, duty %
+} rpm_sync;
+
+void rpmSyncStart(rpm_sync* sync, int master, double ratio, int phase_lock,
+                  double offset_deg, int blades, double duty_step);
+void rpmSyncPhaseSample(rpm_sync* sync, uint32_t follower_tick, uint32_t master_tick,
+                        double master_period_us);
+double rpmSyncUpdate(rpm_sync* sync, double master_duty, double master_rpm,
+                     double follower_rpm, double dt);
+double rpmSyncDither(rpm_sync* sync);
+void rpmSyncStatus(const rpm_sync* sync, rpm_sync_status* status);
+
+#endif // RPM_SYNC_H
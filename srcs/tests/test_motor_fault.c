@@ -0,0 +1,140 @@
+/*
+ * test_motor_fault.c
+ * Regression tests for the stall detector (motor_fault.c) fed the way
+ * faultInput() feeds it: every IR edge for dropouts, the estimator's
+ * accepted blade periods for slowing.
+ *
+ * A simulated 3-blade rotor is stepped in 5 us increments; both edges of
+ * every blade are captured.
+ *
+ * Compilation (from srcs/tests):
+ * gcc -O2 -o test_motor_fault test_motor_fault.c ../motor_fault.c ../rpm_estimator.c -lm
+ *
+ * Run:
+ * ./test_motor_fault   (exit status 0 when every case passes)
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "../motor_fault.h"
+#include "../rpm_estimator.h"
+
+#define BLADES      3
+#define BLADE_SHARE 0.4      // Part of each blade sector the blade covers
+#define STEP_US     5
+
+typedef struct {
+    rpm_estimator est;
+    motor_fault fault;
+    motor_fault_input in;
+    uint32_t edge_ring[FAULT_EDGE_HISTORY];
+    double period_ring[FAULT_PERIOD_HISTORY];
+    uint32_t period_tick_ring[FAULT_PERIOD_HISTORY];
+    unsigned long edges;
+    unsigned long accepted;
+} rig;
+
+static void rigEdge(rig* r, uint32_t tick, int level) {
+    r->edge_ring[r->edges++ % FAULT_EDGE_HISTORY] = tick;
+    unsigned long accepted = r->est.periods;
+    if (rpmEstimatorEdge(&r->est, tick, level) && r->est.periods != accepted) {
+        r->period_ring[r->accepted % FAULT_PERIOD_HISTORY] = r->est.period_us;
+        r->period_tick_ring[r->accepted++ % FAULT_PERIOD_HISTORY] = tick;
+    }
+}
+
+static motor_fault_event rigCheck(rig* r, uint32_t now, double rpm) {
+    motor_fault_input* in = &r->in;
+    in->edges = r->edges;
+    in->num_ticks = r->edges < FAULT_EDGE_HISTORY ? (int)r->edges : FAULT_EDGE_HISTORY;
+    for (int k = 0; k < in->num_ticks; k++) {
+        in->edge_ticks[k] = r->edge_ring[(r->edges - in->num_ticks + k) % FAULT_EDGE_HISTORY];
+    }
+    in->num_periods = r->accepted < FAULT_PERIOD_HISTORY ? (int)r->accepted : FAULT_PERIOD_HISTORY;
+    for (int k = 0; k < in->num_periods; k++) {
+        unsigned long i = (r->accepted - in->num_periods + k) % FAULT_PERIOD_HISTORY;
+        in->periods[k] = r->period_ring[i];
+        in->period_ticks[k] = r->period_tick_ring[i];
+    }
+    in->periods_per_rev = rpmEstimatorPulsesPerRev(&r->est);
+    in->edges_until = now;
+    in->driven = 1;
+    in->duty = 50.0;
+    in->rpm = rpm;
+    return motorFaultCheck(&r->fault, in, now);
+}
+
+/*
+ * Runs the rotor at rpm for run_s; with jam_tau_s > 0 it then slows with
+ * that time constant. drop_at_s drops the first edge after that time, and
+ * the sensor sees nothing from lose_at_s on (< 0: never).
+ * @return The fault raised, FAULT_NONE if none
+ */
+static motor_fault_kind runRotor(double rpm, double run_s, double jam_tau_s, double drop_at_s,
+                                 double lose_at_s) {
+    static rig r;
+    rpmEstimatorInit(&r.est, RPM_EDGES_BOTH, BLADES);
+    motorFaultReset(&r.fault);
+    r.fault.last_edges = 0;
+    r.edges = r.accepted = 0;
+
+    double revs = 0.0, speed = rpm / 60.0;   // Rev/s
+    long sector = 0, covered = -1;
+    int dropped = drop_at_s < 0.0;
+    double end_s = run_s + (jam_tau_s > 0.0 ? 10.0 * jam_tau_s + 0.2 : 0.0);
+    if (lose_at_s >= 0.0 && end_s < lose_at_s + 0.2) end_s = lose_at_s + 0.2;
+    for (long step = 1; step * STEP_US * 1e-6 < end_s; step++) {
+        double t = step * STEP_US * 1e-6;
+        uint32_t tick = 1000 + (uint32_t)(step * STEP_US);
+        if (jam_tau_s > 0.0 && t > run_s) {
+            speed *= exp(-STEP_US * 1e-6 / jam_tau_s);
+        }
+        revs += speed * STEP_US * 1e-6;
+        double s = revs * BLADES;
+        for (int level = 1; level >= 0; level--) {
+            long* count = level ? &sector : &covered;
+            long now_count = (long)floor(level ? s : s - BLADE_SHARE);
+            if (now_count == *count) continue;
+            *count = now_count;
+            if (lose_at_s >= 0.0 && t >= lose_at_s) {
+                continue;
+            }
+            if (!dropped && t >= drop_at_s) {
+                dropped = 1;
+                continue;
+            }
+            rigEdge(&r, tick, level);
+        }
+        if (step % (FAULT_STEP_MS * 1000 / STEP_US) == 0 &&
+            rigCheck(&r, tick, speed * 60.0) == FAULT_RAISED) {
+            printf("   %s: %s\n", motorFaultName(r.fault.fault), r.fault.reason);
+            return r.fault.fault;
+        }
+    }
+    return FAULT_NONE;
+}
+
+static int failures = 0;
+
+static void expect(const char* name, motor_fault_kind got, motor_fault_kind want) {
+    printf("%s %s\n", got == want ? "PASS" : "FAIL", name);
+    if (got != want) failures++;
+}
+
+int main(void) {
+    static const double speeds[] = {1000.0, 2000.0, 2500.0, 4000.0, 6000.0};
+    char name[96];
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        snprintf(name, sizeof(name), "steady %.0f RPM, no fault", speeds[i]);
+        expect(name, runRotor(speeds[i], 2.0, 0.0, -1.0, -1.0), FAULT_NONE);
+        snprintf(name, sizeof(name), "steady %.0f RPM, one dropped edge is no fault", speeds[i]);
+        expect(name, runRotor(speeds[i], 2.0, 0.0, 1.0, -1.0), FAULT_NONE);
+        snprintf(name, sizeof(name), "steady %.0f RPM, dropped edge then no edges is a lost sensor", speeds[i]);
+        expect(name, runRotor(speeds[i], 2.0, 0.0, 1.0, 1.0 + 30.0 / speeds[i]), FAULT_SENSOR);
+    }
+    expect("2500 RPM jammed (20 ms time constant) is a stall", runRotor(2500.0, 1.0, 0.02, -1.0, -1.0),
+           FAULT_STALL);
+    expect("4000 RPM jammed (40 ms time constant) is a stall", runRotor(4000.0, 1.0, 0.04, -1.0, -1.0),
+           FAULT_STALL);
+    return failures > 0;
+}
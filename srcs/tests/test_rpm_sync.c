@@ -0,0 +1,135 @@
+/*
+ * test_rpm_sync.c
+ * Regression tests for the blade phase lock (rpm_sync.c) under software
+ * PWM: the follower's duty is only written in 1/255 steps, like
+ * writeDuty() does, and must still hold the phase well inside
+ * SYNC_LOCK_PHASE. Without dithering the duty swings between two steps and
+ * the phase error wanders over most of the lock limit.
+ *
+ * Two first-order motors (slightly different, like two real ones) are
+ * stepped in 20 us increments, with edge times to the microsecond. Every follower blade edge is a phase sample
+ * against the master's latest edge, the controller runs every control
+ * cycle and the duty is dithered every SYNC_DITHER_MS, as in the main loop.
+ *
+ * Compilation (from srcs/tests):
+ * gcc -O2 -o test_rpm_sync test_rpm_sync.c ../rpm_sync.c -lm
+ *
+ * Run:
+ * ./test_rpm_sync   (exit status 0 when every case passes)
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "../rpm_sync.h"
+
+#define BLADES       3
+#define STEP_US      20
+#define CONTROL_MS   100
+#define PWM_RANGE    255
+#define SETTLE_S     40.0    // Capture and lock before checking
+#define CHECK_S      20.0    // Phase must stay locked this long
+#define MAX_PHASE    (SYNC_LOCK_PHASE / 4)   // Largest phase error allowed, blade pitches
+
+typedef struct {
+    double slope;            // RPM per duty % above sustain
+    double sustain;          // Duty % that just keeps it turning
+    double tau_s;
+    double imbalance;        // Once-per-revolution speed ripple (fraction)
+    double rpm;
+    double revs;
+    long blade;              // Blade edges so far
+    uint32_t edge[BLADES + 1];   // Edges of the last revolution
+    uint32_t last_edge;
+    double period_us;
+} motor;
+
+/*
+ * Duty actually produced by a software PWM output (nearest 1/255 step)
+ */
+static double pwmDuty(double duty) {
+    return lround(duty * PWM_RANGE / 100.0) * 100.0 / PWM_RANGE;
+}
+
+/*
+ * Advances the motor by one step to tick
+ * @return 1 on a new blade edge (last_edge, period_us updated)
+ */
+static int motorStep(motor* mt, double duty, uint32_t tick) {
+    double drive = duty > mt->sustain ? mt->slope * (duty - mt->sustain) : 0.0;
+    double before = mt->revs * BLADES;
+    mt->rpm += (drive - mt->rpm) * STEP_US * 1e-6 / mt->tau_s;
+    mt->revs += mt->rpm * (1.0 + mt->imbalance * sin(2.0 * M_PI * mt->revs)) / 60.0 * STEP_US * 1e-6;
+    long blade = (long)floor(mt->revs * BLADES);
+    if (blade == mt->blade) return 0;
+    mt->blade = blade;
+    mt->period_us = 60e6 / (mt->rpm * BLADES);
+    // Edge time to the microsecond, like the capture timestamps
+    double late = (mt->revs * BLADES - blade) / (mt->revs * BLADES - before);
+    mt->last_edge = tick - (uint32_t)lround(late * STEP_US);
+    mt->edge[blade % (BLADES + 1)] = mt->last_edge;
+    return 1;
+}
+
+/*
+ * Speed measured over the last revolution (like the estimator's calibrated
+ * intervals, free of the imbalance ripple)
+ */
+static double motorRpm(const motor* mt) {
+    uint32_t rev_us = mt->last_edge - mt->edge[(mt->blade + 1) % (BLADES + 1)];
+    return mt->blade > BLADES && rev_us > 0 ? 60e6 / rev_us : mt->rpm;
+}
+
+/*
+ * Runs a phase-locked pair with the master at master_duty
+ * @return Largest phase error while checking, blade pitches (1 if never locked)
+ */
+static double runPair(double master_duty, double offset_deg) {
+    motor master = { 68.0, 12.6, 0.34, 0.0, 0.0, 0.0, 0, {0}, 0, 0.0 };
+    motor follower = { 64.0, 11.8, 0.30, 0.01, 0.0, 0.37, 0, {0}, 0, 0.0 };
+    rpm_sync sync;
+    rpmSyncStart(&sync, 0, 1.0, 1, offset_deg, BLADES, 100.0 / PWM_RANGE);
+
+    double applied = pwmDuty(master_duty), worst = 0.0;
+    int locked = 1;
+    double dt = CONTROL_MS / 1000.0;
+    for (long step = 1; step * STEP_US * 1e-6 < SETTLE_S + CHECK_S; step++) {
+        double t = step * STEP_US * 1e-6;
+        uint32_t tick = 1000 + (uint32_t)(step * STEP_US);
+        motorStep(&master, pwmDuty(master_duty), tick);
+        if (motorStep(&follower, applied, tick) && master.period_us > 0.0) {
+            rpmSyncPhaseSample(&sync, follower.last_edge, master.last_edge, master.period_us);
+        }
+        if (step % (CONTROL_MS * 1000 / STEP_US) == 0) {
+            double duty = rpmSyncUpdate(&sync, pwmDuty(master_duty), motorRpm(&master),
+                                        motorRpm(&follower), dt);
+            applied = pwmDuty(duty);
+            if (t >= SETTLE_S) {
+                rpm_sync_status status;
+                rpmSyncStatus(&sync, &status);
+                double err = fabs(status.phase_deg) * BLADES / 360.0;
+                if (err > worst) worst = err;
+                locked = locked && status.locked;
+            }
+        }
+        if (step % (SYNC_DITHER_MS * 1000 / STEP_US) == 0) {
+            applied = pwmDuty(rpmSyncDither(&sync));
+        }
+    }
+    return locked ? worst : 1.0;
+}
+
+static int failures = 0;
+
+static void expectLocked(const char* name, double worst) {
+    int ok = worst < MAX_PHASE;
+    printf("%s %s (largest phase error %.3f pitches)\n", ok ? "PASS" : "FAIL", name, worst);
+    if (!ok) failures++;
+}
+
+int main(void) {
+    expectLocked("50% master, 30 deg lag, stays locked", runPair(50.0, 30.0));
+    expectLocked("50% master, no lag, stays locked", runPair(50.0, 0.0));
+    expectLocked("35% master, 60 deg lag, stays locked", runPair(35.0, 60.0));
+    expectLocked("80% master, 90 deg lag, stays locked", runPair(80.0, 90.0));
+    return failures > 0;
+}